@@ -3,6 +3,7 @@
 #include <cmath>
 #include <string>
 #include <vector>
+#include <algorithm>
 #include <iomanip>
 #include <fstream>
 #include <iostream>
@@ -98,6 +99,7 @@ void C60_sp(TSIN Input)
   int PotFlag = Input.GetInt("CsixtyPotential", "Potential", 1);
   int PotVerb = Input.GetInt("CsixtyPotential", "Verbose", 1);
   Vel.SetVerbose(PotVerb);
+  Vel.SetHMatrix(Input.GetDouble("CsixtyPotential", "HMatrixTol", 0.0));
   int nMolecules  = Input.GetInt("CsixtyPotential", "nMolecules", 1);
   int nAtomsArray[nMolecules]; 
   double DipoleArray[nMolecules];
@@ -119,6 +121,7 @@ void C60_sp(TSIN Input)
       PotPara[11] = Input.GetDouble("CsixtyPotential", "CarbonType", 1) ; //extra nuclear charge
 
       PotPara[12] = Input.GetDouble("CsixtyPotential", "AlphaComp", 4) ; //A switch that determines which component of the Polarizability will be evaluated, 1 - charge flow, 2 - cross-term, 3 - Induced Dipole, 4 - Sum.
+      PotPara[13] = Input.GetDouble("CsixtyPotential", "FarField", 0.0) ; //coronene: multipole expansion of a molecule beyond FarField molecule radii, 0 = off
       
       Input.GetIntArray("CsixtyPotential", "nAtomsArray", nAtomsArray, nMolecules);
       Input.GetDoubleArray("CsixtyPotential", "DipoleArray", DipoleArray, nMolecules);
@@ -392,6 +395,7 @@ void Potential::SetupFullerElec(int nr, const double *rSites, const double *PotP
   Rtol =  PotPara[10] ; 
   CarbonType = PotPara[11] ;
   AlphaComp = PotPara[12] ;
+  FarFieldCsixty = PotPara[13] ;
 
   AtomType  = new int[nr];
 
@@ -400,7 +404,6 @@ void Potential::SetupFullerElec(int nr, const double *rSites, const double *PotP
 
   nAtomsArray.resize(nFullerenes) ;
   nReturnEnergies = 5;
-  ReturnEnergies.resize(nReturnEnergies) ;
   for (int i = 0 ; i < nFullerenes ; ++i) {
     nAtomsArray[i] = NoAtomsArray[i] ; 
   }
@@ -416,6 +419,7 @@ void Potential::SetupFullerElec(int nr, const double *rSites, const double *PotP
     cout << "PotPara 6: " << PotPara[6] << " (Verbosity) \n";
     cout << "PotPara 7: " << PotPara[7] << " (Extra Nuclear Charge for KT stabilization) \n";
     cout << "PotPara 8: " << PotPara[8] << " (Repulsive flag) = 0 (no repulsion) =1 (gaussian repulsion) \n";
+    cout << "PotPara 13: " << PotPara[13] << " (FarField) coronene multipole expansion beyond FarField molecule radii, 0 = off \n";
     cout << "------------------------\n";
   //}
   SetSites(nr, rSites);
@@ -452,6 +456,19 @@ void Potential::SetupFullerElec(int nr, const double *rSites, const double *PotP
   //  for (int i=0 ; i < (4*nr + 1)*(4*nr + 1) ; i++) 
    //    cout<<" MolPol[0].InvA[0] = "<< MolPol[0].InvA[i]<<endl;
     }
+  // optional H-matrix copy of InvA: the charge i and the dipole rows nr+3i+a belong to
+  // site i, the charge constraints are border rows
+  if (PolFlagCsixty == 1 || PolFlagCsixty == 3 || PolFlagCsixty == 6) {
+    int npol = CsixtyPolDim();
+    iVec site(npol, -1);
+    for (int i = 0; i < nr; ++i) {
+      site[i] = i;
+      for (int a = 0; a < 3; ++a)
+        site[nr+3*i+a] = i;
+    }
+    MolPol[0].InvAH.Setup(npol, &MolPol[0].InvA[0], (PolFlagCsixty == 1) ? "U" : "L", &site[0], nr, rSites, HMatrixTol, 1);
+  }
+  SetupCsixtyPolPot();
 
   // cout << "nr" << nr << endl;
   // int n4plus1 = nr*4+1 ; 
@@ -528,7 +545,10 @@ void Potential::SetAngleArray(const int *NoAtomsArray, const double *CenterArray
 }
 
 void Potential::SetMoleculeFields(const int *NoAtomsArray)
-{ 
+{
+  PotentialWorkspace &w = Work();
+  dVec &Rx = w.Rx, &Ry = w.Ry, &Rz = w.Rz;
+ 
   // calculating the fields on the atoms of a given molecule from all other molecules
   int current_atom = 0;
   int old_atom = 0;
@@ -745,12 +765,16 @@ void Potential::SetCoroneneGDMA()
     } 
 
   }
+  GDMA.close();
+  SetupGDMAMultipoles();
 }
 
 
 
 double Potential::EvaluateCsixty(const double *x)
 {
+  PotentialWorkspace &w = Work();
+  dVec &ReturnEnergies = w.ReturnEnergies;
 
 //  progress_timer tmr("EvaluateCsixty:", verbose);
   double Vtotal = 0.0 ; 
@@ -782,130 +806,223 @@ double Potential::EvaluateCsixty(const double *x)
   return Vtotal ;
 }
 
-double Potential::EvaluateColoreneElecPot(const double *x)
-{ 
+//
+//  C60: np points at once (np <= BatchTile())
+//  the electron fields of all points are collected as columns of a tile,
+//  and the induced dipoles of the whole tile are a single dsymm with InvA
+//  (or one H-matrix product, see SetHMatrix)
+//
+void Potential::EvaluateCsixtyBatch(int np, const double *r, double *v, double *energies)
+{
+  PotentialWorkspace &w = Work();
 
-// progress_timer tmr("EvaluateColoreneElecPot:", verbose);
+  int npol = CsixtyPolDim();
+  int one = 1;
+  if ((int)w.FieldTile.size() < npol*np) {
+    w.FieldTile.resize(npol*np);
+    w.MuTile.resize(npol*np);
+  }
+  double *F = &w.FieldTile[0];
+  double *G = &w.MuTile[0];
+
+  for (int p = 0; p < np; ++p) {
+    const double *x = &r[3*p];
+    ComputeDistances(x);
+    double *e = &energies[nReturnEnergies*p];
+    e[2] = EvaluateCsixtyRepPot(x, GaussExpCsixty, RepScaleCsixty) ; 
+    if (CarbonType == 1 ) e[0] = EvaluateCsixtyElecPot(x);
+    else  e[0] = EvaluateColoreneElecPot(x);
+    e[1] = 0.0;
+    CsixtyPolField(&F[npol*p]);
+  }
 
-  double Velec = 0.0 ;
-  double ElsPot= 0.0 ;
-  double coordX, coordY, coordZ;
+  if (PolFlagCsixty == 2) {
+    for (int p = 0; p < np; ++p)
+      energies[nReturnEnergies*p+3] = -ddot(&npol, &F[npol*p], &one, &MuOnAtoms[0], &one) ;
+  }
+  else {
+    const char *uplo = (PolFlagCsixty == 1) ? "U" : "L";
+    if (MolPol[0].InvAH.Active())
+      MolPol[0].InvAH.Apply(np, F, npol, G, npol, w.HWork);
+    else
+      dsymm("L", uplo, npol, np, 1.0, &(MolPol[0].InvA[0]), npol, F, npol, 0.0, G, npol);
+    for (int p = 0; p < np; ++p) {
+      const double *f = &F[npol*p];
+      energies[nReturnEnergies*p+3] = -0.5*ddot(&npol, f, &one, &G[npol*p], &one) 
+                                      + ddot(&npol, f, &one, &MuOnAtoms[0], &one) + VpolOnAtoms;
+    }
+  }
 
+  for (int p = 0; p < np; ++p) {
+    double *e = &energies[nReturnEnergies*p];
+    e[4] = 0.0;
+    v[p] = e[0] + e[3] + e[2];
+  }
+}
 
-  for (int i =0 ; i < nSites; ++i){
-    // effective-r damping
-    double DampParameter = EsDampCsixty ;
-    double Reff = R[i];
-    double gij = Rminus3[i] ; 
-    double g5 = 1/(Reff*Reff*Reff*Reff*Reff) ; 
-    double g7 = 1/(Reff*Reff*Reff*Reff*Reff*Reff*Reff) ; 
-
-
-    double Qxx, Qyy,Qzz;
-    double Qxy,Qyx,Qxz,Qzx,Qyz,Qzy;
-
-    double Qxxx,Qxxy,Qyxx,Qxyx,Qxyy,Qyxy,Qyyx,Qyyy,Qxxz,Qzxx,Qxzx,Qxyz,Qyzx,Qzxy;
-    double Qyxz,Qxzy,Qzyx,Qyyz,Qyzy,Qzyy,Qxzz,Qzxz,Qzzx,Qyzz,Qzyz,Qzzy,Qzzz;
-
-
-
-    Qxx=-0.5*Q20[i]+0.5*sqrt(3.0)*Q22c[i];
-    Qyy=-0.5*Q20[i]-0.5*sqrt(3.0)*Q22c[i];
-    Qzz=Q20[i];
-    Qxy=0.5*sqrt(3.0)*Q22s[i];
-    Qyx=Qxy;
-    Qxz=0.5*sqrt(3.0)*Q21c[i];
-    Qzx=Qzx;
-    Qyz=0.5*sqrt(3.0)*Q21s[i];
-    Qzy=Qyz;
-
-    Qxxx=sqrt(5.0/8.0)*Q33c[i]-sqrt(3.0/8.0)*Q31c[i];
-    Qxxy=sqrt(5.0/8.0)*Q33s[i]-sqrt(1.0/24.0)*Q31s[i];
-    Qyxx=Qxxy;
-    Qxyx=Qxxy;
-    Qxyy=sqrt(5.0/8.0)*Q33c[i]-sqrt(1.0/24.0)*Q31c[i];
-    Qyxy=Qxyy;
-    Qyyx=Qxyy;
-    Qyyy=sqrt(5.0/8.0)*Q33s[i]-sqrt(1.0/24.0)*Q31s[i];
-    Qxxz=sqrt(5.0/12.0)*Q32c[i]-sqrt(1.0/2.0)*Q30[i];
-    Qzxx=Qxxz;
-    Qxzx=Qxxz;
-    Qxyz=sqrt(5.0/12.0)*Q32s[i];
-    Qyzx=Qxyz;
-    Qzxy=Qxyz;
-    Qyxz=Qxyz;
-    Qxzy=Qxyz;
-    Qzyx=Qxyz;
-    Qyyz=-sqrt(5.0/12.0)*Q32c[i]-sqrt(1.0/2.0)*Q30[i];
-    Qyzy=Qyyz;
-    Qzyy=Qyyz;
-    Qxzz=sqrt(2.0/3.0)*Q31c[i];
-    Qzxz=Qxzz;
-    Qzzx=Qxzz;
-    Qyzz=sqrt(2.0/3.0)*Q31s[i];
-    Qzyz=Qyzz;
-    Qzzy=Qyzz;
-    Qzzz=Q30[i];
-
-   double MuDotR=0.0;
-   double  rQr=0.0;
-   double  rrQr=0.0;
-
- //   cout<<"rrQr = "<<rrQr<<endl;
-
-     MuDotR  = PtDip[3*i+0]*Rx[i] + PtDip[3*i+1]*Ry[i] +PtDip[3*i+2]*Rz[i];
-
-
-     rQr=      Rx[i]*Qxx*Rx[i] + Rx[i]*Qxy*Ry[i] +Rx[i]*Qxz*Rz[i] \
-             + Ry[i]*Qyx*Rx[i] + Ry[i]*Qyy*Ry[i] +Ry[i]*Qyz*Rz[i] \
-             + Rz[i]*Qzx*Rx[i] + Rz[i]*Qzy*Ry[i] +Rz[i]*Qzz*Rz[i];
-
-
-     rrQr=   Rx[i]*Rx[i]*Qxxx*Rx[i] + Rx[i]*Rx[i]*Qxxy*Ry[i] +Rx[i]*Rx[i]*Qxxz*Rz[i]\
-           + Rx[i]*Ry[i]*Qxyx*Rx[i] + Rx[i]*Ry[i]*Qxyy*Ry[i] +Rx[i]*Ry[i]*Qxyz*Rz[i]\
-           + Rx[i]*Rz[i]*Qxzx*Rx[i] + Rx[i]*Rz[i]*Qxzy*Ry[i] +Rx[i]*Rz[i]*Qxzz*Rz[i]\
-           + Ry[i]*Rx[i]*Qyxx*Rx[i] + Ry[i]*Rx[i]*Qyxy*Ry[i] +Ry[i]*Rx[i]*Qyxz*Rz[i]\
-           + Ry[i]*Ry[i]*Qyyx*Rx[i] + Ry[i]*Ry[i]*Qyyy*Ry[i] +Ry[i]*Ry[i]*Qyyz*Rz[i]\
-           + Ry[i]*Rz[i]*Qyzx*Rx[i] + Ry[i]*Rz[i]*Qyzy*Ry[i] +Ry[i]*Rz[i]*Qyzz*Rz[i]\
-           + Rz[i]*Rx[i]*Qzxx*Rx[i] + Rz[i]*Rx[i]*Qzxy*Ry[i] +Rz[i]*Rx[i]*Qzxz*Rz[i]\
-           + Rz[i]*Ry[i]*Qzyx*Rx[i] + Rz[i]*Ry[i]*Qzyy*Ry[i] +Rz[i]*Ry[i]*Qzyz*Rz[i]\
-           + Rz[i]*Rz[i]*Qzzx*Rx[i] + Rz[i]*Rz[i]*Qzzy*Ry[i] +Rz[i]*Rz[i]*Qzzz*Rz[i];
+//
+//  convert the spherical GDMA moments read by SetCoroneneGDMA into packed Cartesian
+//  tensors; the multiplicities of the symmetric components are folded in, so the 
+//  potential of site i at distance R is
+//    - q/R - (d.R)/R^3 - (R.Q.R)/R^5 - (O:RRR)/R^7
+//  the hexadecapoles are read but (as before) not used
+//
+void Potential::SetupGDMAMultipoles()
+{
+  int n = nSites;
+  GDMAMultipoles.assign(20*n, 0.0);
+  double *M = &GDMAMultipoles[0];
+  for (int i = 0; i < n; ++i) {
+    M[ 0*n+i] = Q00[i];
+    M[ 1*n+i] = PtDip[3*i+0];
+    M[ 2*n+i] = PtDip[3*i+1];
+    M[ 3*n+i] = PtDip[3*i+2];
+    // quadrupole: xx yy zz 2xy 2xz 2yz
+    M[ 4*n+i] = -0.5*Q20[i] + 0.5*sqrt(3.0)*Q22c[i];
+    M[ 5*n+i] = -0.5*Q20[i] - 0.5*sqrt(3.0)*Q22c[i];
+    M[ 6*n+i] = Q20[i];
+    M[ 7*n+i] = sqrt(3.0)*Q22s[i];
+    M[ 8*n+i] = sqrt(3.0)*Q21c[i];
+    M[ 9*n+i] = sqrt(3.0)*Q21s[i];
+    // octupole: xxx yyy zzz 3xxy 3xyy 3xxz 3yyz 3xzz 3yzz 6xyz
+    M[10*n+i] = sqrt(5.0/8.0)*Q33c[i] - sqrt(3.0/8.0)*Q31c[i];
+    M[11*n+i] = sqrt(5.0/8.0)*Q33s[i] - sqrt(1.0/24.0)*Q31s[i];
+    M[12*n+i] = Q30[i];
+    M[13*n+i] = 3.0*(sqrt(5.0/8.0)*Q33s[i] - sqrt(1.0/24.0)*Q31s[i]);
+    M[14*n+i] = 3.0*(sqrt(5.0/8.0)*Q33c[i] - sqrt(1.0/24.0)*Q31c[i]);
+    M[15*n+i] = 3.0*(sqrt(5.0/12.0)*Q32c[i] - sqrt(1.0/2.0)*Q30[i]);
+    M[16*n+i] = 3.0*(-sqrt(5.0/12.0)*Q32c[i] - sqrt(1.0/2.0)*Q30[i]);
+    M[17*n+i] = 3.0*sqrt(2.0/3.0)*Q31c[i];
+    M[18*n+i] = 3.0*sqrt(2.0/3.0)*Q31s[i];
+    M[19*n+i] = 6.0*sqrt(5.0/12.0)*Q32s[i];
+  }
 
+  //
+  // far field: charge, dipole, and quadrupole of each molecule about its center
+  // (shifted site charges and dipoles contribute to the molecular dipole and quadrupole,
+  //  the site octupoles and the shift of the site quadrupoles are O(1/R^4) and dropped)
+  //
+  MolCenter.assign(3*nFullerenes, 0.0);
+  MolRadius.assign(nFullerenes, 0.0);
+  MolMultipoles.assign(10*nFullerenes, 0.0);
+  int first = 0;
+  for (int m = 0; m < nFullerenes; ++m) {
+    int last = first + nAtomsArray[m];
+    double *c = &MolCenter[3*m];
+    for (int i = first; i < last; ++i)
+      for (int k = 0; k < 3; ++k)
+        c[k] += Site[3*i+k] / nAtomsArray[m];
+    double *T = &MolMultipoles[10*m];
+    for (int i = first; i < last; ++i) {
+      double s[3] = {Site[3*i+0]-c[0], Site[3*i+1]-c[1], Site[3*i+2]-c[2]};
+      double q = M[i];
+      double d[3] = {M[n+i], M[2*n+i], M[3*n+i]};
+      double s2 = s[0]*s[0] + s[1]*s[1] + s[2]*s[2];
+      double sd = s[0]*d[0] + s[1]*d[1] + s[2]*d[2];
+      MolRadius[m] = std::max(MolRadius[m], sqrt(s2));
+      T[0] += q;
+      for (int k = 0; k < 3; ++k)
+        T[1+k] += d[k] + q*s[k];
+      // Theta_ab = Q_ab + q (3 s_a s_b - s^2 delta_ab)/2 + 3/2 (d_a s_b + s_a d_b) - (s.d) delta_ab
+      for (int k = 0; k < 3; ++k)
+        T[4+k] += M[(4+k)*n+i] + 0.5*q*(3.0*s[k]*s[k] - s2) + 3.0*d[k]*s[k] - sd;
+      T[7] += M[7*n+i] + 3.0*q*s[0]*s[1] + 3.0*(d[0]*s[1] + s[0]*d[1]);
+      T[8] += M[8*n+i] + 3.0*q*s[0]*s[2] + 3.0*(d[0]*s[2] + s[0]*d[2]);
+      T[9] += M[9*n+i] + 3.0*q*s[1]*s[2] + 3.0*(d[1]*s[2] + s[1]*d[2]);
+    }
+    if (verbose > 0 && FarFieldCsixty > 0)
+      cout << "GDMA molecule " << m << ": radius " << MolRadius[m] << " charge " << T[0] 
+           << " dipole " << T[1] << " " << T[2] << " " << T[3] << "\n";
+    first = last;
+  }
+}
+
+//
+//  sites first..last-1 with the packed tensors; 1/R powers by recurrence
+//
+double Potential::GDMANearField(int first, int last)
+{
+  PotentialWorkspace &w = Work();
+  const double *Rx = &w.Rx[0], *Ry = &w.Ry[0], *Rz = &w.Rz[0], *R = &w.R[0];
+  const double *M = &GDMAMultipoles[0];
+  int n = nSites;
+  double DampParameter = EsDampCsixty ;
 
+  double Velec = 0.0 ;
+  for (int i = first; i < last; ++i){
+    double x = Rx[i], y = Ry[i], z = Rz[i];
+    // effective-r damping
+    double Reff = R[i];
     if (Reff < DampParameter) {
       double ror0 = Reff / DampParameter;
       Reff = DampParameter * (0.5 + ror0 * ror0 * ror0 * (1.0 - 0.5 * ror0));
-      // old not quite so smooth fn: Reff = 0.5 * (Reff*Reff/DampParameter + DampParameter);
- 
-      gij = 1.0 / (Reff * Reff * Reff);
-      g5 = 1.0 / (Reff * Reff * Reff*Reff*Reff);
-      g7 = 1.0 / (Reff * Reff * Reff*Reff*Reff*Reff*Reff);
-
     }
+    double g1 = 1.0 / Reff;
+    double r2inv = g1 * g1;
+    double g3 = g1 * r2inv;
+    double g5 = g3 * r2inv;
+    double g7 = g5 * r2inv;
+
+    double dip  = M[n+i]*x + M[2*n+i]*y + M[3*n+i]*z;
+    double quad = M[4*n+i]*x*x + M[5*n+i]*y*y + M[6*n+i]*z*z 
+                + M[7*n+i]*x*y + M[8*n+i]*x*z + M[9*n+i]*y*z;
+    double oct  = M[10*n+i]*x*x*x + M[11*n+i]*y*y*y + M[12*n+i]*z*z*z
+                + M[13*n+i]*x*x*y + M[14*n+i]*x*y*y + M[15*n+i]*x*x*z
+                + M[16*n+i]*y*y*z + M[17*n+i]*x*z*z + M[18*n+i]*y*z*z 
+                + M[19*n+i]*x*y*z;
+
+    Velec -= M[i]*g1 + dip*g3 + quad*g5 + oct*g7;
+  }
+  return Velec ;
+}
 
-    // v_dipole_charge_interaction = dot(dipole[i],R[i])/R^3
-    //Velec += (Rx[i]*PtDip[3*i+0] + Ry[i]*PtDip[3*i+1] + Rz[i]*PtDip[3*i+2])*
-    //          gij ;
- //   cout<<" Q00["<<i<<"] and Reff = "<<Q00[i]<<" "<<Reff<<endl; 
- //   cout<<"dipole: "<<PtDip[3*i+0]<<" "<< PtDip[3*i+1] <<" "<< PtDip[3*i+2]<<endl;  
- //   cout<<"Reff: "<<Rx[i]<<" "<< Ry[i] <<" "<< Rz[i]<<endl;  
-   
-   Velec+=-1.0*Q00[i]/Reff ;
-   Velec+= -(Rx[i]*PtDip[3*i+0] + Ry[i]*PtDip[3*i+1] + Rz[i]*PtDip[3*i+2])*gij  ; 
-   Velec+= -rQr*g5 ; 
-   Velec+= - rrQr*g7 ; 
+//
+//  molecule m as a single charge+dipole+quadrupole at its center
+//
+double Potential::GDMAFarField(int m, const double *x)
+{
+  const double *c = &MolCenter[3*m];
+  const double *T = &MolMultipoles[10*m];
+  double dx = x[0] - c[0], dy = x[1] - c[1], dz = x[2] - c[2];
+  double g1 = 1.0 / sqrt(dx*dx + dy*dy + dz*dz);
+  double r2inv = g1 * g1;
+  double g3 = g1 * r2inv;
+  double g5 = g3 * r2inv;
+  double dip  = T[1]*dx + T[2]*dy + T[3]*dz;
+  double quad = T[4]*dx*dx + T[5]*dy*dy + T[6]*dz*dz + T[7]*dx*dy + T[8]*dx*dz + T[9]*dy*dz;
+  return -(T[0]*g1 + dip*g3 + quad*g5);
+}
 
-  //  Velec += -1.0*ExtraNucQ/Reff + (Rx[i]*PtDip[3*i+0] + Ry[i]*PtDip[3*i+1] + Rz[i]*PtDip[3*i+2])*gij ;
-    
+double Potential::EvaluateColoreneElecPot(const double *x)
+{
+// progress_timer tmr("EvaluateColoreneElecPot:", verbose);
+
+  double Velec = 0.0 ;
+  int first = 0;
+  for (int m = 0; m < nFullerenes; ++m) {
+    int last = first + nAtomsArray[m];
+    bool far = false;
+    if (FarFieldCsixty > 0) {
+      const double *c = &MolCenter[3*m];
+      double D = sqrt((x[0]-c[0])*(x[0]-c[0]) + (x[1]-c[1])*(x[1]-c[1]) + (x[2]-c[2])*(x[2]-c[2]));
+      far = (D > FarFieldCsixty * MolRadius[m] && D - MolRadius[m] > EsDampCsixty);
+    }
+    if (far)
+      Velec += GDMAFarField(m, x);
+    else
+      Velec += GDMANearField(first, last);
+    first = last;
   }
  // cout<<" :  Velec = "<<Velec*27.2114<<endl;
   return Velec ;
-   
 }
 
 
 double Potential::EvaluateCsixtyElecPot(const double *x)
-{ 
+{
+  PotentialWorkspace &w = Work();
+  dVec &Rx = w.Rx, &Ry = w.Ry, &Rz = w.Rz, &R = w.R, &Rminus3 = w.Rminus3;
+ 
 
 // progress_timer tmr("EvaluateCsixtyElecPot:", verbose);
 
@@ -935,6 +1052,8 @@ double Potential::EvaluateCsixtyElecPot(const double *x)
 
 double Potential::EvaluateCsixtyRepPot(const double *x, double GaussExp, double RepScale)
 {
+  PotentialWorkspace &w = Work();
+  dVec &R2 = w.R2;
 // progress_timer tmr("EvaluateCsixtyRepPot", verbose);
   double Vrep = 0.0 ;
  // cout<<"GaussExp = "<<GaussExp<<"  RepScale = "<<RepScale<<endl;
@@ -963,31 +1082,94 @@ double Potential::EvaluateCsixtyRepPot(const double *x, double GaussExp, double
 }
 
 
+//
+//  field of the electron (charge at x) on the charges and dipoles of the fullerenes 
+//  f[0..nSites) potential, f[nSites..4*nSites) field, remaining entries are zero
+//  the distance tables must be up to date
+//
+void Potential::CsixtyPolField(double *f)
+{
+  PotentialWorkspace &w = Work();
+  const dVec &Rx = w.Rx, &Ry = w.Ry, &Rz = w.Rz, &R = w.R, &Rminus3 = w.Rminus3;
+
+  int npol = CsixtyPolDim();
+  for (int i = 4*nSites; i < npol; ++i)
+    f[i] = 0.0;
+
+  for (int i =0 ; i < nSites; ++i){
+    double Reff = R[i];
+    double Reffminus3 = Rminus3[i] ;
+    if (Reff < PolDampCsixty) {
+      double ror0 = Reff / PolDampCsixty;
+      Reff = PolDampCsixty * (0.5 + ror0 * ror0 * ror0 * (1.0 - 0.5 * ror0));
+      // old not quite so smooth fn: Reff = 0.5 * (Reff*Reff/DampParameter + DampParameter);
+      Reffminus3 = 1.0 / (Reff * Reff * Reff);
+    }
+    f[i] = -1.0/Reff;
+    if (PolFlagCsixty == 1) {
+      if (AtomType[i] == 3 ) f[i] -= 0.2451537;
+      else if(AtomType[i] == 2 ) f[i] -= 0.21150515;
+    }
+    f[nSites+3*i+0] = Reffminus3 * Rx[i];
+    f[nSites+3*i+1] = Reffminus3 * Ry[i];
+    f[nSites+3*i+2] = Reffminus3 * Rz[i];
+  }
+}
+
+//
+//  size of the charge-dipole system: one charge constraint per fullerene,
+//  or a single one if charge can flow between fullerenes (PolFlag 3/6/7)
+//
+int Potential::CsixtyPolDim()
+{
+  if (PolFlagCsixty == 3 || PolFlagCsixty == 6 || PolFlagCsixty == 7)
+    return nSites*4+1;
+  return nSites*4+nFullerenes;
+}
+
+//
+//  the field of the other fullerenes (EfieldOnAtoms) does not depend on the electron:
+//  the dipoles it induces and its self-energy are computed once, so that
+//  Vpol = -0.5 f*InvA*f + f*MuOnAtoms + VpolOnAtoms  (f = field of the electron)
+//  PolFlag 1: Vpol = -0.5 (f-E)*InvA*(f-E) - InterFullerPol
+//  PolFlag 2: Vpol = -f*InvA*E  (no electron-induced dipoles, so no quadratic term)
+//  PolFlag 3: Vpol = -f*InvA*(0.5f-E)
+//
+void Potential::SetupCsixtyPolPot()
+{
+  int npol = CsixtyPolDim();
+  int one = 1;
+  double done = 1.0;
+  double dzero = 0.0;
+  const char *uplo = (PolFlagCsixty == 1) ? "U" : "L";
+
+  MuOnAtoms.assign(npol, 0.0);
+  VpolOnAtoms = 0.0;
+  if (PolFlagCsixty != 1 && PolFlagCsixty != 2 && PolFlagCsixty != 3 && PolFlagCsixty != 6)
+    return;
+  dsymv(uplo, &npol, &done, &(MolPol[0].InvA[0]), &npol, &EfieldOnAtoms[0], &one, &dzero, &MuOnAtoms[0], &one);
+  if (PolFlagCsixty == 1)
+    VpolOnAtoms = -0.5*ddot(&npol, &EfieldOnAtoms[0], &one, &MuOnAtoms[0], &one) - InterFullerPol;
+}
+
+
 double Potential::EvaluateCsixtyPolPot(const double *x )
-{ 
+{
+  PotentialWorkspace &w = Work();
+  dVec &Rx = w.Rx, &Ry = w.Ry, &Rz = w.Rz;
+ 
 
 // progress_timer tmr("EvaluateCsixtyPolPot:", verbose);
-  dVec Efield; Efield.resize(nSites*4+nFullerenes);
-  dVec EfieldNet_new ; EfieldNet_new.resize(nSites*4+nFullerenes);
-  dVec mu;     mu.resize(nSites*4+nFullerenes);
+  dVec &Efield = w.Efield;           Efield.resize(nSites*4+nFullerenes);
+  dVec &EfieldNet_new = w.EfieldNet; EfieldNet_new.resize(nSites*4+nFullerenes);
+  dVec &mu = w.mu;                   mu.resize(nSites*4+nFullerenes);
   double Vpol = 0.0 ;
   double dzero = 0.0;
   double done = 1.0;
   int one = 1;
   int n = nSites*4+nFullerenes ;
-
-
-  dVec Efield_pol3 ; Efield_pol3.resize(nSites*4+1);
-  dVec EfieldNet_pol3 ; EfieldNet_pol3.resize(nSites*4+1);
-  dVec mu_pol3;     mu_pol3.resize(nSites*4+1);
   int n_pol3 = nSites*4+1 ;
 
-  int ncomb=nSites*(nSites-1.0)/2.0;
-  dVec Efield_comb ; Efield_comb.resize(n);
-  dVec SijTotal ; SijTotal.resize(nSites*4+1 );
-  dVec SijEach ; SijEach.resize(nSites*4+1 );
-  dVec mu_comb;     mu_comb.resize(ncomb);
-
 
 
 //  cout << "PolFlagCsixty " <<  PolFlagCsixty << "\n" ;
@@ -1000,52 +1182,23 @@ double Potential::EvaluateCsixtyPolPot(const double *x )
         Vpol = 0.0;
       break;
       case 1:
-        // computing polarization and induction
-        for (int i =0 ; i < nSites; ++i){
-          double Reff = R[i];
-          double Reffminus3 = Rminus3[i] ;
-          if (Reff < PolDampCsixty) {
-            double ror0 = Reff / PolDampCsixty;
-            Reff = PolDampCsixty * (0.5 + ror0 * ror0 * ror0 * (1.0 - 0.5 * ror0));
-            // old not quite so smooth fn: Reff = 0.5 * (Reff*Reff/DampParameter + DampParameter);
-            Reffminus3 = 1.0 / (Reff * Reff * Reff);
-          }
-          if (AtomType[i] == 3 ) Efield[i] = -1.0/Reff - 0.2451537;
-          else if(AtomType[i] == 2 ) Efield[i] = -1.0/Reff - 0.21150515;
-          else if(AtomType[i] == 1 ) Efield[i] = -1.0/Reff;
-
-          Efield[nSites+3*i+0] = Reffminus3 * Rx[i];
-          Efield[nSites+3*i+1] = Reffminus3 * Ry[i];
-          Efield[nSites+3*i+2] = Reffminus3 * Rz[i];
-
-
-        }
-        // adding fields from other fullerenes
-        // make sure fields are ADDED
-
-     //   Efield[nSites] = 0.0000;
-     //   n=nSites+1;
-
-        for (int i =0 ; i < n; ++i){
-         // cout<<"Efield["<<i<<"]="<<Efield[i]<<" and  EfieldOnAtoms[i]: "<< EfieldOnAtoms[i]<<endl; 
-          //cout<<"EfieldOnAtoms[i]: "<< EfieldOnAtoms[i]<<endl; 
-          Efield[i] -= EfieldOnAtoms[i]; 
-          // EfieldNet_pol3[i] = 0.5*Efield[i]- EfieldOnAtoms[i]; 
-          // cout<<"Efield["<<i<<"]="<<EfieldNet_pol3[i]<<endl; 
-        }
-        //cout<<"InterFullerPol = "<<InterFullerPol<<endl;
-        //exit(0);
-        // compute dipoles induced by Efield
-       // dgemv("N", &n, &n, &done, &(MolPol[0].InvA[0]), &n, &Efield[0], &one, &dzero, &mu[0], &one);
-        dsymv("U", &n, &done, &(MolPol[0].InvA[0]), &n, &Efield[0], &one, &dzero, &mu[0], &one);
-        Vpol = -0.5*ddot(&n, &Efield[0], &one, &mu[0], &one) - InterFullerPol;
-        //Vpol = -ddot(&n, &Efield[0], &one, &mu[0], &one) ;
-       // for (int i =0 ; i < n ; ++i){
-      //     cout<<"mu[ "<<i<<" ] = "<<mu[i]<<endl;
-      //  }
-      // exit(0);
+      case 3:
+      case 6: {
+        // 1: computing polarization and induction
+        // 3, 6: induction with intermolecular charge flow
+        // the fields from other fullerenes enter through MuOnAtoms, see SetupCsixtyPolPot
+        int npol = CsixtyPolDim();
+        const char *uplo = (PolFlagCsixty == 1) ? "U" : "L";
+        CsixtyPolField(&Efield[0]);
+        // compute dipoles induced by the electron
+        if (MolPol[0].InvAH.Active())
+          MolPol[0].InvAH.Apply(1, &Efield[0], npol, &mu[0], npol, w.HWork);
+        else
+          dsymv(uplo, &npol, &done, &(MolPol[0].InvA[0]), &npol, &Efield[0], &one, &dzero, &mu[0], &one);
+        Vpol = -0.5*ddot(&npol, &Efield[0], &one, &mu[0], &one) 
+               + ddot(&npol, &Efield[0], &one, &MuOnAtoms[0], &one) + VpolOnAtoms;
        // cout<<"Vpol = "<<Vpol<<endl;
-        if (verbose > 1) {
+        if (verbose > 1 && PolFlagCsixty == 1) {
           int current_atom = 0;
           int old_atom = 0;
           for (int i = 0 ; i < nFullerenes ; ++i){
@@ -1053,78 +1206,29 @@ double Potential::EvaluateCsixtyPolPot(const double *x )
             current_atom += nAtomsArray[i] ;
             double net_charge = 0.0 ;
             for (int j =old_atom ; j < current_atom; ++j){
-              net_charge += mu[j] ;
+              net_charge += mu[j] - MuOnAtoms[j] ;
             }
             cout << "net charge on fullerene " <<  i << " is " << net_charge << "\n" ;
           }    
         }
-        // Vpol = -0.5*ddot(&n, &Efield[0], &one, &mu[0], &one) ;
+      }
       break;
       case 2:
         // computing only induction
-        for (int i =0 ; i < nSites; ++i){
-          double Reff = R[i];
-          double Reffminus3 = Rminus3[i] ;
-          if (Reff < PolDampCsixty) {
-            double ror0 = Reff / PolDampCsixty;
-            Reff = PolDampCsixty * (0.5 + ror0 * ror0 * ror0 * (1.0 - 0.5 * ror0));
-            // old not quite so smooth fn: Reff = 0.5 * (Reff*Reff/DampParameter + DampParameter);
-            Reffminus3 = 1.0 / (Reff * Reff * Reff);
-          }
-          Efield[i] = -1.0/Reff ;
-          Efield[nSites+3*i+0] = Reffminus3 * Rx[i];
-          Efield[nSites+3*i+1] = Reffminus3 * Ry[i];
-          Efield[nSites+3*i+2] = Reffminus3 * Rz[i];
-
-
-        }
-        //dgemv("N", &n, &n, &done, &(MolPol[0].InvA[0]), &n, &EfieldOnAtoms[0], &one, &dzero, &mu[0], &one);
-        dsymv("L", &n, &done, &(MolPol[0].InvA[0]), &n, &EfieldOnAtoms[0], &one, &dzero, &mu[0], &one);
-        Vpol = -ddot(&n, &Efield[0], &one, &mu[0], &one) ; // not using 0.5 as nothing is double counted
+        CsixtyPolField(&Efield[0]);
+        Vpol = -ddot(&n, &Efield[0], &one, &MuOnAtoms[0], &one) ; // not using 0.5 as nothing is double counted
       break ;
-      case 3:
-      case 6:
-        // induction with intermolecular charge flow
-        // computing only induction
-        for (int i =0 ; i < nSites; ++i){
-          double Reff = R[i];
-          double Reffminus3 = Rminus3[i] ;
-          if (Reff < PolDampCsixty) {
-            double ror0 = Reff / PolDampCsixty;
-            Reff = PolDampCsixty * (0.5 + ror0 * ror0 * ror0 * (1.0 - 0.5 * ror0));
-            // old not quite so smooth fn: Reff = 0.5 * (Reff*Reff/DampParameter + DampParameter);
-            Reffminus3 = 1.0 / (Reff * Reff * Reff);
-          }
-          Efield_pol3[i] = -1.0/Reff   ;
-          Efield_pol3[nSites+3*i+0] = Reffminus3 * Rx[i];
-          Efield_pol3[nSites+3*i+1] = Reffminus3 * Ry[i];
-          Efield_pol3[nSites+3*i+2] = Reffminus3 * Rz[i];
-        }
-        for (int i =0 ; i < n_pol3 ; ++i){
-          //EfieldNet_pol3[i] = 0.5*Efield_pol3[i] + EfieldOnAtoms[i];
-        //  cout<<"Efield_pol3["<<i<<"]="<<Efield_pol3[i]<<" and  EfieldOnAtoms[i]: "<< EfieldOnAtoms[i]<<endl; 
-          EfieldNet_pol3[i] =  0.5*Efield_pol3[i] - EfieldOnAtoms[i] ;
-          //cout<<"EfieldOnAtoms[i]: "<< EfieldOnAtoms[i]<<endl; 
-        //  cout<<"Efield["<<i<<"]="<<EfieldNet_pol3[i]<<endl; 
-        }
-       // exit(0);
-       // cout<<" n_pol3 = "<<n_pol3<<endl;
-        //dgemv("N", &n_pol3, &n_pol3, &done, &(MolPol[0].InvA[0]), &n_pol3, &EfieldNet_pol3[0], &one, &dzero, &mu_pol3[0], &one);
-        dsymv("L", &n_pol3, &done, &(MolPol[0].InvA[0]), &n_pol3, &EfieldNet_pol3[0], &one, &dzero, &mu_pol3[0], &one);
-       //  for (int i =0 ; i < n_pol3 ; ++i){
-      //     cout<<"mu[ "<<i<<" ] = "<<2.0*mu_pol3[i]<<endl;
-      //  }
-
-        /*
-        for (int i =0 ; i < n_pol3 ; ++i){
-           cout<<"mu_pol3 = "<<mu_pol3[i]<<endl;
-        }
-        */
-         
-        Vpol = -ddot(&n_pol3, &Efield_pol3[0], &one, &mu_pol3[0], &one) ; // not using 0.5 as nothing is double counted
-       // cout<<"Vpol = "<<Vpol<<endl;
-      break;
       case 7: {
+      Efield.assign(n, 0.0);
+      mu.assign(n, 0.0);
+      dVec Efield_pol3 ; Efield_pol3.resize(nSites*4+1);
+      dVec EfieldNet_pol3 ; EfieldNet_pol3.resize(nSites*4+1);
+      dVec mu_pol3;     mu_pol3.resize(nSites*4+1);
+      int ncomb=nSites*(nSites-1.0)/2.0;
+      dVec Efield_comb ; Efield_comb.resize(n);
+      dVec SijTotal ; SijTotal.resize(nSites*4+1 );
+      dVec SijEach ; SijEach.resize(nSites*4+1 );
+      dVec mu_comb;     mu_comb.resize(ncomb);
       // cout<<"here is the elecric filed ----- "<<endl;
  
 
@@ -1871,6 +1975,11 @@ double Q_yz = 0.0;
       break;
    }
       case 8:{
+        Efield.assign(n, 0.0);
+        EfieldNet_new.assign(n, 0.0);
+        mu.assign(n, 0.0);
+        dVec Efield_comb ; Efield_comb.resize(n);
+        dVec SijTotal ; SijTotal.resize(nSites*4+1 );
         // computing polarization and induction
         //
 
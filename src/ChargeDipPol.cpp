@@ -13,6 +13,7 @@ using namespace std;
 #include "lapackblas.h"
 #include "constants.h"
 #include "timer.hpp"
+#include "PairTensors.h"
 
 //
 //  this is for setting up a molecule with interacting atomic polarizability
@@ -344,19 +345,18 @@ void BuildPolarizationMatrix(int nSites, const double *R, double *A, int nFuller
 // for (int k= 0; k<n ; ++k )
 //   cout<<"IonType["<<k<<"] = "<<IonType[k]<<endl;
 
+#pragma omp parallel for
   for (int k = 0; k < n4plus1*n4plus1 ; ++k)
     A[k] = 0.0;
   
-  double* Matrix= new double[nplus1*nplus1];
   double ChargePen=-1.5;
 // double R_const = 0.62*1.889725989 ; 
 //  double R_const = 0.68620399*1.889725989 ; 
-  double Rqi, Rqj, chi; 
  // double Rqq = R_const*sqrt(2.0)  ;
   //cout << "R_const , R_qq" << R_const << " "<<Rqq << endl ; 
   //Tqq
   
-  double R_const;
+  double R_const = 0;
    if (CarbonType == 2) R_const=0.01945;
    else if (CarbonType == 3) R_const=0.02279;
    else if (CarbonType == 4) R_const=0.02652;
@@ -367,52 +367,14 @@ void BuildPolarizationMatrix(int nSites, const double *R, double *A, int nFuller
 
    double H_R=0.0;
 
-  for (int j = 0; j < n; ++j) {
-    //if (IonType[j] == 1) Rqj= 0.67200149*1.889725989 ;
-   // if (IonType[j] == 1) Rqj= 0.66329437*1.889725989 ;
-    if (IonType[j] == 1) Rqj= 0.68620399*1.889725989 ;
-    else if (IonType[j] == 2) Rqj= H_R*1.889725989 ;
-    else if (IonType[j] == 3) Rqj= R_const*1.889725989 ;
-   // cout << "Rqj " << Rqj << endl ; 
-
-    for (int i = 0; i < n; ++i) {
-     // if (IonType[i] == 1) Rqi= 0.67200149*1.889725989 ;
-     // if (IonType[i] == 1) Rqi= 0.66329437*1.889725989 ;
-      if (IonType[i] == 1) Rqi= 0.68620399*1.889725989 ;
-      else if (IonType[i] == 2) Rqi= H_R*1.889725989 ;
-      else if (IonType[i] == 3) Rqi= R_const*1.889725989 ;
-      chi = sqrt(2.0/PI)/Rqi  ;
-     // cout << "Rqi " << Rqi << endl ; 
-      if (i == j) {
-        A[n4plus1*i+j] = chi; 
-        Matrix[nplus1*i+j] = chi;
-      }
-      else {
-        double rij[3] ;
-        rij[0] = R[3*i+0] - R[3*j+0];
-        rij[1] = R[3*i+1] - R[3*j+1];
-        rij[2] = R[3*i+2] - R[3*j+2];
-        double Rij = sqrt(rij[0]*rij[0] + rij[1]*rij[1] + rij[2]*rij[2]);
-        double CT=4.0*pow(10,4)*exp(-1.5*Rij);
-        double Rqq = sqrt(Rqi*Rqi+Rqj*Rqj)  ;
-
-/*
-        double C = 1.00;
-        double B = 0.43; 
-        double w = Rij*B;
-        if ((i < 60 && j >= 60) || (i >= 60 && j < 60) )  {
-         A[n4plus1*i+j] = erf(Rij/Rqq)/Rij *  C*exp(-w)*(1+w+1.0/3.0*w*w) ; 
-        }
-        else  A[n4plus1*i+j] = erf(Rij/Rqq)/Rij ; 
-*/
-         A[n4plus1*i+j] = erf(Rij/Rqq)/Rij ; 
-         Matrix[nplus1*i+j] = erf(Rij/Rqq)/Rij ;
-         // A[n4plus1*i+j] = erf(Rij/Rqq)/(Rij*CT) ; 
-         // cout<<" erf(Rij/Rqq) =  "<< erf(Rij/Rqq) <<endl; 
-         //cout<<" i j : "<<i<<" "<<j<<" "<< erf(Rij/Rqq)/Rij<<endl; 
-      }
-    }
+  // Gaussian widths of the charges
+  dVec Rq(n, 0.0);
+  for (int i = 0; i < n; ++i) {
+    if (IonType[i] == 1) Rq[i]= 0.68620399*1.889725989 ;
+    else if (IonType[i] == 2) Rq[i]= H_R*1.889725989 ;
+    else if (IonType[i] == 3) Rq[i]= R_const*1.889725989 ;
   }
+  GaussianChargeBlock(n, R, &Rq[0], A, n4plus1);
 
   //T-lagrange
   int current_atom = 0 ; 
@@ -458,8 +420,6 @@ void BuildPolarizationMatrix(int nSites, const double *R, double *A, int nFuller
     for (int i = old_atom; i < current_atom ; ++i) {
       A[i*n4plus1+n4 + iFuller]               = 1.0 ; // corresponds to columns of lagrange vector
       A[n4plus1*n4 + n4plus1*iFuller + i]     = 1.0 ; // corresponds to rows of lagrange rows
-      Matrix[i*nplus1+n + iFuller]               = 1.0 ; // corresponds to columns of lagrange vector
-      Matrix[nplus1*n + nplus1*iFuller + i]     = 1.0 ; // corresponds to rows of lagrange rows
 
 
 /*
@@ -548,7 +508,6 @@ void BuildPolarizationMatrix(int nSites, const double *R, double *A, int nFuller
   
 
   double alpha, alphaX, alphaY, alphaZ;
-  double Rpi, Rpj;
   double alpha_parC, alpha_perpC, alpha_parH, alpha_perpH;
 
    if (CarbonType == 1) { 
@@ -622,235 +581,36 @@ void BuildPolarizationMatrix(int nSites, const double *R, double *A, int nFuller
 
 
   //Tpq and Tpp
-  for (int j = 0; j < n; ++j){
-    if (IonType[j] == 1) { 
-      Rqj= R_const*1.889725989 ; 
-      Rpj=Rqj;
-      alphaX= alpha_parC/(0.529177*0.529177*0.529177);
-      alphaY= alpha_parC/(0.529177*0.529177*0.529177);
-      alphaZ= alpha_perpC/(0.529177*0.529177*0.529177);
-
-    //  alphaX = 3.0*sqrt(PI/2)*Rpj*Rpj*Rpj ;
-    //  alphaY = 3.0*sqrt(PI/2)*Rpj*Rpj*Rpj ;
-    //  alphaZ = 3.0*sqrt(PI/2)*Rpj*Rpj*Rpj ;
+  // widths and polarizabilities of the sites
+  const double Bohr3 = 0.529177*0.529177*0.529177;
+  dVec Rqd(n, 0.0), Rp(n, 0.0), invalpha(3*n, 0.0);
+  for (int i = 0; i < n; ++i) {
+    if (IonType[i] == 1) {
+      Rqd[i]= R_const*1.889725989 ;
+      Rp[i]=Rqd[i];
+      alphaX= alpha_parC/Bohr3;
+      alphaY= alpha_parC/Bohr3;
+      alphaZ= alpha_perpC/Bohr3;
     }
-    else if (IonType[j] == 2) {
-     // Rqj= 0.00 ;
-      Rqj= H_R*1.889725989 ;
-      alphaX= alpha_parH/(0.529177*0.529177*0.529177);
-      alphaY= alpha_parH/(0.529177*0.529177*0.529177);
-      alphaZ= alpha_perpH/(0.529177*0.529177*0.529177);
-      Rpj= pow(sqrt(2.0/PI)/(2.0/alphaX +1.0/alphaZ),1.0/3.0);
-     // Rpj= pow(alphaX/3.0/sqrt(PI/2),1.0/3.0);
+    else if (IonType[i] == 2) {
+      Rqd[i]= H_R*1.889725989 ;
+      alphaX= alpha_parH/Bohr3;
+      alphaY= alpha_parH/Bohr3;
+      alphaZ= alpha_perpH/Bohr3;
+      Rp[i]= pow(sqrt(2.0/PI)/(2.0/alphaX +1.0/alphaZ),1.0/3.0);
     }
-    else if (IonType[j] == 3){
-      Rqj= R_const*1.889725989 ; 
-      alphaX= alpha_parC/(0.529177*0.529177*0.529177);
-      alphaY= alpha_parC/(0.529177*0.529177*0.529177);
-      alphaZ= alpha_perpC/(0.529177*0.529177*0.529177);
-      Rpj= pow(sqrt(2.0/PI)/(2.0/alphaX +1.0/alphaZ),1.0/3.0);
-     // Rpj= pow(alphaX/3.0/sqrt(PI/2),1.0/3.0);
-    }
-
-    for (int i = 0; i < n; ++i){
-      if (IonType[i] == 1) {
-        Rqi= R_const*1.889725989 ; 
-        Rpi=Rqi;
-        alphaX= alpha_parC/(0.529177*0.529177*0.529177);
-        alphaY= alpha_parC/(0.529177*0.529177*0.529177);
-        alphaZ= alpha_perpC/(0.529177*0.529177*0.529177);
-
-      //  alphaX = 3.0*sqrt(PI/2)*Rpi*Rpi*Rpi ;
-      //  alphaY = 3.0*sqrt(PI/2)*Rpi*Rpi*Rpi ;
-      //  alphaZ = 3.0*sqrt(PI/2)*Rpi*Rpi*Rpi ;
-       }
-      else if (IonType[i] == 2) {
-       // Rqi= 0.00 ;
-        Rqi= H_R*1.889725989 ;
-        alphaX= alpha_parH/(0.529177*0.529177*0.529177);
-        alphaY= alpha_parH/(0.529177*0.529177*0.529177);
-        alphaZ= alpha_perpH/(0.529177*0.529177*0.529177);
-        Rpi= pow(sqrt(2.0/PI)/(2.0/alphaX +1.0/alphaZ),1.0/3.0);
-       // Rpi= pow(alphaX/3.0/sqrt(PI/2),1.0/3.0);
-      }
-      else if (IonType[i] == 3) {
-        Rqi= R_const*1.889725989 ;
-        alphaX= alpha_parC/(0.529177*0.529177*0.529177);
-        alphaY= alpha_parC/(0.529177*0.529177*0.529177);
-        alphaZ= alpha_perpC/(0.529177*0.529177*0.529177);
-        Rpi= pow(sqrt(2.0/PI)/(2.0/alphaX +1.0/alphaZ),1.0/3.0);
-       // Rpi= pow(alphaX/3.0/sqrt(PI/2),1.0/3.0);
-      }
-      if(i==j){
-      //   cout <<"alphaX : "<<alphaX<<endl;
-      //   cout <<"alphaY : "<<alphaX<<endl;
-      //   cout <<"alphaZ : "<<alphaX<<endl;
-      
-
-
-          A[n*n4plus1+3*i*n4plus1 +                  n+j*3+0] = 1.0/alphaX ;
-          A[n*n4plus1+3*i*n4plus1 +n4plus1+          n+j*3+1] = 1.0/alphaY ;
-          A[n*n4plus1+3*i*n4plus1 +n4plus1+ n4plus1+ n+j*3+2] = 1.0/alphaZ ;
-
-
-       // cout<<" i=j 1 : "<<n*n4plus1+3*i*n4plus1 +                  n+j*3+0 <<endl;
-      //  cout<<" i=j 2 : "<<n*n4plus1+3*i*n4plus1 + n4plus1+         n+j*3+1 <<endl;
-      //  cout<<" i=j 3 : "<<n*n4plus1+3*i*n4plus1 + n4plus1+ n4plus1+n+j*3+2 <<endl;
-      }
-      else {
-        double rij[3] ;
-        rij[0] = R[3*i+0] - R[3*j+0];
-        rij[1] = R[3*i+1] - R[3*j+1];
-        rij[2] = R[3*i+2] - R[3*j+2];
-        double Rij = sqrt(rij[0]*rij[0] + rij[1]*rij[1] + rij[2]*rij[2]);
-        double fac, fac1, fac2, fac_pq, fac_qp; 
-        double Txy, Txz, Tyz, Rpq, Rqp, Rpp ;
-        Rpq = sqrt(Rpi*Rpi+Rqj*Rqj)  ;
-        Rqp = sqrt(Rqi*Rqi+Rpj*Rpj)  ;
-        Rpp = sqrt(Rpi*Rpi+Rpj*Rpj)  ;
-
-      //  cout<<"Rpi Rpj = "<<Rpi<<" "<<Rpj<<endl;
-      //  cout<<"Rpp Rqp = "<<Rpp<<" "<<Rqp<<endl;
-
-        fac = erf(Rij/Rpp)-2.0*Rij*exp(-1.0*(Rij/Rpp)*(Rij/Rpp))/(sqrt(PI)*Rpp) ;
-        fac_pq = (erf(Rij/Rpq)-2.0*Rij*exp(-1.0*(Rij/Rpq)*(Rij/Rpq))/(sqrt(PI)*Rpq))/(Rij*Rij*Rij) ;
-        fac_qp = (erf(Rij/Rqp)-2.0*Rij*exp(-1.0*(Rij/Rqp)*(Rij/Rqp))/(sqrt(PI)*Rqp))/(Rij*Rij*Rij) ;
-       // fac_pq = fac/(Rij*Rij*Rij) ; 
-       // cout<<"Rij = "<<Rij<<endl;
-        //cout<<"Rqq = "<<Rqq<<endl;
-
-        fac1 = fac/(Rij*Rij*Rij*Rij*Rij) ; 
-
-        fac2 = 4.0*exp(-1.0*(Rij/Rpp)*(Rij/Rpp))/(sqrt(PI)*Rpp*Rpp*Rpp*Rij*Rij) ;
-        //cout<<"fac_qp = "<<fac_qp<<endl;
- 
-        Txy = 3.0*rij[0]*rij[1]*fac1 - rij[0]*rij[1]*fac2 ;
-        Txz = 3.0*rij[0]*rij[2]*fac1 - rij[0]*rij[2]*fac2 ;
-        Tyz = 3.0*rij[1]*rij[2]*fac1 - rij[1]*rij[2]*fac2 ;
-
-
-
-
-
-
-
-        A[n*n4plus1+3*i*n4plus1 +                  n+j*3+0] = -1.0*((3.0*rij[0]*rij[0]-Rij*Rij)*fac1 - rij[0]*rij[0]*fac2) ; 
-        A[n*n4plus1+3*i*n4plus1 +n4plus1+          n+j*3+1] = -1.0*((3.0*rij[1]*rij[1]-Rij*Rij)*fac1 - rij[1]*rij[1]*fac2) ; 
-        A[n*n4plus1+3*i*n4plus1 +n4plus1+ n4plus1+ n+j*3+2] = -1.0*((3.0*rij[2]*rij[2]-Rij*Rij)*fac1 - rij[2]*rij[2]*fac2) ; 
-
-
-        A[n*n4plus1+3*i*n4plus1 +                  n+j*3+1] = -1.0*Txy ; 
-        A[n*n4plus1+3*i*n4plus1 +n4plus1+          n+j*3+0] = -1.0*Txy ; 
-        A[n*n4plus1+3*i*n4plus1 +                  n+j*3+2] = -1.0*Txz ; 
-        A[n*n4plus1+3*i*n4plus1 +n4plus1+ n4plus1+ n+j*3+0] = -1.0*Txz ; 
-        A[n*n4plus1+3*i*n4plus1 +n4plus1+          n+j*3+2] = -1.0*Tyz ; 
-        A[n*n4plus1+3*i*n4plus1 +n4plus1+ n4plus1+ n+j*3+1] = -1.0*Tyz ;
-
-         
-
-//        cout<<" Txy: "<<n*n4plus1+3*i*n4plus1 +                  n+j*3+1<<endl; 
-//        cout<<" Txy: "<<n*n4plus1+3*i*n4plus1 +n4plus1+          n+j*3+0<<endl; 
-//        cout<<" Txz: "<<n*n4plus1+3*i*n4plus1 +                  n+j*3+2<<endl; 
-//        cout<<" Txz: "<<n*n4plus1+3*i*n4plus1 +n4plus1+ n4plus1+ n+j*3+0<<endl; 
-//        cout<<" Tyz: "<<n*n4plus1+3*i*n4plus1 +n4plus1+          n+j*3+2<<endl; 
-//        cout<<" Tyz: "<<n*n4plus1+3*i*n4plus1 +n4plus1+ n4plus1+ n+j*3+1<<endl;
-
-
-
-
-        //Tpq
-       
-
-        
-//        A[i*n4plus1+n+3*j+0] = 0;
-//        A[i*n4plus1+n+3*j+1] = 0;
-//        A[i*n4plus1+n+3*j+2] = 0;
-
-
-//        A[n*n4plus1+i*3*n4plus1                  +j] = 0;
-//        A[n*n4plus1+i*3*n4plus1+ n4plus1         +j] = 0;
-//        A[n*n4plus1+i*3*n4plus1+ n4plus1+ n4plus1+j] = 0;
-
-
-       
-
-
-//        if ((i < 60 && j >= 60) || (i >= 60 && j < 60) )  {
-//        A[i*n4plus1+n+3*j+0] = -1.0*rij[0]*fac_pq*(1.0 - exp(ChargePen*Rij));
-//        A[i*n4plus1+n+3*j+1] = -1.0*rij[1]*fac_pq*(1.0 - exp(ChargePen*Rij));
-//        A[i*n4plus1+n+3*j+2] = -1.0*rij[2]*fac_pq*(1.0 - exp(ChargePen*Rij));
-//        }
-//        else {
-
-
-
-        A[i*n4plus1+n+3*j+0] = -1.0*rij[0]*fac_qp;
-        A[i*n4plus1+n+3*j+1] = -1.0*rij[1]*fac_qp;
-        A[i*n4plus1+n+3*j+2] = -1.0*rij[2]*fac_qp;
-
-
-//        }
-
-
-
-
-//        A[n*n4plus1+i*3*n4plus1                  +j] = rij[0]*fac_pq*-1.0;
-//        A[n*n4plus1+i*3*n4plus1+ n4plus1         +j] = rij[1]*fac_pq*-1.0;
-//        A[n*n4plus1+i*3*n4plus1+ n4plus1+ n4plus1+j] = rij[2]*fac_pq*-1.0;
-
-
-
-
-
-//       if ((i < 60 && j >= 60) || (i >= 60 && j < 60) )  {
-//        A[n*n4plus1+j*3*n4plus1                  +i] = -1.0*rij[0]*fac_pq*(1.0 - exp(ChargePen*Rij));
-//        A[n*n4plus1+j*3*n4plus1+ n4plus1         +i] = -1.0*rij[1]*fac_pq*(1.0 - exp(ChargePen*Rij));
-//        A[n*n4plus1+j*3*n4plus1+ n4plus1+ n4plus1+i] = -1.0*rij[2]*fac_pq*(1.0 - exp(ChargePen*Rij));
-//        }
-//        else {
-
-
-
-        A[n*n4plus1+j*3*n4plus1                  +i] = -1.0*rij[0]*fac_qp;
-        A[n*n4plus1+j*3*n4plus1+ n4plus1         +i] = -1.0*rij[1]*fac_qp;
-        A[n*n4plus1+j*3*n4plus1+ n4plus1+ n4plus1+i] = -1.0*rij[2]*fac_qp;
-
-
-
-//        }
-
-
-
-
-//        cout<<"first A["<<i*n4plus1+n+3*j+0<<"] = "<<rij[0]*fac_qp*-1.0<<endl;
-//        cout<<"first A["<<i*n4plus1+n+3*j+1<<"] = "<<rij[1]*fac_qp*-1.0<<endl;
-//        cout<<"first A["<<i*n4plus1+n+3*j+2<<"] = "<<rij[2]*fac_qp*-1.0<<endl;
-//        cout<<"second A["<<n*n4plus1+j*3*n4plus1                  +i<<"]="<<rij[0]*fac_qp*-1.0<<endl;
-//        cout<<"second A["<<n*n4plus1+j*3*n4plus1+ n4plus1         +i<<"]="<<rij[1]*fac_qp*-1.0<<endl;
-//        cout<<"second A["<<n*n4plus1+j*3*n4plus1+ n4plus1+ n4plus1+i<<"]="<<rij[2]*fac_qp*-1.0<<endl;
-
-//        cout<<"second A["<<n*n4plus1+i*3*n4plus1                  +j<<"]="<<rij[0]*fac_qp*-1.0<<endl;
-//        cout<<"second A["<<n*n4plus1+i*3*n4plus1+ n4plus1         +j<<"]="<<rij[1]*fac_qp*-1.0<<endl;
-//        cout<<"second A["<<n*n4plus1+i*3*n4plus1+ n4plus1+ n4plus1+j<<"]="<<rij[2]*fac_qp*-1.0<<endl;
-
-
-//        cout<<"Tqx("<<i<<","<<j<<": "<<i*n4plus1+n+3*j+0 <<" :  "<<  rij[0]*fac_pq*-1.0 <<endl;
-//        cout<<"Tqy : "<<i*n4plus1+n+3*j+1 <<" :  "<<  rij[1]*fac_pq*-1.0 <<endl;
-//        cout<<"Tqz : "<<i*n4plus1+n+3*j+2 <<" :  "<<  rij[2]*fac_pq*-1.0 <<endl;
-//        cout<<"Txq : "<<n*n4plus1+j*3*n4plus1                  +i<<" :  "<<  rij[0]*fac_pq*-1.0 <<endl;
-//        cout<<"Tyq : "<<n*n4plus1+j*3*n4plus1+ n4plus1         +i<<" :  "<<  rij[1]*fac_pq*-1.0 <<endl;
-//        cout<<"Tzq : "<<n*n4plus1+j*3*n4plus1+ n4plus1+ n4plus1+i<<" :  "<<  rij[2]*fac_pq*-1.0 <<endl;
- 
-      }
-     
+    else if (IonType[i] == 3) {
+      Rqd[i]= R_const*1.889725989 ;
+      alphaX= alpha_parC/Bohr3;
+      alphaY= alpha_parC/Bohr3;
+      alphaZ= alpha_perpC/Bohr3;
+      Rp[i]= pow(sqrt(2.0/PI)/(2.0/alphaX +1.0/alphaZ),1.0/3.0);
     }
+    invalpha[3*i+0] = 1.0/alphaX ;
+    invalpha[3*i+1] = 1.0/alphaY ;
+    invalpha[3*i+2] = 1.0/alphaZ ;
   }
-
-
-
-
-
-
+  GaussianDipoleBlocks(n, R, &Rqd[0], &Rp[0], &invalpha[0], A, n4plus1);
 
 
 /*
@@ -894,7 +654,6 @@ void BuildPolarizationMatrix(int nSites, const double *R, double *A, int nFuller
 */
   delete[] eigenvalues;
   delete[] eigenvectors;
-  delete[] Matrix;
 
 
 
@@ -1005,19 +764,12 @@ void BuildPolarizationMatrix3(int nSites, const double *R, double *A, int nFulle
   for (int k = 0; k < nplus1*nplus1 ; ++k)
     A[k] = 0.0;
   
- // double* Matrix= new double[ncomb*ncomb];
- // dVec Matrix; Matrix.resize(ncomb*ncomb);
-  double Matrix[nplus1*nplus1];
   double ChargePen=-1.5;
-  double Rqi, Rqj, chi; 
-  
-  for (int k = 0; k < nplus1*nplus1 ; ++k)
-    Matrix[k] = 0.0;
 
 
   //Tqq
   
-  double R_const;
+  double R_const = 0;
    if (CarbonType == 2) R_const=0.01945;
    else if (CarbonType == 3) R_const=0.02279;
    else if (CarbonType == 4) R_const=0.02652;
@@ -1026,34 +778,14 @@ void BuildPolarizationMatrix3(int nSites, const double *R, double *A, int nFulle
    else if (CarbonType == 7) R_const=0.01838;
    else if (CarbonType == 8) R_const=0.01758;
 
-  for (int j = 0; j < n; ++j) {
-    if (IonType[j] == 1) Rqj= 0.68620399*1.889725989 ;
-    else if (IonType[j] == 2) Rqj= 0.01758*1.889725989 ;
-    else if (IonType[j] == 3) Rqj= R_const*1.889725989 ;
-
-    for (int i = 0; i < n; ++i) {
-      if (IonType[i] == 1) Rqi= 0.68620399*1.889725989 ;
-      else if (IonType[j] == 2) Rqi= 0.01758*1.889725989 ;
-      else if (IonType[i] == 3) Rqi= R_const*1.889725989 ;
-      chi = sqrt(2.0/PI)/Rqi  ;
-      if (i == j) {
-        A[nplus1*i+j] = chi; 
-        Matrix[nplus1*i+j] = chi; 
-      }
-      else {
-        double rij[3] ;
-        rij[0] = R[3*i+0] - R[3*j+0];
-        rij[1] = R[3*i+1] - R[3*j+1];
-        rij[2] = R[3*i+2] - R[3*j+2];
-        double Rij = sqrt(rij[0]*rij[0] + rij[1]*rij[1] + rij[2]*rij[2]);
-        double CT=4.0*pow(10,4)*exp(-1.5*Rij);
-        double Rqq = sqrt(Rqi*Rqi+Rqj*Rqj)  ;
-
-         A[nplus1*i+j] = erf(Rij/Rqq)/Rij ; 
-         Matrix[nplus1*i+j] = erf(Rij/Rqq)/Rij ; 
-      }
-    }
+  // Gaussian widths of the charges
+  dVec Rq(n, 0.0);
+  for (int i = 0; i < n; ++i) {
+    if (IonType[i] == 1) Rq[i]= 0.68620399*1.889725989 ;
+    else if (IonType[i] == 2) Rq[i]= 0.01758*1.889725989 ;
+    else if (IonType[i] == 3) Rq[i]= R_const*1.889725989 ;
   }
+  GaussianChargeBlock(n, R, &Rq[0], A, nplus1);
 
 
  int halfn = n/2.0;
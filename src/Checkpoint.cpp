@@ -0,0 +1,212 @@
+//
+//  binary checkpoint of the DVR: grid definition, potential grids, converged
+//  wavefunctions, and optionally the last Lanczos residual
+//
+//  (ARPACK keeps its iteration state in internal variables, so a Lanczos run cannot be
+//  resumed; the residual is only a start vector if there are no converged wavefunctions)
+//
+//  the file is a sequence of tagged chunks after an 8-byte magic "PISCESCK":
+//
+//     char tag[8]   e.g. "WAVEFN  "
+//     int64 type    0 = double, 1 = int32
+//     int64 count   no of elements
+//     data          padded to a multiple of 8 bytes
+//
+//  chunks a reader does not know are skipped, so new chunks can be added without
+//  breaking old files
+//
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <iostream>
+#include <mpi.h>
+#include "Communicator.h"
+#include <stdint.h>
+
+#include "timer.hpp"
+#include "DVR.h"
+#include "MappedFile.h"
+
+using namespace std;
+
+static const char CheckpointMagic[9] = "PISCESCK";
+enum {ChunkDouble = 0, ChunkInt = 1};
+
+static void WriteChunk(FILE *f, const char *tag, int64_t type, int64_t count, const void *data)
+{
+  char t[8];
+  memset(t, ' ', 8);
+  memcpy(t, tag, strlen(tag) < 8 ? strlen(tag) : 8);
+  int64_t nbytes = count * ((type == ChunkDouble) ? 8 : 4);
+  fwrite(t, 1, 8, f);
+  fwrite(&type, 8, 1, f);
+  fwrite(&count, 8, 1, f);
+  if (nbytes > 0)
+    fwrite(data, 1, nbytes, f);
+  static const char pad[8] = {0};
+  if (nbytes % 8)
+    fwrite(pad, 1, 8 - nbytes % 8, f);
+}
+
+//
+//  find chunk tag in the mapped file; returns the data and sets count, or 0 if absent
+//
+static const char* FindChunk(const MappedFile &mf, const char *tag, int64_t type, int64_t *count)
+{
+  char t[8];
+  memset(t, ' ', 8);
+  memcpy(t, tag, strlen(tag) < 8 ? strlen(tag) : 8);
+  size_t pos = 8;
+  while (pos + 24 <= mf.Size()) {
+    const char *p = mf.Data() + pos;
+    int64_t ctype, ccount;
+    memcpy(&ctype, p + 8, 8);
+    memcpy(&ccount, p + 16, 8);
+    int64_t nbytes = ccount * ((ctype == ChunkDouble) ? 8 : 4);
+    if (ccount < 0 || pos + 24 + nbytes > mf.Size())
+      break;  // truncated
+    if (memcmp(p, t, 8) == 0 && ctype == type) {
+      *count = ccount;
+      return p + 24;
+    }
+    pos += 24 + nbytes + ((nbytes % 8) ? 8 - nbytes % 8 : 0);
+  }
+  *count = 0;
+  return 0;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+//  write the checkpoint (rank 0 only)
+//  krylov = 1: also write the Lanczos residual saved by larnoldi
+//
+void DVR::WriteCheckpoint(const char *fname, int krylov)
+{
+  int rank;
+  MPI_Comm_rank( PiscesComm, &rank );
+  if (rank != 0)
+    return;
+
+  progress_timer tmr("WriteCheckpoint", verbose);
+
+  // write to a temporary file first, so a job killed here leaves the old checkpoint intact
+  char tmpname[1024];
+  snprintf(tmpname, sizeof(tmpname), "%s.tmp", fname);
+  FILE *f = fopen(tmpname, "wb");
+  if (f == 0) {
+    cout << "DVR::WriteCheckpoint: cannot open " << tmpname << "\n";
+    return;
+  }
+  const size_t BufSize = 1 << 24;
+  setvbuf(f, 0, _IOFBF, BufSize);
+
+  fwrite(CheckpointMagic, 1, 8, f);
+
+  int griddef[10] = {dvrtype, sampling, no_dim, n_1dbas[0], n_1dbas[1], n_1dbas[2],
+		     max1db[0], max1db[1], max1db[2], ngp};
+  WriteChunk(f, "GRIDDEF", ChunkInt, 10, griddef);
+  WriteChunk(f, "GRIDPTS", ChunkDouble, max1db[0] + max1db[1] + max1db[2], x_dvr);
+
+  WriteChunk(f, "V_DIAG", ChunkDouble, ngp, v_diag);
+  WriteChunk(f, "V_PC", ChunkDouble, ngp, v_diag_pc);
+  WriteChunk(f, "V_IND", ChunkDouble, ngp, v_diag_ind);
+  WriteChunk(f, "V_REP", ChunkDouble, ngp, v_diag_rep);
+  WriteChunk(f, "V_POL", ChunkDouble, ngp, v_diag_pol);
+
+  int nwf = (nconverged < nwavefn) ? nconverged : nwavefn;
+  WriteChunk(f, "NWAVEFN", ChunkInt, 1, &nwf);
+  if (nwf > 0)
+    WriteChunk(f, "WAVEFN", ChunkDouble, (int64_t)nwf * ngp, &wavefn[0]);
+
+  if (krylov && SaveResid.size() == (size_t)ngp)
+    WriteChunk(f, "KRYLOV_R", ChunkDouble, ngp, &SaveResid[0]);
+
+  int err = ferror(f);
+  if (fclose(f) != 0 || err) {
+    cout << "DVR::WriteCheckpoint: error writing " << tmpname << "\n";
+    return;
+  }
+  if (rename(tmpname, fname) != 0)
+    cout << "DVR::WriteCheckpoint: cannot rename " << tmpname << " to " << fname << "\n";
+  else if (verbose > 0)
+    cout << "Checkpoint " << fname << " written (" << nwf << " wavefunctions)\n";
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+//  read a checkpoint written for the same grid
+//  the wavefunctions are put into wavefn (or, if there are none, the Lanczos residual),
+//  with potential = 1 also v_diag and its components
+//
+//  returns the number of wavefunctions read, or -1 if the file is unusable
+//
+int DVR::ReadCheckpoint(const char *fname, int potential)
+{
+  int rank;
+  MPI_Comm_rank( PiscesComm, &rank );
+
+  progress_timer tmr("ReadCheckpoint", verbose);
+
+  MappedFile mf;
+  if (mf.Open(fname) != 0 || mf.Size() < 8 || memcmp(mf.Data(), CheckpointMagic, 8) != 0) {
+    if(rank==0)cout << "DVR::ReadCheckpoint: " << fname << " is missing or not a checkpoint file\n";
+    return -1;
+  }
+
+  // the grid must be the same
+  int64_t n;
+  const int *griddef = (const int*)FindChunk(mf, "GRIDDEF", ChunkInt, &n);
+  const double *gridpts = (const double*)FindChunk(mf, "GRIDPTS", ChunkDouble, &n);
+  int match = (griddef != 0 && gridpts != 0);
+  if (match)
+    match = (griddef[0] == dvrtype && griddef[2] == no_dim && griddef[9] == ngp
+	     && griddef[3] == n_1dbas[0] && griddef[4] == n_1dbas[1] && griddef[5] == n_1dbas[2]
+	     && n == max1db[0] + max1db[1] + max1db[2]);
+  if (match)
+    for (int i = 0; i < n; ++i)
+      if (fabs(gridpts[i] - x_dvr[i]) > 1e-10)
+	match = 0;
+  if (!match) {
+    if(rank==0)cout << "DVR::ReadCheckpoint: the grid in " << fname << " differs from the current grid\n";
+    return -1;
+  }
+
+  if (potential) {
+    const char *tags[5] = {"V_DIAG", "V_PC", "V_IND", "V_REP", "V_POL"};
+    double *grids[5] = {v_diag, v_diag_pc, v_diag_ind, v_diag_rep, v_diag_pol};
+    int nfound = 0;
+    for (int k = 0; k < 5; ++k) {
+      const char *p = FindChunk(mf, tags[k], ChunkDouble, &n);
+      if (p && n == ngp) {
+	memcpy(grids[k], p, ngp*sizeof(double));
+	nfound ++;
+      }
+    }
+    nTerms = 0;
+    validComponents = (nfound == 5);
+  }
+
+  const int *pn = (const int*)FindChunk(mf, "NWAVEFN", ChunkInt, &n);
+  int nstored = (pn && n == 1) ? pn[0] : 0;
+  const char *pwf = FindChunk(mf, "WAVEFN", ChunkDouble, &n);
+  if (pwf == 0 || nstored < 0 || n < (int64_t)nstored * ngp)
+    nstored = 0;   // truncated or inconsistent
+  int nwf = (nstored < nwavefn) ? nstored : nwavefn;
+  if (nwf > 0)
+    memcpy(&wavefn[0], pwf, (size_t)nwf*ngp*sizeof(double));
+  else {
+    // no converged vectors: the last Lanczos residual is a good start
+    const char *pr = FindChunk(mf, "KRYLOV_R", ChunkDouble, &n);
+    if (pr && n == ngp) {
+      memcpy(&wavefn[0], pr, ngp*sizeof(double));
+      nwf = 1;
+    }
+  }
+
+  if (verbose > 0)
+    if(rank==0)cout << "Checkpoint " << fname << ": " << nwf << " start vectors read\n";
+  return nwf;
+}
@@ -6,6 +6,7 @@
 #include <cmath>                 
 #include <sstream>               
 #include <stdexcept>             
+#include <algorithm>
                                  
 #ifdef _OPENMP                   
 #include <omp.h>                 
@@ -18,6 +19,7 @@
 #endif                           
                                  
 #include <mpi.h>                 
+#include "Communicator.h"
 
 #include "timer.hpp"             
 #include "constants.h"           
@@ -48,7 +50,7 @@ using namespace std;
 ClusterAnion::~ClusterAnion()
 {
    int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
   if(rank==0) std::cout << "Hello from ClusterAnion\n";
 }
 
@@ -56,7 +58,7 @@ ClusterAnion::~ClusterAnion()
 void ClusterAnion::SetUpClusterAnion(const dVec WaterPos, const Parameters InP)
 {
    int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 
 
   //  Sets-up WaterN, Vel, and Hel
@@ -72,6 +74,9 @@ void ClusterAnion::SetUpClusterAnion(const dVec WaterPos, const Parameters InP)
   Hel.SetVerbose(Para.gridverbose);
   Hel.DiagonalizeSetup(Para.nStates, Para.DiagMethod, Para.maxSub, Para.maxIter, Para.ptol);
   Vel.SetVerbose(Para.PotVerbose);
+  Vel.SetMesh(Para.MeshSigma);
+  Vel.SetHMatrix(Para.HMatrixTol);
+  Hel.SetDipoleCache(Para.DipoleCache, Para.DipoleCacheTol);
   //delete[] Molecules ; 
 } 
  
@@ -79,7 +84,7 @@ double ClusterAnion::SinglePoint(const dVec WaterPos)
 {
 
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 
 
 
@@ -114,7 +119,7 @@ double ClusterAnion::SinglePoint(const dVec WaterPos)
       char fname[30];
       if(rank==0) sprintf(fname, "WaveFn%02i.gcube", istate);
       if(rank==0)cout << "  " << fname << "\n";
-      Hel.WriteCubeFile(istate, fname, 3*Para.nWater, &NucCharge[0], &WaterCoor[0]);
+      Hel.WriteCubeFile(istate, fname, 3*Para.nWater, &NucCharge[0], &WaterCoor[0], 0, Para.CubeFile > 1);
     }
   }
 
@@ -129,11 +134,33 @@ double ClusterAnion::SinglePoint(const dVec WaterPos)
 }
 
 
+/////////////////////////////////////////////////
+//
+// the next geometry of a batch (same no of waters): only the
+// water model and the potential are set up again, the DVR is kept
+// and the last converged wavefunction is the start vector
+//
+double ClusterAnion::NextGeometry(const dVec WaterPos)
+{
+  WaterN.SetStructure(Para.nWater, &WaterPos[0], 1, Para.CenterFlag, Para.KTFlag, 0);
+  dVec WaterConf(6*Para.nWater);
+  WaterN.GetConfiguration(Para.nWater, &WaterConf[0], 1.0, 0);
+  return EnergyFromConfiguration(&WaterConf[0]);
+}
+
+
+void ClusterAnion::SetTolerance(int ptol)
+{
+  Para.ptol = ptol;
+  Hel.DiagonalizeSetup(Para.nStates, Para.DiagMethod, Para.maxSub, Para.maxIter, Para.ptol);
+}
+
+
 double ClusterAnion::PrintConf(int nWater, double *WaterConf)
 {
 
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 
 
   if(rank==0)cout << "number of waters in  ClusterAnion::PrintConf =  " << nWater << "\n";
@@ -157,7 +184,8 @@ double ClusterAnion::EnergyFromConfiguration(double *WaterConf)
 {
 
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
+  int talk = (rank==0 && !quiet);
 
 
   int nWater = WaterN.ReportNoOfWaters();
@@ -172,13 +200,13 @@ double ClusterAnion::EnergyFromConfiguration(double *WaterConf)
 // Save WaterWater Polarization ----- Tae Hoon Choi
   Vel.VpolWaterWater=WaterN.ReportPolarization();
 
-  if(rank==0)cout << "Energy of the neutral cluster E0 = " << E0 << "\n";
+  if(talk)cout << "Energy of the neutral cluster E0 = " << E0 << "\n";
   int nSites = 0 , nCharges = 0, nDipoles = 0;
   WaterN.ReportNoOfSites(nSites, nCharges, nDipoles);
   int nPntPol = WaterN.ReportNoOfPolSites() ;
 
   if (Para.PotVerbose > 0)
-    if(rank==0)cout << "The electron sees " << nCharges << " charges, " << nDipoles << " dipoles, and there are "
+    if(talk)cout << "The electron sees " << nCharges << " charges, " << nDipoles << " dipoles, and there are "
          <<  nSites << " sites in the gradient calculations.\n";
 
   static dVec Sites; Sites.resize(3*nSites);
@@ -214,7 +242,7 @@ double ClusterAnion::EnergyFromConfiguration(double *WaterConf)
   if (Icombine == 6) {
     Para.PotFlag[3]= 3;
     double spacing = Para.gpara[0]/(Para.ngrid[0]+1);
-    if(rank==0)cout<<"spacing : "<<spacing<<endl;
+    if(talk)cout<<"spacing : "<<spacing<<endl;
     if (Para.ngrid[0]%2 == 1 ) {
       Tngrid[0]=(Para.ngrid[0]+1)/2;
       Tngrid[1]=(Para.ngrid[1]+1)/2;
@@ -244,11 +272,11 @@ double ClusterAnion::EnergyFromConfiguration(double *WaterConf)
             nDipoles, &Dipoles[0], &ids[0],
             nPntPol, &Alphas[0], &ips[0], &Epc[0],
            &DmuByDR[0],Para.PotPara);
-   if(rank==0)cout << "  ************  BEGIN ENERGY ***************" << endl;
+   if(talk)cout << "  ************  BEGIN ENERGY ***************" << endl;
    Hel.ComputePotential(Vel);
 
   ebes.resize(Para.nStates);
-  if(rank==0)cout<< "Para.istartvec = "<<Para.istartvec<<endl;
+  if(talk)cout<< "Para.istartvec = "<<Para.istartvec<<endl;
   nconverged = Hel.Diagonalize(Para.istartvec, &ebes[0]);
   
   // Now we can save the wavefn - Tae Hoon Choi
@@ -264,7 +292,7 @@ double ClusterAnion::EnergyFromConfiguration(double *WaterConf)
             nDipoles, &Dipoles[0], &ids[0],
             nPntPol, &Alphas[0], &ips[0], &Epc[0],
            &DmuByDR[0],Para.PotPara);
-     if(rank==0)cout << "  ************  refining ENERGY ***************" << endl;
+     if(talk)cout << "  ************  refining ENERGY ***************" << endl;
      Hel.ComputePotential(Vel);
 
     ebes.resize(Para.nStates);
@@ -274,8 +302,8 @@ double ClusterAnion::EnergyFromConfiguration(double *WaterConf)
 // this if for dual-grid method from Tae Hoon Choi
   if (Icombine == 6) {
 
-     if(rank==0)cout<<"  ***  Energies For pre-calculations    ***  "<<endl;
-     if(rank==0)cout << "       EBE      = "<<  ebes[0]*AU2MEV        << " meV"<<endl;
+     if(talk)cout<<"  ***  Energies For pre-calculations    ***  "<<endl;
+     if(talk)cout << "       EBE      = "<<  ebes[0]*AU2MEV        << " meV"<<endl;
 
     Para.PotFlag[3]= 6;
     Para.ptol=OriginTol;
@@ -289,7 +317,7 @@ double ClusterAnion::EnergyFromConfiguration(double *WaterConf)
             nDipoles, &Dipoles[0], &ids[0],
             nPntPol, &Alphas[0], &ips[0], &Epc[0],
            &DmuByDR[0],Para.PotPara);
-     if(rank==0)cout << "  ************  refining ENERGY ***************" << endl;
+     if(talk)cout << "  ************  refining ENERGY ***************" << endl;
      Hel.ComputePotential(Vel);
     ebes.resize(Para.nStates);
     Para.istartvec = 3; // using the converged wavefn with coarse grid + interpolations
@@ -302,29 +330,34 @@ double ClusterAnion::EnergyFromConfiguration(double *WaterConf)
    if (nconverged < 1)
     {if(rank==0)cout << "GetClusterEnergy:: Convergence failure.\n"; exit(1);}
 
+   // restart point for preempted jobs (StartVector = 5)
+   if (Para.Checkpoint > 0)
+     Hel.WriteCheckpoint(Hel.GetCheckpointFile(), Para.Checkpoint > 1);
+
 
-     if(rank==0)cout<<"                                              "<<endl;
-     if(rank==0)cout<<"  ------------------------------------------  "<<endl;
-     if(rank==0)cout<<"  ***  Energies For The Current Geometry ***  "<<endl;
-     if(rank==0)cout<<"  ------------------------------------------  "<<endl;
-     if(rank==0)cout << "       Eneutral = "<<  E0*AU2MEV         << " meV"<<endl;
-     if(rank==0)cout << "       EBE      = "<<  EBE*AU2MEV        << " meV"<<endl;
-     if(rank==0)cout << "       Etotal   = "<<  (EBE+E0)*AU2MEV   << " meV"<<endl;
-     if(rank==0)cout<<"  ------------------------------------------  "<<endl;
-     if(rank==0)cout << "  **************  END ENERGY ***************" << endl;
-     if(rank==0)cout<<"                                              "<<endl;
+     if(talk)cout<<"                                              "<<endl;
+     if(talk)cout<<"  ------------------------------------------  "<<endl;
+     if(talk)cout<<"  ***  Energies For The Current Geometry ***  "<<endl;
+     if(talk)cout<<"  ------------------------------------------  "<<endl;
+     if(talk)cout << "       Eneutral = "<<  E0*AU2MEV         << " meV"<<endl;
+     if(talk)cout << "       EBE      = "<<  EBE*AU2MEV        << " meV"<<endl;
+     if(talk)cout << "       Etotal   = "<<  (EBE+E0)*AU2MEV   << " meV"<<endl;
+     if(talk)cout<<"  ------------------------------------------  "<<endl;
+     if(talk)cout << "  **************  END ENERGY ***************" << endl;
+     if(talk)cout<<"                                              "<<endl;
 
 //   DumpGeometry(nWater, E0+EBE, &Sites[0] );
 
    return E0+EBE;
 }
 
-void ClusterAnion::GetAnalGrad( const double *WaterConf, double *analgrad) 
+void ClusterAnion::GetAnalGrad( const double *WaterConf, double *analgrad, double *SiteGrad, double *SitePos) 
 {
 
 
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
+  int talk = (rank==0 && !quiet);
 
 
   int nWater = WaterN.ReportNoOfWaters();
@@ -406,23 +439,31 @@ void BuildSuperdT(int nPolSites, const double *R, const double *alpha, double aT
  BuildSuperdT(nPntPol, &Rpps[0], &Alphas[0], 0.3, &dT_x[0] , &dT_y[0] , &dT_z[0]) ;
 
 
-   if(rank==0)cout << "  **********  BEGIN GRADIENT  ************" << endl;
+   if(talk)cout << "  **********  BEGIN GRADIENT  ************" << endl;
+   if (quiet)
+     Hel.SetVerbose(-1);  // no timing line either
    Hel.ComputeGradient(Vel, nSites, &Gradient[0], &dT_x[0], &dT_y[0], &dT_z[0], &PolGrad[0], WaterN , &dEfield[0]);
+   if (quiet)
+     Hel.SetVerbose(Para.gridverbose);
 
 
+   if (SiteGrad != 0)
+     std::copy(Gradient.begin(), Gradient.begin() + 3*nSites, SiteGrad);
+   if (SitePos != 0)
+     std::copy(Sites.begin(), Sites.begin() + 3*nSites, SitePos);
    WaterN.ConvertF(&Gradient[0], analgrad);
 
    // printing gradients
-  if(rank==0)cout<<"                                              "<<endl;
-  if(rank==0)cout<<"  ------------------------------------------  "<<endl;
-  if(rank==0)cout<<"  *** Gradients For The Current Geometry ***  "<<endl;
-  if(rank==0)cout<<"  ------------------------------------------  "<<endl;
+  if(talk)cout<<"                                              "<<endl;
+  if(talk)cout<<"  ------------------------------------------  "<<endl;
+  if(talk)cout<<"  *** Gradients For The Current Geometry ***  "<<endl;
+  if(talk)cout<<"  ------------------------------------------  "<<endl;
    for(int k=0; k < nWater*2 ;++k){
-  if(rank==0)cout<<"  AnalGrad "<<analgrad[k*3]<<" "<<analgrad[k*3+1]<<" "<<analgrad[k*3+2]<<endl;
+  if(talk)cout<<"  AnalGrad "<<analgrad[k*3]<<" "<<analgrad[k*3+1]<<" "<<analgrad[k*3+2]<<endl;
    }
-  if(rank==0)cout<<"  ------------------------------------------  "<<endl;
-  if(rank==0)cout << "  **********  END GRADIENT  **************" << endl;
-  if(rank==0)cout<<"                                              "<<endl;
+  if(talk)cout<<"  ------------------------------------------  "<<endl;
+  if(talk)cout << "  **********  END GRADIENT  **************" << endl;
+  if(talk)cout<<"                                              "<<endl;
 //  exit(1);
 
 
@@ -435,7 +476,7 @@ void ClusterAnion::GetNumGrad(const double *configuration, double *numgrad)
 
 
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 
 
   int nWater = WaterN.ReportNoOfWaters();
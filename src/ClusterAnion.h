@@ -6,14 +6,25 @@ class ClusterAnion
  public:
 
   ClusterAnion() 
+    : quiet(0)
     {
     }
 
   void SetUpClusterAnion(const dVec WaterPos, const Parameters InP);
   double SinglePoint(const dVec WaterPos);
+  /// batch runs: energy of a new geometry reusing the grid, the plans, and the last wavefunction
+  double NextGeometry(const dVec WaterPos);
+  double BindingEnergy() const { return ebes[0]; }
+  int StateMoments(dVec &m) { return Hel.StateMoments(m); }
+  /// MD: start vectors, matvec counts, and the tolerance of the next diagonalization
+  DVR& Hamiltonian() { return Hel; }
+  void SetTolerance(int ptol);
   double EnergyFromConfiguration(double *WaterConf);
+  /// quiet = 1: EnergyFromConfiguration and GetAnalGrad print nothing (batch and MD runs)
+  void SetQuiet(int q) { quiet = q; }
   double PrintConf(int nWater, double *WaterConf) ; 
-  void GetAnalGrad( const double *WaterConf, double *analgrad);
+  /// optionally also the cartesian gradient and the positions of all sites (3*nSites each, Bohr)
+  void GetAnalGrad( const double *WaterConf, double *analgrad, double *SiteGrad = 0, double *SitePos = 0);
   void GetNumGrad( const double *WaterConf, double *analgrad);
 
   ~ClusterAnion();
@@ -28,6 +39,7 @@ class ClusterAnion
   int nWater ;
   int nconverged ;
   DVR Hel ;  
+  int quiet ;
 
 };
 
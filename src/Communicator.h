@@ -0,0 +1,16 @@
+#ifndef PISCES_COMMUNICATOR_H_
+#define PISCES_COMMUNICATOR_H_
+
+#include <mpi.h>
+
+//
+//  the ranks that solve one electron problem together: the grid points are
+//  distributed over them and their rank 0 collects and prints
+//
+//  this is MPI_COMM_WORLD, unless a driver splits the ranks into groups
+//  that work on different clusters (replica exchange); input parsing and
+//  the profiler always use MPI_COMM_WORLD
+//
+extern MPI_Comm PiscesComm;
+
+#endif // PISCES_COMMUNICATOR_H_
@@ -0,0 +1,160 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <iostream>
+
+#include "CubeWriter.h"
+
+using namespace std;
+
+
+// 10^(k-350), initialized once (thread-safe as a function-local static)
+struct PowerTable {
+  double p[700];
+  PowerTable() { for (int k = 0; k < 700; ++k) p[k] = pow(10.0, k - 350); }
+};
+
+//
+//  x formatted as by printf("%13.6e"); returns the number of characters written
+//  the mantissa is rounded from x*10^(6-e), which can differ from printf in the
+//  last digit for exact ties
+//
+static int FormatE13(double x, char *s)
+{
+  if (!(fabs(x) <= 1.7e308))  // nan or inf
+    return sprintf(s, "%13.6e", x);
+
+  static const PowerTable tenpow;
+
+  char *p = s;
+  double a = fabs(x);
+  int e = 0;
+  long long m = 0;
+  if (a >= 1e-300) {
+    e = (int)floor(log10(a));
+    m = llround(a * tenpow.p[350 + 6 - e]);
+    if (m >= 10000000) {
+      e ++;
+      m = llround(a * tenpow.p[350 + 6 - e]);
+    }
+    else if (m < 1000000) {
+      e --;
+      m = llround(a * tenpow.p[350 + 6 - e]);
+    }
+  }
+  else if (a > 0)
+    return sprintf(s, "%13.6e", x);
+
+  int ae = abs(e);
+  if (signbit(x))
+    *p++ = '-';
+  else if (ae < 100)
+    *p++ = ' ';   // pad to 13 characters
+  char digits[7];
+  for (int k = 6; k >= 0; --k) {
+    digits[k] = '0' + (char)(m % 10);
+    m /= 10;
+  }
+  *p++ = digits[0];
+  *p++ = '.';
+  for (int k = 1; k < 7; ++k)
+    *p++ = digits[k];
+  *p++ = 'e';
+  *p++ = (e < 0) ? '-' : '+';
+  if (ae >= 100) {
+    *p++ = '0' + ae / 100;
+    ae %= 100;
+  }
+  *p++ = '0' + ae / 10;
+  *p++ = '0' + ae % 10;
+  return (int)(p - s);
+}
+
+
+void WriteCubeValues(FILE *f, const int *n, const long *stride, const double *v,
+		     double scale, int perline, int spacesep)
+{
+  const long nplane = (long)n[1] * n[2];
+  const int nlines = n[1] * ((n[2] + perline - 1) / perline);
+  const long maxplane = nplane * 15 + nlines + 16;   // at most 15 characters per value
+
+  // outer planes per round: about 32 MB of text
+  int round = (int)((1L << 25) / maxplane);
+  if (round < 1) round = 1;
+  if (round > n[0]) round = n[0];
+
+  vector<char> text(round * maxplane);
+  vector<long> length(round);
+
+  for (int i0 = 0; i0 < n[0]; i0 += round) {
+    int i1 = (i0 + round < n[0]) ? i0 + round : n[0];
+#pragma omp parallel
+    {
+      vector<double> plane(nplane);
+#pragma omp for schedule(dynamic)
+      for (int i = i0; i < i1; ++i) {
+	const double *vi = v + i * stride[0];
+	// gather the plane; the loop order follows the smaller stride
+	if (stride[2] <= stride[1])
+	  for (int j = 0; j < n[1]; ++j)
+	    for (int k = 0; k < n[2]; ++k)
+	      plane[(long)j*n[2] + k] = vi[j*stride[1] + k*stride[2]];
+	else
+	  for (int k = 0; k < n[2]; ++k)
+	    for (int j = 0; j < n[1]; ++j)
+	      plane[(long)j*n[2] + k] = vi[j*stride[1] + k*stride[2]];
+
+	char *p = &text[(i - i0) * maxplane];
+	char *p0 = p;
+	for (int j = 0; j < n[1]; ++j) {
+	  const double *row = &plane[(long)j*n[2]];
+	  for (int k = 0; k < n[2]; ++k) {
+	    p += FormatE13(row[k] * scale, p);
+	    if (spacesep)
+	      *p++ = ' ';
+	    if ((k + 1) % perline == 0)
+	      *p++ = '\n';
+	  }
+	  if (n[2] % perline != 0)
+	    *p++ = '\n';
+	}
+	length[i - i0] = p - p0;
+      }
+    }
+    for (int i = i0; i < i1; ++i)
+      fwrite(&text[(i - i0) * maxplane], 1, length[i - i0], f);
+  }
+}
+
+
+void WriteCubeBinary(const char *fname, const int *n, const double *x0, const double *dx,
+		     const double *v, double scale)
+{
+  FILE *f = fopen(fname, "wb");
+  if (f == 0) {
+    cout << "WriteCubeBinary: cannot open " << fname << "\n";
+    return;
+  }
+  fwrite("PISCESCB", 1, 8, f);
+  fwrite(n, sizeof(int), 3, f);
+  int pad = 0;
+  fwrite(&pad, sizeof(int), 1, f);
+  fwrite(x0, sizeof(double), 3, f);
+  fwrite(dx, sizeof(double), 3, f);
+  long ntot = (long)n[0] * n[1] * n[2];
+  if (scale == 1.0)
+    fwrite(v, sizeof(double), ntot, f);
+  else {
+    const long nbuf = 1 << 20;
+    vector<double> buf(nbuf);
+    for (long i0 = 0; i0 < ntot; i0 += nbuf) {
+      long m = (i0 + nbuf < ntot) ? nbuf : ntot - i0;
+      for (long i = 0; i < m; ++i)
+	buf[i] = v[i0 + i] * scale;
+      fwrite(&buf[0], sizeof(double), m, f);
+    }
+  }
+  fclose(f);
+}
@@ -0,0 +1,27 @@
+#ifndef PISCES_CUBEWRITER_H_
+#define PISCES_CUBEWRITER_H_
+
+#include <cstdio>
+
+//
+//  fast output of the data part of cube files
+//
+//  the values are written in file order: n[0] outer, n[1] middle, n[2] inner,
+//  the value (i,j,k) is scale * v[i*stride[0] + j*stride[1] + k*stride[2]]
+//  each value is formatted as "%13.6e", followed by a space if spacesep != 0,
+//  a newline follows every perline values and the end of each inner run
+//
+//  blocks of outer planes are gathered (reading v in its memory order) and formatted
+//  in parallel, and each block of text is written with a single fwrite
+//
+void WriteCubeValues(FILE *f, const int *n, const long *stride, const double *v,
+		     double scale, int perline, int spacesep);
+
+//
+//  binary sibling of a cube file:  "PISCESCB", int n[3], int 0, double x0[3], double dx[3],
+//  then n[0]*n[1]*n[2] doubles, x running fastest
+//
+void WriteCubeBinary(const char *fname, const int *n, const double *x0, const double *dx,
+		     const double *v, double scale);
+
+#endif // PISCES_CUBEWRITER_H_
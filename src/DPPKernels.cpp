@@ -0,0 +1,184 @@
+#include <cstdlib>
+#include <cmath>
+#include <iostream>
+
+#include "vecdefs.h"
+#include "Potential.h"
+
+using namespace std;
+
+//
+//  the DPPnSP potential of EvaluateDPPGTOP (PotFlags 1-4) for a tile of points,
+//  compiled for one model at a time:
+//
+//    Damp       DampType     1: Gaussian damping   2: effective distance
+//    Core       RepCoreType  0: none   1: GTOs   2: STOs
+//    Pol        0: none   1: non-interacting polarizable sites (PolType 1)
+//               9: all other PolTypes, through EvaluatePolarizationTerm
+//    Adiabatic  AdiabaticPolPot (Pol = 1 only)
+//
+//  so the loops over the sites have no switches left: the damping is either a table lookup
+//  (RadialTable) or the effective distance written as a select, and both vectorize
+//
+//  SelectDPPKernel picks the instantiation at Setup, and EvaluateBatch calls it once per tile
+//  (verbose output and PolTypes 5 and 6 stay with Evaluate)
+//
+
+namespace {
+
+  // the effective distance of DampType 2 with cut-off r0
+  inline double EffectiveR(double R, double r0)
+  {
+    double ror0 = R / r0;
+    double Rs = r0 * (0.5 + ror0 * ror0 * ror0 * (1.0 - 0.5 * ror0));
+    return (R < r0) ? Rs : R;
+  }
+
+}
+
+
+template <int Damp, int Core, int Pol, int Adiabatic>
+void Potential::EvaluateDPPTile(int np, const double *r, double *v, double *energies)
+{
+  PotentialWorkspace &w = Work();
+  const double *Rx = w.Rx.data(), *Ry = w.Ry.data(), *Rz = w.Rz.data();
+  const double *R = w.R.data(), *R2 = w.R2.data(), *Rminus3 = w.Rminus3.data();
+
+  const double *q = Charge.data(), *mu = Dipole.data(), *a = PPS.data(), *c = Gauss.data();
+  const int *qs = ChargeSite.data(), *ds = DipoleSite.data(), *ps = PPSSite.data(), *gs = GaussSite.data();
+
+  // tables matching the parameters, or libm
+  const RadialTable *qt = ChargeTable.Is(RadialTable::GaussDamp, ChargeDamping) ? &ChargeTable : 0;
+  const RadialTable *dt = DipoleTable.Is(RadialTable::GaussDamp, DipoleDamping) ? &DipoleTable : 0;
+  const RadialTable *pt = PolTable.Is(RadialTable::GaussDamp, PolDamping) ? &PolTable : 0;
+  const RadialTable *ct = (CoreTabulated == Core) ? CoreTables.data() : 0;
+  const int *gt = GaussTable.data();
+  int inductionInPol = (PolType == 4 || PolType == 6);
+
+  for (int p = 0; p < np; ++p) {
+    const double *x = &r[3*p];
+    ComputeDistances(x);
+
+    // point charges
+    double Vpc = 0;
+    if (Damp == 1 && qt) {
+      const RadialTable &f = *qt;
+#pragma omp simd reduction(+:Vpc)
+      for (int i = 0; i < nCharges; ++i)
+	Vpc += -q[i] / R[qs[i]] * f(R2[qs[i]]);
+    }
+    else if (Damp == 1) {
+      for (int i = 0; i < nCharges; ++i)
+	Vpc += -q[i] / R[qs[i]] * (1.0 - exp(-ChargeDamping * R2[qs[i]]));
+    }
+    else {
+#pragma omp simd reduction(+:Vpc)
+      for (int i = 0; i < nCharges; ++i)
+	Vpc += -q[i] / EffectiveR(R[qs[i]], ChargeDamping);
+    }
+
+    // point dipoles
+    double Vind = 0;
+    if (!inductionInPol) {
+      if (Damp == 1) {
+#pragma omp simd reduction(+:Vind)
+	for (int i = 0; i < nDipoles; ++i) {
+	  int s = ds[i];
+	  double d = dt ? (*dt)(R2[s]) : 1.0 - exp(-DipoleDamping * R2[s]);
+	  Vind += -(Rx[s]*mu[3*i] + Ry[s]*mu[3*i+1] + Rz[s]*mu[3*i+2]) * Rminus3[s] * d * d;
+	}
+      }
+      else {
+#pragma omp simd reduction(+:Vind)
+	for (int i = 0; i < nDipoles; ++i) {
+	  int s = ds[i];
+	  double Reff = EffectiveR(R[s], DipoleDamping);
+	  double Rm3 = (R[s] < DipoleDamping) ? 1.0 / (Reff * Reff * Reff) : Rminus3[s];
+	  Vind += -(Rx[s]*mu[3*i] + Ry[s]*mu[3*i+1] + Rz[s]*mu[3*i+2]) * Rm3;
+	}
+      }
+    }
+
+    // repulsive core
+    double Vrep = 0;
+    if (Core > 0 && ct) {
+      for (int i = 0; i < nGauss; ++i)
+	Vrep += c[2*i+1] * ct[gt[i]]((Core == 1) ? R2[gs[i]] : R[gs[i]]);
+    }
+    else if (Core > 0) {
+#pragma omp simd reduction(+:Vrep)
+      for (int i = 0; i < nGauss; ++i)
+	Vrep += c[2*i+1] * exp(-c[2*i] * ((Core == 1) ? R2[gs[i]] : R[gs[i]]));
+    }
+
+    // polarization
+    double Vpol = 0;
+    if (Pol == 1) {
+      double Spol = 0;
+      if (Damp == 1) {
+#pragma omp simd reduction(+:Spol)
+	for (int i = 0; i < nPPS; ++i) {
+	  double Rsq = R2[ps[i]];
+	  double d = pt ? (*pt)(Rsq) : 1.0 - exp(-PolDamping * Rsq);
+	  Spol += a[i] * d * d / (Rsq * Rsq);
+	}
+      }
+      else {
+#pragma omp simd reduction(+:Spol)
+	for (int i = 0; i < nPPS; ++i) {
+	  double Rsq = R2[ps[i]];
+	  double Reff = EffectiveR(R[ps[i]], PolDamping);
+	  double Rsqeff = Reff * Reff;
+	  Spol += (R[ps[i]] < PolDamping) ? a[i] * Rsq / (Rsqeff * Rsqeff * Rsqeff) : a[i] / (Rsq * Rsq);
+	}
+      }
+      if (Adiabatic)
+	Vpol = EpsDrude - sqrt(EpsDrude*(EpsDrude + Spol));
+      else
+	Vpol = -0.5 * Spol;
+    }
+    else if (Pol == 9)
+      Vpol = EvaluatePolarizationTerm(x);
+
+    double *e = &energies[nReturnEnergies*p];
+    e[0] = Vpc;
+    e[1] = Vind;
+    e[2] = Vrep;
+    e[3] = Vpol;
+    e[4] = v[p] = Vpc + Vind + Vrep + Vpol;
+  }
+}
+
+
+//
+//  the instantiation for the model that has been set up (0 if there is none)
+//
+void Potential::SelectDPPKernel()
+{
+  DPPKernel = 0;
+  if (PotFlags[0] < 1 || PotFlags[0] > 4 || PolType == 5 || PolType == 6)
+    return;
+  int pol = (PolType == 0 || PolType == 1) ? PolType : 9;
+  int adiabatic = (pol == 1) ? AdiabaticPolPot : 0;
+  int model = 1000*DampType + 100*RepCoreType + 10*pol + adiabatic;
+
+#define DPP_KERNEL(d, c, p, a) \
+  case 1000*d + 100*c + 10*p + a: DPPKernel = &Potential::EvaluateDPPTile<d, c, p, a>; break;
+#define DPP_KERNELS(d, c) \
+  DPP_KERNEL(d, c, 0, 0) DPP_KERNEL(d, c, 1, 0) DPP_KERNEL(d, c, 1, 1) DPP_KERNEL(d, c, 9, 0)
+
+  switch (model)
+    {
+      DPP_KERNELS(1, 0)
+      DPP_KERNELS(1, 1)
+      DPP_KERNELS(1, 2)
+      DPP_KERNELS(2, 0)
+      DPP_KERNELS(2, 1)
+      DPP_KERNELS(2, 2)
+    default:
+      break;   // Evaluate point by point
+    }
+
+#undef DPP_KERNELS
+#undef DPP_KERNEL
+}
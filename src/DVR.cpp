@@ -12,12 +12,14 @@
 #include <cstring>
 #include <cmath>
 #include <iostream>
+#include <algorithm>
 
 
 #ifdef _OPENMP
 #include <omp.h>
 #endif
 #include <mpi.h>
+#include "Communicator.h"
 #include "VectorFFT.hpp"
 
 #include "timer.hpp"
@@ -31,6 +33,7 @@
 #include "writewfcuts.h"
 #include "Small2Large.h"
 #include "ReadCubeFile.h"
+#include "CubeWriter.h"
 #include "lapackblas.h"
 
 
@@ -41,6 +44,8 @@
 
 using namespace std;
 
+MPI_Comm PiscesComm = MPI_COMM_WORLD;
+
 // get random number in [0,1]
 double Rand01(void);
 double Rand01(void)
@@ -64,8 +69,10 @@ inline int sub2ind( int i, int j, int k, const int n[] );
 void DVR::SetupDVR(const int *npts, int type, int Sampling, const double *para, int gridverbose)
 {
 
+  nCachedDipoles = 0;  // cached induced dipoles are for the old grid
+
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 
 
   verbose = gridverbose;
@@ -100,6 +107,8 @@ cout<<"npts 0 1 2 ="<<n_1dbas[0]<<" "<<n_1dbas[1]<<" "<<n_1dbas[2]<<endl;
 cout<<"para 0 1 2 ="<<gridpara[0]<<" "<<gridpara[1]<<" "<<gridpara[2]<<endl;
   
   Idual = 0;
+  nTerms = 0;
+  validComponents = 0;
   ComputeGridParameters();  // finds max1d, ngp, and strides for v_diag
 
 
@@ -111,7 +120,7 @@ cout<<"para 0 1 2 ="<<gridpara[0]<<" "<<gridpara[1]<<" "<<gridpara[2]<<endl;
   Vec_x_dvr.resize(max1db[0]*max1db[1]*max1db[2]);
   x_dvr = &Vec_x_dvr[0];
 //  Vec_v_diag.resize(un_ngp);
-   Vec_v_diag.resize(ngp);
+   GridResize(Vec_v_diag, ngp);
 
   v_diag = &Vec_v_diag[0];
 
@@ -120,10 +129,10 @@ cout<<"para 0 1 2 ="<<gridpara[0]<<" "<<gridpara[1]<<" "<<gridpara[2]<<endl;
 //  Vec_v_diag_rep.resize(un_ngp);
 //  Vec_v_diag_pol.resize(un_ngp);
 
-  Vec_v_diag_pc.resize(ngp);
-  Vec_v_diag_ind.resize(ngp);
-  Vec_v_diag_rep.resize(ngp);
-  Vec_v_diag_pol.resize(ngp);
+  GridResize(Vec_v_diag_pc, ngp);
+  GridResize(Vec_v_diag_ind, ngp);
+  GridResize(Vec_v_diag_rep, ngp);
+  GridResize(Vec_v_diag_pol, ngp);
 
 
 
@@ -135,10 +144,17 @@ cout<<"para 0 1 2 ="<<gridpara[0]<<" "<<gridpara[1]<<" "<<gridpara[2]<<endl;
   v_diag_pol = &Vec_v_diag_pol[0];
 
 
+  // a repeated setup replaces the 1D matrices
+  for (int idim = 0; idim < no_dim; ++idim) {
+    delete[] e_kin[idim];
+    delete[] dvr_rep[idim];
+  }
+
   //TV: Set up FFT parameters if DVRtype =3
-  if(dvrtype == 3){
+  //    DVRtype =4 is the sine DVR with the sine transform for T
+  if(dvrtype == 3 || dvrtype == 4){
      FFTSetup();
-     if(rank==0)cout << "Using FFT for Hamiltonian \n"; cout.flush();
+     if(rank==0)cout << ((dvrtype == 3) ? "Using FFT for Hamiltonian \n" : "Using DST-I for Hamiltonian \n"); cout.flush();
   }
 
   for (int idim = 0; idim < no_dim; ++idim) {
@@ -163,8 +179,10 @@ cout<<"para 0 1 2 ="<<gridpara[0]<<" "<<gridpara[1]<<" "<<gridpara[2]<<endl;
 void DVR::SetupDVR2(const int *npts, int type, int Sampling, const double *para, int gridverbose)
 {
 
+  nCachedDipoles = 0;  // cached induced dipoles are for the old grid
+
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 
 // this is basicall the same as SetupDVR, but it is for the dual grid method. -- Tae Hoon Choi
 //
@@ -190,6 +208,8 @@ if(rank==0)cout<<"para 0 1 2 ="<<para[0]<<" "<<para[1]<<" "<<para[2]<<endl;
    if(rank==0)cout<<"npts[0] = "<<npts[0]<<endl;
    if(rank==0)cout<<"Idual = "<<Idual<<endl;
 
+  nTerms = 0;
+  validComponents = 0;
   ComputeGridParameters();  // finds max1d, ngp, and strides for v_diag
 
   cout<<" finish GridParameters "<<endl;
@@ -205,7 +225,7 @@ if(rank==0)cout<<"para 0 1 2 ="<<para[0]<<" "<<para[1]<<" "<<para[2]<<endl;
 
 
 //  Vec_v_diag.resize(un_ngp);
-  Vec_v_diag.resize(ngp);
+  GridResize(Vec_v_diag, ngp);
   v_diag = &Vec_v_diag[0];
 
 
@@ -214,10 +234,10 @@ if(rank==0)cout<<"para 0 1 2 ="<<para[0]<<" "<<para[1]<<" "<<para[2]<<endl;
 //  Vec_v_diag_rep.resize(un_ngp);
 //  Vec_v_diag_pol.resize(un_ngp);
 
-  Vec_v_diag_pc.resize(ngp);
-  Vec_v_diag_ind.resize(ngp);
-  Vec_v_diag_rep.resize(ngp);
-  Vec_v_diag_pol.resize(ngp);
+  GridResize(Vec_v_diag_pc, ngp);
+  GridResize(Vec_v_diag_ind, ngp);
+  GridResize(Vec_v_diag_rep, ngp);
+  GridResize(Vec_v_diag_pol, ngp);
 
   v_diag_pc = &Vec_v_diag_pc[0];
   v_diag_ind = &Vec_v_diag_ind[0];
@@ -226,12 +246,11 @@ if(rank==0)cout<<"para 0 1 2 ="<<para[0]<<" "<<para[1]<<" "<<para[2]<<endl;
 
 
   for (int idim = 0; idim < no_dim; ++idim) {
-    if (e_kin[idim] >= 0) delete[] e_kin[idim];
-    if (dvr_rep[idim] >= 0) delete[] dvr_rep[idim];
+    delete[] e_kin[idim];
+    delete[] dvr_rep[idim];
   }
 
 /*
-   delete []  KE_diag ;
    delete []  phi_x   ;
    delete []  phi_k  ;
    delete []  KE_phi_k;
@@ -239,9 +258,10 @@ if(rank==0)cout<<"para 0 1 2 ="<<para[0]<<" "<<para[1]<<" "<<para[2]<<endl;
 */
 
   //TV: Set up FFT parameters if DVRtype =3
-  if(dvrtype == 3){
+  //    DVRtype =4 is the sine DVR with the sine transform for T
+  if(dvrtype == 3 || dvrtype == 4){
      FFTSetup();
-     if(rank==0)cout << "Using FFT for Hamiltonian \n"; cout.flush();
+     if(rank==0)cout << ((dvrtype == 3) ? "Using FFT for Hamiltonian \n" : "Using DST-I for Hamiltonian \n"); cout.flush();
   }
 
 
@@ -269,8 +289,8 @@ DVR::~DVR()
 {
 
   for (int idim = 0; idim < no_dim; ++idim) {
-    if (e_kin[idim] >= 0) delete[] e_kin[idim];
-    if (dvr_rep[idim] >= 0) delete[] dvr_rep[idim];
+    delete[] e_kin[idim];
+    delete[] dvr_rep[idim];
   }
 
 }
@@ -282,13 +302,16 @@ void DVR::SetVerbose(int v)
    verbose = v;
 }
 
-void DVR::FFTSetup()
-{
 
+void DVR::SetDipoleCache(int flag, double tol)
+{
+  DipoleCacheFlag = flag;
+  DipoleCacheTol = tol;
+  nCachedDipoles = 0;
+}
 
-    int nthreads = 1;    
-    nthreads = omp_get_max_threads();
-
+void DVR::FFTSetup()
+{
 
 // FFTW-MPI routine
 /*
@@ -298,14 +321,10 @@ void DVR::FFTSetup()
 */
 
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
-  //TV: Define the arrays for fourier transformation  
-  int nrofpts = n_1dbas[0]*n_1dbas[1]*n_1dbas[2];
-
+  MPI_Comm_rank( PiscesComm, &rank );
  //class VectorFFT fft_engine(n_1dbas);
 
 
-      KE_diag = new double[nrofpts];        
 /*
       phi_x       = new Complex[nrofpts];     
       phi_k       = new Complex[nrofpts]; 
@@ -327,12 +346,12 @@ void DVR::FFTSetup()
 
 
 /*
-  MPI_Barrier( MPI_COMM_WORLD );
+  MPI_Barrier( PiscesComm );
 
-  // plan_forward   = fftw_mpi_plan_dft(3, Narray, phi_x, phi_k, MPI_COMM_WORLD, FFTW_FORWARD,  FFTW_ESTIMATE);
-  //  plan_backward  = fftw_mpi_plan_dft(3, Narray, KE_phi_k,KE_phi_x, MPI_COMM_WORLD, FFTW_BACKWARD, FFTW_ESTIMATE);
-   plan_forward   = fftw_mpi_plan_dft_3d(N0,N1,N2, phi_x, phi_k, MPI_COMM_WORLD, FFTW_FORWARD,  FFTW_ESTIMATE);
-    plan_backward  = fftw_mpi_plan_dft_3d(N0,N1,N2,  KE_phi_k,KE_phi_x, MPI_COMM_WORLD, FFTW_BACKWARD, FFTW_ESTIMATE);
+  // plan_forward   = fftw_mpi_plan_dft(3, Narray, phi_x, phi_k, PiscesComm, FFTW_FORWARD,  FFTW_ESTIMATE);
+  //  plan_backward  = fftw_mpi_plan_dft(3, Narray, KE_phi_k,KE_phi_x, PiscesComm, FFTW_BACKWARD, FFTW_ESTIMATE);
+   plan_forward   = fftw_mpi_plan_dft_3d(N0,N1,N2, phi_x, phi_k, PiscesComm, FFTW_FORWARD,  FFTW_ESTIMATE);
+    plan_backward  = fftw_mpi_plan_dft_3d(N0,N1,N2,  KE_phi_k,KE_phi_x, PiscesComm, FFTW_BACKWARD, FFTW_ESTIMATE);
   for (int i=1; i < ngp; i++) {
         phi_x[i][0]=1.0;
         phi_x[i][1]=1.0;
@@ -371,7 +390,7 @@ int DVR::Diagonalize(int SVFlag, double *ev)
 
 
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
    counter kc; m_pkc = &kc;
    progress_timer tmr("DVR::Diagonalize", verbose);
 
@@ -391,7 +410,7 @@ int DVR::Diagonalize(int SVFlag, double *ev)
          nconverged = 0;
       }
 
-      wavefn.resize(ngp*nStates);
+      GridResize(wavefn, ngp*nStates);
       nwavefn = nStates;
    }
    //  The start vectors are the first nStates columns of wavefn
@@ -401,6 +420,7 @@ int DVR::Diagonalize(int SVFlag, double *ev)
    //         = 2   all random start vectors
    //         = 3   use coarse converged vectrs plus interpolation for the missing points  -- Tae Hoon Choi
    //         = 4   use coarse converged vectrs for the gradient calculations    -- Tae Hoon Choi
+   //         = 5   read start vectors from the binary checkpoint CheckpointFile
    //
    int istart = 0;
    switch (SVFlag)
@@ -425,7 +445,7 @@ int DVR::Diagonalize(int SVFlag, double *ev)
      istart = 1;
 
      //resize the wavefn for the fine grid calcuation -- Tae Hoon Choi
-     wavefn.resize(ngp*nStates);
+     GridResize(wavefn, ngp*nStates);
      nwavefn = nStates;
 
      if(rank==0)cout<< "Idual = "<<Idual<<endl;
@@ -440,6 +460,14 @@ int DVR::Diagonalize(int SVFlag, double *ev)
        wavefn[igp]=CoarseWf[igp];
 
      break; // we can use the saved wavefn
+   case 5:
+     istart = ReadCheckpoint(CheckpointFile.c_str());
+     if (istart < 0) {
+       if(rank==0)cout << "DVR::Diagonalize: using a PiaB-like start vector instead\n";
+       ParticleInAnDBoxWf(&wavefn[0]);
+       istart = 1;
+     }
+     break;
    default:
      if(rank==0)cout << "DVR::Diagonalize: illegal value of start vector flag = " << SVFlag << "\n";
      exit(1);
@@ -517,6 +545,35 @@ int DVR::Diagonalize(int SVFlag, double *ev)
 
 
 
+//////////////////////////////////////////////////////
+//
+//  coordinates of np consecutive grid points, stepping through the 1D grids
+//  (one division for the first point, then x-pencil by x-pencil)
+//
+void DVR::GridTile(int first, int np, double *q) const
+{
+  const double *ygrid = x_dvr + max1db[0];
+  const double *zgrid = x_dvr + max1db[0] + max1db[1];
+  int i = first % n_1dbas[0];
+  int j = (first / n_1dbas[0]) % n_1dbas[1];
+  int k = first / (n_1dbas[0]*n_1dbas[1]);
+  int p = 0;
+  while (p < np) {
+    int nrow = std::min(n_1dbas[0] - i, np - p);
+    for (int ir = 0; ir < nrow; ++ir, ++p) {
+      q[3*p]   = x_dvr[i + ir];
+      q[3*p+1] = ygrid[j];
+      q[3*p+2] = zgrid[k];
+    }
+    i = 0;
+    if (++j == n_1dbas[1]) {
+      j = 0;
+      ++k;
+    }
+  }
+}
+
+
 //////////////////////////////////////////////////////
 //
 //  Compute grid parameters:  no of grid points, max of 1D basis set functions, and strides
@@ -525,7 +582,7 @@ void DVR::ComputeGridParameters()
 {
 
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
    //
    //  first dimension has stride 1
    //
@@ -572,7 +629,7 @@ void DVR::ComputeGridPointsAndKineticEnergy()
 {
 
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
    // kinetic energy 1d-matrices
   cout<<" no_dim = "<<no_dim<<endl; 
   cout<<" n_1dbas[0] = "<<n_1dbas[0]<<endl; 
@@ -596,9 +653,17 @@ void DVR::ComputeGridPointsAndKineticEnergy()
          break;
       case 3:	
           Tdiag(npts, mass, -0.5*gridpara[idim], 0.5*gridpara[idim], x_dvr+(initIndex),e_kin[idim] , ldt, 0);
+          ke_spec[idim].assign(e_kin[idim], e_kin[idim]+npts);
           StepSize[idim] = x_dvr[initIndex+1] - x_dvr[initIndex];          
           cout<<" StepSize["<<idim<<"]="<<StepSize[idim]<<endl;
          break;
+      case 4:
+         // the matrices are kept for the diagonal and full diagonalization, H*x uses the spectra
+         sine_dvr(npts, mass, -0.5*gridpara[idim], 0.5*gridpara[idim], x_dvr+(initIndex), e_kin[idim], ldt, 0);
+         StepSize[idim] = x_dvr[initIndex+1] - x_dvr[initIndex];
+         ke_spec[idim].resize(npts);
+         Tsine(npts, mass, -0.5*gridpara[idim], 0.5*gridpara[idim], &ke_spec[idim][0], verbose);
+         break;
       default:
          sine_dvr(npts, mass, -0.5*gridpara[idim], 0.5*gridpara[idim], x_dvr+(initIndex), e_kin[idim], ldt, 0);
 	 StepSize[idim] = x_dvr[initIndex+1] - x_dvr[initIndex];
@@ -609,25 +674,8 @@ void DVR::ComputeGridPointsAndKineticEnergy()
     //  if(rank==0)cout<<"e_kin[idim] = "<< e_kin[idim][i]<<std::endl;
    }
 
-   //TV: the final Diagonal KE matrix is constructed. This is used in the FFT
-   // This part can be improved. Assumes a 3 dimensional case
-   cout<<" dvrtype 3 start = "<<endl; 
-  cout<<" n_1dbas[1] = "<<n_1dbas[1]<<endl; 
-  cout<<" n_1dbas[2] = "<<n_1dbas[2]<<endl; 
-   if(dvrtype == 3){  
-   for( int xa1 = 0; xa1 < n_1dbas[0]; xa1++){
-        for( int ya2 = 0; ya2 < n_1dbas[1]; ya2++){
-           for( int za3 = 0; za3 < n_1dbas[2]; za3++){	     
-	     KE_diag[xa1*n_1dbas[1]*n_1dbas[2]+ya2*n_1dbas[2]+za3] =   *(e_kin[0]+xa1)+  *(e_kin[1]+ya2) +   *(e_kin[2]+za3);
-           //  if(rank==0)printf(" KE_diag[%4i] =  %10.6f\n", xa1*n_1dbas[1]*n_1dbas[2]+ya2*n_1dbas[2]+za3, KE_diag[xa1*n_1dbas[1]*n_1dbas[2]+ya2*n_1dbas[2]+za3] );
-            //if(rank==0)printf(" e_kin[0]=%10.6f e_kin[1]=%10.6f e_kin[2]=%10.6f, xa1a=%d ya2=%d za3=%d \n", e_kin[0],e_kin[1],e_kin[2], xa1, ya2, za3 );
-            //if(rank==0)printf(" xa1a=%d ya2=%d za3=%d \n", xa1, ya2, za3 );
-            //if(rank==0)printf(" 1=%10.6f 2=%10.6f 3=%10.6f \n", *(e_kin[0]+xa1),  *(e_kin[1]+ya2), *(e_kin[2]+za3) );
-           }
-        }
-	
-    }
-  } 
+   //TV: the kinetic energy for FFT and DST is diagonal, T(i,j,k) = ke_spec[0][i] + ke_spec[1][j] + ke_spec[2][k],
+   //    VectorFFT sums the spectra on the fly
 
    if (verbose > 0) {
       for (int k = 0; k < no_dim; k++) {
@@ -662,47 +710,44 @@ void DVR::ComputePotential(class Potential &V)
 {
 
   progress_timer t("ComputePotential", verbose);
+  // the potential points of the whole grid, counted once (on rank 0)
+  int prank;
+  MPI_Comm_rank( PiscesComm, &prank );
+  if (prank == 0)
+    Profiler::Count("grid points", double(ngp) * ((sampling == 2) ? 8 : ((sampling == 3) ? 27 : 1)));
+
+  nTerms = 0;  // stored term grids refer to the previous potential
+  validComponents = 0;
+  nCachedDipoles = 0;
+  V.PrepareWorkspaces();  // all threads evaluate V itself
+
+  // particle-mesh electrostatics needs an equally spaced grid
+  if (sampling == 1 && no_dim == 3 && dvrtype != 1 && dvrtype != 20) {
+    int mmask[Potential::NTERMS];
+    if (V.MeshTerms(mmask) > 0) {
+      ComputePotentialTerms(V);
+      return;
+    }
+    if (V.MeshPotential()) {
+      V.EvaluateMeshPotential(n_1dbas, x_dvr, x_dvr + max1db[0], x_dvr + max1db[0] + max1db[1], v_diag);
+      for (int igp = 0; igp < ngp; igp++) {
+	v_diag_pc[igp] = v_diag[igp];
+	v_diag_ind[igp] = 0;
+	v_diag_rep[igp] = 0;
+	v_diag_pol[igp] = 0;
+      }
+      validComponents = 1;
+      return;
+    }
+  }
    // stepping over the grid
    // this is designed for arbitrary dimension
    // so instead of three loops (x, y, z) there is a loop over all grid points
    // and there are counters for the points in each dimension
 
 
-  // this vector holds all DVR points 
-  // TS: it is not really needed, I would think, and,
-  // if this is done, it should be done in ComputeGridPointsAndKineticEnergy
-
-
-// unsigned long long int un_ngp=ngp;
-//  static dVec qtest; qtest.resize(no_dim*un_ngp );
-  static dVec qtest; qtest.resize(no_dim*ngp );
-  
-   cout<<" here is ComputePotential "<<endl;
-   cout<<" ngp= "<<ngp<<endl;
-
-//  istart with all indicies 0 (1st step of the grid point loop will increase ii[0])
-  int ii[MAXDIM] = {-1,0,0};
-  for (int igp = 0; igp < ngp; igp++)
-    {
-      for (int k = 0; k < no_dim; k++) {
-	ii[k] ++;
-       // cout<<"ii["<<k<<"]="<<ii[k]<<endl;
-	if (ii[k] == n_1dbas[k])
-	  ii[k] = 0;
-	else
-	  break;
-      }
-      // prepare next grid point in q
-      for (int id = 0; id < no_dim; ++id){
-      //  unsigned long long int un_igp=igp;
-        int initIndex = 0;
-        if ( id == 1) initIndex= max1db[0];
-        if ( id == 2) initIndex= max1db[0]+max1db[1];
-
-	qtest[igp*no_dim + id] = x_dvr[initIndex + ii[id]];
-       // cout<<"index; qtest and x_dvr"<<igp*no_dim + id<<" "<<initIndex + ii[id]<<endl;
-       }
-    }
+  // the coordinates of the grid points are generated where they are needed
+  // (GridPoint, GridTile), there is no array of all DVR points
 
   //
   // loop over the nD grid
@@ -713,15 +758,15 @@ void DVR::ComputePotential(class Potential &V)
   int my_PE_num;
 
   int rank, size;
-  MPI_Comm_size( MPI_COMM_WORLD, &size );
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_size( PiscesComm, &size );
+  MPI_Comm_rank( PiscesComm, &rank );
   MPI_Status status;
 
 
 
 #define DOWN     0
 
-  MPI_Barrier( MPI_COMM_WORLD );
+  MPI_Barrier( PiscesComm );
   double start_time = MPI_Wtime();
 
 // remainder should be zero, otherwise it will make some trouble.
@@ -735,7 +780,8 @@ void DVR::ComputePotential(class Potential &V)
    int PreNgp=Pre1db[0]*Pre1db[1]*Pre1db[2];
 //   unsigned long long int un_PreNgp=PreNgp;
 //   double *TempV_diag  = new double[un_PreNgp];
-   double *TempV_diag  = new double[PreNgp];
+   gVec TempV_diag;
+   TempV_diag.resize(PreNgp);   // not initialized, first touch in the copy loop
 
 #pragma omp parallel
 #pragma omp for
@@ -748,20 +794,84 @@ void DVR::ComputePotential(class Potential &V)
     int icount2=0;
 
  cout<<"TempV="<<my_N<<endl; 
-  if (sampling == 1) { 
+  // induced dipoles kept for ComputeGradient: the points of this rank where the previous
+  // wavefunction (same grid) has a density above DipoleCacheTol of its maximum
+  int ndip = 0;
+  if (sampling == 1 && DipoleCacheFlag > 0 && (int)wavefn.size() >= ngp)
+    V.InducedDipoles(&ndip);
+  int keep = (ndip > 0);
+  if (keep) {
+    double dmax = 0;
+    for (int igp = rank*my_N; igp < my_N*(rank+1); igp++)
+      dmax = std::max(dmax, wavefn[igp]*wavefn[igp]);
+    keep = (dmax > 0);
+    int nslot = 0;
+    DipoleSlot.assign(ngp, -1);
+    for (int igp = rank*my_N; keep && igp < my_N*(rank+1); igp++)
+      if (wavefn[igp]*wavefn[igp] > DipoleCacheTol * dmax)
+        DipoleSlot[igp] = nslot++;
+    if (DipoleCacheFlag == 2)
+      DipoleCacheF.resize(size_t(nslot) * ndip);
+    else
+      DipoleCacheD.resize(size_t(nslot) * ndip);
+    nDipoleComponents = ndip;
+    if (keep)
+      keep = nslot;
+  }
+
+  int nbatch = V.BatchTile();
+  if (sampling == 1) {
+  if (nbatch > 0 && !keep && V.getPolType() != 5 && V.getPolType() != 6) {
+    // tiles of nbatch points are evaluated at once (C60 polarization via dsymm, DPPnSP kernels specialized for the model)
+    double *vout = (rank != 0) ? my_v_diag : v_diag;
+    int first = rank*my_N;
+    int last = my_N*(rank+1);
 #pragma omp parallel
    {
-      Potential l_V = V;
+      dVec energies(5*nbatch);
+      dVec qtile(3*nbatch);
+#pragma omp for schedule(dynamic)
+      for (int ib = first; ib < last; ib += nbatch)
+      {
+        int np = std::min(nbatch, last - ib);
+        GridTile(ib, np, &qtile[0]);
+        V.EvaluateBatch(np, &qtile[0], &vout[ib], &energies[0]);
+        for (int p = 0; p < np; ++p) {
+          v_diag_pc[ib+p]  = energies[5*p+0];
+          v_diag_ind[ib+p] = energies[5*p+1];
+          v_diag_rep[ib+p] = energies[5*p+2];
+          v_diag_pol[ib+p] = energies[5*p+3];
+        }
+      }
+   }
+  }
+  else {
+#pragma omp parallel
+   {
+      Potential &l_V = V;
 #pragma omp for
 //      for (int igp = 0; igp < ngp; igp++)
       for (int igp = rank*my_N; igp < my_N*(rank+1); igp++)
       {
        //if(rank==0)cout<<"l_V.getPolType() = "<<l_V.getPolType()<<endl;
       //  unsigned long long int un_igp=igp;
+       double q[MAXDIM];
+       GridPoint(igp, q);
 
-       if (rank!=0) my_v_diag[igp] = l_V.Evaluate(&qtest[igp*no_dim]);
+       if (rank!=0) my_v_diag[igp] = l_V.Evaluate(q);
        else {
-         if(l_V.getPolType() !=6) v_diag[igp] = l_V.Evaluate(&qtest[no_dim*igp]);
+         if(l_V.getPolType() !=6) v_diag[igp] = l_V.Evaluate(q);
+       }
+
+       if (keep && DipoleSlot[igp] >= 0) {
+         int nd;
+         const double *mu = l_V.InducedDipoles(&nd);
+         size_t off = size_t(DipoleSlot[igp]) * nd;
+         if (DipoleCacheFlag == 2)
+           for (int k = 0; k < nd; ++k)
+             DipoleCacheF[off+k] = float(mu[k]);
+         else
+           std::copy(mu, mu + nd, &DipoleCacheD[off]);
        }
 
          double energies[5] ;
@@ -793,7 +903,7 @@ void DVR::ComputePotential(class Potential &V)
                  pz= igp/max1db[2]/max1db[2]; 
 
                  double mindist;
-                 mindist = l_V.MinDistCheck(&qtest[no_dim*igp]);
+                 mindist = l_V.MinDistCheck(q);
 
                  if (Idual == 0 ) {  // it is for triple spacing for even number grid
                     px= igp%max1db[0]-checkM[0]/2; 
@@ -812,7 +922,7 @@ void DVR::ComputePotential(class Potential &V)
                         icount++;
                     }
                     else
-                      v_diag[igp] = l_V.Evaluate(&qtest[no_dim*igp]); 
+                      v_diag[igp] = l_V.Evaluate(q); 
                        
                  }
                  else {  // it is for double spacing for odd number grid
@@ -825,34 +935,58 @@ void DVR::ComputePotential(class Potential &V)
                       icount++;
                     }
                     else
-                      v_diag[igp] = l_V.Evaluate(&qtest[no_dim*igp]); 
+                      v_diag[igp] = l_V.Evaluate(q); 
                  }
                  icount2++;
 
          }  
       } 
-      l_V.PrintMinMax();
    }
+   V.PrintMinMax();  // after the parallel region: the ranges of all threads
 
  if(rank==0)cout <<" Ratio of number of Interpolation : " <<icount<<" / "<<icount2<<endl; 
+  if (keep) {
+    nCachedDipoles = keep;
+    DipolePotential = &V;
+    DipolePotentialSetup = V.SetupCount();
+    if (rank == 0 && verbose > 0)
+      printf(" induced dipoles cached at %d points (%.1f MB)\n", keep,
+             double(keep) * ndip * ((DipoleCacheFlag == 2) ? sizeof(float) : sizeof(double)) / 1048576.0);
+  }
+  }
+
+  // rank 0 collects v_diag and (below) its components, for the tiled and the point-wise loop
 if (rank !=0) {
- MPI_Send(&my_v_diag[rank*my_N], my_N, MPI_DOUBLE, 0, DOWN, MPI_COMM_WORLD);
-// MPI_Send(my_v_diag, my_N, MPI_DOUBLE, 0, DOWN, MPI_COMM_WORLD);
+ MPI_Send(&my_v_diag[rank*my_N], my_N, MPI_DOUBLE, 0, DOWN, PiscesComm);
+// MPI_Send(my_v_diag, my_N, MPI_DOUBLE, 0, DOWN, PiscesComm);
 // for (int igp = rank*my_N; igp < my_N*(rank+1); igp++)
 //  if(rank==0)cout<<"my_v_diag1["<<igp<<"] = "<< my_v_diag[igp]<<endl;
  
 }
 else {
  for (int i=1; i< size; i++) {
-//    MPI_Recv(&my_v_diag2[0], my_N, MPI_DOUBLE, 1, DOWN, MPI_COMM_WORLD, &status);
-    MPI_Recv(&v_diag[i*my_N], my_N, MPI_DOUBLE, i, DOWN, MPI_COMM_WORLD, &status);
+//    MPI_Recv(&my_v_diag2[0], my_N, MPI_DOUBLE, 1, DOWN, PiscesComm, &status);
+    MPI_Recv(&v_diag[i*my_N], my_N, MPI_DOUBLE, i, DOWN, PiscesComm, &status);
  }
 // for (int igp = 0; igp < ngp; igp++)
 //  if(rank==0)cout<<"  v_diag2["<<igp<<"] = "<<v_diag[igp]<<endl;
 
 }
 
-  MPI_Barrier( MPI_COMM_WORLD );
+  // the components are complete except for the dual-grid methods
+  if (V.getPolType() != 5 && V.getPolType() != 6) {
+    double *grids[4] = {v_diag_pc, v_diag_ind, v_diag_rep, v_diag_pol};
+    for (int k = 0; k < 4; ++k) {
+      if (rank != 0)
+        MPI_Send(&grids[k][rank*my_N], my_N, MPI_DOUBLE, 0, k+1, PiscesComm);
+      else
+        for (int i = 1; i < size; i++)
+          MPI_Recv(&grids[k][i*my_N], my_N, MPI_DOUBLE, i, k+1, PiscesComm, &status);
+    }
+    validComponents = 1;
+  }
+
+  MPI_Barrier( PiscesComm );
   double etime = MPI_Wtime() - start_time;
  if (rank==0 ) if(rank==0)printf(" estime= %f \n", etime);
 
@@ -860,13 +994,13 @@ else {
   // 
   // 8x sampling
   // now this assumes equally space gridpoints in 3D grids
-  else if (dvrtype == 0 && sampling == 2) {
+  else if ((dvrtype == 0 || dvrtype == 4) && sampling == 2) {
     double dx = 0.25 * StepSize[0];
     double dy = 0.25 * StepSize[1];
     double dz = 0.25 * StepSize[2];
 #pragma omp parallel
    {
-      Potential l_V = V;
+      Potential &l_V = V;
 #pragma omp for
       for (int igp = 0; igp < ngp; igp++)
       {
@@ -876,9 +1010,10 @@ else {
 	// this is replaced: v_diag[igp] = l_V.Evaluate(&qtest[igp*no_dim]);
 	double q[MAXDIM];
 	double v8 = 0;
-	double x0 = qtest[igp*no_dim];
-	double y0 = qtest[igp*no_dim +1];
-	double z0 = qtest[igp*no_dim +2];
+	GridPoint(igp, q);
+	double x0 = q[0];
+	double y0 = q[1];
+	double z0 = q[2];
 	double wsum = 1.0/8.0;
 	q[0] = x0 + dx;   q[1] = y0 + dy;   q[2] = z0 + dz;   v8 += l_V.Evaluate(q);
 	q[0] = x0 - dx;   q[1] = y0 + dy;   q[2] = z0 + dz;   v8 += l_V.Evaluate(q);
@@ -895,13 +1030,13 @@ else {
   //
   // 27x sampling
   // equally spaced grids in 3D again
-  else if (dvrtype == 0 && sampling == 3) {
+  else if ((dvrtype == 0 || dvrtype == 4) && sampling == 3) {
     double dx = StepSize[0] / 3.0;
     double dy = StepSize[1] / 3.0;
     double dz = StepSize[2] / 3.0;
 #pragma omp parallel
     {
-      Potential l_V = V;
+      Potential &l_V = V;
 #pragma omp for
       for (int igp = 0; igp < ngp; igp++)
 	{
@@ -910,9 +1045,10 @@ else {
 	  // this is replaced: v_diag[igp] = l_V.Evaluate(&qtest[igp*no_dim]);
 	  double q[MAXDIM];
 	  double v27 = 0;
-	  double x0 = qtest[igp*no_dim];
-	  double y0 = qtest[igp*no_dim+1];
-	  double z0 = qtest[igp*no_dim+2];
+	  GridPoint(igp, q);
+	  double x0 = q[0];
+	  double y0 = q[1];
+	  double z0 = q[2];
 	  // 27 = 1 center, 6 faces, 12 edges, and 8 corners
 	  q[0] = x0;        q[1] = y0;        q[2] = z0;        v27 += l_V.Evaluate(q);
 	  // faces
@@ -958,7 +1094,7 @@ else {
       double dx = 0.2;
 #pragma omp parallel
       {
-	Potential l_V = V;
+	Potential &l_V = V;
 #pragma omp for
 	for (int igp = 0; igp < ngp; igp++)
 	  {
@@ -967,9 +1103,10 @@ else {
 
 	    double q[MAXDIM];
 	    double v6 = 0;
-	    double x0 = qtest[igp*no_dim];
-	    double y0 = qtest[igp*no_dim+1];
-	    double z0 = qtest[igp*no_dim+2];
+	    GridPoint(igp, q);
+	    double x0 = q[0];
+	    double y0 = q[1];
+	    double z0 = q[2];
 	    double wsum = 1.0/6.0;
 	    q[0] = x0 + dx;   q[1] = y0;        q[2] = z0;        v6 += l_V.Evaluate(q);
 	    q[0] = x0 - dx;   q[1] = y0;        q[2] = z0;        v6 += l_V.Evaluate(q);
@@ -988,20 +1125,22 @@ else {
   else { 
 #pragma omp parallel
     {
-      Potential l_V = V;
+      Potential &l_V = V;
 #pragma omp for
       for (int igp = 0; igp < ngp; igp++)
 	{
      //   unsigned long long int un_igp=igp;
 
-	  v_diag[igp] = l_V.Evaluate(&qtest[igp*no_dim]);
+	  double q[MAXDIM];
+	  GridPoint(igp, q);
+	  v_diag[igp] = l_V.Evaluate(q);
 	} 
     }
 
-    static dVec v_copy;
+    static gVec v_copy;
 //    unsigned long long int un_ngp=ngp;
 //    v_copy.resize(un_ngp);
-    v_copy.resize(ngp);
+    GridResize(v_copy, ngp);
     std::copy(v_diag, &v_diag[ngp-1], &v_copy[0]);
     double qs = sampling;
     double wface = 1.0 / qs;
@@ -1059,6 +1198,164 @@ else {
 }
 
 
+/////////////////////////////////////////////////////////////////////////////////
+//
+//  term-decomposed potential: the grids of the unscaled terms of V are stored
+//  so that a change of the linear parameters of V is a linear combination of grids, 
+//  and a change of a damping parameter requires only one term to be re-evaluated
+//
+//  use: Setup the potential, call ComputePotentialTerms(V), then for each new parameter
+//  set call V.UpdateParameters(PotPara) and UpdatePotential(V)
+//
+void DVR::ComputePotentialTerms(class Potential &V)
+{
+  progress_timer t("ComputePotentialTerms", verbose);
+
+  int rank;
+  MPI_Comm_rank( PiscesComm, &rank );
+
+  int nt = V.nPotentialTerms();
+  if (nt == 0 || sampling != 1) {
+    if (verbose > 0)
+      if(rank==0)cout << "ComputePotentialTerms: the potential is not decomposed (PotFlag or sampling), calling ComputePotential\n";
+    ComputePotential(V);
+    return;
+  }
+
+  nTerms = nt;
+  GridAssign(Vec_v_terms, nTerms*ngp, 0.0);
+  TermKeys.resize(2*nTerms);
+  iVec mask(nTerms, 1);
+  EvaluateTermGrids(V, &mask[0]);
+  V.TermKeys(&TermKeys[0]);
+  RecombinePotential(V);
+}
+
+
+void DVR::UpdatePotential(class Potential &V)
+{
+  int rank;
+  MPI_Comm_rank( PiscesComm, &rank );
+
+  if (nTerms == 0 || nTerms != V.nPotentialTerms()) {
+    ComputePotentialTerms(V);
+    return;
+  }
+
+  // re-evaluate only terms with changed non-linear parameters
+  dVec keys(2*nTerms);
+  V.TermKeys(&keys[0]);
+  iVec mask(nTerms, 0);
+  int nchanged = 0;
+  for (int it = 0; it < nTerms; ++it) {
+    if (keys[2*it] != TermKeys[2*it] || keys[2*it+1] != TermKeys[2*it+1]) {
+      mask[it] = 1;
+      nchanged ++;
+    }
+  }
+  if (verbose > 0)
+    if(rank==0)cout << "UpdatePotential: " << nchanged << " of " << nTerms << " term grids are re-evaluated\n";
+  if (nchanged > 0) {
+    progress_timer t("UpdatePotential", verbose);
+    EvaluateTermGrids(V, &mask[0]);
+    TermKeys = keys;
+  }
+  RecombinePotential(V);
+}
+
+
+//
+//  evaluate the terms with mask[iterm] != 0 at all grid points 
+//  the grid is split among the MPI ranks as in ComputePotential, rank 0 collects
+//
+void DVR::EvaluateTermGrids(class Potential &V, const int *mask)
+{
+  int rank, size;
+  MPI_Comm_size( PiscesComm, &size );
+  MPI_Comm_rank( PiscesComm, &rank );
+  MPI_Status status;
+
+  int my_N = ngp / size;
+  double *v_terms = &Vec_v_terms[0];
+  const double *ygrid = x_dvr + max1db[0];
+  const double *zgrid = x_dvr + max1db[0] + max1db[1];
+
+  // the electrostatic terms on the whole grid at once (on every rank)
+  // the remaining terms point by point
+  int mmask[Potential::NTERMS];
+  iVec pmask(mask, mask + nTerms);
+  int npoint = 0;
+  if (no_dim == 3 && dvrtype != 1 && dvrtype != 20 && V.MeshTerms(mmask) > 0) {
+    for (int it = 0; it < nTerms; ++it) {
+      mmask[it] = mmask[it] && mask[it];
+      pmask[it] = mask[it] && !mmask[it];
+    }
+    V.EvaluateMeshTerms(n_1dbas, x_dvr, ygrid, zgrid, mmask, v_terms, ngp);
+  }
+  for (int it = 0; it < nTerms; ++it)
+    npoint += pmask[it];
+  if (npoint == 0)
+    return;
+  mask = &pmask[0];
+
+  V.PrepareWorkspaces();
+#pragma omp parallel
+  {
+    Potential &l_V = V;
+    double terms[Potential::NTERMS];
+#pragma omp for
+    for (int igp = rank*my_N; igp < my_N*(rank+1); igp++) {
+      // x runs fastest, see ComputePotential
+      double q[MAXDIM];
+      GridPoint(igp, q);
+      l_V.EvaluateTerms(q, mask, terms);
+      for (int it = 0; it < nTerms; ++it)
+	if (mask[it])
+	  v_terms[it*ngp + igp] = terms[it];
+    }
+  }
+
+  if (size > 1) {
+    for (int it = 0; it < nTerms; ++it) {
+      if (!mask[it]) continue;
+      if (rank != 0)
+	MPI_Send(&v_terms[it*ngp + rank*my_N], my_N, MPI_DOUBLE, 0, it, PiscesComm);
+      else
+	for (int i = 1; i < size; i++)
+	  MPI_Recv(&v_terms[it*ngp + i*my_N], my_N, MPI_DOUBLE, i, it, PiscesComm, &status);
+    }
+  }
+}
+
+
+//
+//  v_diag and its components from the stored term grids and the current parameters of V
+//
+void DVR::RecombinePotential(class Potential &V)
+{
+  double c[Potential::NTERMS];
+  V.TermCoefficients(c);
+  const double *vpc  = &Vec_v_terms[Potential::TermPC*ngp];
+  const double *vind = &Vec_v_terms[Potential::TermInd*ngp];
+  const double *vreh = &Vec_v_terms[Potential::TermRepH*ngp];
+  const double *vreo = &Vec_v_terms[Potential::TermRepO*ngp];
+  const double *vpol = &Vec_v_terms[Potential::TermPol*ngp];
+  double ch = c[Potential::TermRepH];
+  double co = c[Potential::TermRepO];
+  double cp = c[Potential::TermPol];
+
+#pragma omp parallel for
+  for (int igp = 0; igp < ngp; igp++) {
+    v_diag_pc[igp]  = vpc[igp];
+    v_diag_ind[igp] = vind[igp];
+    v_diag_rep[igp] = ch * vreh[igp] + co * vreo[igp];
+    v_diag_pol[igp] = cp * vpol[igp];
+    v_diag[igp] = v_diag_pc[igp] + v_diag_ind[igp] + v_diag_rep[igp] + v_diag_pol[igp];
+  }
+  validComponents = 1;
+}
+
+
 // small inline utility to convert from 3D subscript into Fortran style (column-major) indices
 inline int sub2ind( int i, int j, int k, const int n[] )
 {
@@ -1075,6 +1372,33 @@ inline void ind2sub( int I, const int n[], int& i, int& j, int& k )
    I -= j*n[X];
    i = I;
 }
+//
+//  the induced dipoles cached by ComputePotential are for V as it is now
+//
+int DVR::DipoleCacheValid(const class Potential &V) const
+{
+  return nCachedDipoles > 0 && DipolePotential == &V && DipolePotentialSetup == V.SetupCount()
+    && (int)DipoleSlot.size() == ngp;
+}
+
+//
+//  the cached induced dipoles of grid point igp, or 0 if igp is not in the cache
+//  (float entries are converted into buf)
+//
+const double* DVR::CachedDipoles(int igp, dVec &buf) const
+{
+  int slot = DipoleSlot[igp];
+  if (slot < 0)
+    return 0;
+  size_t off = size_t(slot) * nDipoleComponents;
+  if (DipoleCacheFlag != 2)
+    return &DipoleCacheD[off];
+  buf.resize(nDipoleComponents);
+  for (int k = 0; k < nDipoleComponents; ++k)
+    buf[k] = DipoleCacheF[off+k];
+  return &buf[0];
+}
+
 #if _OPENMP
 // These storage hacks allow for two optimizations:
 //   (1) Do reduction without using omp critical 
@@ -1086,7 +1410,6 @@ struct Storage {
 //   dVec mCm ;
    
  //  int nAtoms = nSites/4*3
-   Potential V;
    Storage(int nSites)
       : tGrad(nSites*3)
       , Gradient(nSites*3)
@@ -1101,9 +1424,8 @@ void DVR::ComputeGradient(class Potential &V, int nSites, double *Gradient, doub
 {
 
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
   progress_timer t("ComputeGradient", verbose);
-   static dVec qtest(no_dim * ngp);
    int nAtoms = nSites/4*3;
 //   dVec mu(nAtoms*3);
 //   dVec mu_cross_mu(nAtoms*3*nAtoms*3);
@@ -1114,40 +1436,32 @@ void DVR::ComputeGradient(class Potential &V, int nSites, double *Gradient, doub
    // allocate thread local arrays 
    int nthread = omp_get_max_threads();
    static std::vector<Storage> storage(nthread, Storage(nSites));
-
-   // 3D loop for qtest
-   enum {X,Y,Z,NDIM};
+   V.PrepareWorkspaces();  // all threads share V
+   int usecache = DipoleCacheValid(V);
 
 #  pragma omp parallel
 {
-#  pragma omp for
-   for (int k=0; k<n_1dbas[Z]; ++k) {
-      for (int j=0; j<n_1dbas[Y]; ++j) {
-         for (int i=0; i<n_1dbas[X]; ++i) {
-            int ig = sub2ind(i,j,k,n_1dbas);
-            qtest[ ig*NDIM + X ] = x_dvr[ X*max1db[0] + i ];
-            qtest[ ig*NDIM + Y ] = x_dvr[ Y*max1db[1] + j ];
-            qtest[ ig*NDIM + Z ] = x_dvr[ Z*max1db[2] + k ];
-         }
-      }
-   }
    int ithread = omp_get_thread_num(); 
    Storage& loc = storage[ithread];
    std::fill(loc.Gradient.begin(), loc.Gradient.end(), 0.);
-   loc.V = V;
    dVec mCm(nAtoms*3*nAtoms*3);
    std::fill(mCm.begin(), mCm.end(), 0.);
 //   std::fill(loc.tmu.begin(), loc.tmu.end(), 0.);
    dVec tmu(nAtoms*3*nAtoms*3);
    std::fill(tmu.begin(), tmu.end(), 0.);
 
+   dVec mubuf;
+
 #  pragma omp barrier
 #  pragma omp for
    for (int igp = 0; igp < ngp; igp++)
    {
       std::fill( loc.tGrad.begin(), loc.tGrad.end(), 0.);
 
-      loc.V.EvaluateGradient(&qtest[igp*no_dim], loc.tGrad, tmu, mCm, wavefn[igp] , WaterN);
+      double q[MAXDIM];
+      GridPoint(igp, q);
+      const double *cachedmu = usecache ? CachedDipoles(igp, mubuf) : 0;
+      V.EvaluateGradient(q, loc.tGrad, tmu, mCm, wavefn[igp] , WaterN, cachedmu);
       for (int j=0; j<nSites*3; ++j) 
          loc.Gradient[j] += wavefn[igp]*wavefn[igp]*loc.tGrad[j];
 
@@ -1155,7 +1469,7 @@ void DVR::ComputeGradient(class Potential &V, int nSites, double *Gradient, doub
 
    }
 
-   loc.V.FinalGradient(nAtoms, &loc.Gradient[0] , &tmu[0], &mCm[0] , &dT_x[0] , &dT_y[0], &dT_z[0],  &dEfield[0]);
+   V.FinalGradient(nAtoms, &loc.Gradient[0] , &tmu[0], &mCm[0] , &dT_x[0] , &dT_y[0], &dT_z[0],  &dEfield[0]);
 
 
 } // omp parallel
@@ -1180,33 +1494,24 @@ void DVR::ComputeGradient(class Potential &V, int nSites, double *Gradient, doub
 {
 
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
   progress_timer t("ComputeGradient", verbose);
-  static dVec qtest(no_dim * ngp);
   int nAtoms = nSites/4*3;
 
-  // 3D loop for qtest
-  enum {X,Y,Z,NDIM};
-  for (int k=0; k<n_1dbas[Z]; ++k) {
-     for (int j=0; j<n_1dbas[Y]; ++j) {
-        for (int i=0; i<n_1dbas[X]; ++i) {
-           int ig = sub2ind(i,j,k,n_1dbas);
-           qtest[ ig*NDIM + X ] = x_dvr[ X*max1db[0] + i ];
-           qtest[ ig*NDIM + Y ] = x_dvr[ Y*max1db[1] + j ];
-           qtest[ ig*NDIM + Z ] = x_dvr[ Z*max1db[2] + k ];
-        }
-     }
-  }
-
   dVec mCm(nAtoms*3*nAtoms*3);
   dVec tmu(nAtoms*3*nAtoms*3);
   dVec tGrad(nSites*3);
+  dVec mubuf;
+  int usecache = DipoleCacheValid(V);
 
   for (int igp = 0; igp < ngp; igp++)
   {
      std::fill( tGrad.begin(), tGrad.end(), 0.);
 
-     V.EvaluateGradient(&qtest[igp*no_dim], tGrad, tmu, mCm, wavefn[igp] , WaterN);
+     double q[MAXDIM];
+     GridPoint(igp, q);
+     const double *cachedmu = usecache ? CachedDipoles(igp, mubuf) : 0;
+     V.EvaluateGradient(q, tGrad, tmu, mCm, wavefn[igp] , WaterN, cachedmu);
      for (int j=0; j<nSites*3; ++j) 
         Gradient[j] += wavefn[igp]*wavefn[igp]*tGrad[j];
 
@@ -1241,7 +1546,7 @@ double DVR::InterpolVtriple(double *TempF, int px, int py, int pz, int *Pre1db)
 {
 
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
     double wf;
    double weight1=0.707107/1.955087; // 1/sqrt(2) / 1/sqrt(2) + 1/sqrt(5) + 1/sqrt(5) + 1/sqrt(8)
    double weight2=0.447214/1.955087; // 1/sqrt(5) / 1/sqrt(2) + 1/sqrt(5) + 1/sqrt(5) + 1/sqrt(8)
@@ -1399,7 +1704,7 @@ double DVR::InterpolVtriple(double *TempF, int px, int py, int pz, int *Pre1db)
 double DVR::InterpolVdouble(double *TempF, int px, int py, int pz, int Pre1db[])
 {
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
     double wf;
             if (px%2 == 0 && py%2 == 0 && pz%2 == 0 ) {
                wf=TempF[px/2 + py/2*Pre1db[0] +pz/2*Pre1db[1]*Pre1db[2]];
@@ -1446,12 +1751,12 @@ double DVR::InterpolVdouble(double *TempF, int px, int py, int pz, int Pre1db[])
 void DVR::ExtendWfThree(double *wf)
 {
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 //   int Pre1db[]=(max1db+2)/2;
    int PreNgp=Pre1db[0]*Pre1db[1]*Pre1db[2];
 //  unsigned long long int un_PreNgp=PreNgp;
 //   CoarseWf.resize(un_PreNgp);
-   CoarseWf.resize(PreNgp);
+   GridResize(CoarseWf, PreNgp);
 //   double *CoarseWf  = new double[PreNgp]; 
    for (int igp = 0; igp < PreNgp; igp++)
        CoarseWf[igp]=wf[igp];
@@ -1639,12 +1944,12 @@ void DVR::ExtendWfDouble(double *wf)
 {
 
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 //   int Pre1db[]=(max1db+1)/2;
    int PreNgp=Pre1db[0]*Pre1db[1]*Pre1db[2];
 //   unsigned long long int un_PreNgp=PreNgp;
 //   CoarseWf.resize(un_PreNgp);
-   CoarseWf.resize(PreNgp);
+   GridResize(CoarseWf, PreNgp);
 //   double *CoarseWf  = new double[PreNgp]; 
    for (int igp = 0; igp < PreNgp; igp++)
        CoarseWf[igp]=wf[igp];
@@ -1726,7 +2031,7 @@ void DVR::ParticleInAnDBoxWf(double *wf)
 {
 
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
    int *ii = new int[no_dim];
    double *q  = new double[no_dim];
    double *x0 = new double[no_dim];
@@ -1884,10 +2189,10 @@ void addtdiag(int n1, int inc1, int nod, int *ndod, int *incr, double *t, double
 //
 //  writing a .cub file: the ground state is wavefunction 1
 //
-void DVR::WriteCubeFile(int iwf, const char *fname, int nAtoms, const int *Z, const double *position, int cubeflag)
+void DVR::WriteCubeFile(int iwf, const char *fname, int nAtoms, const int *Z, const double *position, int cubeflag, int binary)
 {
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
    if (verbose > 2)
       if(rank==0)cout << "Writing cube-file " << fname << " for wavefunction " << iwf << "\n";
 
@@ -1901,10 +2206,14 @@ void DVR::WriteCubeFile(int iwf, const char *fname, int nAtoms, const int *Z, co
       exit(1);
    }
 
+   if (rank != 0)
+      return;
+
+   progress_timer tmr("WriteCubeFile", verbose);
+
    int nx = n_1dbas[0];
    int ny = n_1dbas[1];
    int nz = n_1dbas[2];
-   int ix, iy, iz;
 
    double *xgrid = x_dvr;
    double *ygrid = x_dvr+max1db[0];
@@ -1921,61 +2230,53 @@ void DVR::WriteCubeFile(int iwf, const char *fname, int nAtoms, const int *Z, co
    //
    //  all this makes only sense for Sine DVR (equidistant grids)
    //
-
-   double dV = (zgrid[nz-1]-zgrid[0])*(ygrid[nz-1]-ygrid[0])*(xgrid[nz-1]-xgrid[0]) / double((nx-1)*(ny-1)*(nz-1));
+   double dx = (xgrid[nx-1]-xgrid[0]) / double(nx-1);
+   double dy = (ygrid[ny-1]-ygrid[0]) / double(ny-1);
+   double dz = (zgrid[nz-1]-zgrid[0]) / double(nz-1);
+   double dV = dx*dy*dz;
    double oosqrdv = 1.0/sqrt(dV);
 
    if (verbose > 2)     
-     if(rank==0)cout << "Cube normalization factor is " << oosqrdv << "\n";
+     cout << "Cube normalization factor is " << oosqrdv << "\n";
 
    
    double *wfp = &wavefn[0] +(iwf-1)*ngp;
 
    FILE *cube;
    cube = fopen(fname,"w+");
+   setvbuf(cube, 0, _IOFBF, 1 << 22);
 
 
    //
    // 1=gOpenMol 2=Gaussian cube file format
    // all this does not work for HO DVR (this should be tested in dvr3d!)
    //
-   double rho = 0, intr = 0;
-
    if (cubeflag == 1)
    {
-      // gOpenMol
-      if(rank==0)fprintf(cube, "3 3\n%i %i %i\n", nz, ny, nx);
+      // gOpenMol: z outer, x inner, one value per line
+      fprintf(cube, "3 3\n%i %i %i\n", nz, ny, nx);
       const double B2A = Bohr2Angs;
-      if(rank==0)fprintf(cube, "%13.6e %13.6e    %13.6e %13.6e    %13.6e %13.6e\n",
+      fprintf(cube, "%13.6e %13.6e    %13.6e %13.6e    %13.6e %13.6e\n",
          zgrid[0]*B2A, zgrid[nz-1]*B2A, ygrid[0]*B2A, ygrid[ny-1]*B2A, xgrid[0]*B2A, xgrid[nx-1]*B2A);
-      for (iz = 0; iz < nz; ++iz) {
-         for (iy = 0; iy < ny; ++iy) {
-            for (ix = 0; ix < nx; ++ix) {
-               rho = wfp[ix*incv[0]+iy*incv[1]+iz*incv[2]] * oosqrdv;
-               if(rank==0)fprintf(cube, "%13.6e\n", rho);
-               intr += rho*rho;
-            }
-         }
-      }
+      int n[3] = {nz, ny, nx};
+      long stride[3] = {incv[2], incv[1], incv[0]};
+      WriteCubeValues(cube, n, stride, wfp, oosqrdv, 1, 0);
    }
    else
    {
       // Gaussian-like cube file
       int ValuesPerLine = 6;
       double nought = 0.0;
-      double dx = xgrid[1] - xgrid[0];
-      double dy = ygrid[1] - ygrid[0];
-      double dz = zgrid[1] - zgrid[0];
       // two comment lines suitable for cubeint
-      if(rank==0)fprintf(cube, " 5 0\n");
-      if(rank==0)fprintf(cube, " 0.01 0.001 0.0001 0.00001 0.000001\n");
+      fprintf(cube, " 5 0\n");
+      fprintf(cube, " 0.01 0.001 0.0001 0.00001 0.000001\n");
       // header: no of atoms and definition of the grid
       // vkv thinks that gaussian cube files for orbitals requires natoms < 0
-      //if(rank==0)fprintf(cube, "%5i  %11.6f  %11.6f  %11.6f\n", nAtoms, xgrid[0], ygrid[0], zgrid[0]);
-      if(rank==0)fprintf(cube, "%5i  %11.6f  %11.6f  %11.6f\n", -nAtoms, xgrid[0], ygrid[0], zgrid[0]);
-      if(rank==0)fprintf(cube, "%5i  %11.6f  %11.6f  %11.6f\n", nx, dx, nought, nought);
-      if(rank==0)fprintf(cube, "%5i  %11.6f  %11.6f  %11.6f\n", ny, nought, dy, nought);
-      if(rank==0)fprintf(cube, "%5i  %11.6f  %11.6f  %11.6f\n", nz, nought, nought, dz);
+      //fprintf(cube, "%5i  %11.6f  %11.6f  %11.6f\n", nAtoms, xgrid[0], ygrid[0], zgrid[0]);
+      fprintf(cube, "%5i  %11.6f  %11.6f  %11.6f\n", -nAtoms, xgrid[0], ygrid[0], zgrid[0]);
+      fprintf(cube, "%5i  %11.6f  %11.6f  %11.6f\n", nx, dx, nought, nought);
+      fprintf(cube, "%5i  %11.6f  %11.6f  %11.6f\n", ny, nought, dy, nought);
+      fprintf(cube, "%5i  %11.6f  %11.6f  %11.6f\n", nz, nought, nought, dz);
       // atoms list: the 2nd number is ignored by most programs and usually 0.0
       // for cubeint it is set to the van der Waals radius
       for (int k = 0; k < nAtoms; ++k) {
@@ -1989,33 +2290,35 @@ void DVR::WriteCubeFile(int iwf, const char *fname, int nAtoms, const int *Z, co
          case 8: RvdW = 1.52; break;
          default: break; // do nothing;
          }
-         if(rank==0)fprintf(cube, "   %i %11.6f  %11.6f  %11.6f  %11.6f\n",
+         fprintf(cube, "   %i %11.6f  %11.6f  %11.6f  %11.6f\n",
             Z[k], RvdW*Angs2Bohr, r[0]*Angs2Bohr, r[1]*Angs2Bohr, r[2]*Angs2Bohr);
       }
       //vkv
-      if(rank==0)fprintf(cube, "   1  %5i \n", iwf);
-      // here comes the cube
-      for (ix = 0; ix < nx; ++ix) {
-         for (iy = 0; iy < ny; ++iy) {
-            int iPerLine = 1;
-            for (iz = 0; iz < nz; ++iz) {
-               rho = wfp[ix*incv[0]+iy*incv[1]+iz*incv[2]] * oosqrdv;
-               if(rank==0)fprintf(cube, "%13.6e ", rho);
-               if (iPerLine % ValuesPerLine == 0)
-                  if(rank==0)fprintf(cube, "\n");
-               iPerLine++;
-               intr += rho*rho;
-            }
-            if (nz % ValuesPerLine != 0)
-               if(rank==0)fprintf(cube, "\n");
-         }
-      }
+      fprintf(cube, "   1  %5i \n", iwf);
+      // here comes the cube: x outer, z inner
+      int n[3] = {nx, ny, nz};
+      long stride[3] = {incv[0], incv[1], incv[2]};
+      WriteCubeValues(cube, n, stride, wfp, oosqrdv, ValuesPerLine, 1);
+   }
+   if (verbose > 2) {
+     double intr = 0;
+#pragma omp parallel for reduction(+:intr)
+     for (int igp = 0; igp < ngp; igp++)
+       intr += wfp[igp]*wfp[igp];
+     printf("  Int d3r rho(r) = %11.9f\n", intr);
    }
-   if (verbose > 2)
-     if(rank==0)printf("  Int d3r rho(r) = %11.9f\n", intr*dV);
 
    fclose(cube);
 
+   // binary sibling in memory order (x fastest)
+   if (binary) {
+     char bname[1024];
+     snprintf(bname, sizeof(bname), "%s.bin", fname);
+     int n[3] = {nx, ny, nz};
+     double x0[3] = {xgrid[0], ygrid[0], zgrid[0]};
+     double h[3] = {dx, dy, dz};
+     WriteCubeBinary(bname, n, x0, h, wfp, oosqrdv);
+   }
 }
 
 
@@ -2026,7 +2329,7 @@ void DVR::GetWaveFnCube(int iwf, double *cube)
 {
 
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
   if (iwf > nconverged) {
     if(rank==0)cout << "GetWaveFnCube: There are only " << nconverged << " states available at the moment.\n";
     exit(1);
@@ -2076,7 +2379,7 @@ void DVR::GetWaveFnCube(int iwf, double *cube)
 void DVR::WriteOneDCuts(void)
 {
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
    if (no_dim != 3) {
       if(rank==0)cout << "Error in WriteCuts; this is a function for 3D grids only\n";
       exit(1);
@@ -2140,7 +2443,7 @@ void DVR::WriteOneDCuts(void)
 void DVR::WriteCuts(void)
 {
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
    if (no_dim != 3) {
       if(rank==0)cout << "Error in WriteCuts; this is a function for 3D grids only\n";
       exit(1);
@@ -2237,82 +2540,129 @@ void DVR::WriteCuts(void)
 
 
 
+/////////////////////////////////////////
+//
+//  integrals of all converged states over the grid
+//
+//  the properties are 1, x, y, z, r^2, and the ngrids grids
+//  expval[i + nconverged*k] = <i|g_k|i>  and  trans[i + nconverged*k] = <i|g_k|0>
+//
+//  for a block of points, the densities w_i^2 and the products w_i*w_0 are columns of P,
+//  the properties are columns of G, and the block contributes P^T G (one dgemm)
+//  the blocks are distributed over the threads, which reduce their sums at the end
+//
+//  this is a DVR wavefunction, so the volume element is already in the
+//  value of the wavefunction at that grid point
+//
+void DVR::StateIntegrals(int ngrids, const double * const *grids, double *expval, double *trans)
+{
+  const int nblock = 4096;
+  const int ns = nconverged;
+  const int ns2 = 2*nconverged;
+  const int nprop = 5 + ngrids;
+  const int nx = n_1dbas[0];
+  const int nxy = n_1dbas[0]*n_1dbas[1];
+  const double *xgrid = x_dvr;
+  const double *ygrid = x_dvr + max1db[0];
+  const double *zgrid = x_dvr + max1db[0] + max1db[1];
+  const double *w0 = &wavefn[0];
+
+  dVec sum(ns2*nprop, 0.0);
+#pragma omp parallel
+  {
+    dVec P(nblock*ns2), G(nblock*nprop), C(ns2*nprop, 0.0);
+    double one = 1.0;
+#pragma omp for schedule(static)
+    for (int ib = 0; ib < ngp; ib += nblock) {
+      int m = std::min(nblock, ngp - ib);
+      for (int p = 0; p < m; ++p) {
+	// x runs fastest
+	int igp = ib + p;
+	double x = xgrid[igp % nx];
+	double y = ygrid[(igp / nx) % n_1dbas[1]];
+	double z = zgrid[igp / nxy];
+	G[p] = 1.0;
+	G[p + nblock] = x;
+	G[p + 2*nblock] = y;
+	G[p + 3*nblock] = z;
+	G[p + 4*nblock] = x*x + y*y + z*z;
+      }
+      for (int k = 0; k < ngrids; ++k)
+	for (int p = 0; p < m; ++p)
+	  G[p + (5+k)*nblock] = grids[k][ib + p];
+      for (int i = 0; i < ns; ++i) {
+	const double *wi = &wavefn[(long)i*ngp + ib];
+	for (int p = 0; p < m; ++p) {
+	  P[p + i*nblock] = wi[p] * wi[p];
+	  P[p + (ns+i)*nblock] = wi[p] * w0[ib + p];
+	}
+      }
+      dgemm("T", "N", ns2, nprop, m, one, &P[0], nblock, &G[0], nblock, one, &C[0], ns2);
+    }
+#pragma omp critical
+    for (int k = 0; k < ns2*nprop; ++k)
+      sum[k] += C[k];
+  }
+
+  for (int k = 0; k < nprop; ++k)
+    for (int i = 0; i < ns; ++i) {
+      expval[i + ns*k] = sum[i + ns2*k];
+      trans[i + ns*k] = sum[ns + i + ns2*k];
+    }
+}
+
+
+//
+//  energy components of all converged states
+//  the stored component grids are used if ComputePotential provided them,
+//  otherwise the components are evaluated once at all grid points
+//
 void DVR::EnergyPartitioning(class Potential &V)
 {
 
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
   if (nconverged < 1) {
       if(rank==0)cout << "ExpectationValues: No converged states available at the moment.\n";
       exit(1);
   }
-   int nx = n_1dbas[0];
-   int ny = n_1dbas[1];
-   int nz = n_1dbas[2];
-   int ix, iy, iz;
-
-   double *xgrid = x_dvr;
-   double *ygrid = x_dvr+max1db[0];
-   double *zgrid = x_dvr+max1db[0]+max1db[1];
-
-   //
-   //  this is a DVR wavefunction, so the volume element is already in the
-   //  value of the wavefunction at that grid point
-   //  in the grid-integrater we have dV=dxdydz  dx = (xmax-xmin)/(nx-1)
-   //
-   //  good check: the sum over a DVR grid should always be 1.00000000
-   //
-   //  multiplication with 1/sqrt(dV) should give the Bohr^(-3/2) unit of the wavefunction
-   //
-   //  all this makes only sense for Sine DVR (equidistant grids)
-   //
 
-   double dV = (zgrid[nz-1]-zgrid[0])*(ygrid[nz-1]-ygrid[0])*(xgrid[nz-1]-xgrid[0]) / double((nx-1)*(ny-1)*(nz-1));
-   double oosqrdv = 1.0/sqrt(dV);
+  dVec vcomp;
+  const double *grids[4] = {v_diag_pc, v_diag_ind, v_diag_rep, v_diag_pol};
+  if (!validComponents) {
+    if (verbose > 0)
+      if(rank==0)cout << "EnergyPartitioning: no stored potential components, evaluating V\n";
+    vcomp.resize(4*(long)ngp);
+    V.PrepareWorkspaces();
+#pragma omp parallel
+    {
+      Potential &l_V = V;
+#pragma omp for
+      for (int igp = 0; igp < ngp; igp++) {
+	double q[MAXDIM];
+	GridPoint(igp, q);
+	double energies[5];
+	l_V.Evaluate(q);
+	l_V.ReportEnergies(5, energies);
+	for (int k = 0; k < 4; ++k)
+	  vcomp[k*(long)ngp + igp] = energies[k];
+      }
+    }
+    for (int k = 0; k < 4; ++k)
+      grids[k] = &vcomp[k*(long)ngp];
+  }
 
-   if (verbose > 1)     
-     if(rank==0)cout << "Cube normalization factor is " << oosqrdv << "\n";
+  int ns = nconverged;
+  dVec expval(ns*9), trans(ns*9);
+  StateIntegrals(4, grids, &expval[0], &trans[0]);
+  const double *vElec = &expval[5*ns];
+  const double *vInd  = &expval[6*ns];
+  const double *vRep  = &expval[7*ns];
+  const double *vPol  = &expval[8*ns];
 
-   
-   double *wfp = &wavefn[0];
-   dVec wf; wf.resize(nconverged);
-   dVec rho; rho.resize(nconverged);
-   dVec vRep ; vRep.resize(nconverged);
-   dVec vElec ; vElec.resize(nconverged);
-   dVec vPol ; vPol.resize(nconverged);
-   dVec vInd ; vInd.resize(nconverged);
-   for (ix = 0; ix < nx; ++ix)
-     for (iy = 0; iy < ny; ++iy)
-       for (iz = 0; iz < nz; ++iz)
-         {
-           // get wavefunctions at this grid point
-           int idx = ix*incv[0]+iy*incv[1]+iz*incv[2];
-           for (int i_state = 0; i_state < nconverged; ++i_state) {
-             wf[i_state] = wavefn[i_state*ngp + idx];
-             rho[i_state] = wf[i_state] * wf[i_state];
-           }
-           // sums for expectation values
-           // sums for transition dipoles
-           double relectron[3]; relectron[0] = xgrid[ix] ; relectron[1] = ygrid[iy] ; relectron[2] = zgrid[iz] ;
-           double energies[5] ;
-           V.Evaluate(&relectron[0])  ; 
-           V.ReportEnergies(5, energies)  ;
-           //if(rank==0)cout << energies[0] << endl;
-           //if(rank==0)cout << rho[0] << endl;
-           for (int i = 0; i < nconverged; ++i) {
-             //vKinteic[i] += vKinteic[i]+rho[i_siate]*;
-             vElec[i] += rho[i]*energies[0] ;
-             vInd[i]  += rho[i]*energies[1] ;
-             vRep[i]  += rho[i]*energies[2] ;
-             vPol[i]  += rho[i]*energies[3] ;
-           }
-         }
-
-//   if(rank==0)cout << AU2EV << endl; 
    if(rank==0)cout << "\nEnergy expectation values (all in meV)\n";
    if(rank==0)cout << "\nState     vElec     vInd      vRep      vPol  \n";
    for (int i = 0; i < nconverged; ++i) {
-//   if(rank==0)cout << vElec[i] ; 
     if(rank==0)printf(" %3i   %10.5f  %10.5f  %10.5f  %10.5f\n ",
             i,  vElec[i]*AU2MEV ,vInd[i]*AU2MEV,  vRep[i]*AU2MEV, vPol[i]*AU2MEV);
    }
@@ -2329,7 +2679,7 @@ void DVR::EnergyPartitioning(class Potential &V)
 void DVR::ExpectationValues(int verbose)
 {
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
    if (verbose > 1)
       if(rank==0)cout << "\nExpectation values are printed for all converged wavefunctions\n";
    
@@ -2341,80 +2691,34 @@ void DVR::ExpectationValues(int verbose)
    int nx = n_1dbas[0];
    int ny = n_1dbas[1];
    int nz = n_1dbas[2];
-   int ix, iy, iz;
 
    double *xgrid = x_dvr;
    double *ygrid = x_dvr+max1db[0];
    double *zgrid = x_dvr+max1db[0]+max1db[1];
 
-   //
-   //  this is a DVR wavefunction, so the volume element is already in the
-   //  value of the wavefunction at that grid point
-   //  in the grid-integrater we have dV=dxdydz  dx = (xmax-xmin)/(nx-1)
    //
    //  good check: the sum over a DVR grid should always be 1.00000000
    //
    //  multiplication with 1/sqrt(dV) should give the Bohr^(-3/2) unit of the wavefunction
+   //  in the grid-integrater we have dV=dxdydz  dx = (xmax-xmin)/(nx-1)
    //
    //  all this makes only sense for Sine DVR (equidistant grids)
    //
+   if (verbose > 1) {
+     double dV = (zgrid[nz-1]-zgrid[0])*(ygrid[ny-1]-ygrid[0])*(xgrid[nx-1]-xgrid[0]) / double((nx-1)*(ny-1)*(nz-1));
+     if(rank==0)cout << "Cube normalization factor is " << 1.0/sqrt(dV) << "\n";
+   }
 
-   double dV = (zgrid[nz-1]-zgrid[0])*(ygrid[nz-1]-ygrid[0])*(xgrid[nz-1]-xgrid[0]) / double((nx-1)*(ny-1)*(nz-1));
-   double oosqrdv = 1.0/sqrt(dV);
-
-   if (verbose > 1)     
-     if(rank==0)cout << "Cube normalization factor is " << oosqrdv << "\n";
-
-   
-   double *wfp = &wavefn[0];
-   dVec wf; wf.resize(nconverged);
-   dVec rho; rho.resize(nconverged);
-   dVec intr; intr.resize(nconverged);
-   
    //
    // lots of expectation values for all converged states 
+   //   expval[i + n*k]: k = 0 norm, 1-3 <n|x|n>, <n|y|n>, <n|z|n>, 4 <n|r^2|n>
+   //   trans[i + n*k]:  k = 1-3 <n|x|0>, <n|y|0>, and <n|z|0>
    //
-   //   
-   dVec xyzexpval; xyzexpval.resize(nconverged*3); // xyzexpval[3*i_state + k]  <n|x|n>, <n|y|n>, and <n|z|n>
-   dVec rexpval; rexpval.resize(nconverged); // <n|r|n>
-   dVec rsqexpval; rsqexpval.resize(nconverged); // <n|r^2|n>
-   for (int i_state = 0; i_state < nconverged; ++i_state) {
-     rexpval[i_state] = 0;
-     rsqexpval[i_state] = 0;
-     for (int k = 0; k < 3; ++k)
-       xyzexpval[3*i_state + k] = 0;
-   }
-
-   // <n|x|0>, <n|y|0>, and <n|z|0> for all converged excited states
-   dVec transdipole; transdipole.resize((nconverged-1)*3); // transdipole[3*i_exstate + k]
-
-
-   for (ix = 0; ix < nx; ++ix) 
-     for (iy = 0; iy < ny; ++iy) 
-       for (iz = 0; iz < nz; ++iz) 
-	 {
-	   // get wavefunctions at this grid point
-	   int idx = ix*incv[0]+iy*incv[1]+iz*incv[2];
-	   for (int i_state = 0; i_state < nconverged; ++i_state) {
-	     wf[i_state] = wavefn[i_state*ngp + idx];
-	     rho[i_state] = wf[i_state] * wf[i_state];
-	     intr[i_state] += rho[i_state];
-	   }
-	   // sums for expectation values
-	   for (int i_state = 0; i_state < nconverged; ++i_state) {
-	       xyzexpval[3*i_state + 0] += rho[i_state] * xgrid[ix]; 
-	       xyzexpval[3*i_state + 1] += rho[i_state] * ygrid[iy]; 
-	       xyzexpval[3*i_state + 2] += rho[i_state] * zgrid[iz];
-	       rsqexpval[i_state] += rho[i_state] * (xgrid[ix]*xgrid[ix] + ygrid[iy]*ygrid[iy] + zgrid[iz]*zgrid[iz]);
-	   }
-	   // sums for transition dipoles
-	   for (int i = 1; i < nconverged; ++i) { 
-	     transdipole[3*(i-1) + 0] += wf[i] * xgrid[ix] * wf[0];
-	     transdipole[3*(i-1) + 1] += wf[i] * ygrid[iy] * wf[0];
-	     transdipole[3*(i-1) + 2] += wf[i] * zgrid[iz] * wf[0];
-	   }
-	 }
-
+   int ns = nconverged;
+   dVec expval(ns*5), trans(ns*5);
+   StateIntegrals(0, 0, &expval[0], &trans[0]);
+   const double *intr = &expval[0];
+   const double *rsqexpval = &expval[4*ns];
 
    //
    //  print some nice output
@@ -2425,12 +2729,13 @@ void DVR::ExpectationValues(int verbose)
        if(rank==0)cout << "Warning: normaliziation integral of state " << i << " is not 1.0, but " << intr[i]
 	    << "\nThis chould not happen.\n";
      if(rank==0)cout << "normalization of state" << i << " is " << intr[i] << "\n" ; 
-     for (int k = 0; k < 3; ++k)
-       rexpval[i] += xyzexpval[3*i + k] * xyzexpval[3*i + k];
-     rexpval[i] = sqrt(rexpval[i]);
+     double rexpval = 0;
+     for (int k = 1; k <= 3; ++k)
+       rexpval += expval[i + ns*k] * expval[i + ns*k];
+     rexpval = sqrt(rexpval);
     if(rank==0)printf(" %3i   %10.5f  %10.5f  %10.5f\n", 
-	    i, Bohr2Angs*rexpval[i], Bohr2Angs*sqrt(rsqexpval[i]), 
-	    Bohr2Angs*sqrt(rsqexpval[i] - rexpval[i]*rexpval[i]) );
+	    i, Bohr2Angs*rexpval, Bohr2Angs*sqrt(rsqexpval[i]), 
+	    Bohr2Angs*sqrt(rsqexpval[i] - rexpval*rexpval) );
    }
    if(rank==0)cout << "\n";
 
@@ -2438,12 +2743,42 @@ void DVR::ExpectationValues(int verbose)
    if (nconverged > 1) {
      if(rank==0)cout << "Transition dipoles d^2 and d=(<n|x|0>, <n|y|0>, <n|z|0>) (all in au)\n";
      for (int i = 1; i < nconverged; ++i) {
-       double dsq = transdipole[3*(i-1)]*transdipole[3*(i-1)];
-       dsq += transdipole[3*(i-1)+1]*transdipole[3*(i-1)+1];
-       dsq += transdipole[3*(i-1)+2]*transdipole[3*(i-1)+2];
+       double dx = trans[i + ns], dy = trans[i + 2*ns], dz = trans[i + 3*ns];
+       double dsq = dx*dx + dy*dy + dz*dz;
       if(rank==0)printf(" %3i      %10.5f     (%10.5f,  %10.5f,  %10.5f)\n",
-	      i, dsq, transdipole[3*(i-1)], transdipole[3*(i-1)+1], transdipole[3*(i-1)+2]);
+	      i, dsq, dx, dy, dz);
      }
    if(rank==0)cout << "\n";
    }
 }
+
+
+//
+//  a start vector prepared by the caller; it replaces the lowest converged state,
+//  so that Diagonalize(0, ev) begins with it
+//
+void DVR::SetStartVector(const double *x)
+{
+  if (nwavefn < 1) {
+    wavefn.resize(ngp*std::max(nStates, 1));
+    nwavefn = std::max(nStates, 1);
+  }
+  std::copy(x, x + ngp, wavefn.begin());
+  if (nconverged < 1)
+    nconverged = 1;
+}
+
+
+//
+//  the moments printed by ExpectationValues() without the printing
+//
+int DVR::StateMoments(dVec &m)
+{
+  int ns = nconverged;
+  m.resize(5*ns);
+  if (ns < 1)
+    return 0;
+  dVec trans(5*ns);
+  StateIntegrals(0, 0, &m[0], &trans[0]);
+  return ns;
+}
@@ -2,7 +2,9 @@
 #define PISCES_DVR_H_
 
 #include <iostream>
+#include <string>
 #include "vecdefs.h"
+#include "GridMemory.h"
 
 //******header files for FFT
 // header files for FFTW3
@@ -35,8 +37,20 @@ public:
       , tformat(0) 
       , nconverged(0)
       , nwavefn(0)
+      , nMatVecs(0)
       , StepSize(MAXDIM)
-   {}
+      , nTerms(0)
+      , DipoleCacheFlag(0)
+      , DipoleCacheTol(1e-6)
+      , nCachedDipoles(0)
+      , nDipoleComponents(0)
+      , DipolePotential(0)
+      , DipolePotentialSetup(-1)
+      , CheckpointFile("Checkpoint.chk")
+   {
+     for (int id = 0; id < MAXDIM; ++id)
+       e_kin[id] = dvr_rep[id] = 0;
+   }
 
    /// Deallocates work arrays
    ~DVR();
@@ -62,6 +76,23 @@ public:
    /// This is the DVR approximation: the V-operator is diagonal.  
    void ComputePotential(class Potential &V);
 
+   /// \brief Evaluates and stores the unscaled terms of the potential (see Potential::EvaluateTerms)
+   ///
+   /// v_diag is then their linear combination; falls back to ComputePotential() 
+   /// for potentials that cannot be decomposed and for sampling > 1
+   void ComputePotentialTerms(class Potential &V);
+
+   /// \brief Rebuilds v_diag after V.UpdateParameters() from the stored term grids
+   ///
+   /// only terms whose damping parameters have changed are re-evaluated on the grid
+   void UpdatePotential(class Potential &V);
+
+   /// \brief Keep the induced dipoles of ComputePotential for ComputeGradient
+   ///
+   /// flag 0: off, 1: double, 2: float; only points where |psi|^2 of the current wavefunction
+   /// exceeds tol*max|psi|^2 are kept (see Potential::InducedDipoles)
+   void SetDipoleCache(int flag, double tol);
+
 //   void ComputeGradient(class Potential &V, int nSites, double *Gradient, double *DmuByDx, double *DmuByDy, double *DmuByDz);
 //   void ComputeGradient(class Potential &V, int nSites, double *Gradient, double *dEfield, double *PolGrad, class WaterCluster &WaterN);
    void ComputeGradient(class Potential &V, int nSites, double *Gradient, double *dT_x , double *dT_y , double *dT_z, double *PolGrad, class WaterCluster &WaterN , double *dEfield);
@@ -76,9 +107,22 @@ public:
    \li 1 : lowest particle-in-the-box startvector
    \li 0 : the start vector is read from a smaller grid (StartVector.cub)
    \li 2 : to use the old wavefunction 
+   \li 5 : the start vectors are read from the binary checkpoint (see SetCheckpointFile)
    */ 
    int Diagonalize(int SVFlag, double *ev);
 
+   /// \brief Writes grid, potential grids, converged wavefunctions (and with krylov=1 the last Lanczos residual) to a binary checkpoint
+   void WriteCheckpoint(const char *fname, int krylov = 0);
+
+   /// \brief Reads wavefunctions (and with potential=1 the potential grids) from a checkpoint for the same grid
+   ///
+   /// returns the number of wavefunctions read or -1
+   int ReadCheckpoint(const char *fname, int potential = 0);
+
+   /// \brief The checkpoint of SVFlag 5 (default Checkpoint.chk)
+   void SetCheckpointFile(const char *fname) { CheckpointFile = fname; }
+   const char* GetCheckpointFile() const { return CheckpointFile.c_str(); }
+
    /** \brief Set parameters for the Eigen-solver
    
    \param nEV  no of Eigen-pairs (Davidson can do only 1 so far)
@@ -91,7 +135,9 @@ public:
    void DiagonalizeSetup(int nEV, int DiagFlag, int nMaxSub, int nMaxIter, int pTol);
 
    /// Writes a gaussian-type cubefile that can be read by Avogadro/
-   void WriteCubeFile(int iwf, const char *fname, int nAtoms, const int *Z, const double *position, int cubeflag = 0);
+   ///
+   /// with binary=1 also fname.bin with the raw grid (see CubeWriter.h)
+   void WriteCubeFile(int iwf, const char *fname, int nAtoms, const int *Z, const double *position, int cubeflag = 0, int binary = 0);
 
    /// put the DVR wavefunctions into cube 
    void GetWaveFnCube(int iwf, double *cube);
@@ -101,11 +147,42 @@ public:
    void WriteOneDCuts(void);
    
    void ExpectationValues(int verbose=0);
+   /// norm, <x>, <y>, <z>, <r^2> of the converged states in m[i + n*k], k = 0..4; returns n
+   int StateMoments(dVec &m);
    void EnergyPartitioning(class Potential &V) ;
+
+   /// \name access for benchmarks and tools
+   //@{
+   int nGridPoints() const { return ngp; }
+   const int* GridPoints() const { return n_1dbas; }
+   const double* PotentialDiagonal() const { return v_diag; }
+   /// the 1D kinetic energy spectrum of direction idim in momentum space (DVRType 3) or in the sine basis (DVRType 4)
+   const double* KineticSpectrum(int idim) const { return (dvrtype == 3 || dvrtype == 4) ? &ke_spec[idim][0] : 0; }
+   /// y = H x with the kinetic energy matrices (MatrixTimesVector)
+   void HamiltonianTimesVector(const double *x, double *y);
+   /// matrix-times-vector operations of the last Davidson
+   int MatVecs() const { return nMatVecs; }
+   //@}
+
+   /// \name start vectors from outside (e.g., extrapolation in MD)
+   //@{
+   /// the lowest converged state (ngp values)
+   const double* WaveFunction() const { return &wavefn[0]; }
+   /// becomes the first start vector of the next Diagonalize(0, ev)
+   void SetStartVector(const double *x);
+   //@}
 private: // METHODS
 
    void ComputeGridParameters();
    void ComputeGridPointsAndKineticEnergy();
+   /// coordinates of grid point igp (x runs fastest), from the 1D grids in x_dvr
+   void GridPoint(int igp, double *q) const {
+     q[0] = x_dvr[igp % n_1dbas[0]];
+     q[1] = x_dvr[max1db[0] + (igp / n_1dbas[0]) % n_1dbas[1]];
+     q[2] = x_dvr[max1db[0] + max1db[1] + igp / (n_1dbas[0]*n_1dbas[1])];
+   }
+   /// coordinates of the np grid points first, first+1, ... in q[3*np] (a tile for EvaluateBatch)
+   void GridTile(int first, int np, double *q) const;
    //set up the FFT parameters
    void FFTSetup();
    /// Can be used as a start vector
@@ -114,6 +191,11 @@ private: // METHODS
    void ExtendWfThree(double *wf);  
    double InterpolVdouble(double *TempF, int px, int py, int pz, int *Pre1db);
    double InterpolVtriple(double *TempF, int px, int py, int pz, int *Pre1db);
+   void EvaluateTermGrids(class Potential &V, const int *mask);
+   void RecombinePotential(class Potential &V);
+   void StateIntegrals(int ngrids, const double * const *grids, double *expval, double *trans);
+   int DipoleCacheValid(const class Potential &V) const;
+   const double* CachedDipoles(int igp, dVec &buf) const;
 
 
    /// \name Diagonalizer functions
@@ -140,7 +222,7 @@ private: // MEMBERS
    counter* m_pkc;
    static const int MAXDIM = 3;
    int verbose;
-   int dvrtype;          ///< 1 : Harmonic oscillator; !=1 Sine
+   int dvrtype;          ///< 1 : Harmonic oscillator; 3 : FFT; 4 : Sine with DST-I; else Sine
    int sampling;         // evaluate V at gridpoints, or double, or triple density
    double gridpara[MAXDIM];///< gridparameter: for type 1: omega; for type 2: length
    int no_dim;           ///< no of dimensions (3 here, but can be arbitrary but many functions make sense only for 3) 
@@ -154,6 +236,7 @@ private: // MEMBERS
    int tformat;          ///< format of T (triangle=0 or full matrix=1)
    int nconverged;       ///< no of converged eigenvalues and eigenfunctions (from ARPACK or Davidson)
    int nwavefn;          ///< current number of wavefunctions allocated
+   int nMatVecs;         ///< matrix-times-vector operations of the last Davidson
    int DiagCount;
 
    ///\name diagonalization information
@@ -170,21 +253,44 @@ private: // MEMBERS
    double* dvr_rep[MAXDIM]; ///< matrix to go from DVR to FBS representation              
    dVec Vec_x_dvr;
    double*  x_dvr;   ///< list with gridpoints in each dimension : x_dvr[max_1db * no_dim]
-   dVec Vec_v_diag;  
+   gVec Vec_v_diag;  
    double*  v_diag;  ///< potential energy at the grid points v_diag[product of n_1dbas]
-   dVec Vec_v_diag_pc;  
+   gVec Vec_v_diag_pc;  
    double*  v_diag_pc;  
-   dVec Vec_v_diag_ind;  
+   gVec Vec_v_diag_ind;  
    double*  v_diag_ind;  
-   dVec Vec_v_diag_rep;  
+   gVec Vec_v_diag_rep;  
    double*  v_diag_rep;  
-   dVec Vec_v_diag_pol;  
+   gVec Vec_v_diag_pol;  
    double*  v_diag_pol;  
+   int validComponents;  ///< v_diag_pc, _ind, _rep, and _pol are complete on rank 0
    //double*  wavefn;
-   dVec wavefn;  ///< value of the wavefunction at the grid points (times volume element)
-   dVec CoarseWf;  ///< value of the wavefunction at the sparse grid points (times volume element)
+   gVec wavefn;  ///< value of the wavefunction at the grid points (times volume element)
+   gVec CoarseWf;  ///< value of the wavefunction at the sparse grid points (times volume element)
    dVec StepSize;
 
+   ///\name term-decomposed potential for fast reparametrization
+   //@{
+   int nTerms;          ///< no of stored term grids (0 = none stored)
+   gVec Vec_v_terms;    ///< term grids, term-major: v_terms[iterm*ngp + igp]
+   dVec TermKeys;       ///< non-linear parameters the stored term grids were computed with
+   //@}
+
+   ///\name induced dipoles of ComputePotential, reused by ComputeGradient
+   //@{
+   int DipoleCacheFlag;        ///< 0: off, 1: double, 2: float
+   double DipoleCacheTol;      ///< relative density threshold
+   int nCachedDipoles;         ///< no of points in the cache (0 = invalid)
+   int nDipoleComponents;      ///< 3 * no of polarizable atoms
+   const class Potential *DipolePotential;  ///< the potential the cache belongs to
+   int DipolePotentialSetup;   ///< and its SetupCount()
+   iVec DipoleSlot;            ///< slot of igp in the cache, or -1
+   dVec DipoleCacheD;
+   std::vector<float> DipoleCacheF;
+
+   std::string CheckpointFile;  ///< read by Diagonalize(5)
+   //@}
+
 //   iVec select;       // the bloody, allegedly not referenced array
 //   dVec v;             // Lanczos basis
 //   dVec workd;         // Lanczos vectors
@@ -203,7 +309,7 @@ private: // MEMBERS
    
    //Variable for the fourier transformation of x and KE operator  
    int threads_ok;
-   double* KE_diag;   ///< final diagonal kinetic energy matrices coordinate x,y,z
+   dVec ke_spec[MAXDIM];   ///< 1D kinetic energy spectra for FFT and DST; T(i,j,k) is their sum
 
   Complex *phi_x;     //Copies vector x to new complex array: x can be directly fourier transformed
   Complex *phi_k;    //forward fourier transform of vector x
@@ -7,7 +7,10 @@
 // in addition to the electron's field, there may be an "external" field, say, 
 // due to point charges: Epc
 //
+// InvAH is an optional H-matrix copy of InvA for fast products with large clusters
+//
 #include "vecdefs.h"
+#include "HMatrix.h"
 
 
 struct DistributedPolarizabilities
@@ -21,6 +24,7 @@ struct DistributedPolarizabilities
   iVec SiteList;
   dVec Alpha;
   dVec InvA;
+  HMatrix InvAH;
   dVec Tensor;
   dVec Epc;
 //  dVec dTij ; 
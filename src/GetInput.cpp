@@ -31,6 +31,7 @@ void GetInputParameters(Parameters &P, TSIN Input)
   P.nElectron  = Input.GetInt("Job", "nElectron", 1); // can be 0 or 1
   P.CubeFile   = Input.GetInt("Job", "CubeFile", 0); 
   P.WfCuts     = Input.GetInt("Job", "WfCuts", 0); 
+  P.Profile    = Input.GetInt("Job", "Profile", 0);   // 1 = write profile.json
   
   // WaterModel group
   P.WMverbose  = Input.GetInt("WaterModel", "Verbose", 1);
@@ -47,6 +48,10 @@ void GetInputParameters(Parameters &P, TSIN Input)
     P.PotFlag[4] = Input.GetInt("ElectronPotential", "AdiabaticPolPot", 0);
     P.PotFlag[5] = Input.GetInt("ElectronPotential", "InternalParam", 0);
     P.PotVerbose = Input.GetInt("ElectronPotential", "Verbose", 0);
+    P.MeshSigma = Input.GetDouble("ElectronPotential", "MeshSigma", 0.0);
+    P.DipoleCache = Input.GetInt("ElectronPotential", "DipoleCache", 0);
+    P.DipoleCacheTol = Input.GetDouble("ElectronPotential", "DipoleCacheTol", 1e-6);
+    P.HMatrixTol = Input.GetDouble("ElectronPotential", "HMatrixTol", 0.0);
     switch (P.PotFlag[0])
       {
       case 1:  // DPP-6S_GTO-P
@@ -139,6 +144,7 @@ void GetInputParameters(Parameters &P, TSIN Input)
   P.maxIter = Input.GetInt("Diag", "maxIter", 100);      // max no of macro-iterations
   P.ptol = Input.GetInt("Diag", "pTol", 5);          // tolerance = 10^-pTol
   P.istartvec = Input.GetInt("Diag", "StartVector", 1); // this is different for Lanczos + Davidson and needs work
+  P.Checkpoint = Input.GetInt("Diag", "Checkpoint", 0);  // 1 = write Checkpoint.chk, 2 = including the Lanczos residual
 
   // Optimize group
   if (P.runtype == 2) {
@@ -150,8 +156,34 @@ void GetInputParameters(Parameters &P, TSIN Input)
     P.nsteps = Input.GetInt("MolecularDynamics", "nsteps", 100);
     P.timestep = Input.GetDouble("MolecularDynamics", "timestep", 0.001);
     P.RigidBody = Input.GetInt("MolecularDynamics", "RigidBody", 1);
+    P.Temperature = Input.GetDouble("MolecularDynamics", "Temperature", 0.0);
+    P.ASPCOrder = Input.GetInt("MolecularDynamics", "ASPCOrder", 2);
+    P.DriftTol = Input.GetDouble("MolecularDynamics", "DriftTol", 1e-5);
 
   }   
+  // ParallelTempering group
+  if (P.runtype == 5) {
+    P.ptSteps = Input.GetInt("ParallelTempering", "nSteps", 1000);
+    P.ptExchange = Input.GetInt("ParallelTempering", "ExchangeEvery", 10);
+    P.ptRanksPerReplica = Input.GetInt("ParallelTempering", "RanksPerReplica", 1);
+    P.ptTmin = Input.GetDouble("ParallelTempering", "Tmin", 50.0);
+    P.ptTmax = Input.GetDouble("ParallelTempering", "Tmax", 200.0);
+    P.ptStepTrans = Input.GetDouble("ParallelTempering", "StepTrans", 0.3);
+    P.ptStepRot = Input.GetDouble("ParallelTempering", "StepRot", 10.0);
+  }
+  // Batch group
+  if (P.runtype == 4) {
+    char *str = 0;
+    Input.GetString("Batch", "Trajectory", "trajectory.xyz", &str);
+    strncpy(P.Trajectory, str, sizeof(P.Trajectory)-1);
+    P.Trajectory[sizeof(P.Trajectory)-1] = 0;
+    delete[] str;
+    Input.GetString("Batch", "Output", "batch.dat", &str);
+    strncpy(P.BatchOutput, str, sizeof(P.BatchOutput)-1);
+    P.BatchOutput[sizeof(P.BatchOutput)-1] = 0;
+    delete[] str;
+    P.BatchRanksPerFrame = Input.GetInt("Batch", "RanksPerFrame", 0);
+  }
 
 
 
@@ -162,6 +194,11 @@ void GetInputParameters(Parameters &P, TSIN Input)
     P.LowCutOff  = Input.GetDouble("PotFit", "LowCutOff", 2.0); 
     P.HighCutOff = Input.GetDouble("PotFit", "HighCutOff", 15.0); 
     P.wexp = Input.GetDouble("PotFit", "WeightExp", -1.0);
+    char *refcube = 0;
+    Input.GetString("PotFit", "RefCube", "StartVector.cub", &refcube);
+    strncpy(P.RefCube, refcube, sizeof(P.RefCube)-1);
+    P.RefCube[sizeof(P.RefCube)-1] = 0;
+    delete[] refcube;
     P.minimizer = Input.GetInt("PotFit", "Method", 0); 
     P.mapping.resize(P.nParaOpt);
     Input.GetIntArray("PotFit", "Mapping", &P.mapping[0], P.nParaOpt);
@@ -40,18 +40,11 @@ using namespace std;
 void Potential:: EvaluateGradient(
                                   const double *relectron, 
                                   dVec& Grad, dVec& tmu, dVec& mu_cross_mu, double wavefn,
-                                  class WaterCluster &WaterN) 
+                                  class WaterCluster &WaterN, const double *cachedmu) 
 {
 
    // compute a list of distances of all sites to the point r=(x,y,z)
-   for (int i = 0; i < nSites; ++i) {
-      Rx[i] = relectron[0] - Site[3*i+0];
-      Ry[i] = relectron[1] - Site[3*i+1];
-      Rz[i] = relectron[2] - Site[3*i+2];
-      R2[i] = Rx[i]*Rx[i] + Ry[i]*Ry[i] + Rz[i]*Rz[i];
-      R[i] = sqrt(R2[i]);
-      Rminus3[i] = 1.0 / (R2[i] * R[i]);
-   }
+   ComputeDistances(relectron);
 
 
 
@@ -65,7 +58,7 @@ void Potential:: EvaluateGradient(
    case 1: // this should work for 2 as well
    case 2:
    case 3:
-      EvaluateDPPGTOPGradient(relectron,Grad, tmu, mu_cross_mu, wavefn,  WaterN);
+      EvaluateDPPGTOPGradient(relectron,Grad, tmu, mu_cross_mu, wavefn,  WaterN, cachedmu);
       break;
    default:
       cout << "Error in EvaluateGradient: unknown PotFlags[0]; this should not happen\n";
@@ -80,8 +73,10 @@ void Potential:: EvaluateGradient(
 void Potential::EvaluateDPPGTOPGradient(
                                        const double *x,
                                        dVec& Grad, dVec& tmu,dVec& mu_cross_mu, double wavefn,
-                                       class WaterCluster &WaterN) 
+                                       class WaterCluster &WaterN, const double *cachedmu) 
 {
+  PotentialWorkspace &w = Work();
+  dVec &Rx = w.Rx, &Ry = w.Ry, &Rz = w.Rz, &R = w.R, &Rminus3 = w.Rminus3;
 
 // gradients  due to point charge electrostatic potential
 
@@ -129,38 +124,39 @@ void Potential::EvaluateDPPGTOPGradient(
   int nAtoms = MolPol[0].nAtoms;
   int n = 3*nAtoms;  // dimension of InvA and Efield, and mu
 
-  dVec Efield; Efield.resize(n);
-  dVec mu;     mu.resize(n);
-
-  double gij;
-  double de1;
-  double de2;
-  for (int i = 0; i < nAtoms; ++i) {
-    int SiteIndex = MolPol[0].SiteList[i];
-    gij = Rminus3[SiteIndex];
-    double Reff = R[SiteIndex];
-    if (Reff < PolDamping ) {
-       double ror0 = Reff / PolDamping;
-       Reff = PolDamping * (0.5 + ror0 * ror0 * ror0 * (1.0 - 0.5 * ror0));
-       gij = 1.0 / (Reff * Reff * Reff);
+  // the dipoles may be known from the potential pass (DVR::SetDipoleCache)
+  const double *mu = cachedmu;
+  if (mu == 0) {
+    dVec &Efield = w.Efield; Efield.resize(n);
+    dVec &wmu = w.mu;        wmu.resize(n);
+
+    double gij;
+    for (int i = 0; i < nAtoms; ++i) {
+      int SiteIndex = MolPol[0].SiteList[i];
+      gij = Rminus3[SiteIndex];
+      double Reff = R[SiteIndex];
+      if (Reff < PolDamping ) {
+	double ror0 = Reff / PolDamping;
+	Reff = PolDamping * (0.5 + ror0 * ror0 * ror0 * (1.0 - 0.5 * ror0));
+	gij = 1.0 / (Reff * Reff * Reff);
+      }
+
+      Efield[3*i+0] = gij * Rx[SiteIndex];
+      Efield[3*i+1] = gij * Ry[SiteIndex];
+      Efield[3*i+2] = gij * Rz[SiteIndex];
     }
 
-    Efield[3*i+0] = gij * Rx[SiteIndex];
-    Efield[3*i+1] = gij * Ry[SiteIndex];
-    Efield[3*i+2] = gij * Rz[SiteIndex];
+    for (int k = 0; k < n; ++k)
+      Efield[k] += MolPol[0].Epc[k];
 
+    // compute dipoles induced by Efield
+    double dzero = 0.0;
+    double done = 1.0;
+    int one = 1;
+    dgemv("N", &n, &n, &done, &(MolPol[0].InvA[0]), &n, &Efield[0], &one, &dzero, &wmu[0], &one);
+    mu = &wmu[0];
   }
 
-  for (int k = 0; k < n; ++k)
-    Efield[k] += MolPol[0].Epc[k];
-  
-  // compute dipoles induced by Efield
-  double dzero = 0.0;
-  double done = 1.0;
-  int one = 1;
-  int dim_x = 3 ;
-  dgemv("N", &n, &n, &done, &(MolPol[0].InvA[0]), &n, &Efield[0], &one, &dzero, &mu[0], &one);
-
 
 //////////////////////////////////////////////////////////////////////
 //
@@ -172,21 +168,23 @@ void Potential::EvaluateDPPGTOPGradient(
 //dVpol/dR = mu * (2*dEfield/dR + dT/dR *mu )
 //////////////////////////////////////////////////////////////////////
 
-   nSites = nAtoms/3*4;
+   int nSites = nAtoms/3*4;
    // Calculate derivative of Ee which is from interaction between  electron and atoms
    // dE(elec)/dR
-   DerivElecField ( nSites, PolDamping, &Rminus3[0] , &R[0] , &Grad[0] , &mu[0]) ;
+   DerivElecField ( nSites, PolDamping, &Rminus3[0] , &R[0] , &Grad[0] , mu) ;
 
    // this just calculates a kind of cross product of mu^T x mu and accumulates density wighted mu
    // but is the most time consuming
 
-   MuCrossMu( nAtoms, &mu[0] , tmu , mu_cross_mu, wavefn) ;  
+   MuCrossMu( nAtoms, mu , tmu , mu_cross_mu, wavefn) ;  
 
 
 }
 
-void Potential::DerivElecField ( int nSites, double DampParameter, double *Rminus3 , double *R , double *Grad , double *mu)
+void Potential::DerivElecField ( int nSites, double DampParameter, double *Rminus3 , double *R , double *Grad , const double *mu)
 {
+  PotentialWorkspace &w = Work();
+  dVec &Rx = w.Rx, &Ry = w.Ry, &Rz = w.Rz;
    double gij;
    int n = nSites*9/4 ;
    int one = 1 ;
@@ -236,7 +234,7 @@ void Potential::DerivElecField ( int nSites, double DampParameter, double *Rminu
    }
 }
 
-void Potential::MuCrossMu (int nAtoms, double *mu , dVec& tmu , dVec& mu_cross_mu, double wavefn)
+void Potential::MuCrossMu (int nAtoms, const double *mu , dVec& tmu , dVec& mu_cross_mu, double wavefn)
 {
 
  
@@ -0,0 +1,110 @@
+#ifndef PISCES_GRIDMEMORY_H_
+#define PISCES_GRIDMEMORY_H_
+
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+#include <sys/mman.h>
+
+//
+//  memory for grid-sized arrays (potential, wavefunctions, Davidson/Lanczos vectors)
+//
+//  gVec is a std::vector<double> with
+//   - 64-byte aligned storage, 2 MB aligned with transparent huge pages for arrays of 4 MB and more
+//   - no initialization by the allocator: resize() does not write, so it does not touch the pages
+//
+//  GridResize and GridAssign then write the new elements in an OpenMP loop with the static
+//  schedule of the grid loops (omp for over igp), so every page is first touched, and placed
+//  on the NUMA node of, the thread that works on it later
+//
+//  the arrays are only ever grown: the capacity of the largest grid is kept, and switching
+//  back and forth between grids (SetupDVR, SetupDVR2) reuses it without new allocations
+//
+
+inline void* GridAlloc(size_t bytes)
+{
+  const size_t huge = size_t(2) << 20;
+  size_t align = (bytes >= 2*huge) ? huge : 64;
+  void *p = 0;
+  if (posix_memalign(&p, align, (bytes > 0) ? bytes : align) != 0)
+    throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+  if (align == huge)
+    madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+  return p;
+}
+
+
+template <class T>
+struct grid_allocator
+{
+  typedef T value_type;
+  template <class U> struct rebind { typedef grid_allocator<U> other; };
+
+  grid_allocator() {}
+  template <class U> grid_allocator(const grid_allocator<U> &) {}
+
+  T* allocate(size_t n) { return static_cast<T*>(GridAlloc(n * sizeof(T))); }
+  void deallocate(T *p, size_t) { free(p); }
+
+  /// default-initialization: no write, no first touch
+  template <class U> void construct(U *p) { ::new(static_cast<void*>(p)) U; }
+  template <class U, class... Args> void construct(U *p, Args&&... args)
+  { ::new(static_cast<void*>(p)) U(std::forward<Args>(args)...); }
+};
+
+template <class T, class U>
+bool operator==(const grid_allocator<T> &, const grid_allocator<U> &) { return true; }
+template <class T, class U>
+bool operator!=(const grid_allocator<T> &, const grid_allocator<U> &) { return false; }
+
+typedef std::vector<double, grid_allocator<double> > gVec;
+
+
+/// like v.resize(n): the old elements are kept, new ones are 0; first touch in parallel
+inline void GridResize(gVec &v, size_t n)
+{
+  long old = long(v.size());
+  long nn = long(n);
+  if (n > v.capacity()) {
+    gVec w;
+    w.reserve(n);
+    w.resize(n);
+    const double *src = (old > 0) ? &v[0] : 0;
+    double *dst = &w[0];
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < nn; ++i)
+      dst[i] = (i < old) ? src[i] : 0.0;
+    v.swap(w);
+  }
+  else {
+    v.resize(n);
+    if (nn > old) {
+      double *dst = &v[0];
+#pragma omp parallel for schedule(static)
+      for (long i = old; i < nn; ++i)
+	dst[i] = 0.0;
+    }
+  }
+}
+
+/// like v.assign(n, value), first touch in parallel
+inline void GridAssign(gVec &v, size_t n, double value)
+{
+  if (n > v.capacity()) {
+    gVec w;
+    w.reserve(n);
+    v.swap(w);
+  }
+  v.resize(n);
+  long nn = long(n);
+  double *dst = (nn > 0) ? &v[0] : 0;
+#pragma omp parallel for schedule(static)
+  for (long i = 0; i < nn; ++i)
+    dst[i] = value;
+}
+
+#endif // PISCES_GRIDMEMORY_H_
@@ -0,0 +1,325 @@
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+#include "HMatrix.h"
+#include "lapackblas.h"
+
+using namespace std;
+
+const double HMatrix::Eta = 2.0;
+
+
+void HMatrix::Clear()
+{
+  N = nSiteRows = active = 0;
+  perm.clear();
+  clusters.clear();
+  blocks.clear();
+  data.clear();
+  border.clear();
+}
+
+
+//
+//  element (i,j) of the permuted matrix, from the triangle dsymv would use
+//  (uplo "L" of the column-major view is the upper triangle of the row-major array)
+//
+inline double HMatrix::Element(const double *A, int lda, int upper, int i, int j) const
+{
+  int p = perm[i], q = perm[j];
+  if ((p < q) != (upper != 0))
+    swap(p, q);
+  return A[long(lda)*p + q];
+}
+
+
+void HMatrix::Setup(int n, const double *A, const char *uplo, const int *site, int nsites,
+		    const double *pos, double tolerance, int verbose)
+{
+  Clear();
+  if (tolerance <= 0 || n == 0)
+    return;
+  N = n;
+  tol = tolerance;
+  int upper = (uplo[0] == 'L' || uplo[0] == 'l');
+
+  // rows of each site
+  iVec rowstart(nsites+1, 0), rowcount(nsites, 0), rows(n);
+  for (int i = 0; i < n; ++i)
+    if (site[i] >= 0)
+      rowcount[site[i]]++;
+  for (int k = 0; k < nsites; ++k)
+    rowstart[k+1] = rowstart[k] + rowcount[k];
+  iVec fill(rowstart.begin(), rowstart.end() - 1);
+  for (int i = 0; i < n; ++i)
+    if (site[i] >= 0)
+      rows[fill[site[i]]++] = i;
+
+  // cluster tree; perm lists the rows leaf by leaf
+  std::vector<int> sites;
+  for (int k = 0; k < nsites; ++k)
+    if (rowcount[k] > 0)
+      sites.push_back(k);
+  perm.reserve(n);
+  if (!sites.empty())
+    Bisect(sites, 0, int(sites.size()), &rowstart[0], &rows[0], pos);
+  nSiteRows = int(perm.size());
+  for (int i = 0; i < n; ++i)
+    if (site[i] < 0)
+      perm.push_back(i);
+
+  // block tree, then the blocks in parallel
+  if (nSiteRows > 0)
+    Partition(0, 0);
+
+  std::vector<dVec> blockdata(blocks.size());
+#pragma omp parallel
+  {
+    dVec R;
+#pragma omp for schedule(dynamic)
+    for (int b = 0; b < (int)blocks.size(); ++b) {
+      Block &B = blocks[b];
+      int m = B.m, nc = B.n;
+      R.resize(long(m)*nc);
+      for (int j = 0; j < nc; ++j)
+	for (int i = 0; i < m; ++i)
+	  R[i + long(m)*j] = Element(A, n, upper, B.r0 + i, B.c0 + j);
+      dVec &D = blockdata[b];
+      if (B.rank == 0) {
+	// admissible: cross approximation with full pivoting, R is the residual,
+	// until its Frobenius norm is below tol times that of the block
+	double norm2 = 0;
+	for (long l = 0; l < long(m)*nc; ++l)
+	  norm2 += R[l] * R[l];
+	double eps2 = tol * tol * norm2;
+	int kmax = int(double(m) * nc / (m + nc));
+	dVec U, V;
+	int k = 0;
+	for (; k <= kmax; ++k) {
+	  long ip = 0;
+	  double res2 = 0;
+	  for (long l = 0; l < long(m)*nc; ++l) {
+	    res2 += R[l] * R[l];
+	    if (fabs(R[l]) > fabs(R[ip]))
+	      ip = l;
+	  }
+	  if (res2 <= eps2 || k == kmax)
+	    break;
+	  int i0 = int(ip % m), j0 = int(ip / m);
+	  double piv = R[ip];
+	  for (int i = 0; i < m; ++i)
+	    U.push_back(R[i + long(m)*j0]);
+	  for (int j = 0; j < nc; ++j)
+	    V.push_back(R[i0 + long(m)*j] / piv);
+	  const double *u = &U[long(m)*k], *v = &V[long(nc)*k];
+	  for (int j = 0; j < nc; ++j)
+	    for (int i = 0; i < m; ++i)
+	      R[i + long(m)*j] -= u[i] * v[j];
+	}
+	if (k < kmax) {
+	  B.rank = k;
+	  D.swap(U);
+	  D.insert(D.end(), V.begin(), V.end());
+	  continue;
+	}
+	// not low-rank after all: refill and keep dense
+	for (int j = 0; j < nc; ++j)
+	  for (int i = 0; i < m; ++i)
+	    R[i + long(m)*j] = Element(A, n, upper, B.r0 + i, B.c0 + j);
+      }
+      B.rank = -1;
+      D.assign(R.begin(), R.end());
+    }
+  }
+  long total = 0;
+  for (size_t b = 0; b < blocks.size(); ++b) {
+    blocks[b].offset = total;
+    total += blockdata[b].size();
+  }
+  data.resize(total);
+  for (size_t b = 0; b < blocks.size(); ++b)
+    std::copy(blockdata[b].begin(), blockdata[b].end(), data.begin() + blocks[b].offset);
+
+  // border rows
+  int nb = N - nSiteRows;
+  border.resize(long(N)*nb);
+  for (int b = 0; b < nb; ++b)
+    for (int j = 0; j < N; ++j)
+      border[j + long(N)*b] = Element(A, n, upper, j, nSiteRows + b);
+
+  active = (Storage() < 0.5 * double(N) * N);
+  if (verbose > 0) {
+    int maxrank = 0, nlow = 0;
+    for (size_t b = 0; b < blocks.size(); ++b)
+      if (blocks[b].rank >= 0) {
+	nlow++;
+	maxrank = max(maxrank, blocks[b].rank);
+      }
+    cout << "H-matrix of InvA: N = " << N << ", " << clusters.size() << " clusters, "
+	 << blocks.size() << " blocks (" << nlow << " low-rank, max rank " << maxrank << "), "
+	 << 100.0 * Storage() / (double(N) * N) << "% of the dense storage";
+    if (!active)
+      cout << ", not used";
+    cout << "\n";
+  }
+  if (!active)
+    Clear();
+}
+
+
+//
+//  cluster of sites[begin, end): bisect at the median of the longest side of the bounding box
+//
+int HMatrix::Bisect(std::vector<int> &sites, int begin, int end, const int *rowstart, const int *rows, const double *pos)
+{
+  int c = int(clusters.size());
+  clusters.push_back(Cluster());
+  Cluster cl;
+  cl.child[0] = cl.child[1] = -1;
+  for (int d = 0; d < 3; ++d) {
+    cl.lo[d] = pos[3*sites[begin]+d];
+    cl.hi[d] = cl.lo[d];
+  }
+  for (int k = begin; k < end; ++k)
+    for (int d = 0; d < 3; ++d) {
+      cl.lo[d] = min(cl.lo[d], pos[3*sites[k]+d]);
+      cl.hi[d] = max(cl.hi[d], pos[3*sites[k]+d]);
+    }
+  cl.first = int(perm.size());
+
+  if (end - begin <= LeafSites) {
+    for (int k = begin; k < end; ++k)
+      for (int r = rowstart[sites[k]]; r < rowstart[sites[k]+1]; ++r)
+	perm.push_back(rows[r]);
+  }
+  else {
+    int d = 0;
+    for (int e = 1; e < 3; ++e)
+      if (cl.hi[e] - cl.lo[e] > cl.hi[d] - cl.lo[d])
+	d = e;
+    int mid = (begin + end) / 2;
+    std::nth_element(sites.begin() + begin, sites.begin() + mid, sites.begin() + end,
+		     [pos, d](int a, int b) { return pos[3*a+d] < pos[3*b+d]; });
+    cl.child[0] = Bisect(sites, begin, mid, rowstart, rows, pos);
+    cl.child[1] = Bisect(sites, mid, end, rowstart, rows, pos);
+  }
+  cl.last = int(perm.size());
+  clusters[c] = cl;
+  return c;
+}
+
+
+int HMatrix::Admissible(int s, int t) const
+{
+  const Cluster &a = clusters[s], &b = clusters[t];
+  double dist2 = 0, diam2a = 0, diam2b = 0;
+  for (int d = 0; d < 3; ++d) {
+    double gap = max(0.0, max(a.lo[d] - b.hi[d], b.lo[d] - a.hi[d]));
+    dist2 += gap * gap;
+    diam2a += (a.hi[d] - a.lo[d]) * (a.hi[d] - a.lo[d]);
+    diam2b += (b.hi[d] - b.lo[d]) * (b.hi[d] - b.lo[d]);
+  }
+  return dist2 > 0 && max(diam2a, diam2b) <= Eta * Eta * dist2;
+}
+
+
+//
+//  block tree for clusters s and t, s == t or s before t (upper half)
+//
+void HMatrix::Partition(int s, int t)
+{
+  const Cluster &a = clusters[s], &b = clusters[t];
+  int leafs = (a.child[0] < 0), leaft = (b.child[0] < 0);
+  if (s == t) {
+    if (leafs)
+      AddBlock(s, t, 0);
+    else {
+      Partition(a.child[0], a.child[0]);
+      Partition(a.child[0], a.child[1]);
+      Partition(a.child[1], a.child[1]);
+    }
+  }
+  else if (Admissible(s, t))
+    AddBlock(s, t, 1);
+  else if (leafs && leaft)
+    AddBlock(s, t, 0);
+  else if (!leafs && (leaft || a.last - a.first >= b.last - b.first)) {
+    int c0 = a.child[0], c1 = a.child[1];
+    Partition(c0, t);
+    Partition(c1, t);
+  }
+  else {
+    int c0 = b.child[0], c1 = b.child[1];
+    Partition(s, c0);
+    Partition(s, c1);
+  }
+}
+
+
+// the blocks are filled by Setup; rank -1: dense, 0: to be approximated
+void HMatrix::AddBlock(int s, int t, int lowrank)
+{
+  Block B = {clusters[s].first, clusters[s].last - clusters[s].first,
+	     clusters[t].first, clusters[t].last - clusters[t].first, lowrank ? 0 : -1, 0};
+  blocks.push_back(B);
+}
+
+
+double HMatrix::Storage() const
+{
+  return double(data.size()) + double(border.size());
+}
+
+
+//
+//  Y = A X: every off-diagonal block is applied as itself and as its transpose
+//
+void HMatrix::Apply(int nrhs, const double *X, int ldx, double *Y, int ldy, dVec &work) const
+{
+  int maxrank = 0;
+  for (size_t b = 0; b < blocks.size(); ++b)
+    maxrank = max(maxrank, blocks[b].rank);
+  work.resize(2*long(N)*nrhs + long(max(maxrank, 1))*nrhs);
+  double *xp = &work[0];
+  double *yp = xp + long(N)*nrhs;
+  double *tp = yp + long(N)*nrhs;
+
+  for (int c = 0; c < nrhs; ++c)
+    for (int k = 0; k < N; ++k) {
+      xp[k + long(N)*c] = X[perm[k] + long(ldx)*c];
+      yp[k + long(N)*c] = 0.0;
+    }
+
+  for (size_t b = 0; b < blocks.size(); ++b) {
+    const Block &B = blocks[b];
+    const double *D = &data[B.offset];
+    double *yr = yp + B.r0, *yc = yp + B.c0;
+    const double *xr = xp + B.r0, *xc = xp + B.c0;
+    if (B.rank < 0) {
+      dgemm("N", "N", B.m, nrhs, B.n, 1.0, D, B.m, xc, N, 1.0, yr, N);
+      if (B.r0 != B.c0)
+	dgemm("T", "N", B.n, nrhs, B.m, 1.0, D, B.m, xr, N, 1.0, yc, N);
+    }
+    else if (B.rank > 0) {
+      const double *U = D, *V = D + long(B.m)*B.rank;
+      dgemm("T", "N", B.rank, nrhs, B.n, 1.0, V, B.n, xc, N, 0.0, tp, B.rank);
+      dgemm("N", "N", B.m, nrhs, B.rank, 1.0, U, B.m, tp, B.rank, 1.0, yr, N);
+      dgemm("T", "N", B.rank, nrhs, B.m, 1.0, U, B.m, xr, N, 0.0, tp, B.rank);
+      dgemm("N", "N", B.n, nrhs, B.rank, 1.0, V, B.n, tp, B.rank, 1.0, yc, N);
+    }
+  }
+
+  int nb = N - nSiteRows;
+  if (nb > 0) {
+    // border rows with all columns, and the border columns of the site rows
+    dgemm("T", "N", nb, nrhs, N, 1.0, &border[0], N, xp, N, 1.0, yp + nSiteRows, N);
+    if (nSiteRows > 0)
+      dgemm("N", "N", nSiteRows, nrhs, nb, 1.0, &border[0], N, xp + nSiteRows, N, 1.0, yp, N);
+  }
+
+  for (int c = 0; c < nrhs; ++c)
+    for (int k = 0; k < N; ++k)
+      Y[perm[k] + long(ldy)*c] = yp[k + long(N)*c];
+}
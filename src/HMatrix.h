@@ -0,0 +1,79 @@
+#ifndef PISCES_HMATRIX_H_
+#define PISCES_HMATRIX_H_
+
+#include <vector>
+#include "vecdefs.h"
+
+//
+//  hierarchical (H-matrix) approximation of a dense symmetric matrix whose rows belong to
+//  points in space, here the inverse polarization matrix InvA of the polarizable sites
+//
+//  the sites are clustered by recursive bisection of their bounding boxes; every row of
+//  a site (3 dipole components, or charge and dipole) stays in the cluster of its site,
+//  and rows that belong to no site (Lagrange multipliers) are kept as dense border rows
+//
+//  a pair of clusters with max(diam) <= Eta * dist is admissible: its block is stored as
+//  U V^T with the rank found by adaptive cross approximation (full pivoting on the
+//  explicit block) to a Frobenius-norm error of tol relative to the block; all other blocks are refined
+//  down to leaves and stored dense; only the upper half of the block tree is kept
+//
+//  Apply() is then y = A x for nrhs columns at once, O(N log N) instead of O(N^2) for
+//  large clusters of sites; Setup() needs the dense matrix once, and switches itself
+//  off (Active() = 0) if compression does not save at least half of the storage
+//
+class HMatrix
+{
+public:
+
+  HMatrix() : N(0), nSiteRows(0), active(0), tol(0) {}
+
+  /// n x n matrix A (row-major, lda = n), uplo as for dsymv (the triangle that is used);
+  /// site[i] is the site of row i (-1: border), pos[3*k] the position of site k
+  void Setup(int n, const double *A, const char *uplo, const int *site, int nsites,
+	     const double *pos, double tol, int verbose);
+  void Clear();
+
+  /// Y = A X, X and Y are column-major with nrhs columns; work is scratch of the caller (thread)
+  void Apply(int nrhs, const double *X, int ldx, double *Y, int ldy, dVec &work) const;
+
+  int Active() const { return active; }
+  double Storage() const;   ///< doubles stored
+
+  enum {LeafSites = 16};
+  static const double Eta;
+
+private:
+
+  struct Cluster
+  {
+    int first, last;      // rows [first, last) in the permuted order
+    int child[2];         // -1 for leaves
+    double lo[3], hi[3];  // bounding box of the sites
+  };
+
+  struct Block
+  {
+    int r0, m;            // rows
+    int c0, n;            // columns
+    int rank;             // -1: dense m x n; else U (m x rank) and V (n x rank)
+    long offset;          // into data, column-major
+  };
+
+  int N;                  // dimension
+  int nSiteRows;          // rows of sites, the border rows follow
+  int active;
+  double tol;             // of the low-rank blocks, relative Frobenius norm
+  iVec perm;              // original row of permuted row k
+  std::vector<Cluster> clusters;
+  std::vector<Block> blocks;
+  dVec data;
+  dVec border;            // N x (N - nSiteRows), column-major: the border rows
+
+  int Bisect(std::vector<int> &sites, int begin, int end, const int *rowstart, const int *rows, const double *pos);
+  void Partition(int s, int t);
+  int Admissible(int s, int t) const;
+  void AddBlock(int s, int t, int lowrank);
+  double Element(const double *A, int lda, int upper, int i, int j) const;
+};
+
+#endif // PISCES_HMATRIX_H_
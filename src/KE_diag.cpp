@@ -70,7 +70,7 @@ void Tdiag(int ngp, double mu, double x0, double xNp1, double *x, double *ekin,
     for( a = 0; a < ngp; a++){
       int kpoint  = a;
      //  kpoint=-ngp/2+a;
-      if(kpoint >= ngp/2) kpoint= kpoint - ngp; 
+      if(kpoint > ngp/2) kpoint= kpoint - ngp;   // -(N-1)/2 ... N/2, symmetric for odd N
       // k[x]        = dk*kpoint;
       ekin[a]      = pow(DeltaK*kpoint,2)/(2.0*mu);
     // cout<<"igp and kpoint ekin="<<a<<"  "<<kpoint<<"  "<<ekin[a]<<endl;
@@ -78,3 +78,34 @@ void Tdiag(int ngp, double mu, double x0, double xNp1, double *x, double *ekin,
     /************************************/ 
    
 }
+
+
+//////////////////////////////
+//
+//  for the sine transform (DVRType 4)
+//
+//  the sine DVR kinetic energy matrix (sine_dvr) is diagonal in the basis
+//  sin(pi*(a+1)*(j+1)/(N+1)), which is what FFTW's RODFT00 (DST-I) uses,
+//  so T = S diag(ekin) S / (2(N+1)) holds exactly (no wrap-around)
+//
+//  input:
+//    ngp     : no of grid points
+//    mu      : mass of the particle
+//    x0      : left wall
+//    xN+1    : right wall
+//    verbose : output level 
+//
+//  output:
+//    ekin    : particle-in-a-box energies (pi*(a+1)/L)^2 / (2*mu), a = 0 ... ngp-1
+//
+void Tsine(int ngp, double mu, double x0, double xNp1, double *ekin, int verbose)
+{
+  double L = xNp1 - x0;
+  for (int a = 0; a < ngp; ++a)
+    ekin[a] = 0.5 * SQR(PI * (double)(a+1) / L) / mu;
+  if (verbose > 2) {
+    printf("\nDST-I kinetic energy spectrum\n");
+    for (int a = 0; a < ngp; ++a)
+      printf("%3i  %15.7f\n", a+1, ekin[a]);
+  }
+}
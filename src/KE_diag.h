@@ -1 +1,2 @@
 void Tdiag(int ngp, double mu, double x0, double xNp1, double *x, double *ekin, int ldt, int verbose);
+void Tsine(int ngp, double mu, double x0, double xNp1, double *ekin, int verbose);
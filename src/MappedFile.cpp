@@ -0,0 +1,36 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "MappedFile.h"
+
+
+int MappedFile::Open(const char *fname)
+{
+  Close();
+  int fd = open(fname, O_RDONLY);
+  if (fd < 0)
+    return -1;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return -1;
+  }
+  void *p = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);  // the mapping stays valid
+  if (p == MAP_FAILED)
+    return -1;
+  madvise(p, st.st_size, MADV_SEQUENTIAL);
+  ptr = (const char*)p;
+  len = st.st_size;
+  return 0;
+}
+
+void MappedFile::Close()
+{
+  if (ptr)
+    munmap((void*)ptr, len);
+  ptr = 0;
+  len = 0;
+}
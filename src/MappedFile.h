@@ -0,0 +1,32 @@
+#ifndef PISCES_MAPPEDFILE_H_
+#define PISCES_MAPPEDFILE_H_
+
+#include <cstddef>
+
+//
+//  read-only memory map of a whole file
+//  the pages are shared with the page cache, so all MPI ranks on a node
+//  reading the same file share one copy
+//
+class MappedFile
+{
+public:
+  MappedFile() : ptr(0), len(0) {}
+  ~MappedFile() { Close(); }
+
+  /// returns 0 on success, -1 if the file cannot be opened or mapped
+  int Open(const char *fname);
+  void Close();
+
+  const char* Data() const { return ptr; }
+  size_t Size() const { return len; }
+
+private:
+  MappedFile(const MappedFile&);
+  MappedFile& operator=(const MappedFile&);
+
+  const char *ptr;
+  size_t len;
+};
+
+#endif // PISCES_MAPPEDFILE_H_
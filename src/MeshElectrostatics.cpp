@@ -0,0 +1,258 @@
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+#include <omp.h>
+
+#include "fftw3.h"
+#include "timer.hpp"
+#include "MeshElectrostatics.h"
+
+using namespace std;
+
+
+//
+//  n[3] grid points starting at x0[3] with spacing h[3]
+//  sigma is the width of the smooth long-range part in Bohr;
+//  it should be at least 3 grid spacings for the interpolation to be accurate
+//
+MeshElectrostatics::MeshElectrostatics()
+  : sigma(0)
+{
+  for (int k = 0; k < 3; ++k) {
+    n[k] = L[k] = 0;
+    x0[k] = h[k] = 0;
+  }
+}
+
+MeshElectrostatics::MeshElectrostatics(const int *npts, const double *xstart, const double *step, double s)
+  : sigma(0)
+{
+  for (int k = 0; k < 3; ++k)
+    h[k] = L[k] = 0;
+  SetGrid(npts, xstart, step, s);
+}
+
+//
+//  a new spacing or sigma invalidates the transformed kernel
+//
+void MeshElectrostatics::SetGrid(const int *npts, const double *xstart, const double *step, double s)
+{
+  if (s != sigma || step[0] != h[0] || step[1] != h[1] || step[2] != h[2])
+    L[0] = 0;
+  sigma = s;
+  for (int k = 0; k < 3; ++k) {
+    n[k] = npts[k];
+    x0[k] = xstart[k];
+    h[k] = step[k];
+  }
+}
+
+
+//
+//  K(R) = erf(R/sigma)/R
+//
+double MeshElectrostatics::Kernel(double R)
+{
+  if (R < 1e-8 * sigma)
+    return 2.0 / (sigma * sqrt(M_PI));
+  return erf(R / sigma) / R;
+}
+
+//
+//  K3(R) = -K'(R)/R = (erf(x) - 2x/sqrt(pi) exp(-x^2)) / R^3   with x = R/sigma
+//
+double MeshElectrostatics::Kernel3(double R)
+{
+  double x = R / sigma;
+  if (x < 1e-3)
+    return 4.0 / (3.0 * sqrt(M_PI) * sigma * sigma * sigma) * (1.0 - 0.6 * x * x);
+  return (erf(x) - 2.0 * x / sqrt(M_PI) * exp(-x * x)) / (R * R * R);
+}
+
+//
+//  distance beyond which 1/R - K(R) < tol/R
+//
+double MeshElectrostatics::Cutoff(double tol)
+{
+  double x = 0;
+  while (erfc(x) > tol)
+    x += 0.05;
+  return x * sigma;
+}
+
+
+//
+//  Lagrange weights w[j] and their derivatives dw[j] for the NORDER nodes 0..NORDER-1 at t
+//
+void MeshElectrostatics::Weights(double t, double *w, double *dw)
+{
+  for (int j = 0; j < NORDER; ++j) {
+    double wj = 1.0;
+    double dwj = 0.0;
+    for (int k = 0; k < NORDER; ++k) {
+      if (k == j) continue;
+      wj *= (t - k) / (j - k);
+      double p = 1.0 / (j - k);
+      for (int l = 0; l < NORDER; ++l)
+	if (l != j && l != k)
+	  p *= (t - l) / (j - l);
+      dwj += p;
+    }
+    w[j] = wj;
+    dw[j] = dwj;
+  }
+}
+
+//
+//  smallest even length >= m with only factors 2, 3, 5, 7
+//
+int MeshElectrostatics::GoodFFTSize(int m)
+{
+  for (int l = m + (m % 2); ; l += 2) {
+    int r = l;
+    while (r % 2 == 0) r /= 2;
+    while (r % 3 == 0) r /= 3;
+    while (r % 5 == 0) r /= 5;
+    while (r % 7 == 0) r /= 7;
+    if (r == 1)
+      return l;
+  }
+}
+
+
+//
+//  vq[igp] += long-range potential of the nq charges q at rq[3*i]
+//  vd[igp] += long-range potential of the nd dipoles d[3*i] at rd[3*i]
+//
+//  with vd = 0 (or vd = vq) the sum is spread and convolved at once, 
+//  otherwise the charges and the dipoles are two convolutions with the same kernel
+//
+void MeshElectrostatics::AddPotential(int nq, const double *rq, const double *q,
+				      int nd, const double *rd, const double *d, double *vq, double *vd)
+{
+  progress_timer tmr("MeshElectrostatics", 0);
+
+  const int half = NORDER / 2;
+
+  // mesh nodes needed for the grid and the interpolation stencils of all sites
+  int lo[3], hi[3];
+  for (int k = 0; k < 3; ++k) {
+    lo[k] = 0;
+    hi[k] = n[k] - 1;
+  }
+  for (int i = 0; i < nq + nd; ++i) {
+    const double *s = (i < nq) ? &rq[3*i] : &rd[3*(i-nq)];
+    for (int k = 0; k < 3; ++k) {
+      int base = (int)floor((s[k] - x0[k]) / h[k]) - (half - 1);
+      lo[k] = min(lo[k], base);
+      hi[k] = max(hi[k], base + NORDER - 1);
+    }
+  }
+
+  // zero padding to at least 2M-1 makes the cyclic convolution a linear one
+  int Lnew[3];
+  for (int k = 0; k < 3; ++k)
+    Lnew[k] = GoodFFTSize(2 * (hi[k] - lo[k] + 1) - 1);
+  int newkernel = (Lnew[0] != L[0] || Lnew[1] != L[1] || Lnew[2] != L[2]);
+  for (int k = 0; k < 3; ++k)
+    L[k] = Lnew[k];
+  size_t nreal = (size_t)L[0] * L[1] * L[2];
+  size_t ncplx = (size_t)(L[0]/2 + 1) * L[1] * L[2];
+
+  double *buf = fftw_alloc_real(nreal);
+  fftw_complex *C = fftw_alloc_complex(ncplx);
+  int dims[3] = {L[2], L[1], L[0]};  // FFTW is row-major, x runs fastest
+  // the 3D transforms are threaded by FFTW (VectorFFT plans its 1D passes single-threaded)
+  fftw_init_threads();
+  fftw_plan_with_nthreads(omp_get_max_threads());
+  fftw_plan forward  = fftw_plan_dft_r2c(3, dims, buf, C, FFTW_ESTIMATE);
+  fftw_plan backward = fftw_plan_dft_c2r(3, dims, C, buf, FFTW_ESTIMATE);
+
+  // the kernel; symmetric in each direction, so its transform is real
+  if (newkernel) {
+#pragma omp parallel for
+    for (int c = 0; c < L[2]; ++c) {
+      double dz = min(c, L[2] - c) * h[2];
+      for (int b = 0; b < L[1]; ++b) {
+	double dy = min(b, L[1] - b) * h[1];
+	double *row = &buf[(size_t)L[0] * (b + (size_t)L[1] * c)];
+	for (int a = 0; a < L[0]; ++a) {
+	  double dx = min(a, L[0] - a) * h[0];
+	  row[a] = Kernel(sqrt(dx*dx + dy*dy + dz*dz));
+	}
+      }
+    }
+    fftw_execute(forward);
+    ghat.resize(ncplx);
+#pragma omp parallel for
+    for (size_t i = 0; i < ncplx; ++i)
+      ghat[i] = C[i][0] / nreal;
+  }
+
+  // one pass for the sum, or one for the charges and one for the dipoles
+  int split = (vd != 0 && vd != vq);
+  for (int pass = 0; pass < 1 + split; ++pass) {
+    int ifirst = (split && pass == 1) ? nq : 0;
+    int iend = (split && pass == 0) ? nq : nq + nd;
+    double *v = (split && pass == 1) ? vd : vq;
+    if (ifirst == iend)
+      continue;
+
+    // spread charges and dipoles onto the mesh
+#pragma omp parallel for
+    for (size_t i = 0; i < nreal; ++i)
+      buf[i] = 0.0;
+    for (int i = ifirst; i < iend; ++i) {
+      const double *s = (i < nq) ? &rq[3*i] : &rd[3*(i-nq)];
+      int base[3];
+      double w[3][NORDER], dw[3][NORDER];
+      for (int k = 0; k < 3; ++k) {
+	double t = (s[k] - x0[k]) / h[k];
+	base[k] = (int)floor(t) - (half - 1);
+	Weights(t - base[k], w[k], dw[k]);
+	for (int j = 0; j < NORDER; ++j)
+	  dw[k][j] /= h[k];
+      }
+      for (int c = 0; c < NORDER; ++c) {
+	for (int b = 0; b < NORDER; ++b) {
+	  double *row = &buf[(base[0] - lo[0]) + (size_t)L[0] * ((base[1] - lo[1] + b) + (size_t)L[1] * (base[2] - lo[2] + c))];
+	  for (int a = 0; a < NORDER; ++a) {
+	    if (i < nq)
+	      row[a] += q[i] * w[0][a] * w[1][b] * w[2][c];
+	    else {
+	      const double *mu = &d[3*(i-nq)];
+	      row[a] += mu[0] * dw[0][a] * w[1][b] * w[2][c]
+		      + mu[1] * w[0][a] * dw[1][b] * w[2][c]
+		      + mu[2] * w[0][a] * w[1][b] * dw[2][c];
+	    }
+	  }
+	}
+      }
+    }
+
+    // convolution
+    fftw_execute(forward);
+#pragma omp parallel for
+    for (size_t i = 0; i < ncplx; ++i) {
+      C[i][0] *= ghat[i];
+      C[i][1] *= ghat[i];
+    }
+    fftw_execute(backward);
+
+    // the electron has charge -1
+#pragma omp parallel for
+    for (int k = 0; k < n[2]; ++k)
+      for (int j = 0; j < n[1]; ++j) {
+	const double *row = &buf[-lo[0] + (size_t)L[0] * ((j - lo[1]) + (size_t)L[1] * (k - lo[2]))];
+	double *vrow = &v[(size_t)n[0] * (j + (size_t)n[1] * k)];
+	for (int i = 0; i < n[0]; ++i)
+	  vrow[i] -= row[i];
+      }
+  }
+
+  fftw_destroy_plan(forward);
+  fftw_destroy_plan(backward);
+  fftw_free(C);
+  fftw_free(buf);
+}
@@ -0,0 +1,57 @@
+#ifndef PISCES_MESHELECTROSTATICS_H_
+#define PISCES_MESHELECTROSTATICS_H_
+
+#include "vecdefs.h"
+
+//
+//  long-range part of the potential of point charges and point dipoles
+//  on a whole equally spaced grid (x runs fastest):
+//
+//    v(r) = - sum_i q_i K(|r-s_i|)  - sum_i (d_i.R_i) K3(|r-s_i|)      R_i = r - s_i
+//
+//    K(R) = erf(R/sigma)/R     K3(R) = -K'(R)/R      (smooth versions of 1/R and 1/R^3)
+//
+//  charges and dipoles are spread onto a mesh aligned with the grid using Lagrange
+//  interpolation weights (and their derivatives for dipoles), the mesh is convolved
+//  with K using a zero-padded (aperiodic) FFT, so the cost is O(M log M) for M mesh
+//  points rather than O(ngp * nSites)
+//
+//  the short-range remainder, damped potential minus K, is left to the caller
+//
+//  the transformed kernel only depends on the padded mesh, the spacing, and sigma,
+//  and is kept for the next call (sites that move a little keep the padded mesh)
+//
+class MeshElectrostatics
+{
+public:
+
+  MeshElectrostatics();
+  MeshElectrostatics(const int *n, const double *x0, const double *h, double sigma);
+
+  void SetGrid(const int *n, const double *x0, const double *h, double sigma);
+
+  /// vq += potential of the charges, vd += potential of the dipoles (vd = 0: both go to vq)
+  void AddPotential(int nq, const double *rq, const double *q,
+		    int nd, const double *rd, const double *d, double *vq, double *vd = 0);
+
+  double Kernel(double R);
+  double Kernel3(double R);
+  double Cutoff(double tol);
+
+private:
+
+  enum {NORDER = 8};  // interpolation points per dimension
+
+  int n[3];          // grid points
+  double x0[3];      // first grid point
+  double h[3];       // spacing
+  double sigma;      // Gaussian width of the long-range part
+
+  int L[3];          // padded mesh of ghat
+  dVec ghat;         // transformed kernel (real), divided by the mesh size
+
+  void Weights(double t, double *w, double *dw);
+  static int GoodFFTSize(int n);
+};
+
+#endif // PISCES_MESHELECTROSTATICS_H_
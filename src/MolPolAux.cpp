@@ -13,6 +13,7 @@ using namespace std;
 
 #include "vecdefs.h"
 #include "lapackblas.h"
+#include "PairTensors.h"
 
 //
 //  this is for setting up a molecule with interacting atomic polarizability
@@ -95,7 +96,7 @@ void ComputeInvA(int nSites, const double *R, const double *alpha, double aThole
 ///           aThole        : Thole's damping parameter
 ///   output: A       
 ///
-///   calls: CalcDDTensor() 
+///   calls: TholePolarizationMatrix() (PairTensors.cpp), the tensor of CalcDDTensor() 
 ///
 void BuildPolarizationMatrix(int nSites, const double *R, const double *alpha, double aThole, double *A)
 {
@@ -103,65 +104,16 @@ void BuildPolarizationMatrix(int nSites, const double *R, const double *alpha, d
   int n = nSites;
   int n3 = 3*n; // dimension of super-matrix A and leading dimension of any block B
 
-
-  for (int k = 0; k < n3*n3; ++k)
-    A[k] = 0.0;
-
-  // super-diagonal: (alpha)^-1 
-  for (int i = 0; i < n; ++i) {
-    double *B = A + n3*3*i + 3*i;  // pointer to current 3x3 block 
-    B[0] = B[n3+1] = B[2*n3+2] = 1.0 / alpha[i]; 
-    B[1] = B[2] = B[n3+0] = B[n3+2] = B[2*n3+0] = B[2*n3+1] = 0.0;
-  }
-
-  // diagonal blocks: Tij
-  double rij[3];
-  double T[9];
-
   cout<<"nSites: "<<nSites<<endl;
 
-  for (int i = 0; i < n; ++i) {
-    for (int j = i+1; j < n; ++j) {
-      double *B  = A + n3*3*j + 3*i;  // pointer to current 3x3 block (ldb = n)
-      double *Bt = A + n3*3*i + 3*j;  // and to the symmetry-related block
-      rij[0] = R[3*i+0] - R[3*j+0];
-      rij[1] = R[3*i+1] - R[3*j+1];
-      rij[2] = R[3*i+2] - R[3*j+2];
-      CalcDDTensor(T, rij, alpha[i], alpha[j], aThole);
-      for (int a = 0; a < 3; ++a)
-	for (int b = 0; b < 3; ++b) 
-	  B[a*n3+b] = Bt[a*n3+b] = -T[3*a+b];
-    }
-  }
+  // every element is written: diagonal blocks (alpha)^-1, off-diagonal blocks -Tij
+  TholePolarizationMatrix(n, R, alpha, aThole, A, n3);
 }
 
 
 void BuildTensor(int nSites, const double *R, const double *alpha, double aThole, double *Tensor)
 {
-
-  int n = nSites;
-  int n3 = 3*n; // dimension of super-matrix A and leading dimension of any block B
-
-  double rij[3];
-  double T[9];
-  int iter=0;
-
-  for (int i = 0; i < n; ++i) {
-    for (int j = 0; j < n; ++j) {
-       if (j == i)
-         continue;
-
-      rij[0] = R[3*i+0] - R[3*j+0];
-      rij[1] = R[3*i+1] - R[3*j+1];
-      rij[2] = R[3*i+2] - R[3*j+2];
-      CalcDDTensor(T, rij, alpha[i], alpha[j], aThole);
-      for (int a = 0; a < 3; ++a)
-	for (int b = 0; b < 3; ++b) {
-            Tensor[9*iter+3*a+b]=T[3*a+b];
-        }
-      iter++;
-    }
-  }
+  TholeTensorList(nSites, R, alpha, aThole, Tensor);
 }
 
 
@@ -5,6 +5,7 @@
 #include <vector>
 
 #include <mpi.h>
+#include "Communicator.h"
 
 #include <iomanip>
 #include <fstream>
@@ -27,7 +28,7 @@ void Molecule::SetupDPPWater(const double *WaterCoor)
 {
 
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
   Type = 1;
   nSites = 4;
   Tag = new char[nSites];
@@ -89,6 +89,7 @@ void NaCl_sp(TSIN Input)
   int PotFlag = Input.GetInt("ElectronPotential", "Potential", 101);
   int PotVerb = Input.GetInt("ElectronPotential", "Verbose", 1);
   Vel.SetVerbose(PotVerb);
+  Vel.SetMesh(Input.GetDouble("ElectronPotential", "MeshSigma", 0.0));
   switch (PotFlag)
     {
     case 101:
@@ -275,6 +276,7 @@ void Potential::SetupBloomfield(int nr, const double *r, int nq, const double *q
 
   SetSites(nr, r);
   SetCharges(nq, q, iq);
+  SetupRadialTables();
 
   SetupMinMax();
   cout << "Leaving SetupBl\n";
@@ -284,6 +286,8 @@ void Potential::SetupBloomfield(int nr, const double *r, int nq, const double *q
 
 double Potential::EvaluateBloomfield(const double *x)
 {
+  PotentialWorkspace &w = Work();
+  dVec &R = w.R, &R2 = w.R2;
   // compute a list of distances of all sites to the point r=(x,y,z)
   //for (int i = 0; i < nSites; ++i) {
   //  Rx[i] = x[0] - Site[3*i+0];
@@ -303,7 +307,11 @@ double Potential::EvaluateBloomfield(const double *x)
       damp = CationDamping;
     else
       damp = AnionDamping;
-    Vel += -Charge[i] * erf(damp*R[iqs]) / R[iqs];
+    const RadialTable &f = (Charge[i] > 0) ? CationTable : AnionTable;
+    if (f.Is(RadialTable::ErfCoulomb, damp))
+      Vel += -Charge[i] * f.Coulomb(R2[iqs], 1.0 / R[iqs]);
+    else
+      Vel += -Charge[i] * erf(damp*R[iqs]) / R[iqs];
   }
 
 
@@ -0,0 +1,272 @@
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+
+#include "vecdefs.h"
+#include "constants.h"
+#include "PairTensors.h"
+
+using namespace std;
+
+namespace {
+
+  enum {TILE = 32};   // sites per tile
+
+  //
+  //  SoA copy of the positions R[3*n], and the list of tile pairs I <= J
+  //
+  struct PairTiles
+  {
+    dVec x, y, z;
+    iVec first, second;
+
+    PairTiles(int n, const double *R) : x(n), y(n), z(n)
+    {
+      for (int i = 0; i < n; ++i) {
+	x[i] = R[3*i+0];
+	y[i] = R[3*i+1];
+	z[i] = R[3*i+2];
+      }
+      int nt = (n + TILE - 1) / TILE;
+      for (int I = 0; I < nt; ++I)
+	for (int J = I; J < nt; ++J) {
+	  first.push_back(I);
+	  second.push_back(J);
+	}
+    }
+
+    int Pairs() const { return int(first.size()); }
+
+    /// the sites of tile pair t: i in [i0,i1), for each i the partners j in [max(j0,i+1),j1)
+    void Range(int t, int n, int &i0, int &i1, int &j0, int &j1) const
+    {
+      i0 = TILE * first[t];   i1 = min(n, i0 + TILE);
+      j0 = TILE * second[t];  j1 = min(n, j0 + TILE);
+    }
+  };
+
+}
+
+
+//////////////////////////////////////////////////////////////
+//
+//  A = alpha^-1 - T,  T_ij = f5 3 r r^T / r^5 - f3 / r^3
+//  with Thole's f3 = 1 - exp(-u), f5 = 1 - (1+u) exp(-u), u = aThole r^3 / sqrt(alpha_i alpha_j)
+//
+void TholePolarizationMatrix(int n, const double *R, const double *alpha, double aThole, double *A, int lda)
+{
+  PairTiles tiles(n, R);
+  const double *x = &tiles.x[0], *y = &tiles.y[0], *z = &tiles.z[0];
+
+#pragma omp parallel
+  {
+    double dx[TILE], dy[TILE], dz[TILE], f1[TILE], f2[TILE];
+
+#pragma omp for schedule(dynamic)
+    for (int t = 0; t < tiles.Pairs(); ++t) {
+      int i0, i1, j0, j1;
+      tiles.Range(t, n, i0, i1, j0, j1);
+      for (int i = i0; i < i1; ++i) {
+	double *Bii = A + long(lda)*3*i + 3*i;
+	if (j0 == i0) {
+	  // diagonal block: alpha^-1
+	  for (int a = 0; a < 3; ++a)
+	    for (int b = 0; b < 3; ++b)
+	      Bii[a*lda+b] = (a == b) ? 1.0 / alpha[i] : 0.0;
+	}
+	int jb = max(j0, i+1);
+	int m = j1 - jb;
+	if (m <= 0)
+	  continue;
+#pragma omp simd
+	for (int k = 0; k < m; ++k) {
+	  int j = jb + k;
+	  double rx = x[i] - x[j], ry = y[i] - y[j], rz = z[i] - z[j];
+	  double r2 = rx*rx + ry*ry + rz*rz;
+	  double r = sqrt(r2);
+	  double r3 = r * r2;
+	  double r5 = r2 * r3;
+	  double u = aThole * r3 / sqrt(alpha[i] * alpha[j]);
+	  double e = exp(-u);
+	  dx[k] = rx;  dy[k] = ry;  dz[k] = rz;
+	  f1[k] = (1 - (1+u) * e) * 3.0 / r5;
+	  f2[k] = (1 - e) / r3;
+	}
+	for (int k = 0; k < m; ++k) {
+	  int j = jb + k;
+	  double *B  = A + long(lda)*3*j + 3*i;
+	  double *Bt = A + long(lda)*3*i + 3*j;
+	  double r[3] = {dx[k], dy[k], dz[k]};
+	  for (int a = 0; a < 3; ++a)
+	    for (int b = 0; b < 3; ++b)
+	      B[a*lda+b] = Bt[a*lda+b] = -(f1[k] * r[a] * r[b] - ((a == b) ? f2[k] : 0.0));
+	}
+      }
+    }
+  }
+}
+
+
+//////////////////////////////////////////////////////////////
+//
+//  T_ij for i != j in the order i*(n-1) + (j < i ? j : j-1)
+//
+void TholeTensorList(int n, const double *R, const double *alpha, double aThole, double *T)
+{
+  PairTiles tiles(n, R);
+  const double *x = &tiles.x[0], *y = &tiles.y[0], *z = &tiles.z[0];
+
+#pragma omp parallel
+  {
+    double dx[TILE], dy[TILE], dz[TILE], f1[TILE], f2[TILE];
+
+#pragma omp for schedule(dynamic)
+    for (int t = 0; t < tiles.Pairs(); ++t) {
+      int i0, i1, j0, j1;
+      tiles.Range(t, n, i0, i1, j0, j1);
+      for (int i = i0; i < i1; ++i) {
+	int jb = max(j0, i+1);
+	int m = j1 - jb;
+	if (m <= 0)
+	  continue;
+#pragma omp simd
+	for (int k = 0; k < m; ++k) {
+	  int j = jb + k;
+	  double rx = x[i] - x[j], ry = y[i] - y[j], rz = z[i] - z[j];
+	  double r2 = rx*rx + ry*ry + rz*rz;
+	  double r = sqrt(r2);
+	  double r3 = r * r2;
+	  double r5 = r2 * r3;
+	  double u = aThole * r3 / sqrt(alpha[i] * alpha[j]);
+	  double e = exp(-u);
+	  dx[k] = rx;  dy[k] = ry;  dz[k] = rz;
+	  f1[k] = (1 - (1+u) * e) * 3.0 / r5;
+	  f2[k] = (1 - e) / r3;
+	}
+	for (int k = 0; k < m; ++k) {
+	  int j = jb + k;
+	  double *Tij = T + 9 * (long(i)*(n-1) + j - 1);
+	  double *Tji = T + 9 * (long(j)*(n-1) + i);
+	  double r[3] = {dx[k], dy[k], dz[k]};
+	  for (int a = 0; a < 3; ++a)
+	    for (int b = 0; b < 3; ++b)
+	      Tij[3*a+b] = Tji[3*a+b] = f1[k] * r[a] * r[b] - ((a == b) ? f2[k] : 0.0);
+	}
+      }
+    }
+  }
+}
+
+
+//////////////////////////////////////////////////////////////
+//
+//  charge-charge block of Gaussian charges
+//
+void GaussianChargeBlock(int n, const double *R, const double *Rq, double *A, int lda)
+{
+  PairTiles tiles(n, R);
+  const double *x = &tiles.x[0], *y = &tiles.y[0], *z = &tiles.z[0];
+
+#pragma omp parallel
+  {
+    double qq[TILE];
+
+#pragma omp for schedule(dynamic)
+    for (int t = 0; t < tiles.Pairs(); ++t) {
+      int i0, i1, j0, j1;
+      tiles.Range(t, n, i0, i1, j0, j1);
+      for (int i = i0; i < i1; ++i) {
+	if (j0 == i0)
+	  A[long(lda)*i+i] = sqrt(2.0/PI) / Rq[i];
+	int jb = max(j0, i+1);
+	int m = j1 - jb;
+	if (m <= 0)
+	  continue;
+#pragma omp simd
+	for (int k = 0; k < m; ++k) {
+	  int j = jb + k;
+	  double rx = x[i] - x[j], ry = y[i] - y[j], rz = z[i] - z[j];
+	  double r = sqrt(rx*rx + ry*ry + rz*rz);
+	  double Rqq = sqrt(Rq[i]*Rq[i] + Rq[j]*Rq[j]);
+	  qq[k] = erf(r/Rqq) / r;
+	}
+	for (int k = 0; k < m; ++k) {
+	  int j = jb + k;
+	  A[long(lda)*i+j] = A[long(lda)*j+i] = qq[k];
+	}
+      }
+    }
+  }
+}
+
+
+//////////////////////////////////////////////////////////////
+//
+//  charge-dipole and dipole-dipole blocks with Gaussian widths
+//
+//    w = Rij / Rpq,   g(w) = erf(w) - 2 w exp(-w^2) / sqrt(pi)
+//
+//    q_i - p_j:   -r_a g / r^3                       Rpq = sqrt(Rqd_i^2 + Rp_j^2)
+//    p_i - p_j:   -((3 r_a r_b - delta_ab r^2) g / r^5 - r_a r_b 4 exp(-w^2) / (sqrt(pi) Rpp^3 r^2))
+//
+void GaussianDipoleBlocks(int n, const double *R, const double *Rqd, const double *Rp,
+			  const double *invalpha, double *A, int lda)
+{
+  PairTiles tiles(n, R);
+  const double *x = &tiles.x[0], *y = &tiles.y[0], *z = &tiles.z[0];
+  const double sqpi = sqrt(PI);
+  long ld = lda;
+
+#pragma omp parallel
+  {
+    double dx[TILE], dy[TILE], dz[TILE], r2s[TILE], f1[TILE], f2[TILE], qpij[TILE], qpji[TILE];
+
+#pragma omp for schedule(dynamic)
+    for (int t = 0; t < tiles.Pairs(); ++t) {
+      int i0, i1, j0, j1;
+      tiles.Range(t, n, i0, i1, j0, j1);
+      for (int i = i0; i < i1; ++i) {
+	if (j0 == i0)
+	  for (int a = 0; a < 3; ++a)
+	    A[ld*(n+3*i+a) + n+3*i+a] = invalpha[3*i+a];
+	int jb = max(j0, i+1);
+	int m = j1 - jb;
+	if (m <= 0)
+	  continue;
+#pragma omp simd
+	for (int k = 0; k < m; ++k) {
+	  int j = jb + k;
+	  double rx = x[i] - x[j], ry = y[i] - y[j], rz = z[i] - z[j];
+	  double r2 = rx*rx + ry*ry + rz*rz;
+	  double r = sqrt(r2);
+	  double r3 = r * r2;
+	  double Rpp = sqrt(Rp[i]*Rp[i] + Rp[j]*Rp[j]);
+	  double Rij = sqrt(Rqd[i]*Rqd[i] + Rp[j]*Rp[j]);
+	  double Rji = sqrt(Rqd[j]*Rqd[j] + Rp[i]*Rp[i]);
+	  double epp = exp(-(r/Rpp)*(r/Rpp));
+	  double eij = exp(-(r/Rij)*(r/Rij));
+	  double eji = exp(-(r/Rji)*(r/Rji));
+	  dx[k] = rx;  dy[k] = ry;  dz[k] = rz;  r2s[k] = r2;
+	  f1[k] = (erf(r/Rpp) - 2.0*r*epp/(sqpi*Rpp)) / (r3*r2);
+	  f2[k] = 4.0*epp / (sqpi*Rpp*Rpp*Rpp*r2);
+	  qpij[k] = (erf(r/Rij) - 2.0*r*eij/(sqpi*Rij)) / r3;
+	  qpji[k] = (erf(r/Rji) - 2.0*r*eji/(sqpi*Rji)) / r3;
+	}
+	for (int k = 0; k < m; ++k) {
+	  int j = jb + k;
+	  double r[3] = {dx[k], dy[k], dz[k]};
+	  for (int a = 0; a < 3; ++a) {
+	    // q_i - p_j and q_j - p_i, r_ji = -r_ij
+	    A[ld*i + n+3*j+a] = A[ld*(n+3*j+a) + i] = -r[a] * qpij[k];
+	    A[ld*j + n+3*i+a] = A[ld*(n+3*i+a) + j] =  r[a] * qpji[k];
+	    // p_i - p_j
+	    double *Bij = A + ld*(n+3*i+a) + n+3*j;
+	    double *Bji = A + ld*(n+3*j+a) + n+3*i;
+	    for (int b = 0; b < 3; ++b)
+	      Bij[b] = Bji[b] = -((3.0*r[a]*r[b] - ((a == b) ? r2s[k] : 0.0)) * f1[k] - r[a]*r[b]*f2[k]);
+	  }
+	}
+      }
+    }
+  }
+}
@@ -0,0 +1,33 @@
+#ifndef PISCES_PAIRTENSORS_H_
+#define PISCES_PAIRTENSORS_H_
+
+//
+//  assembly of the pair-interaction super-matrices of the polarization models
+//
+//  all matrices are symmetric and are written as full row-major arrays with leading
+//  dimension lda, both triangles, so they go to dsytrf/dgetrf (or dsymv) as they are
+//
+//  the pairs are worked on in tiles of sites: the tile pairs (I <= J) are distributed over
+//  the OpenMP threads, within a tile the positions are read from SoA copies and the
+//  damping functions of one row of pairs are evaluated in a simd loop, then both the
+//  (i,j) and the (j,i) blocks are written
+//
+
+/// A = alpha^-1 - T (3n x 3n) with Thole-damped dipole-dipole tensors (see CalcDDTensor)
+void TholePolarizationMatrix(int n, const double *R, const double *alpha, double aThole, double *A, int lda);
+
+/// the Thole-damped T_ij of all ordered pairs i != j, 9 numbers each, j running fastest (BuildTensor)
+void TholeTensorList(int n, const double *R, const double *alpha, double aThole, double *T);
+
+/// Gaussian charges, width Rq[i]: A(i,j) = erf(Rij/Rqq)/Rij, A(i,i) = sqrt(2/pi)/Rq[i]
+void GaussianChargeBlock(int n, const double *R, const double *Rq, double *A, int lda);
+
+/// charge-dipole and dipole-dipole blocks of the charge-dipole model (ChargeDipPol.cpp)
+///
+///   rows/columns 0..n-1 are the charges, n+3i+a the dipoles;
+///   Rqd[i] is the charge width used with the dipoles, Rp[i] the dipole width,
+///   invalpha[3*i+a] the diagonal of the dipole blocks; the charge-charge block is left alone
+void GaussianDipoleBlocks(int n, const double *R, const double *Rqd, const double *Rp,
+			  const double *invalpha, double *A, int lda);
+
+#endif // PISCES_PAIRTENSORS_H_
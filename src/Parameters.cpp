@@ -23,6 +23,8 @@ void Parameters::Print()
     case 1   : if(rank==0)cout << " (single point)\n"; break;
     case 2   : if(rank==0)cout << " (optimization)\n"; break;
     case 3   : if(rank==0)cout << " (MDsimulation)\n"; break;
+    case 4   : if(rank==0)cout << " (batch of single points)\n"; break;
+    case 5   : if(rank==0)cout << " (parallel tempering MC)\n"; break;
     case 42  : if(rank==0)cout << " (potfit for electron model potentials)\n"; break;
     case 60  : if(rank==0)cout << " (plot polarization potential)\n";break;  //vkv
     case 101 : if(rank==0)cout << " (NaCl cluster)\n"; break;
@@ -39,9 +41,13 @@ void Parameters::Print()
   if (runtype == 1) {
     if (CubeFile > 0)
     if(rank==0)cout << "  Cube files will be created for all states\n";
+    if (CubeFile > 1)
+      if(rank==0)cout << "  with binary siblings (.gcube.bin)\n";
     if (WfCuts > 0)
       if(rank==0)cout << "  Cuts through the main axis will be created for all states\n";
   }
+  if (Profile > 0)
+    if(rank==0)cout << "  A profile of the run is written to profile.json\n";
 
   // Water model
   if (KTFlag == 1)
@@ -134,6 +140,13 @@ void Parameters::Print()
        default:
          if(rank==0)cout << "GetInputParameters: unknown option for internal-parameters in electron-water potential \n" ; 
       }
+    if (MeshSigma > 0)
+      if(rank==0)cout << "   Particle-mesh electrostatics, MeshSigma = " << MeshSigma << " grid spacings\n";
+    if (DipoleCache > 0)
+      if(rank==0)cout << "   Induced dipoles cached for the gradient (" << ((DipoleCache == 2) ? "float" : "double")
+			<< "), DipoleCacheTol = " << DipoleCacheTol << "\n";
+    if (HMatrixTol > 0)
+      if(rank==0)cout << "   H-matrix products with InvA, HMatrixTol = " << HMatrixTol << "\n";
   }
 
   // GridDef group
@@ -142,6 +155,9 @@ void Parameters::Print()
     case 1:
       if(rank==0)cout << "\n  Harmonic oscillator DVR\n    Freqs [au] = ";
       break;
+    case 4:
+      if(rank==0)cout << "\n  Particle-in-a-box (sine) DVR, T applied with the sine transform\n    Length [Bohr] = ";
+      break;
     default:
       if(rank==0)cout << "\n  Particle-in-a-box (sine) DVR\n    Length [Bohr] = ";
       break;
@@ -183,10 +199,13 @@ void Parameters::Print()
     case 0: if(rank==0)cout << " (read from StartVector.cub)\n"; break;
     case 1: if(rank==0)cout << " (particle-in-a-box-like startvector)\n"; break;
     case 2: if(rank==0)cout << " (use last converged vector if available)\n"; break;
+    case 5: if(rank==0)cout << " (read from the binary checkpoint Checkpoint.chk)\n"; break;
     default:
       if(rank==0)cout << "  GetInput: illegal value for startvector flag \n";
       exit(1);
     }
+  if (Checkpoint > 0)
+    if(rank==0)cout << "    Checkpoint.chk (Checkpoint.rNN.chk for replica NN) is written after each diagonalization" << ((Checkpoint > 1) ? " (with the Lanczos residual)\n" : "\n");
 
   // Optimize group
   if (runtype == 2) {
@@ -195,10 +214,40 @@ void Parameters::Print()
     if(rank==0)cout << "  Optimizer Verbose = " << optverbose << "\n"; 
   }
 
+  // Molecular Dynamics group
+  if (runtype == 3) {
+    if(rank==0)cout << "  \n  Rigid-body Born-Oppenheimer MD (velocity Verlet)\n";
+    if(rank==0)cout << "    nsteps = " << nsteps << ", timestep = " << timestep << " ps\n";
+    if(rank==0)cout << "    initial temperature = " << Temperature << " K\n";
+    if (ASPCOrder >= 0)
+      if(rank==0)cout << "    start vectors extrapolated from " << ASPCOrder+2 << " steps (ASPC)\n";
+    else
+      if(rank==0)cout << "    start vectors are the last wavefunction\n";
+    if(rank==0)cout << "    ptol adapts to an energy drift of " << DriftTol << " Hartree per step\n";
+  }
+
+  // ParallelTempering group
+  if (runtype == 5) {
+    if(rank==0)cout << "  \n  Parallel tempering Monte Carlo\n";
+    if(rank==0)cout << "    nSteps = " << ptSteps << ", exchanges every " << ptExchange << " steps\n";
+    if(rank==0)cout << "    temperatures from " << ptTmin << " to " << ptTmax << " K, "
+		    << ptRanksPerReplica << " rank(s) per replica\n";
+    if(rank==0)cout << "    max. steps: " << ptStepTrans << " Bohr, " << ptStepRot << " degree\n";
+  }
+
+  // Batch group
+  if (runtype == 4) {
+    if(rank==0)cout << "  \n  Batch of single points\n";
+    if(rank==0)cout << "    Trajectory = " << Trajectory << "\n";
+    if(rank==0)cout << "    Output = " << BatchOutput << "\n";
+    if (BatchRanksPerFrame > 0)
+      if(rank==0)cout << "    " << BatchRanksPerFrame << " rank(s) per frame\n";
+  }
+
   // PotFit group
   if (nParaOpt > 0) {
     if(rank==0)cout << "  \n  Fitting the electron's potential to reproduce a EOM-NO\n";
-    if(rank==0)cout << "    The EOM-NO is read from StartVector.cub\n";
+    if(rank==0)cout << "    The EOM-NO is read from " << RefCube << "\n";
     if(rank==0)cout << "    Points are weighted according to the distance to the nearest O atom Rnext\n";
     if(rank==0)cout << "    LowCutOff  = " << LowCutOff << " (of Rnext)\n";
     if(rank==0)cout << "    HighCutOff = " << HighCutOff << " (of Rnext)\n";
@@ -10,6 +10,7 @@ struct Parameters
   int nElectron;
   int CubeFile;
   int WfCuts;
+  int Profile;
 
   // WaterModel group
   int WMverbose;
@@ -19,6 +20,10 @@ struct Parameters
 
   // ElectronPotential group
   int PotVerbose;
+  double MeshSigma;
+  int DipoleCache;        // induced dipoles of the energy kept for the gradient: 0 off, 1 double, 2 float
+  double DipoleCacheTol;  // at points with |psi|^2 above this fraction of its maximum
+  double HMatrixTol;      // H-matrix products with InvA to this accuracy, 0 = dense
   iVec PotFlag;
   double PotPara[32];
 
@@ -37,6 +42,7 @@ struct Parameters
   int maxIter;
   int ptol;
   int istartvec;
+  int Checkpoint;
 
   // Optimize group
   int optverbose;
@@ -45,10 +51,27 @@ struct Parameters
   // Molecular Dynamics group
   int nsteps;
   int RigidBody;
-  double timestep;
+  double timestep;       // ps
+  double Temperature;    // K, initial velocities
+  int ASPCOrder;         // wavefunction extrapolation from ASPCOrder+2 old steps, -1 = none
+  double DriftTol;       // Hartree per step, tightens or relaxes ptol
+
+  // ParallelTempering group: replica-exchange MC, one replica per group of ranks
+  int ptSteps;           // MC steps per replica
+  int ptExchange;        // exchange attempts every ptExchange steps
+  int ptRanksPerReplica;
+  double ptTmin, ptTmax; // K, geometric ladder
+  double ptStepTrans;    // Bohr
+  double ptStepRot;      // degree
+
+  // Batch group: single points for all frames of a trajectory
+  char Trajectory[256];  // multi-frame xyz file (Angstrom, O H H)
+  char BatchOutput[256]; // one line per frame
+  int BatchRanksPerFrame;  // ranks per group, every group works on one frame at a time (0: all)
 
   // potfit 
   //   weights for NO from cube file
+  char RefCube[256];  // cube file with the NO (text or binary)
   double LowCutOff;   // weights R from next O must be bigger than this
   double HighCutOff;  // and smaller than this
   double wexp;        // and will get weighted with R^wexp * sqrt(NO amplitude)
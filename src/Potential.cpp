@@ -3,8 +3,10 @@
 #include <cmath>
 #include <ctime>
 #include <vector>
+#include <algorithm>
 
 #include <mpi.h>
+#include "Communicator.h"
 
 #include <iomanip>
 #include <fstream>
@@ -24,6 +26,7 @@
 #include "Water.h"
 #include "DPP.h"
 #include "Molecule.h"
+#include "MeshElectrostatics.h"
 
 #include "erf.h"
 
@@ -34,6 +37,9 @@
 
 using namespace std;
 
+// relative accuracy of the tabulated radial functions
+static const double RadialTolerance = 1e-10;
+
 //
 //  verbose > 0  : print min and max of all contributions
 //  verbose > 15 : print potential at every grid point
@@ -41,7 +47,7 @@ using namespace std;
 void Potential::SetVerbose(int v)
 {
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 
    verbose = v;
    if(rank==0)cout << "Potential::SetVerbose called with " << v << "\n";
@@ -60,9 +66,10 @@ void Potential::Setup(const iVec& potflaginp, int nSites, const double *Sites,
 		      const double *DmuByDR, const double *PotPara)
 {
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 
   PotFlags = potflaginp;
+  nSetups++;
 
   switch (PotFlags[0])
     {
@@ -115,6 +122,93 @@ double Potential::MinDistCheck(const double *relectron)
 
 
 
+//
+//  one workspace for each thread that may call Evaluate 
+//  called by the constructor and SetSites; call it again (outside of parallel regions)
+//  if the number of OpenMP threads is increased
+//
+void Potential::PrepareWorkspaces()
+{
+#ifdef _OPENMP
+  int nthreads = omp_get_max_threads();
+#else
+  int nthreads = 1;
+#endif
+  if ((int)Workspaces.size() < nthreads)
+    Workspaces.resize(nthreads);
+  for (size_t it = 0; it < Workspaces.size(); ++it) {
+    PotentialWorkspace &w = Workspaces[it];
+    w.Rx.resize(nSites);
+    w.Ry.resize(nSites);
+    w.Rz.resize(nSites);
+    w.R.resize(nSites);
+    w.R2.resize(nSites);
+    w.Rminus3.resize(nSites);
+    w.RVec.resize(nSites/4*3);
+    w.X.resize(nSites);
+    w.Y.resize(nSites);
+    w.Z.resize(nSites);
+    w.ReturnEnergies.resize(5);  // Vpc, Vind, Vrep, Vpol, and Vtotal
+    w.MaxV.resize(nContributions, -std::numeric_limits<double>::max());
+    w.MinV.resize(nContributions, std::numeric_limits<double>::max());
+  }
+}
+
+//
+//  the dipoles induced at the polarizable sites by the most recent Evaluate of this thread
+//  SelfConsistentPolarizability leaves them in the workspace; with DampType 2 they are
+//  the dipoles EvaluateDPPGTOPGradient would compute again for the same point
+//
+//  not with the H-matrix: its dipoles are approximate, while the gradient recomputes 
+//  the exact ones with the dense InvA, so cached and recomputed points would not match
+//
+const double* Potential::InducedDipoles(int *n)
+{
+  *n = 0;
+  if (PotFlags.size() == 0 || PotFlags[0] < 1 || PotFlags[0] > 3 || PolType != 3 || DampType != 2)
+    return 0;
+  if (nMolPol > 0 && MolPol[0].InvAH.Active())
+    return 0;
+  *n = 3*MolPol[0].nAtoms;
+  return Work().mu.data();
+}
+
+//
+//  the workspace of the calling thread
+//
+PotentialWorkspace& Potential::Work()
+{
+#ifdef _OPENMP
+  int it = omp_get_thread_num();
+#else
+  int it = 0;
+#endif
+  if (it >= (int)Workspaces.size()) {
+    cout << "Potential::Work: no workspace for thread " << it << "; call PrepareWorkspaces outside the parallel region\n";
+    exit(1);
+  }
+  return Workspaces[it];
+}
+
+//
+//  distances of all sites to the point r=(x,y,z) into Rx, Ry, Rz, R, R2, and Rminus3
+//
+void Potential::ComputeDistances(const double *r)
+{
+  PotentialWorkspace &w = Work();
+  double *Rx = &w.Rx[0], *Ry = &w.Ry[0], *Rz = &w.Rz[0];
+  double *R = &w.R[0], *R2 = &w.R2[0], *Rminus3 = &w.Rminus3[0];
+  for (int i = 0; i < nSites; ++i) {
+    Rx[i] = r[0] - Site[3*i+0];
+    Ry[i] = r[1] - Site[3*i+1];
+    Rz[i] = r[2] - Site[3*i+2];
+    R2[i] = Rx[i]*Rx[i] + Ry[i]*Ry[i] + Rz[i]*Rz[i];
+    R[i] = sqrt(R2[i]);
+    Rminus3[i] = 1.0 / (R2[i] * R[i]);
+  }
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 //  this function evaluates the potential that has been setup most recently
@@ -129,21 +223,11 @@ double Potential::Evaluate(const double *relectron)
 {
   
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 
   // compute a list of distances of all sites to the point r=(x,y,z)
   // this is identical for all potentials
-  for (int i = 0; i < nSites; ++i) {
-    Rx[i] = relectron[0] - Site[3*i+0];
-    Ry[i] = relectron[1] - Site[3*i+1];
-    Rz[i] = relectron[2] - Site[3*i+2];
-    R2[i] = Rx[i]*Rx[i] + Ry[i]*Ry[i] + Rz[i]*Rz[i];
-    R[i] = sqrt(R2[i]);
-  //  cout<<"relectron= "<<relectron[0]<<" "<<relectron[1]<<" "<<relectron[2]<<endl;
-  //  cout<<"Site ="<<Site[3*i+0]<<" "<<Site[3*i+1]<<" "<<Site[3*i+2]<<endl;
-  //  cout<<"R["<<i<<"]="<<Rx[i]<<" "<<Ry[i]<<" "<<Rz[i]<<" "<<R[i]<<endl;
-    Rminus3[i] = 1.0 / (R2[i] * R[i]);
-  }
+  ComputeDistances(relectron);
   
  // cout<<"--------------------------------------"<<endl;
 //  cout<<"relectron : "<<relectron[0]<<" "<< relectron[1]<<" "<<relectron[2]<< endl;
@@ -181,6 +265,41 @@ double Potential::Evaluate(const double *relectron)
   return 0;
 }
 
+//
+//  number of points per call of the batched kernel; 0 if the potential 
+//  has none and EvaluateBatch falls back to Evaluate point by point
+//  (with verbose output everything goes through Evaluate)
+//
+int Potential::BatchTile()
+{
+  if (verbose > 0 || PotFlags.size() == 0) return 0;
+  if (PotFlags[0] == 1021)
+    if (PolFlagCsixty == 1 || PolFlagCsixty == 2 || PolFlagCsixty == 3 || PolFlagCsixty == 6)
+      return 32;
+  if (PotFlags[0] >= 1 && PotFlags[0] <= 4 && DPPKernel)
+    return 32;
+  return 0;
+}
+
+//
+//  evaluate np points r[3*p] at once
+//  v[p] is the potential, and energies[nReturnEnergies*p] what ReportEnergies would give
+//
+void Potential::EvaluateBatch(int np, const double *r, double *v, double *energies)
+{
+  int nb = BatchTile();
+  if (nb == 0) {
+    for (int p = 0; p < np; ++p) {
+      v[p] = Evaluate(&r[3*p]);
+      ReportEnergies(nReturnEnergies, &energies[nReturnEnergies*p]);
+    }
+    return;
+  }
+  TileKernel kernel = (PotFlags[0] == 1021) ? &Potential::EvaluateCsixtyBatch : DPPKernel;
+  for (int ib = 0; ib < np; ib += nb)
+    (this->*kernel)(std::min(nb, np-ib), &r[3*ib], &v[ib], &energies[nReturnEnergies*ib]);
+}
+
 /*
 
 void Potential:: EvaluateGradient(
@@ -250,10 +369,9 @@ void Potential::SetupDPPGTOP(
 { 
 
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 
-  nReturnEnergies = 5;
-  ReturnEnergies.resize(nReturnEnergies); // Vpc, Vind, Vrep, Vpol, and Vtotal
+  nReturnEnergies = 5; // Vpc, Vind, Vrep, Vpol, and Vtotal
 
   //progress_timer tmr("SetupDPPGTOP:", verbose);
   
@@ -429,6 +547,7 @@ void Potential::SetupDPPGTOP(
 
 	// so far aThole=0.3  this should be different for DPP and DPP2
 	ComputeInvA(npp, &Rpps[0], &MolPol[0].Alpha[0], 0.3, &MolPol[0].InvA[0], 1);
+	SetupHMatrix(npp, &Rpps[0]);
         
         // Calculate Tensor Tae Hoon Choi
         //void BuildTensor(int nSites, const double *R, const double *alpha, double aThole, double *Tensor);
@@ -541,6 +660,7 @@ void Potential::SetupDPPGTOP(
 	void ComputeInvA(int nSites, const double *R, const double *alpha, double aThole, double *InvA, int verbose); // defined in PolAux.cpp
 	// so far aThole=0.3  this is taken from DPP
 	ComputeInvA(npp, &Rpps[0], &MolPol[0].Alpha[0], 0.3, &MolPol[0].InvA[0], 1);       
+	SetupHMatrix(npp, &Rpps[0]);
 
 	// compute the Water-Water induced dipoles in Rpps
 	// and then the Water-Water polarization energy as an energy offset 
@@ -590,6 +710,8 @@ void Potential::SetupDPPGTOP(
       if(rank==0)cout << " Potential::SetupDPPGTOP PotFlags[0] this should never happen.\n"; exit(1);
     }
 
+  SetupRadialTables();
+  SelectDPPKernel();
 }
 
 
@@ -600,7 +722,7 @@ void Potential::SetupDPPGTOP(
 void Potential::Set6GTORepCore(int nWater)
 {
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 
   nGauss = 6 * nWater;
   Gauss.resize(2*nGauss);
@@ -641,7 +763,7 @@ void Potential::Set6GTORepCore(int nWater)
 void Potential::Set12GTORepCore(int nWater)
 {
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 
   const int nGpW = 12;
   nGauss = nGpW * nWater;
@@ -699,7 +821,7 @@ void Potential::Set12GTORepCore(int nWater)
 void Potential::Set4STORepCore(int nWater)
 {
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 
   const int nGpW = 4;   // 4 s-type Slaters per water
   nGauss = nGpW * nWater;
@@ -732,11 +854,14 @@ void Potential::Set4STORepCore(int nWater)
 ////////////////////
 //
 //  this works so far only for DPPnSP 
+//  InvA, EpsDrude, and Rtol are not updated: changing alpha of interacting sites
+//  (PolType >= 2), PotPara[6], or PotPara[10] needs a new Setup
 //
 void Potential::UpdateParameters(const double *PotPara)
 { 
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
+  nSetups++;
 
 
   if (PotFlags[0] == 1 || PotFlags[0] == 2) 
@@ -751,10 +876,25 @@ void Potential::UpdateParameters(const double *PotPara)
       }
 
       Alpha = PotPara[0];
-      PolDamping = fabs(PotPara[1]);  // use fabs to keep Powell from doing stupid stuff
-      VRepScale = fabs(PotPara[2]);
-      ChargeDamping = 1.0 / (PotPara[3]*PotPara[3]);   // Gaussian damping width (default may still be 0.2 Bohr)
-      DipoleDamping = 1.0 / (PotPara[4]*PotPara[4]);   // Gaussian damping width (default may still be 0.4 Bohr)
+      VRepScale = fabs(PotPara[2]);  // use fabs to keep Powell from doing stupid stuff
+      if (SigmaOFlag == 1)
+	VRepScaleO = fabs(PotPara[5]);
+      // same damping conventions as in SetupDPPGTOP
+      switch (DampType)
+	{
+	case 1:
+	  ChargeDamping = 1.0 / (PotPara[3]*PotPara[3]);   // Gaussian damping width (default may still be 0.2 Bohr)
+	  DipoleDamping = 1.0 / (PotPara[4]*PotPara[4]);   // Gaussian damping width (default may still be 0.4 Bohr)
+	  PolDamping    = 1.0 / (PotPara[1]*PotPara[1]);
+	  break;
+	case 2:
+	  ChargeDamping = fabs(PotPara[3]);
+	  DipoleDamping = fabs(PotPara[4]);
+	  PolDamping    = fabs(PotPara[1]);
+	  break;
+	default: 
+	  if(rank==0)cout << " Potential::UpdateParameters DampFlag this should never happen.\n"; exit(1);
+	}
       
       // update polarization potential
       for (int i = 0; i < nPPS; ++i)
@@ -782,7 +922,10 @@ void Potential::UpdateParameters(const double *PotPara)
       if (PotFlags[0] == 2) {
 	const int nGpW = 12;   // 12 s-type Gaussians per water
 	int nWater = nGauss / nGpW;
-	double sigma = 1.0 / VRepScale; // overall scaling factor for Vrep
+	double sigma = 1.0 / VRepScale; // overall scaling factor for Vrep, or just for H
+	double sigmaO = sigma;
+	if (SigmaOFlag == 1)
+	  sigmaO = 1.0 / VRepScaleO;    // separate scaling factor for O
 	for (int i = 0; i < nWater; ++i) {
 	  int ipara = 2 * nGpW * i;
 	  Gauss[ipara+1]  = 41.69216064; // coefficient
@@ -797,12 +940,13 @@ void Potential::UpdateParameters(const double *PotPara)
 	  Gauss[ipara+19] = 0.69233452;  // coefficient
 	  Gauss[ipara+21] = 0.66686241;  // coefficient
 	  Gauss[ipara+23] = 0.07193908;  // coefficient
-	  // scale all coefficients by common RepCore scaling factor
+	  // scale all coefficients by the RepCore scaling factors (the first 6 Gaussians are on O)
 	  for (int j = 1; j < 2*nGpW; j += 2){
-	    Gauss[ipara+j] *= sigma;
+	    Gauss[ipara+j] *= (j < 12) ? sigmaO : sigma;
 	  }
 	}
       }
+      SetupRadialTables();
     }
   else {
     if(rank==0)cout << "UpdateParameters: So far Potential " << PotFlags[0] << " does not update\n";
@@ -815,7 +959,7 @@ void Potential::UpdateChargeDipole(int nr, double *r, int nq, double *q, int *iq
 { 
 
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 
   if (nSites != nr || nCharges != nq || nDipoles != nd) {
     if(rank==0)cout << "You should not be calling UpdateChargeDipole. Call SetupXXX instead.\n";
@@ -843,11 +987,13 @@ void Potential::UpdateChargeDipole(int nr, double *r, int nq, double *q, int *iq
 //
 double Potential::EvaluateDPPGTOP(const double *x)
 {
+  PotentialWorkspace &w = Work();
+  dVec &ReturnEnergies = w.ReturnEnergies;
 
   // progress_timer tmr("EvaluateDPPGTOP:", verbose);
 
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 
 
  //  cout<<"x ="<<x[0]<<" "<<x[1]<<" "<<x[2]<<endl;
@@ -871,47 +1017,9 @@ double Potential::EvaluateDPPGTOP(const double *x)
   //   cout<<"Vrep = "<<Vrep<<endl;
  }
   //  polarization potential
-   Vpol = 0; 
-  switch (PolType)
-    {
-    case 0:
-      break; // no polarization potential in the model
-    case 1:  // non-interacting point-polarizable sites
-      Vpol = EvaluatePolPot(x, DampType, PolDamping);
-      if (AdiabaticPolPot)
-	Vpol = EpsDrude - sqrt(EpsDrude*(EpsDrude + Vpol));  // adiabatic potential of Drude oscillators
-      else
-	Vpol *= -0.5;  // this is the usual -0.5a/R**4, the 1st-order expansion of the adiabatic potential for large R
-      break;
-    case 2:  // non-interacting molecules with interacting atomic point-polarizabilities 
-      Vpol = EvaluateMolecularPolarizableSites(x, DampType, PolDamping);
-      if (AdiabaticPolPot)
-	Vpol = EpsDrude - sqrt(EpsDrude*(EpsDrude + Vpol));  // adiabatic potential of Drude oscillators
-      else
-	Vpol *= -0.5;  // this is the usual -0.5a/R**4, the 1st-order expansion of the adiabatic potential for large R
-      break;
-    case 3:  // fully interacting atomic polarizabilities
-      Vpol = SelfConsistentPolarizability(x, DampType, PolDamping);
-    //   cout<<"Vpol = "<<Vpol<<endl;
-      break;
-    case 4:  // case 3: distributed, case 4: single sites
-//      Vpol = SelfConsistentPolarizability(x, DampType, PolDamping);
-//      break;
-    case 5:  // fully interacting atomic polarizabilities
-      Vpol = SelfConsistentPolarizability(x, DampType, PolDamping);
-      Vind = 0.0;
-      break;
-    case 6:  // fully interacting atomic polarizabilities
-      Vpol = SelfConsistentPolarizability(x, DampType, PolDamping);
-      Vind = 0.0;
-      break;
-    case 33:
-      Vpol = SelfConsistentPolarizability_33(x, DampType, PolDamping) ;
-      break; 
-    default:
-      if(rank==0)cout << "EvaluateDPPGTOP: PolType = " << PolType << ", this should not happen.\n";
-      exit(1);
-    }
+  Vpol = EvaluatePolarizationTerm(x);
+  if (PolType == 4 || PolType == 5 || PolType == 6)
+    Vind = 0.0;  // the water dipoles are part of the self-consistent polarization
 
 
  if (x[0] == 0 && x[2] == 0.0) {
@@ -962,6 +1070,410 @@ double Potential::EvaluateDPPGTOP(const double *x)
 
 
 
+//
+//  polarization potential of EvaluateDPPGTOP for the current PolType
+//
+double Potential::EvaluatePolarizationTerm(const double *x)
+{
+  int rank;
+  MPI_Comm_rank( PiscesComm, &rank );
+
+  double Vpol = 0; 
+  switch (PolType)
+    {
+    case 0:
+      break; // no polarization potential in the model
+    case 1:  // non-interacting point-polarizable sites
+      Vpol = EvaluatePolPot(x, DampType, PolDamping);
+      if (AdiabaticPolPot)
+	Vpol = EpsDrude - sqrt(EpsDrude*(EpsDrude + Vpol));  // adiabatic potential of Drude oscillators
+      else
+	Vpol *= -0.5;  // this is the usual -0.5a/R**4, the 1st-order expansion of the adiabatic potential for large R
+      break;
+    case 2:  // non-interacting molecules with interacting atomic point-polarizabilities 
+      Vpol = EvaluateMolecularPolarizableSites(x, DampType, PolDamping);
+      if (AdiabaticPolPot)
+	Vpol = EpsDrude - sqrt(EpsDrude*(EpsDrude + Vpol));  // adiabatic potential of Drude oscillators
+      else
+	Vpol *= -0.5;  // this is the usual -0.5a/R**4, the 1st-order expansion of the adiabatic potential for large R
+      break;
+    case 3:  // fully interacting atomic polarizabilities
+    case 4:  // case 3: distributed, case 4: single sites
+    case 5:  // fully interacting atomic polarizabilities
+    case 6:  // fully interacting atomic polarizabilities
+      Vpol = SelfConsistentPolarizability(x, DampType, PolDamping);
+      break;
+    case 33:
+      Vpol = SelfConsistentPolarizability_33(x, DampType, PolDamping) ;
+      break; 
+    default:
+      if(rank==0)cout << "EvaluateDPPGTOP: PolType = " << PolType << ", this should not happen.\n";
+      exit(1);
+    }
+  return Vpol;
+}
+
+
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+//  term-decomposed DPPnSP potential for fast reparametrization
+//
+//  V = Vpc + Vind + sigmaH*VrepH + sigmaO*VrepO + cpol*Vpol 
+//
+//  Vpc, Vind, and Vpol depend non-linearly only on their damping parameters (Vpol also 
+//  on alpha unless it is the non-adiabatic PolType 1 potential, then cpol = alpha), 
+//  and VrepH and VrepO are the repulsive cores with unit scaling factors (sigma = 1/PotPara[2] 
+//  and 1/PotPara[5]).  So the DVR can store a grid for each term, and after UpdateParameters
+//  only terms with a changed key need to be re-evaluated; V itself is a linear combination.
+//
+//  the terms are only valid as long as the sites, charges, and dipoles do not change
+//
+int Potential::nPotentialTerms()
+{
+  if (PotFlags.size() == 0)
+    return 0;
+  if (PotFlags[0] < 1 || PotFlags[0] > 4)
+    return 0;
+  if (PolType == 5 || PolType == 6)   // these need the dual grid and the potential of the previous call
+    return 0;
+  return NTERMS;
+}
+
+//
+//  Vpol is linear in alpha only for non-interacting, non-adiabatic sites
+//
+int Potential::LinearPolTerm()
+{
+  return (PolType == 1 && AdiabaticPolPot == 0 && Alpha != 0.0);
+}
+
+//
+//  coefficients c[NTERMS] of the term grids for the current parameters
+//
+void Potential::TermCoefficients(double *c)
+{
+  c[TermPC] = 1.0;
+  c[TermInd] = 1.0;
+  c[TermRepH] = 1.0 / VRepScale;
+  c[TermRepO] = (SigmaOFlag == 1) ? 1.0 / VRepScaleO : 1.0 / VRepScale;
+  c[TermPol] = LinearPolTerm() ? Alpha : 1.0;
+}
+
+//
+//  keys[2*NTERMS]: the non-linear parameters each term depends on
+//  a stored term grid is valid as long as both of its keys are unchanged
+//
+void Potential::TermKeys(double *keys)
+{
+  for (int k = 0; k < 2*NTERMS; ++k)
+    keys[k] = 0.0;
+  keys[2*TermPC] = ChargeDamping;
+  keys[2*TermInd] = DipoleDamping;
+  keys[2*TermPol] = PolDamping;
+  if (!LinearPolTerm())
+    keys[2*TermPol+1] = Alpha;
+}
+
+//
+//  evaluate the unscaled terms at r; only terms with mask[iterm] != 0 are computed 
+//
+void Potential::EvaluateTerms(const double *r, const int *mask, double *terms)
+{
+  ComputeDistances(r);
+
+  if (mask[TermPC])
+    terms[TermPC] = EvaluateChargePotential(r, DampType, ChargeDamping);
+
+  if (mask[TermInd]) {
+    if (PolType == 4)
+      terms[TermInd] = 0.0;
+    else
+      terms[TermInd] = EvaluateDipolePotential(r, DampType, DipoleDamping);
+  }
+
+  if (mask[TermRepH] || mask[TermRepO]) {
+    double VrepH = 0, VrepO = 0;
+    if (RepCoreType > 0)
+      EvaluateRepulsiveTerms(r, RepCoreType, &VrepH, &VrepO);
+    terms[TermRepH] = VrepH;
+    terms[TermRepO] = VrepO;
+  }
+
+  if (mask[TermPol]) {
+    terms[TermPol] = EvaluatePolarizationTerm(r);
+    if (LinearPolTerm())
+      terms[TermPol] /= Alpha;
+  }
+}
+
+
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+//  particle-mesh electrostatics: the potential of all charges (and dipoles) on a whole
+//  equally spaced grid at once
+//
+//  the undamped long-range part erf(R/sigma)/R comes from MeshElectrostatics, and 
+//  only pairs closer than the cut-off, where damping or erfc(R/sigma) matter, are 
+//  computed explicitly; this is O(ngp log ngp + nSites) instead of O(ngp*nSites)
+//
+//  sigma is given in grid spacings, 0 turns the mesh off (4 is accurate to about 1e-5 Hartree)
+//
+void Potential::SetMesh(double sigma)
+{
+  MeshSigma = sigma;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+//  H-matrix products with InvA: for large clusters the induced dipoles InvA*E cost
+//  O(N log N) instead of O(N^2) per point; tol is the relative accuracy of the
+//  far-field blocks (1e-4 gives dipoles to about 1e-6), 0 keeps the dense dsymv
+//
+//  must be called before Setup; InvA itself is kept for the setup and the gradients
+//
+void Potential::SetHMatrix(double tol)
+{
+  HMatrixTol = tol;
+}
+
+// MolPol[0] with 3 rows per polarizable site, the sites at R[3*i]
+void Potential::SetupHMatrix(int npp, const double *R)
+{
+  int rank;
+  MPI_Comm_rank( PiscesComm, &rank );
+  int n = 3*npp;
+  iVec site(n);
+  for (int k = 0; k < n; ++k)
+    site[k] = k / 3;
+  MolPol[0].InvAH.Setup(n, &MolPol[0].InvA[0], "L", &site[0], npp, R, HMatrixTol, rank == 0);
+}
+
+//
+//  which terms of the term-decomposed DPP potential are evaluated on the mesh
+//
+int Potential::MeshTerms(int *mask)
+{
+  for (int it = 0; it < NTERMS; ++it)
+    mask[it] = 0;
+  if (MeshSigma <= 0 || nPotentialTerms() == 0)
+    return 0;
+  mask[TermPC] = 1;
+  mask[TermInd] = 1;
+  return 2;
+}
+
+//
+//  the Bloomfield potential consists of charges only
+//
+int Potential::MeshPotential()
+{
+  return (MeshSigma > 0 && PotFlags.size() > 0 && PotFlags[0] == 101);
+}
+
+//
+//  the grid is gx[0..n[0]) x gy[0..n[1]) x gz[0..n[2]), x runs fastest
+//  v_terms[it*ldv + igp] is overwritten for the terms with mask[it] != 0
+//
+void Potential::EvaluateMeshTerms(const int *n, const double *gx, const double *gy, const double *gz,
+				  const int *mask, double *v_terms, int ldv)
+{
+  int ngp = n[0]*n[1]*n[2];
+  double *vq = 0, *vd = 0;
+  if (mask[TermPC]) {
+    vq = &v_terms[TermPC*ldv];
+    std::fill(vq, vq+ngp, 0.0);
+  }
+  if (mask[TermInd]) {
+    double *v = &v_terms[TermInd*ldv];
+    std::fill(v, v+ngp, 0.0);
+    if (PolType != 4)
+      vd = v;
+  }
+  // both terms in one call: one set-up of the mesh, one kernel transform
+  if (vq || vd)
+    MeshChargesDipoles(n, gx, gy, gz, vq, vd);
+}
+
+void Potential::EvaluateMeshPotential(const int *n, const double *gx, const double *gy, const double *gz, double *v)
+{
+  std::fill(v, v + n[0]*n[1]*n[2], 0.0);
+  MeshChargesDipoles(n, gx, gy, gz, v, 0);
+}
+
+//
+//  damped 1/R of charge i, as in EvaluateChargePotential and EvaluateBloomfield
+//
+double Potential::DampedCharge(int i, double R, double R2)
+{
+  if (PotFlags[0] == 101) {
+    double damp = (Charge[i] > 0) ? CationDamping : AnionDamping;
+    const RadialTable &f = (Charge[i] > 0) ? CationTable : AnionTable;
+    if (f.Is(RadialTable::ErfCoulomb, damp))
+      return f.Coulomb(R2, 1.0 / R);
+    if (R < 1e-12) return 2.0 * damp / sqrt(M_PI);
+    return erf(damp*R) / R;
+  }
+  if (DampType == 1) {
+    if (R < 1e-12) return 0.0;
+    if (ChargeTable.Tabulated())
+      return ChargeTable(R2) / R;
+    return (1.0 - exp(-ChargeDamping * R2)) / R;
+  }
+  double Reff = R;
+  if (Reff < ChargeDamping) {
+    double ror0 = Reff / ChargeDamping;
+    Reff = ChargeDamping * (0.5 + ror0 * ror0 * ror0 * (1.0 - 0.5 * ror0));  
+  }
+  return 1.0 / Reff;
+}
+
+//
+//  damped 1/R^3 of the dipoles, as in EvaluateDipolePotential
+//
+double Potential::DampedDipole(double R, double R2)
+{
+  if (DampType == 1) {
+    double damp = DipoleTable.Tabulated() ? DipoleTable(R2) : 1.0 - exp(-DipoleDamping * R2);
+    return damp * damp / (R2 * R);
+  }
+  double Reff = R;
+  if (Reff < DipoleDamping) {
+    double ror0 = Reff / DipoleDamping;
+    Reff = DipoleDamping * (0.5 + ror0 * ror0 * ror0 * (1.0 - 0.5 * ror0));  
+  }
+  return 1.0 / (Reff * Reff * Reff);
+}
+
+//
+//  distance beyond which the damping functions are 1 (to about 1e-10)
+//
+double Potential::DampingRange()
+{
+  if (PotFlags[0] == 101)
+    return 4.6 / std::min(CationDamping, AnionDamping);
+  if (DampType == 1)
+    return sqrt(25.0 / std::min(ChargeDamping, DipoleDamping));
+  return std::max(ChargeDamping, DipoleDamping);
+}
+
+//
+//  tables of the radial functions for the current parameters
+//  the kernels use a table if it matches their DampParameter, and libm otherwise
+//  (RadialTolerance = 0 switches the tables off)
+//
+void Potential::SetupRadialTables()
+{
+  RadialTable::Kind damp = RadialTable::None, thole = RadialTable::None, coulomb = RadialTable::None;
+  if (PotFlags[0] >= 1 && PotFlags[0] <= 4 && DampType == 1) {
+    damp = RadialTable::GaussDamp;
+    thole = RadialTable::TholeDamp;
+  }
+  if (PotFlags[0] == 101)
+    coulomb = RadialTable::ErfCoulomb;
+  ChargeTable.Setup(damp, ChargeDamping, RadialTolerance);
+  DipoleTable.Setup(damp, DipoleDamping, RadialTolerance);
+  PolTable.Setup(damp, PolDamping, RadialTolerance);
+  TholeTable.Setup(thole, PolDamping, RadialTolerance);
+  CationTable.Setup(coulomb, CationDamping, RadialTolerance);
+  AnionTable.Setup(coulomb, AnionDamping, RadialTolerance);
+
+  // the repulsive core: the same few exponents on every water
+  CoreTables.clear();
+  GaussTable.assign(nGauss, -1);
+  CoreTabulated = 0;
+  RadialTable::Kind core = RadialTable::None;
+  if (PotFlags[0] >= 1 && PotFlags[0] <= 3)
+    core = (RepCoreType == 1) ? RadialTable::GaussCore : RadialTable::SlaterCore;
+  if (core == RadialTable::None || nGauss == 0)
+    return;
+  for (int i = 0; i < nGauss; ++i) {
+    int it = 0;
+    while (it < (int)CoreTables.size() && !CoreTables[it].Is(core, Gauss[2*i]))
+      ++it;
+    if (it == (int)CoreTables.size()) {
+      CoreTables.push_back(RadialTable());
+      CoreTables.back().Setup(core, Gauss[2*i], RadialTolerance);
+      if (!CoreTables.back().Tabulated())
+	return;
+    }
+    GaussTable[i] = it;
+  }
+  CoreTabulated = RepCoreType;
+}
+
+//
+//  vq += potential of the charges, vd += potential of the dipoles (either may be 0)
+//
+void Potential::MeshChargesDipoles(const int *n, const double *gx, const double *gy, const double *gz,
+				   double *vq, double *vd)
+{
+  progress_timer tmr("MeshChargesDipoles", verbose);
+
+  const double *g[3] = {gx, gy, gz};
+  double x0[3], h[3];
+  for (int k = 0; k < 3; ++k) {
+    x0[k] = g[k][0];
+    h[k] = g[k][1] - g[k][0];
+  }
+  double sigma = MeshSigma * std::max(h[0], std::max(h[1], h[2]));
+  Mesh.SetGrid(n, x0, h, sigma);
+
+  int nq = (vq) ? nCharges : 0;
+  int nd = (vd) ? nDipoles : 0;
+  dVec rq(3*nq+1), rd(3*nd+1);
+  for (int i = 0; i < nq; ++i)
+    for (int k = 0; k < 3; ++k)
+      rq[3*i+k] = Site[3*ChargeSite[i]+k];
+  for (int i = 0; i < nd; ++i)
+    for (int k = 0; k < 3; ++k)
+      rd[3*i+k] = Site[3*DipoleSite[i]+k];
+  Mesh.AddPotential(nq, &rq[0], &Charge[0], nd, &rd[0], &Dipole[0], (vq) ? vq : vd, vd);
+
+  //
+  // short range: damped potential minus the long-range part within rc of each site
+  // parallel over z-planes, so that no two threads write the same grid point
+  //
+  double rc = std::max(Mesh.Cutoff(1e-10), DampingRange());
+  if (verbose > 0)
+    cout << "MeshChargesDipoles: sigma = " << sigma << " Bohr, short-range cut-off = " << rc << " Bohr\n";
+#pragma omp parallel for schedule(dynamic)
+  for (int kz = 0; kz < n[2]; ++kz) {
+    for (int is = 0; is < nq + nd; ++is) {
+      const double *s = (is < nq) ? &rq[3*is] : &rd[3*(is-nq)];
+      double dz = gz[kz] - s[2];
+      double ryz2 = rc*rc - dz*dz;
+      if (ryz2 <= 0) continue;
+      double ryz = sqrt(ryz2);
+      int jlo = std::max(0, (int)ceil((s[1] - ryz - gy[0]) / h[1]));
+      int jhi = std::min(n[1]-1, (int)floor((s[1] + ryz - gy[0]) / h[1]));
+      for (int jy = jlo; jy <= jhi; ++jy) {
+	double dy = gy[jy] - s[1];
+	double rx2 = ryz2 - dy*dy;
+	if (rx2 <= 0) continue;
+	double rx = sqrt(rx2);
+	int ilo = std::max(0, (int)ceil((s[0] - rx - gx[0]) / h[0]));
+	int ihi = std::min(n[0]-1, (int)floor((s[0] + rx - gx[0]) / h[0]));
+	double *vrow = (is < nq) ? &vq[n[0]*(jy + n[1]*kz)] : &vd[n[0]*(jy + n[1]*kz)];
+	for (int ix = ilo; ix <= ihi; ++ix) {
+	  double dx = gx[ix] - s[0];
+	  double R2 = dx*dx + dy*dy + dz*dz;
+	  double R = sqrt(R2);
+	  if (is < nq)
+	    vrow[ix] -= Charge[is] * (DampedCharge(is, R, R2) - Mesh.Kernel(R));
+	  else if (R > 1e-12) {
+	    const double *mu = &Dipole[3*(is-nq)];
+	    vrow[ix] -= (dx*mu[0] + dy*mu[1] + dz*mu[2]) * (DampedDipole(R, R2) - Mesh.Kernel3(R));
+	  }
+	}
+      }
+    }
+  }
+}
+
+
 /////////////////////////////////////////////////////////////////////////////////////////////
 //
 //  A DPP based potential, that is, the Sites are O1, H1a, H1b, M1, O2, H2a, H2b, M2, ....
@@ -986,7 +1498,7 @@ void Potential::SetupDPPTB(int nr, const double *r,                         // s
 			   const double *PotPara)                           // Parameters 
 { 
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 
   PotFlags.resize(1);
   PotFlags[0] = 11;
@@ -1068,9 +1580,11 @@ void Potential::SetupDPPTB(int nr, const double *r,                         // s
 //
 double Potential::EvaluateDPPTB(const double *x)
 {
+  PotentialWorkspace &w = Work();
+  dVec &Rx = w.Rx, &Ry = w.Ry, &Rz = w.Rz, &R = w.R, &R2 = w.R2, &Rminus3 = w.Rminus3;
 
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 
   // this list has been computed in Evaluate()
   // compute a list of distances of all sites to the point r=(x,y,z)
@@ -1168,9 +1682,11 @@ double Potential::EvaluateDPPTB(const double *x)
 //
 double Potential::EvaluateChargePotential(const double *x, int DampFlag, double DampParameter)
 {
+  PotentialWorkspace &w = Work();
+  dVec &R = w.R, &R2 = w.R2;
 
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 
  //  cout<<"x ="<<x[0]<<" "<<x[1]<<" "<<x[2]<<endl;
    //progress_timer tmr("EvaluateChargePotential:", verbose); 
@@ -1178,7 +1694,15 @@ double Potential::EvaluateChargePotential(const double *x, int DampFlag, double
    switch (DampFlag)
      {
      case 1:
-       {
+       if (ChargeTable.Is(RadialTable::GaussDamp, DampParameter)) {
+	 const RadialTable &f = ChargeTable;
+#pragma omp simd reduction(+:Vpc)
+	 for (int i = 0; i < nCharges; ++i) {
+	   int iqs = ChargeSite[i];
+	   Vpc += -Charge[i]/R[iqs] * f(R2[iqs]);
+	 }
+       }
+       else {
 	 for (int i = 0; i < nCharges; ++i) {
 	   int iqs = ChargeSite[i];
 	   Vpc += -Charge[i]/R[iqs] * (1.0 - exp(-DampParameter * R2[iqs]));
@@ -1221,8 +1745,10 @@ double Potential::EvaluateChargePotential(const double *x, int DampFlag, double
 //
 double Potential::EvaluateDipolePotential(const double *x, int DampFlag, double DampParameter)
 {
+  PotentialWorkspace &w = Work();
+  dVec &Rx = w.Rx, &Ry = w.Ry, &Rz = w.Rz, &R = w.R, &R2 = w.R2, &Rminus3 = w.Rminus3;
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 
 
   //progress_timer tmr("EvaluateDipolePotential:", verbose);
@@ -1234,7 +1760,17 @@ double Potential::EvaluateDipolePotential(const double *x, int DampFlag, double
    switch (DampFlag)
      {
      case 1:
-       {
+       if (DipoleTable.Is(RadialTable::GaussDamp, DampParameter)) {
+	 const RadialTable &f = DipoleTable;
+#pragma omp simd reduction(+:Vpd)
+	 for (int i = 0; i < nDipoles; ++i) {
+	   int ids = DipoleSite[i];
+	   const double *mu = &Dipole[3*i];
+	   double damp = f(R2[ids]);
+	   Vpd += -(Rx[ids]*mu[0] + Ry[ids]*mu[1] + Rz[ids]*mu[2]) * Rminus3[ids] * damp * damp;
+	 }
+       }
+       else {
 	 for (int i = 0; i < nDipoles; ++i) {
 	   int ids = DipoleSite[i];
 	   double *mu = &Dipole[3*i];
@@ -1281,9 +1817,11 @@ double Potential::EvaluateDipolePotential(const double *x, int DampFlag, double
 //
 double Potential::EvaluateRepulsivePotential(const double *x, int RepCoreFlag)
 {
+  PotentialWorkspace &w = Work();
+  dVec &R = w.R, &R2 = w.R2;
 
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 
   //progress_timer tmr("EvaluateRepulsivePotential:", verbose);
 
@@ -1291,7 +1829,13 @@ double Potential::EvaluateRepulsivePotential(const double *x, int RepCoreFlag)
    switch (RepCoreFlag)
      {
      case 1:
-       {
+       if (CoreTabulated == 1) {
+	 for (int i = 0; i < nGauss; ++i) {
+	   int igs = GaussSite[i];
+	   Vrep +=  Gauss[2*i+1] * CoreTables[GaussTable[i]](R2[igs]);
+	 }
+       }
+       else {
 	 for (int i = 0; i < nGauss; ++i) {
 	   int igs = GaussSite[i];
 	   Vrep +=  Gauss[2*i+1] * exp(-Gauss[2*i] * R2[igs]);
@@ -1299,7 +1843,13 @@ double Potential::EvaluateRepulsivePotential(const double *x, int RepCoreFlag)
        }
        break;
      case 2:
-       {
+       if (CoreTabulated == 2) {
+	 for (int i = 0; i < nGauss; ++i) {
+	   int igs = GaussSite[i];
+	   Vrep +=  Gauss[2*i+1] * CoreTables[GaussTable[i]](R[igs]);
+	 }
+       }
+       else {
 	 for (int i = 0; i < nGauss; ++i) {
 	   int igs = GaussSite[i];
           // cout<<" Gauss[2*i+1] , Gauss[2*i] "<<Gauss[2*i+1]<<" "<<Gauss[2*i]<<endl;
@@ -1314,6 +1864,39 @@ double Potential::EvaluateRepulsivePotential(const double *x, int RepCoreFlag)
    return Vrep;
 }
 
+//
+//  as EvaluateRepulsivePotential, but split into O-sites and H-sites (DPP order O, H, H, M)
+//  and with the scaling factors 1/VRepScale and 1/VRepScaleO taken out
+//
+void Potential::EvaluateRepulsiveTerms(const double *x, int RepCoreFlag, double *VrepH, double *VrepO)
+{
+  PotentialWorkspace &w = Work();
+  dVec &R = w.R, &R2 = w.R2;
+  int rank;
+  MPI_Comm_rank( PiscesComm, &rank );
+
+  double scaleO = (SigmaOFlag == 1) ? VRepScaleO : VRepScale;
+  double vh = 0, vo = 0;
+  for (int i = 0; i < nGauss; ++i) {
+    int igs = GaussSite[i];
+    double v = 0;
+    switch (RepCoreFlag)
+      {
+      case 1: v = Gauss[2*i+1] * ((CoreTabulated == 1) ? CoreTables[GaussTable[i]](R2[igs]) : exp(-Gauss[2*i] * R2[igs])); break;
+      case 2: v = Gauss[2*i+1] * ((CoreTabulated == 2) ? CoreTables[GaussTable[i]](R[igs]) : exp(-Gauss[2*i] * R[igs])); break;
+      default:
+	if(rank==0)cout << "Potential::EvaluateRepulsiveTerms: RepCoreFlag = " << RepCoreFlag << ", this should not happen\n"; 
+	exit(1);
+      }
+    if (igs % 4 == 0)
+      vo += v;
+    else
+      vh += v;
+  }
+  *VrepH = vh * VRepScale;
+  *VrepO = vo * scaleO;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 //  for evaluating a potential consisting of non-interacting point-polarizabilities
@@ -1330,19 +1913,22 @@ double Potential::EvaluateRepulsivePotential(const double *x, int RepCoreFlag)
 //
 double Potential::EvaluatePolPot(const double *x, int DampFlag, double DampParameter)
 {
+  PotentialWorkspace &w = Work();
+  dVec &R = w.R, &R2 = w.R2;
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 
    double Spol = 0;
    switch (DampFlag)
      {
      case 1:
        {
+	 int tab = PolTable.Is(RadialTable::GaussDamp, DampParameter);
 	 for (int i = 0; i < nPPS; ++i) {
 	   int ips = PPSSite[i];
 	   double alpha = PPS[i];
 	   double Rsq = R2[ips];
-	   double damp = 1.0 - exp(-DampParameter*Rsq);
+	   double damp = tab ? PolTable(Rsq) : 1.0 - exp(-DampParameter*Rsq);
 	   Spol += alpha * damp * damp / (Rsq * Rsq);
 	 }
        }
@@ -1388,14 +1974,16 @@ double Potential::EvaluatePolPot(const double *x, int DampFlag, double DampParam
 //
 double Potential::EvaluateMolecularPolarizableSites(const double *x, int DampFlag, double DampParameter)
 {
+  PotentialWorkspace &w = Work();
+  dVec &Rx = w.Rx, &Ry = w.Ry, &Rz = w.Rz, &R = w.R, &R2 = w.R2, &Rminus3 = w.Rminus3;
 
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 
   double Spol = 0;
 
-  static dVec Efield;
-  static dVec mu;
+  dVec &Efield = w.Efield;
+  dVec &mu = w.mu;
 
 
   for (int imol = 0; imol < nMolPol; ++imol) 
@@ -1406,6 +1994,7 @@ double Potential::EvaluateMolecularPolarizableSites(const double *x, int DampFla
       Efield.resize(n);
       mu.resize(n);
       double gij;
+      int thole = TholeTable.Is(RadialTable::TholeDamp, DampParameter);
       for (int i = 0; i < nAtoms; ++i) {
 	int SiteIndex = MolPol[imol].SiteList[i];
 	// Rij[k] = RSites[3*i+k] - Rel[k];
@@ -1421,7 +2010,7 @@ double Potential::EvaluateMolecularPolarizableSites(const double *x, int DampFla
 	  {
 	  case 1:
 	    // Thole, Gauss damping as in the Drude code is not enough
-	    gij *= (1.0 - exp(-DampParameter * R[SiteIndex] * R2[SiteIndex]));
+	    gij *= thole ? TholeTable(R[SiteIndex]) : (1.0 - exp(-DampParameter * R[SiteIndex] * R2[SiteIndex]));
 	    if(rank==0)printf("%20.12f", gij);
 	    break;
 	  case 2:
@@ -1494,12 +2083,14 @@ double Potential::EvaluateMolecularPolarizableSites(const double *x, int DampFla
 //
 double Potential::SelfConsistentPolarizability(const double *x, int DampFlag, double DampParameter)
 {
+  PotentialWorkspace &w = Work();
+  dVec &Rx = w.Rx, &Ry = w.Ry, &Rz = w.Rz, &R = w.R, &R2 = w.R2, &Rminus3 = w.Rminus3;
 
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 
-  dVec Efield;
-  dVec mu;
+  dVec &Efield = w.Efield;
+  dVec &mu = w.mu;
 
 
    //progress_timer tmr("SelfConsistentPolarizability:", verbose);
@@ -1515,6 +2106,7 @@ double Potential::SelfConsistentPolarizability(const double *x, int DampFlag, do
   Efield.resize(n);
   mu.resize(n);
   double gij;
+  int thole = TholeTable.Is(RadialTable::TholeDamp, DampParameter);
   for (int i = 0; i < nAtoms; ++i) {
     int SiteIndex = MolPol[0].SiteList[i];
     gij = Rminus3[SiteIndex];
@@ -1522,7 +2114,7 @@ double Potential::SelfConsistentPolarizability(const double *x, int DampFlag, do
       {
       case 1:
 	// cubic Thole, Gauss damping as in the Drude code is too weak
-	gij *= 1.0 - exp(-DampParameter * R[SiteIndex] * R2[SiteIndex]);
+	gij *= thole ? TholeTable(R[SiteIndex]) : 1.0 - exp(-DampParameter * R[SiteIndex] * R2[SiteIndex]);
 	break;
       case 2:
 	// effective-r damping
@@ -1580,7 +2172,10 @@ double Potential::SelfConsistentPolarizability(const double *x, int DampFlag, do
 
 
 //  dgemv("N", &n, &n, &done, &(MolPol[0].InvA[0]), &n, &Efield[0], &one, &dzero, &mu[0], &one);
-  dsymv("L", &n, &done, &(MolPol[0].InvA[0]), &n, &Efield[0], &one, &dzero, &mu[0], &one);
+  if (MolPol[0].InvAH.Active())
+    MolPol[0].InvAH.Apply(1, &Efield[0], n, &mu[0], n, w.HWork);
+  else
+    dsymv("L", &n, &done, &(MolPol[0].InvA[0]), &n, &Efield[0], &one, &dzero, &mu[0], &one);
 
 //   for (int i =0; i < n; ++i)
 //    if(rank==0)cout<<"Second mu["<<i<<"i] ="<<mu[i]<<endl;
@@ -1636,12 +2231,14 @@ double Potential::SelfConsistentPolarizability(const double *x, int DampFlag, do
 //
 double Potential::SelfConsistentPolarizability_33(const double *x, int DampFlag, double DampParameter)
 {
+  PotentialWorkspace &w = Work();
+  dVec &Rx = w.Rx, &Ry = w.Ry, &Rz = w.Rz, &R = w.R, &R2 = w.R2, &Rminus3 = w.Rminus3;
 
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 
-  dVec Efield;
-  dVec mu;
+  dVec &Efield = w.Efield;
+  dVec &mu = w.mu;
 
 
 
@@ -1651,6 +2248,7 @@ double Potential::SelfConsistentPolarizability_33(const double *x, int DampFlag,
   Efield.resize(n);
   mu.resize(n);
   double gij;
+  int thole = TholeTable.Is(RadialTable::TholeDamp, DampParameter);
   for (int i = 0; i < nAtoms; ++i) {
     int SiteIndex = MolPol[0].SiteList[i];
     gij = Rminus3[SiteIndex];
@@ -1658,7 +2256,7 @@ double Potential::SelfConsistentPolarizability_33(const double *x, int DampFlag,
       {
       case 1:
 	// cubic Thole, Gauss damping as in the Drude code is too weak
-	gij *= 1.0 - exp(-DampParameter * R[SiteIndex] * R2[SiteIndex]);
+	gij *= thole ? TholeTable(R[SiteIndex]) : 1.0 - exp(-DampParameter * R[SiteIndex] * R2[SiteIndex]);
 	break;
       case 2:
 	// effective-r damping
@@ -1736,7 +2334,7 @@ double Potential::SelfConsistentPolarizability_33(const double *x, int DampFlag,
 void Potential::SetupMinMax()
 {
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 
    switch (PotFlags[0]) 
    {
@@ -1755,19 +2353,19 @@ void Potential::SetupMinMax()
       exit(1);
    }
 
-   MaxV.resize(nContributions, -std::numeric_limits<double>::max());
-   MinV.resize(nContributions, std::numeric_limits<double>::max());
-
-
+   PrepareWorkspaces();  // MaxV and MinV of every thread
 }
 
 void Potential::CheckMinMax(const double *v)
 {
 
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 
 
+   PotentialWorkspace &w = Work();
+   dVec &MaxV = w.MaxV;
+   dVec &MinV = w.MinV;
    for (int i = 0; i < nContributions; ++i) {
       if (v[i] > MaxV[i]) 
          MaxV[i] = v[i]; 
@@ -1779,8 +2377,16 @@ void Potential::CheckMinMax(const double *v)
 void Potential::PrintMinMax()
 {
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
-
+  MPI_Comm_rank( PiscesComm, &rank );
+
+   // min and max over the grid points of all threads (call outside the parallel region)
+   dVec MaxV(nContributions, -std::numeric_limits<double>::max());
+   dVec MinV(nContributions, std::numeric_limits<double>::max());
+   for (size_t it = 0; it < Workspaces.size(); ++it)
+     for (int i = 0; i < nContributions && i < (int)Workspaces[it].MaxV.size(); ++i) {
+       MaxV[i] = std::max(MaxV[i], Workspaces[it].MaxV[i]);
+       MinV[i] = std::min(MinV[i], Workspaces[it].MinV[i]);
+     }
    if (nContributions > 0) {  // that means MinMax has been initialized at some point
       switch (PotFlags[0])
       {
@@ -1821,17 +2427,7 @@ void Potential::SetSites(int n, const double *sites)
    Site.resize(3*n);
    std::copy(sites, sites+3*n, Site.begin());
 
-   Rx.resize(n);
-   Ry.resize(n);
-   Rz.resize(n);
-   R.resize(n);
-   R2.resize(n);
-   Rminus3.resize(n);
-
-   RVec.resize(n/4*3);
-   X.resize(n);
-   Y.resize(n);
-   Z.resize(n);
+   PrepareWorkspaces();  // distance tables
 }
 
 //
@@ -1892,12 +2488,13 @@ void Potential::ReportEnergies(int n, double *e)
 {
 
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 
   if (n != nReturnEnergies) {
     if(rank==0)cout << "Nonono in ReportEnergies.";
     exit(1);
   }
+  const dVec &ReturnEnergies = Work().ReturnEnergies;
   for (int i = 0; i < nReturnEnergies; ++i) 
     e[i] = ReturnEnergies[i];
 
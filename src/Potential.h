@@ -10,6 +10,42 @@
 #include "vecdefs.h"
 
 #include "DistributedPolarizabilities.h"
+#include "RadialTable.h"
+#include "MeshElectrostatics.h"
+
+//
+//  scratch space of Potential::Evaluate and friends
+//
+//  Potential keeps one workspace per OpenMP thread, so all threads can evaluate 
+//  the same Potential object: while evaluating, the model data (sites, charges, 
+//  multipoles, InvA, ...) are only read, and all writes go to the thread's workspace
+//
+struct PotentialWorkspace
+{
+  dVec Rx;          // distance tables: electron - site
+  dVec Ry;
+  dVec Rz;
+  dVec R;
+  dVec R2;
+  dVec Rminus3;
+
+  dVec RVec;        // for the DPP6SP gradient
+  dVec X;
+  dVec Y;
+  dVec Z;
+
+  dVec Efield;      // field at the polarizable sites
+  dVec EfieldNet;   // field plus external field (C60)
+  dVec mu;          // induced dipoles
+
+  dVec FieldTile;   // C60 batched polarization: electron fields, one column per point
+  dVec MuTile;      // and the induced dipoles
+  dVec HWork;       // scratch of the H-matrix products
+
+  dVec ReturnEnergies;  // contributions of the most recent Evaluate
+  dVec MaxV;            // for MinMax debug output
+  dVec MinV;
+};
 
 class Potential
 {
@@ -18,11 +54,14 @@ public:
 
   Potential()
     : verbose(0)
+    , nSetups(0)
     , nSites(0)
     , nCharges(0)
     , nDipoles(0)
     , nPPS(0)
     , nGauss(0)
+    , CoreTabulated(0)
+    , DPPKernel(0)
     , nContributions(0)
     , ChargeDamping(0)
     , DipoleDamping(0)
@@ -31,10 +70,13 @@ public:
     , VRepScale(0)
     , CationDamping(0)
     , AnionDamping(0)
-    , nMolPol(0) {}
+    , MeshSigma(0)
+    , HMatrixTol(0)
+    , nMolPol(0) { PrepareWorkspaces(); }
 
 
    void SetVerbose(int v);
+   void PrepareWorkspaces();
    void Setup(const iVec& potflag, int nr, const double *r,
 	      int nq, const double *q, const int *iq,
 	      int nd, const double *d, const int *id,
@@ -42,6 +84,17 @@ public:
 	      const double *DmuByDR, const double *potpara);
 
    double Evaluate(const double *r);
+   // particle-mesh electrostatics for whole grids, see MeshElectrostatics.h
+   void SetMesh(double sigma);
+   int MeshTerms(int *mask);
+   int MeshPotential();
+   void EvaluateMeshTerms(const int *n, const double *gx, const double *gy, const double *gz,
+			  const int *mask, double *v_terms, int ldv);
+   void EvaluateMeshPotential(const int *n, const double *gx, const double *gy, const double *gz, double *v);
+   // H-matrix products with InvA, see HMatrix.h
+   void SetHMatrix(double tol);
+   int BatchTile();
+   void EvaluateBatch(int np, const double *r, double *v, double *energies);
    double MinDistCheck(const double *relectron);
    void ReportEnergies(int n, double *e);
    int getPolType();
@@ -55,12 +108,18 @@ public:
                      double *TDerivXZ ,
                      double *Rij, double alpha_i, double alpha_j, double aThole) ;
 
-   void EvaluateGradient(const double *r, dVec& Grad, dVec& mu,dVec& mu_cross_mu, double wavefn, class WaterCluster &WaterN);
-   void DerivElecField ( int nSites, double DampParameter, double *Rminus3 , double *R , double *Grad , double *mu) ;
+   void EvaluateGradient(const double *r, dVec& Grad, dVec& mu,dVec& mu_cross_mu, double wavefn, class WaterCluster &WaterN,
+			 const double *cachedmu = 0);
+   void DerivElecField ( int nSites, double DampParameter, double *Rminus3 , double *R , double *Grad , const double *mu) ;
    void FinalGradient( int nAtoms, double *Gradient, double *mu, double *mu_cross_mu,
                                double *dT_x, double *dT_y, double *dT_z, double *dEfield);
 
-   void MuCrossMu (int nAtoms, double *mu ,dVec& mu1,dVec& mu_cross_mu  , double wavefn) ;
+   void MuCrossMu (int nAtoms, const double *mu ,dVec& mu1,dVec& mu_cross_mu  , double wavefn) ;
+
+   // induced dipoles of this thread's most recent Evaluate if they are the ones
+   // EvaluateGradient needs (PolType 3, DampType 2, no H-matrix), else 0; n is their number
+   const double* InducedDipoles(int *n);
+   int SetupCount() const { return nSetups; }  // changes with every Setup and UpdateParameters
    void SubtractWWGradient (int nSites, double *PolGrad, double *Gradient) ;
 
 
@@ -76,6 +135,13 @@ public:
 
   void UpdateParameters(const double *PotPara);
 
+  // term-decomposed evaluation for fast reparametrization (DPPnSP only, see Potential.cpp)
+  enum {TermPC, TermInd, TermRepH, TermRepO, TermPol, NTERMS};
+  int nPotentialTerms();
+  void EvaluateTerms(const double *r, const int *mask, double *terms);
+  void TermCoefficients(double *c);
+  void TermKeys(double *keys);
+
   void PrintMinMax();
   
   // for SphericalPot
@@ -87,6 +153,15 @@ public:
 private: // METHODS
 
    void SetSites(int n, const double* sites);
+   void ComputeDistances(const double *r);
+   PotentialWorkspace& Work();
+   void MeshChargesDipoles(const int *n, const double *gx, const double *gy, const double *gz,
+			   double *vq, double *vd);
+   void SetupHMatrix(int npp, const double *R);
+   double DampedCharge(int i, double R, double R2);
+   double DampedDipole(double R, double R2);
+   double DampingRange();
+   void SetupRadialTables();
    void SetCharges(int n, const double *q, const int *iq);
    void SetDipoles(int n, const double *d, const int *id);
    void SetGauss(int n, const double *expcoeff, const int *ig);
@@ -100,6 +175,9 @@ private: // METHODS
 		     const double *DmuByDR, const double *potpara);
 
    double EvaluateDPPGTOP(const double *x);
+   void SelectDPPKernel();
+   template <int Damp, int Core, int Pol, int Adiabatic>
+   void EvaluateDPPTile(int np, const double *r, double *v, double *energies);
 
    void Set6GTORepCore(int n);
    void Set12GTORepCore(int n);
@@ -108,6 +186,9 @@ private: // METHODS
    double EvaluateChargePotential(const double *x, int DampFlag, double DampParameter);
    double EvaluateDipolePotential(const double *x, int DampFlag, double DampParameter);
    double EvaluateRepulsivePotential(const double *x, int RepCoreFlag);
+   void EvaluateRepulsiveTerms(const double *x, int RepCoreFlag, double *VrepH, double *VrepO);
+   double EvaluatePolarizationTerm(const double *x);
+   int LinearPolTerm();
    double EvaluatePolPot(const double *x, int DampFlag, double DampParameter);
    double EvaluateMolecularPolarizableSites(const double *x, int DampFlag, double DampParameter);
    double SelfConsistentPolarizability(const double *x, int DampFlag, double DampParameter);
@@ -116,7 +197,8 @@ private: // METHODS
    void EvaluateDPP6SPGradient(const double *x, dVec& Grad);
 
 //   void EvaluateDPPGTOPGradient(const double *x, dVec& Grad, double *dEfield, double *PolGrad,  class WaterCluster &WaterN);
-   void EvaluateDPPGTOPGradient(const double *x, dVec& Grad,dVec& mu,dVec& mu_cross_mu, double wavefn, class WaterCluster &WaterN);
+   void EvaluateDPPGTOPGradient(const double *x, dVec& Grad,dVec& mu,dVec& mu_cross_mu, double wavefn, class WaterCluster &WaterN,
+				const double *cachedmu);
    double EvaluateDPPTB(const double *x);
    double EvaluateBloomfield(const double *x);
 
@@ -130,6 +212,10 @@ private: // METHODS
    double EvaluateCsixty(const double *x);
    void SetSitesCsixty(int n, const double* sites);
    double EvaluateCsixtyPolPot(const double *x);
+   void EvaluateCsixtyBatch(int np, const double *r, double *v, double *energies);
+   void CsixtyPolField(double *f);
+   int CsixtyPolDim();
+   void SetupCsixtyPolPot();
    double EvaluateCsixtyElecPot(const double *x);
    double EvaluateColoreneElecPot(const double *x);
    double EvaluateCsixtyRepPot(const double *x, double RepScale, double GaussExp);
@@ -138,6 +224,9 @@ private: // METHODS
    double EvaluateSphericalPotential(const double *x);
    // for colorene system
    void SetCoroneneGDMA();
+   void SetupGDMAMultipoles();
+   double GDMANearField(int first, int last);
+   double GDMAFarField(int m, const double *x);
 
    double CalculateOverlapIntegral_S(double c1, double a1, int l1, int m1, int n1,
                                             double x1, double y1, double z1,
@@ -153,6 +242,7 @@ private: // DATA MEMBERS
 
    iVec PotFlags;
    int verbose;
+   int nSetups;
    int DampType;           // 1=Thole-like GTO  2=effective distance
    int SigmaOFlag;         // separate scaling for Vrep on O nad H (kind of deprecated)
    int PolType;            // 1=isotropic molecular, 2=interacting atomic, non-interacting molecular, 3=fully interacting
@@ -172,6 +262,10 @@ private: // DATA MEMBERS
    double AnionDamping;
    // distance cut-off for interpolation
    double Rtol;
+   // width of the long-range part for particle-mesh electrostatics [grid spacings], 0 = off
+   double MeshSigma;
+   // accuracy of the H-matrix copy of InvA, 0 = off (dense products)
+   double HMatrixTol;
 
 
    // for C60
@@ -187,6 +281,8 @@ private: // DATA MEMBERS
    dVec PtDip ;
    dVec AngleArray ;
    dVec EfieldOnAtoms ; 
+   dVec MuOnAtoms ;      // InvA * EfieldOnAtoms
+   double VpolOnAtoms ;  // electron-independent part of Vpol
    int nFullerenes ;
    iVec nAtomsArray ;
    //iVec nAtomsArray ; 
@@ -220,26 +316,30 @@ private: // DATA MEMBERS
    dVec Gauss;       // 2*nGauss (exp + coef)
    iVec GaussSite;   // mapping again
 
-   struct DistributedPolarizabilities *MolPol;
+   // tabulated radial functions of the current parameters (RadialTable.h)
+   RadialTable ChargeTable;   // 1 - exp(-ChargeDamping R^2)
+   RadialTable DipoleTable;   // 1 - exp(-DipoleDamping R^2)
+   RadialTable PolTable;      // 1 - exp(-PolDamping R^2)
+   RadialTable TholeTable;    // 1 - exp(-PolDamping R^3)
+   RadialTable CationTable;   // erf(CationDamping R)/R
+   RadialTable AnionTable;    // erf(AnionDamping R)/R
+   MeshElectrostatics Mesh;   // keeps the transformed kernel between grids of the same shape
+   std::vector<RadialTable> CoreTables;  // one per distinct exponent in Gauss
+   iVec GaussTable;                      // Gauss -> CoreTables
+   int CoreTabulated;                    // RepCoreType if all of Gauss are in CoreTables, else 0
+
+   // the batched kernel of the model that has been set up (DPPKernels.cpp)
+   typedef void (Potential::*TileKernel)(int np, const double *r, double *v, double *energies);
+   TileKernel DPPKernel;
 
-   dVec Rx;
-   dVec Ry;
-   dVec Rz;
-   dVec R;
-   dVec R2;
-   dVec Rminus3;
+   struct DistributedPolarizabilities *MolPol;
 
-   dVec RVec;
-   dVec X;
-   dVec Y;
-   dVec Z;
+   // one scratch workspace per thread
+   std::vector<PotentialWorkspace> Workspaces;
 
    // for MinMax debug output and detailed reporting
    int nContributions;
    int nReturnEnergies;
-   dVec ReturnEnergies;
-   dVec MaxV;
-   dVec MinV;
 
    
    // for the GDMA analysis
@@ -269,6 +369,15 @@ private: // DATA MEMBERS
   dVec Q44c;
   dVec Q44s;
 
+  // GDMA moments as Cartesian tensors, packed component-major: [c*nSites + site]
+  // c = 0 charge, 1-3 dipole, 4-9 quadrupole, 10-19 octupole (see SetupGDMAMultipoles)
+  dVec GDMAMultipoles;
+  // far field: one charge+dipole+quadrupole expansion per molecule
+  double FarFieldCsixty;  // used beyond FarFieldCsixty * molecule radius; 0 = off
+  dVec MolCenter;         // 3 per molecule
+  dVec MolRadius;
+  dVec MolMultipoles;     // 10 per molecule, same order as GDMAMultipoles
+
 /*
     dVec Qxx; 
     dVec Qyy; 
@@ -0,0 +1,315 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+#include <mpi.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "Profiler.h"
+
+using namespace std;
+
+bool Profiler::enabled = false;
+
+namespace {
+
+  struct Node {
+    string name;
+    int parent;
+    vector<int> children;
+    long calls;
+    double time;       // inclusive wall time of the finished calls
+    double start;      // of the current call
+    vector<string> cname;
+    vector<double> csum;
+    vector<long> cn;
+  };
+
+  // the tree of one thread, padded to keep the threads apart
+  struct ThreadTree {
+    ThreadTree() : current(-1) {}
+    vector<Node> nodes;
+    int current;
+    char pad[64];
+  };
+
+  vector<ThreadTree> trees;
+  string reportfile;
+  // path of the open region of the master thread outside of parallel regions;
+  // the regions of the other threads are put below it
+  string masterpath;
+
+  // the tree of the calling thread, or 0 for nested parallel regions and extra threads
+  inline ThreadTree* MyTree(int *tid)
+  {
+#ifdef _OPENMP
+    if (omp_get_level() > 1)
+      return 0;
+    *tid = omp_get_thread_num();
+#else
+    *tid = 0;
+#endif
+    return (*tid < (int)trees.size()) ? &trees[*tid] : 0;
+  }
+
+  string Path(const vector<Node> &nodes, int n)
+  {
+    if (n < 0)
+      return "";
+    string p = nodes[n].name;
+    for (n = nodes[n].parent; n >= 0; n = nodes[n].parent)
+      p = nodes[n].name + "/" + p;
+    return p;
+  }
+
+  inline void SetMasterPath(int tid, const ThreadTree *t)
+  {
+#ifdef _OPENMP
+    if (tid != 0 || omp_in_parallel())
+      return;
+#endif
+    masterpath = Path(t->nodes, t->current);
+  }
+
+  string JsonString(const string &s)
+  {
+    string r = "\"";
+    for (size_t i = 0; i < s.size(); ++i) {
+      if (s[i] == '"' || s[i] == '\\')
+	r += '\\';
+      r += s[i];
+    }
+    return r + "\"";
+  }
+
+  // statistics of one region over all ranks and threads
+  struct Summary {
+    long calls;
+    vector<double> ranktime;   // max over the threads of a rank, -1 if the rank has no such region
+    vector<double> threadtime;
+    map<string, double> csum;
+    map<string, long> cn;
+  };
+
+  void MinAvgMax(const vector<double> &v, double *mn, double *avg, double *mx, int *n)
+  {
+    *mn = 0; *avg = 0; *mx = 0; *n = 0;
+    for (size_t i = 0; i < v.size(); ++i) {
+      if (v[i] < 0) continue;
+      if (*n == 0 || v[i] < *mn) *mn = v[i];
+      if (*n == 0 || v[i] > *mx) *mx = v[i];
+      *avg += v[i];
+      (*n) ++;
+    }
+    if (*n > 0)
+      *avg /= *n;
+  }
+
+}
+
+
+void Profiler::Enable(const char *fname)
+{
+#ifndef PISCES_NO_PROFILER
+#ifdef _OPENMP
+  trees.resize(omp_get_max_threads());
+#else
+  trees.resize(1);
+#endif
+  reportfile = fname;
+  enabled = true;
+#endif
+}
+
+
+void Profiler::Begin(const char *name)
+{
+  int tid;
+  ThreadTree *t = MyTree(&tid);
+  if (t == 0)
+    return;
+  vector<Node> &nodes = t->nodes;
+  int n = -1;
+  string key = name;
+  if (t->current >= 0) {
+    const vector<int> &ch = nodes[t->current].children;
+    for (size_t i = 0; i < ch.size(); ++i)
+      if (nodes[ch[i]].name == key) { n = ch[i]; break; }
+  }
+  else {
+    if (tid > 0 && !masterpath.empty())
+      key = masterpath + "/" + key;
+    for (size_t i = 0; i < nodes.size(); ++i)
+      if (nodes[i].parent < 0 && nodes[i].name == key) { n = (int)i; break; }
+  }
+  if (n < 0) {
+    n = (int)nodes.size();
+    nodes.push_back(Node());
+    nodes[n].name = key;
+    nodes[n].parent = t->current;
+    nodes[n].calls = 0;
+    nodes[n].time = 0;
+    if (t->current >= 0)
+      nodes[t->current].children.push_back(n);
+  }
+  t->current = n;
+  SetMasterPath(tid, t);
+  nodes[n].start = MPI_Wtime();
+}
+
+
+void Profiler::End()
+{
+  double now = MPI_Wtime();
+  int tid;
+  ThreadTree *t = MyTree(&tid);
+  if (t == 0 || t->current < 0)
+    return;
+  Node &node = t->nodes[t->current];
+  node.time += now - node.start;
+  node.calls ++;
+  t->current = node.parent;
+  SetMasterPath(tid, t);
+}
+
+
+void Profiler::AddCount(const char *name, double value)
+{
+  int tid;
+  ThreadTree *t = MyTree(&tid);
+  if (t == 0 || t->current < 0)
+    return;
+  Node &node = t->nodes[t->current];
+  size_t i = 0;
+  while (i < node.cname.size() && node.cname[i] != name)
+    ++i;
+  if (i == node.cname.size()) {
+    node.cname.push_back(name);
+    node.csum.push_back(0);
+    node.cn.push_back(0);
+  }
+  node.csum[i] += value;
+  node.cn[i] ++;
+}
+
+
+//
+//  every rank writes its regions as lines
+//    path  thread  calls  time  ncounters  (name  sum  n)...
+//  rank 0 gathers the text and computes the statistics
+//
+void Profiler::Report()
+{
+  if (!Enabled())
+    return;
+
+  int rank, size;
+  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_size( MPI_COMM_WORLD, &size );
+
+  double now = MPI_Wtime();
+  ostringstream text;
+  text.precision(17);
+  for (size_t it = 0; it < trees.size(); ++it) {
+    vector<Node> nodes = trees[it].nodes;
+    // regions still open count as one call until now
+    for (int n = trees[it].current; n >= 0; n = nodes[n].parent) {
+      nodes[n].time += now - nodes[n].start;
+      nodes[n].calls ++;
+    }
+    for (size_t n = 0; n < nodes.size(); ++n) {
+      text << Path(nodes, (int)n) << '\t' << it << '\t' << nodes[n].calls << '\t' << nodes[n].time
+	   << '\t' << nodes[n].cname.size();
+      for (size_t i = 0; i < nodes[n].cname.size(); ++i)
+	text << '\t' << nodes[n].cname[i] << '\t' << nodes[n].csum[i] << '\t' << nodes[n].cn[i];
+      text << '\n';
+    }
+  }
+
+  string mine = text.str();
+  int len = (int)mine.size();
+  vector<int> lens(size), offs(size);
+  MPI_Gather(&len, 1, MPI_INT, &lens[0], 1, MPI_INT, 0, MPI_COMM_WORLD);
+  int total = 0;
+  for (int i = 0; i < size; ++i) {
+    offs[i] = total;
+    total += lens[i];
+  }
+  vector<char> all(rank == 0 ? total + 1 : 1);
+  MPI_Gatherv(&mine[0], len, MPI_CHAR, &all[0], &lens[0], &offs[0], MPI_CHAR, 0, MPI_COMM_WORLD);
+  if (rank != 0)
+    return;
+
+  map<string, Summary> regions;
+  int maxthreads = 0;
+  for (int r = 0; r < size; ++r) {
+    istringstream in(string(&all[offs[r]], lens[r]));
+    string line;
+    while (getline(in, line)) {
+      istringstream f(line);
+      string path, cname;
+      int thread, nc;
+      long calls, n;
+      double time, sum;
+      getline(f, path, '\t');
+      f >> thread >> calls >> time >> nc;
+      maxthreads = max(maxthreads, thread + 1);
+      Summary &s = regions[path];
+      if (s.ranktime.empty()) {
+	s.calls = 0;
+	s.ranktime.assign(size, -1.0);
+      }
+      s.calls += calls;
+      s.ranktime[r] = max(s.ranktime[r], time);
+      s.threadtime.push_back(time);
+      for (int i = 0; i < nc; ++i) {
+	f.ignore(1);
+	getline(f, cname, '\t');
+	f >> sum >> n;
+	s.csum[cname] += sum;
+	s.cn[cname] += n;
+      }
+    }
+  }
+
+  FILE *out = fopen(reportfile.c_str(), "w");
+  if (out == 0) {
+    cout << "Profiler: cannot open " << reportfile << "\n";
+    return;
+  }
+  fprintf(out, "{\n  \"ranks\": %d,\n  \"threads\": %d,\n  \"regions\": [", size, maxthreads);
+  const char *sep = "";
+  for (map<string, Summary>::iterator ir = regions.begin(); ir != regions.end(); ++ir) {
+    Summary &s = ir->second;
+    double mn, avg, mx;
+    int nr, nt;
+    fprintf(out, "%s\n    {\"path\": %s, \"calls\": %ld,", sep, JsonString(ir->first).c_str(), s.calls);
+    MinAvgMax(s.ranktime, &mn, &avg, &mx, &nr);
+    fprintf(out, "\n     \"rank_time\": {\"n\": %d, \"min\": %.6e, \"avg\": %.6e, \"max\": %.6e},", nr, mn, avg, mx);
+    double wall = mx;
+    MinAvgMax(s.threadtime, &mn, &avg, &mx, &nt);
+    fprintf(out, "\n     \"thread_time\": {\"n\": %d, \"min\": %.6e, \"avg\": %.6e, \"max\": %.6e},", nt, mn, avg, mx);
+    // rates refer to the wall time, i.e., the slowest rank
+    fprintf(out, "\n     \"counters\": {");
+    const char *csep = "";
+    for (map<string, double>::iterator ic = s.csum.begin(); ic != s.csum.end(); ++ic) {
+      long n = s.cn[ic->first];
+      fprintf(out, "%s\n       %s: {\"sum\": %.6e, \"mean\": %.6e, \"per_s\": %.6e}", csep,
+	      JsonString(ic->first).c_str(), ic->second, (n > 0) ? ic->second / n : 0.0,
+	      (wall > 0) ? ic->second / wall : 0.0);
+      csep = ",";
+    }
+    fprintf(out, "}}");
+    sep = ",";
+  }
+  fprintf(out, "\n  ]\n}\n");
+  fclose(out);
+  cout << "Profile written to " << reportfile << "\n";
+}
@@ -0,0 +1,56 @@
+#ifndef PISCES_PROFILER_H_
+#define PISCES_PROFILER_H_
+
+//
+//  hierarchical profiler: named, nestable regions with call counts and counters
+//
+//  regions are opened and closed by profile_region objects (progress_timer opens one, too),
+//  each thread keeps its own tree of regions, so regions inside OpenMP loops are fine
+//  (they appear below the region the master thread had open when the loop started)
+//  counters (Count) are added to the innermost open region of the calling thread,
+//  e.g. grid points or floating point operations, and are reported as sum, mean per
+//  Count() call, and rate (sum per second of wall time)
+//
+//  Report() is collective over MPI_COMM_WORLD: rank 0 collects the trees of all ranks
+//  and writes a JSON file with min/avg/max over ranks and over threads for every region
+//
+//  if the profiler is not enabled a region costs one test of a static flag,
+//  compiling with PISCES_NO_PROFILER removes even that
+//
+class Profiler
+{
+public:
+  /// start collecting; the report goes to fname
+  static void Enable(const char *fname = "profile.json");
+#ifdef PISCES_NO_PROFILER
+  static bool Enabled() { return false; }
+#else
+  static bool Enabled() { return enabled; }
+#endif
+
+  static void Begin(const char *name);
+  static void End();
+  static void Count(const char *name, double value) { if (Enabled()) AddCount(name, value); }
+
+  /// collective; writes the report on rank 0
+  static void Report();
+
+private:
+  static void AddCount(const char *name, double value);
+  static bool enabled;
+};
+
+
+/// a profiler region for the lifetime of the object
+class profile_region
+{
+public:
+  explicit profile_region(const char *name) : on(Profiler::Enabled()) { if (on) Profiler::Begin(name); }
+  ~profile_region() { if (on) Profiler::End(); }
+private:
+  profile_region(const profile_region &);
+  profile_region& operator=(const profile_region &);
+  bool on;
+};
+
+#endif // PISCES_PROFILER_H_
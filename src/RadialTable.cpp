@@ -0,0 +1,168 @@
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+#include "RadialTable.h"
+
+using namespace std;
+
+
+//
+//  tabulate kind k with parameter param to the relative accuracy tol
+//  tol <= 0 or an unknown kind switches the table off
+//
+void RadialTable::Setup(Kind k, double param, double tol)
+{
+  kind = k;
+  a = param;
+  n = 0;
+  coef.clear();
+  if (kind == None || tol <= 0 || !(a > 0))
+    return;
+
+  for (int nint = 16; nint <= MaxIntervals; nint *= 2) {
+    Fit(nint);
+    if (MaxError() < 0.25 * tol * Scale())
+      return;
+  }
+  // not worth it, use libm
+  n = 0;
+  coef.clear();
+}
+
+
+//
+//  f(x) with libm
+//
+double RadialTable::Exact(double x) const
+{
+  switch (kind)
+    {
+    case GaussDamp:
+      return 1.0 - exp(-a * x);
+    case GaussCore:
+      return exp(-a * x);
+    case ErfCoulomb:
+      {
+	double R = sqrt(x);
+	if (a * R < 1e-8)
+	  return 2.0 * a / sqrt(M_PI);
+	return erf(a * R) / R;
+      }
+    case SlaterCore:
+      return exp(-a * x);
+    case TholeDamp:
+      return 1.0 - exp(-a * x * x * x);
+    default:
+      cout << "RadialTable::Exact: kind " << kind << ", this should not happen\n";
+      exit(1);
+    }
+  return 0;
+}
+
+
+//
+//  x beyond which f is its asymptote to about 1e-17
+//  exp(-40) = 4e-18,  erfc(6) = 2e-17
+//
+double RadialTable::Range() const
+{
+  switch (kind)
+    {
+    case GaussDamp:
+    case GaussCore:
+    case SlaterCore:
+      return 40.0 / a;
+    case ErfCoulomb:
+      return 36.0 / (a * a);
+    case TholeDamp:
+      return cbrt(40.0 / a);
+    default:
+      return 0;
+    }
+}
+
+//
+//  max |f|, the error is relative to this
+//
+double RadialTable::Scale() const
+{
+  return (kind == ErfCoulomb) ? 2.0 * a / sqrt(M_PI) : 1.0;
+}
+
+double RadialTable::Asymptote() const
+{
+  switch (kind)
+    {
+    case GaussDamp:
+    case TholeDamp:
+      return 1.0;
+    case ErfCoulomb:
+      return Exact(xmax);   // never used, Coulomb() returns 1/R
+    default:
+      return 0.0;
+    }
+}
+
+
+//
+//  interpolate at the NCOEF Chebyshev points of each of nint intervals
+//  the Chebyshev series in t = 2u-1 is then converted to monomials in u
+//
+void RadialTable::Fit(int nint)
+{
+  const int m = NCOEF;
+  n = nint;
+  xmax = Range();
+  h = xmax / n;
+  hinv = 1.0 / h;
+  coef.assign(m*(n+1), 0.0);
+
+  // shifted Chebyshev polynomials T_j(2u-1) as monomials in u: tm[m*j + p]
+  double tm[m*m] = {0};
+  tm[0] = 1.0;
+  tm[m+0] = -1.0;
+  tm[m+1] = 2.0;
+  for (int j = 2; j < m; ++j)
+    for (int p = 0; p < m; ++p) {
+      double v = -2.0 * tm[m*(j-1)+p] - tm[m*(j-2)+p];
+      if (p > 0)
+	v += 4.0 * tm[m*(j-1)+p-1];
+      tm[m*j+p] = v;
+    }
+
+  double node[m], f[m];
+  for (int l = 0; l < m; ++l)
+    node[l] = cos(M_PI * (l + 0.5) / m);   // in t
+
+  for (int i = 0; i < n; ++i) {
+    for (int l = 0; l < m; ++l)
+      f[l] = Exact(h * (i + 0.5 * (node[l] + 1.0)));
+    double *c = &coef[m*i];
+    for (int j = 0; j < m; ++j) {
+      double cj = 0;
+      for (int l = 0; l < m; ++l)
+	cj += f[l] * cos(M_PI * j * (l + 0.5) / m);
+      cj *= ((j == 0) ? 1.0 : 2.0) / m;
+      for (int p = 0; p < m; ++p)
+	c[p] += cj * tm[m*j+p];
+    }
+  }
+  coef[m*n] = Asymptote();
+}
+
+
+//
+//  largest error at 8 points of each interval, none of them an interpolation point
+//
+double RadialTable::MaxError() const
+{
+  double err = 0;
+  for (int i = 0; i < n; ++i)
+    for (int l = 0; l < 8; ++l) {
+      double x = h * (i + (l + 0.5) / 8.0);
+      err = max(err, fabs((*this)(x) - Exact(x)));
+    }
+  return err;
+}
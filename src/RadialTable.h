@@ -0,0 +1,81 @@
+#ifndef PISCES_RADIALTABLE_H_
+#define PISCES_RADIALTABLE_H_
+
+#include <algorithm>
+#include "vecdefs.h"
+
+//
+//  tabulated radial functions of the potential kernels
+//
+//  f(x) is stored as a piecewise polynomial of degree 5 on a uniform grid x_k = k*h, 0 <= x <= xmax;
+//  x is R^2 for the functions that are smooth in R^2 (Gaussian damping, GTO cores, erf(aR)/R),
+//  and R for those that are not (STO cores, cubic Thole damping)
+//
+//  on each interval the polynomial interpolates f at the Chebyshev points;
+//  Setup doubles the number of intervals until the error at 8 test points of every interval
+//  is below tol/4 (relative to max|f|), so the interpolation error is below tol;
+//  if that takes more than MaxIntervals, the table is not used (Tabulated() = 0),
+//  and the callers evaluate f with libm, as before
+//
+//  beyond xmax the functions have reached their asymptotic value (to 1e-17), which is
+//  stored as one more, constant, interval; so the lookup has no branches and vectorizes:
+//  a clamp, a gather of 6 coefficients, and 5 FMAs
+//
+class RadialTable
+{
+public:
+
+  enum Kind {
+    None = 0,
+    GaussDamp,     // 1 - exp(-a R^2)     x = R^2
+    GaussCore,     // exp(-a R^2)         x = R^2
+    ErfCoulomb,    // erf(a R) / R        x = R^2, the asymptote is 1/R, see Coulomb()
+    SlaterCore,    // exp(-a R)           x = R
+    TholeDamp      // 1 - exp(-a R^3)     x = R
+  };
+
+  RadialTable() : kind(None), a(0), n(0), h(0), hinv(0), xmax(0) {}
+
+  void Setup(Kind k, double param, double tol);
+  double Exact(double x) const;
+
+  /// true if the table is set up for f(x) with parameter param
+  bool Is(Kind k, double param) const { return kind == k && a == param && n > 0; }
+  int Tabulated() const { return n > 0; }
+  int Intervals() const { return n; }
+
+  inline double operator()(double x) const
+  {
+    double t = std::min(x, xmax) * hinv;
+    int i = int(t);
+    double u = t - i;
+    const double *c = &coef[NCOEF*i];
+    return c[0] + u*(c[1] + u*(c[2] + u*(c[3] + u*(c[4] + u*c[5]))));
+  }
+
+  /// ErfCoulomb: erf(aR)/R, with x = R^2 and Rinv = 1/R
+  inline double Coulomb(double x, double Rinv) const
+  {
+    return (x < xmax) ? (*this)(x) : Rinv;
+  }
+
+  enum {NCOEF = 6, MaxIntervals = 8192};
+
+private:
+
+  Kind kind;
+  double a;          // the parameter (exponent)
+  int n;             // intervals, 0 = not tabulated
+  double h;          // interval length
+  double hinv;
+  double xmax;       // n*h, where f has reached its asymptote
+  dVec coef;         // NCOEF*(n+1), monomials in u = x/h - i, lowest first
+
+  double Range() const;
+  double Scale() const;
+  double Asymptote() const;
+  void Fit(int nint);
+  double MaxError() const;
+};
+
+#endif // PISCES_RADIALTABLE_H_
@@ -6,7 +6,9 @@
 #include <cstring>
 #include <cctype>
 #include <iostream>
-#include <fstream>
+#include <vector>
+
+#include "ReadCubeFile.h"
 
 using namespace std;
 
@@ -14,91 +16,343 @@ using namespace std;
 //  const double Angs2Bohr = 1.889725989;
 
 
-void ReadCubeFile(int *npts, double *x0, double *dx, double **cube)
+// 10^0 ... 10^22, all exact
+struct ExactPowers {
+  double p[23];
+  ExactPowers() { p[0] = 1.0; for (int k = 1; k < 23; ++k) p[k] = 10.0 * p[k-1]; }
+};
+
+//
+//  parse one number starting at p (no leading white space), return the position behind it
+//  [-+]ddd.ddd[eEdD][-+]dd with a mantissa below 2^53 and |exponent| <= 22 is parsed directly
+//  (one multiplication or division by an exact power, so correctly rounded as strtod),
+//  everything else by strtod
+//
+static const char* ParseDouble(const char *p, const char *end, double *x)
 {
+  static const ExactPowers tenpow;
 
-  cout << "\nReading a start vector from cube file\n";
+  const char *s = p;
+  int neg = 0;
+  if (p < end && (*p == '-' || *p == '+'))
+    neg = (*p++ == '-');
+  unsigned long long m = 0;
+  int ndig = 0, e10 = 0;
+  while (p < end && *p >= '0' && *p <= '9') {
+    m = 10*m + (*p++ - '0');
+    ndig ++;
+  }
+  if (p < end && *p == '.') {
+    p++;
+    while (p < end && *p >= '0' && *p <= '9') {
+      m = 10*m + (*p++ - '0');
+      ndig ++;
+      e10 --;
+    }
+  }
+  if (p < end && (*p == 'e' || *p == 'E' || *p == 'd' || *p == 'D')) {
+    p++;
+    int eneg = 0, e = 0;
+    if (p < end && (*p == '-' || *p == '+'))
+      eneg = (*p++ == '-');
+    while (p < end && *p >= '0' && *p <= '9' && e < 10000)
+      e = 10*e + (*p++ - '0');
+    e10 += (eneg) ? -e : e;
+  }
+  if (ndig == 0 || ndig > 18 || m >= (1ULL << 53) || e10 < -22 || e10 > 22 || (p < end && !isspace(*p))) {
+    // not a plain number: let the library do it
+    char buf[64];
+    int len = 0;
+    while (s + len < end && !isspace(s[len]) && len < 63)
+      len ++;
+    memcpy(buf, s, len);
+    buf[len] = 0;
+    *x = strtod(buf, 0);
+    return s + len;
+  }
+  double v = (double)m;   // exact
+  if (e10 < 0)
+    v /= tenpow.p[-e10];
+  else
+    v *= tenpow.p[e10];
+  *x = (neg) ? -v : v;
+  return p;
+}
 
-  int i;
-  int verbose = 1;
-  const char *fngrid = "StartVector.cub";
-  ifstream input;
-  input.open(fngrid);
+static const char* NextLine(const char *p, const char *end)
+{
+  while (p < end && *p != '\n')
+    p++;
+  return (p < end) ? p + 1 : end;
+}
 
+static void CopyLine(const char *p, const char *end, char *buf, int maxlen)
+{
+  int len = 0;
+  while (p + len < end && p[len] != '\n' && len < maxlen)
+    len ++;
+  memcpy(buf, p, len);
+  buf[len] = 0;
+}
 
-  const int LineLength = 132;
-  char buffer[LineLength+1];
 
-  // two comment lines, after that formatted input
-  input.getline(buffer, LineLength);
-  input.getline(buffer, LineLength);
+//
+//  header and block index only; the values are parsed by ParseBlock() or Read()
+//
+int CubeFile::Open(const char *fname, int verbose)
+{
+  data = 0;
+  values.clear();
+  blockStart.clear();
+  blockFirst.clear();
+  if (mf.Open(fname) != 0) {
+    cout << "CubeFile::Read: cannot open " << fname << "\n";
+    return -1;
+  }
+  if (verbose > 0)
+    cout << "\nReading cube file " << fname << "\n";
+  binary = (mf.Size() >= 8 && memcmp(mf.Data(), "PISCESCB", 8) == 0);
+  int err = (binary) ? ReadBinary() : ReadText();
+  if (err == 0 && verbose > 0) {
+    cout << n[0] << " x pts from " << x0[0] << " to " << x0[0]+(n[0]-1)*dx[0] << " steplength = " << dx[0] << endl;
+    cout << n[1] << " y pts from " << x0[1] << " to " << x0[1]+(n[1]-1)*dx[1] << " steplength = " << dx[1] << endl;
+    cout << n[2] << " z pts from " << x0[2] << " to " << x0[2]+(n[2]-1)*dx[2] << " steplength = " << dx[2] << endl;
+  }
+  return err;
+}
 
-  
-  // read no of atoms and grid parameters
-  int nnuc;
-  int nx, ny, nz;
-  double xx, yy, zz;
 
-  input.getline(buffer, LineLength);
-  sscanf(buffer, "%i %lf %lf %lf", &nnuc, x0, x0+1, x0+2);
-  //input >> nnuc >> x0[0] >> x0[1] >> x0[2];
+int CubeFile::Read(const char *fname, int verbose)
+{
+  if (Open(fname, verbose) != 0)
+    return -1;
+  if (binary)
+    return 0;   // data points into the mapped file
+  long ntotal = (long)n[0] * n[1] * n[2];
+  values.resize(ntotal);
+#pragma omp parallel for schedule(dynamic)
+  for (int ib = 0; ib < nBlocks(); ++ib)
+    ParseBlock(ib, &values[BlockFirst(ib)]);
+  if (verbose > 0)
+    printf("Last value read is %e (no %li)\n", values[ntotal-1], ntotal);
+  data = &values[0];
+  return 0;
+}
+
+
+//
+//  grid point of the i-th value in the file
+//
+void CubeFile::Point(long i, int *ix, int *iy, int *iz) const
+{
+  if (binary) {
+    // x fastest
+    *ix = int(i % n[0]);
+    i /= n[0];
+    *iy = int(i % n[1]);
+    *iz = int(i / n[1]);
+  }
+  else {
+    // z fastest
+    *iz = int(i % n[2]);
+    i /= n[2];
+    *iy = int(i % n[1]);
+    *ix = int(i / n[1]);
+  }
+}
+
+
+//
+//  the values of block ib, i.e., BlockSize(ib) values starting at BlockFirst(ib) in file order
+//
+void CubeFile::ParseBlock(int ib, double *v) const
+{
+  long nb = BlockSize(ib);
+  if (binary) {
+    memcpy(v, mf.Data() + BinaryHeader + BlockFirst(ib)*sizeof(double), nb*sizeof(double));
+    return;
+  }
+  const char *q = blockStart[ib];
+  const char *qend = blockStart[ib+1];
+  for (long k = 0; k < nb; ++k) {
+    while (isspace(*q)) q++;
+    q = ParseDouble(q, qend, v + k);
+  }
+}
+
 
-  input.getline(buffer, LineLength);
-  sscanf(buffer, "%i %lf %lf %lf", &nx, &(dx[0]), &yy, &zz);
-  //  input >> nx >> dx[0] >> yy >> zz;
-  if (yy != 0 || zz != 0) {cout << "Only cartesian grids please:"<< buffer <<"\n"; exit(1);}
+//
+//  binary sibling: the values are used in place
+//
+int CubeFile::ReadBinary()
+{
+  const size_t header = BinaryHeader;
+  if (mf.Size() < header) {
+    cout << "CubeFile::Read: truncated binary cube\n";
+    return -1;
+  }
+  memcpy(n, mf.Data() + 8, 3*sizeof(int));
+  memcpy(x0, mf.Data() + 8 + 4*sizeof(int), 3*sizeof(double));
+  memcpy(dx, mf.Data() + 8 + 4*sizeof(int) + 3*sizeof(double), 3*sizeof(double));
+  if (n[0] <= 0 || n[1] <= 0 || n[2] <= 0) {
+    cout << "CubeFile::Read: invalid grid " << n[0] << " x " << n[1] << " x " << n[2] << " in binary cube\n";
+    return -1;
+  }
+  long ntotal = (long)n[0] * n[1] * n[2];
+  if (mf.Size() < header + ntotal*sizeof(double)) {
+    cout << "CubeFile::Read: truncated binary cube\n";
+    return -1;
+  }
+  nAtoms = 0;
+  Z.clear();
+  Atoms.clear();
+  data = (const double*)(mf.Data() + header);
+  stride[0] = 1;
+  stride[1] = n[0];
+  stride[2] = (long)n[0]*n[1];
+
+  const long BlockLength = 1 << 16;
+  for (long i = 0; i < ntotal; i += BlockLength)
+    blockFirst.push_back(i);
+  blockFirst.push_back(ntotal);
+  return 0;
+}
 
-  input.getline(buffer, LineLength);
-  sscanf(buffer, "%i %lf %lf %lf", &ny, &xx, &(dx[1]), &zz);
-  //  input >> ny >> xx >> dx[1] >> zz;
-  if (xx != 0 || zz != 0) {cout << "Only cartesian grids please:"<< buffer <<"\n"; exit(1);}
 
-  input.getline(buffer, LineLength);
-  sscanf(buffer, "%i %lf %lf %lf", &nz, &xx, &yy, &(dx[2]));
-  //  input >> nz >> xx >> yy >> dx[2];
-  if (xx != 0 || yy != 0) {cout << "Only cartesian grids please:"<< buffer <<"\n"; exit(1);}
-  npts[0] = nx;
-  npts[1] = ny;
-  npts[2] = nz;
+//
+//  text cube: two comment lines, the grid, the atoms, (for nAtoms < 0 a list of orbitals),
+//  and the values with z running fastest
+//
+int CubeFile::ReadText()
+{
+  const char *p = mf.Data();
+  const char *end = p + mf.Size();
+  const int LineLength = 132;
+  char buffer[LineLength+1];
 
-  int ntotal = nx * ny * nz;
-  *cube = new double[ntotal];
-  
-  if (verbose > 0) {
-    cout << nx << " x pts from " << x0[0] << " to " << x0[0]+(nx-1)*dx[0] << " steplength = " << dx[0] << endl;
-    cout << ny << " y pts from " << x0[1] << " to " << x0[1]+(ny-1)*dx[1] << " steplength = " << dx[1] << endl;
-    cout << nz << " z pts from " << x0[2] << " to " << x0[2]+(nz-1)*dx[2] << " steplength = " << dx[2] << endl;
+  // two comment lines, after that formatted input
+  p = NextLine(p, end);
+  p = NextLine(p, end);
+
+  double xx, yy, zz;
+  CopyLine(p, end, buffer, LineLength); p = NextLine(p, end);
+  if (sscanf(buffer, "%i %lf %lf %lf", &nAtoms, x0, x0+1, x0+2) != 4) {
+    cout << "CubeFile::Read: cannot read the grid origin:" << buffer << "\n"; return -1;
+  }
+  CopyLine(p, end, buffer, LineLength); p = NextLine(p, end);
+  if (sscanf(buffer, "%i %lf %lf %lf", &n[0], &(dx[0]), &yy, &zz) != 4 || n[0] <= 0) {
+    cout << "CubeFile::Read: cannot read the x axis:" << buffer << "\n"; return -1;
+  }
+  if (yy != 0 || zz != 0) {cout << "Only cartesian grids please:"<< buffer <<"\n"; return -1;}
+  CopyLine(p, end, buffer, LineLength); p = NextLine(p, end);
+  if (sscanf(buffer, "%i %lf %lf %lf", &n[1], &xx, &(dx[1]), &zz) != 4 || n[1] <= 0) {
+    cout << "CubeFile::Read: cannot read the y axis:" << buffer << "\n"; return -1;
+  }
+  if (xx != 0 || zz != 0) {cout << "Only cartesian grids please:"<< buffer <<"\n"; return -1;}
+  CopyLine(p, end, buffer, LineLength); p = NextLine(p, end);
+  if (sscanf(buffer, "%i %lf %lf %lf", &n[2], &xx, &yy, &(dx[2])) != 4 || n[2] <= 0) {
+    cout << "CubeFile::Read: cannot read the z axis:" << buffer << "\n"; return -1;
   }
+  if (xx != 0 || yy != 0) {cout << "Only cartesian grids please:"<< buffer <<"\n"; return -1;}
 
-  // read over the lines with the nuclei
-  for (i = 0; i < nnuc; ++i) {
-    input.getline(buffer, LineLength);
+  // the nuclei
+  int orbitals = (nAtoms < 0);
+  nAtoms = abs(nAtoms);
+  Z.resize(nAtoms);
+  Atoms.resize(4*nAtoms);
+  for (int i = 0; i < nAtoms; ++i) {
+    CopyLine(p, end, buffer, LineLength); p = NextLine(p, end);
+    double *a = &Atoms[4*i];
+    sscanf(buffer, "%i %lf %lf %lf %lf", &Z[i], a, a+1, a+2, a+3);
   }
 
-  // 
-  //  read the grid data and do your sums  
+  // orbital cubes: no of orbitals followed by their numbers
+  if (orbitals) {
+    char *q;
+    long norb = strtol(p, &q, 10);
+    p = q;
+    for (long k = 0; k < norb; ++k) {
+      strtol(p, &q, 10);
+      p = q;
+    }
+    p = NextLine(p, end);
+  }
+  stride[0] = (long)n[1]*n[2];
+  stride[1] = n[2];
+  stride[2] = 1;
+
   //
-  double density = 0; 
-
-  int nvaluesread = 0;
-  for (int ix = 0; ix < nx; ++ix) {
-    for (int iy = 0; iy < ny; ++iy) {
-      for (int iz = 0; iz < nz; ++iz) {
-	// get next density
-	input >> density;
-	(*cube)[nvaluesread] = density;
-	if (nvaluesread < 3) {
-	  cout << nvaluesread << "-th value read from cube file: " << density << "\n";  
-	}
-	nvaluesread += 1;
-      }
+  //  block index: the body is split into blocks at white space, and the numbers 
+  //  in each block are counted (in parallel) 
+  //
+  long ntotal = (long)n[0] * n[1] * n[2];
+  const char *body = p;
+  const long BlockBytes = 1 << 20;
+  int nblocks = (int)((end - body) / BlockBytes) + 1;
+  blockStart.resize(nblocks+1);
+  for (int c = 0; c <= nblocks; ++c) {
+    const char *q = body + (end - body) * c / nblocks;
+    if (c > 0 && c < nblocks) {
+      // move to the beginning of the next number
+      while (q < end && !isspace(*q)) q++;
+      if (q < blockStart[c-1]) q = blockStart[c-1];
+    }
+    blockStart[c] = q;
+  }
+  blockFirst.assign(nblocks+1, 0);
+#pragma omp parallel for schedule(dynamic)
+  for (int c = 0; c < nblocks; ++c) {
+    long nc = 0;
+    const char *q = blockStart[c];
+    const char *qend = blockStart[c+1];
+    while (q < qend) {
+      while (q < qend && isspace(*q)) q++;
+      if (q == qend) break;
+      nc ++;
+      while (q < qend && !isspace(*q)) q++;
     }
+    blockFirst[c+1] = nc;
+  }
+  for (int c = 0; c < nblocks; ++c)
+    blockFirst[c+1] += blockFirst[c];
+  long nvaluesread = blockFirst[nblocks];
+  if (nvaluesread != ntotal) {
+    cout << "CubeFile::Read: " << nvaluesread << " values in the file, but there should be " << ntotal << endl;
+    return -1;
+  }
+  return 0;
+}
+
+
+void CubeFile::Copy(double *v, int zfastest) const
+{
+#pragma omp parallel for
+  for (int ix = 0; ix < n[0]; ++ix)
+    for (int iy = 0; iy < n[1]; ++iy)
+      for (int iz = 0; iz < n[2]; ++iz) {
+	long i = (zfastest) ? iz + n[2]*(iy + (long)n[1]*ix) : ix + n[0]*(iy + (long)n[1]*iz);
+	v[i] = Value(ix, iy, iz);
+      }
+}
+
+
+void ReadCubeFile(const char *fname, int *npts, double *x0, double *dx, double **cube)
+{
+  CubeFile cf;
+  if (cf.Read(fname, 1) != 0)
+    exit(1);
+  for (int k = 0; k < 3; ++k) {
+    npts[k] = cf.n[k];
+    x0[k] = cf.x0[k];
+    dx[k] = cf.dx[k];
   }
-  input.close();
-  printf("Last value read is %e (no %i)\n", density, nvaluesread);
-  if (nvaluesread != ntotal)
-    cout << "But there should be " << ntotal << endl;
-  
+  *cube = new double[(long)npts[0]*npts[1]*npts[2]];
+  cf.Copy(*cube, 1);
 }
 
 
+void ReadCubeFile(int *npts, double *x0, double *dx, double **cube)
+{
+  cout << "\nReading a start vector from cube file\n";
+  ReadCubeFile("StartVector.cub", npts, x0, dx, cube);
+}
@@ -1 +1,69 @@
+#ifndef PISCES_READCUBEFILE_H_
+#define PISCES_READCUBEFILE_H_
+
+#include <vector>
+#include "vecdefs.h"
+#include "MappedFile.h"
+
+//
+//  reading Gaussian-cube files (and the binary siblings written by WriteCubeBinary)
+//
+//  the file is memory-mapped and the numeric body is parsed in parallel;
+//  for a binary sibling the values are used in place, without any copy
+//
+//  the value at grid point (ix,iy,iz) is data[ix*stride[0] + iy*stride[1] + iz*stride[2]]
+//  (z runs fastest in text cubes, x in binary ones)
+//
+class CubeFile
+{
+public:
+  CubeFile() : nAtoms(0), data(0), binary(0) {}
+
+  /// reads the whole file; returns 0 on success, -1 if the file cannot be read
+  int Read(const char *fname, int verbose = 0);
+
+  /// copy of the values, z running fastest (zfastest = 1) as in a text cube, or x fastest
+  void Copy(double *v, int zfastest = 1) const;
+
+  double Value(int ix, int iy, int iz) const { return data[ix*stride[0] + iy*stride[1] + iz*stride[2]]; }
+
+  /// \name streaming access: Open() reads only the header, then the blocks can be parsed in any order
+  //@{
+  int Open(const char *fname, int verbose = 0);
+  int nBlocks() const { return (int)blockFirst.size() - 1; }
+  long BlockFirst(int ib) const { return blockFirst[ib]; }
+  long BlockSize(int ib) const { return blockFirst[ib+1] - blockFirst[ib]; }
+  void ParseBlock(int ib, double *v) const;
+  /// grid point of the i-th value in the file
+  void Point(long i, int *ix, int *iy, int *iz) const;
+  //@}
+
+  int n[3];        // grid points
+  double x0[3];    // first grid point
+  double dx[3];    // spacing
+  int nAtoms;
+  iVec Z;          // atomic numbers
+  dVec Atoms;      // 4 per atom: the charge column and x, y, z
+
+  const double *data;   // set by Read()
+  long stride[3];       // see Value()
+
+private:
+  enum {BinaryHeader = 8 + 4*sizeof(int) + 6*sizeof(double)};
+
+  int ReadText();
+  int ReadBinary();
+
+  MappedFile mf;
+  int binary;
+  std::vector<const char*> blockStart;   // text blocks in the mapped file
+  std::vector<long> blockFirst;          // index of the first value of each block
+  dVec values;     // parsed values of a text cube
+};
+
+/// the cube is allocated with new[], z runs fastest
+void ReadCubeFile(const char *fname, int *npts, double *x0, double *dx, double **cube);
+/// reads StartVector.cub
 void ReadCubeFile(int *npts, double *x0, double *dx, double **cube);
+
+#endif // PISCES_READCUBEFILE_H_
@@ -12,23 +12,25 @@ struct VectorFFT
 
   typedef std::complex<double> Complex;
 
-  Complex *phi_xk;     //Copies vector x to new complex array: x can be directly fourier transformed
-  double *phi_x;     //new double
-  Complex  *KE_phi_xk; //KE matrix multiplied by FFT(x):T*FFT(x)
+  Complex *phi_xk;     //in-place, padded r2c buffer (nx/2+1)*ny*nz, x is copied into its rows
   size_t ngp;
-  size_t ngp2;
+  size_t ngp2;       //size of the r2c half spectrum, (nx/2+1)*ny*nz
   int n_1dbas[3];
+  int dst;           //1: sine transform (RODFT00) for the Dirichlet sine DVR, works in y, phi_xk is not used
 
 #if defined(USE_MKL_DFT)
   DFTI_DESCRIPTOR_HANDLE  plan_yz;
   DFTI_DESCRIPTOR_HANDLE  plan_x;
 #else
-  fftw_plan plan_forward;
-  fftw_plan plan_backward;
+  fftw_plan plan_xf, plan_xb;   //1D transforms along x, y, and z for one block (see VectorFFTW.cpp)
+  fftw_plan plan_yf, plan_yb;
+  fftw_plan plan_zf, plan_zb;
 #endif
 
-  explicit VectorFFT(int * n_1dbas);
+  explicit VectorFFT(int * n_1dbas, int dst = 0);
   ~VectorFFT();
-  void apply(const double* __restrict x, double* __restrict y, const double * __restrict v_diag, const double * __restrict KE_diag);
+  // y = V*x + T*x, ekin[d] is the 1D kinetic energy spectrum of direction d (x, y, z)
+  void apply(const double* __restrict x, double* __restrict y, const double * __restrict v_diag, const double * const * ekin);
+  void applySine(const double* __restrict x, double* __restrict y, const double * __restrict v_diag, const double * const * ekin);
 };
 #endif
@@ -1,4 +1,5 @@
 #include <omp.h>
+#include <cmath>
 #include <iostream>
 #include "timer.hpp"
 #include "VectorFFT.hpp"
@@ -9,105 +10,208 @@
  * - remove temporary arrays and assignments
  * - combine y = V*x + ifft(fft(x)*V(g))
  * - reuse phi_xk for KE_phi_xk
+ * - no grid-sized kinetic energy array: T(kx,ky,kz) = ekin[0][i] + ekin[1][j] + ekin[2][k]
+ *   is summed from the three 1D spectra in the scaling loop
+ * - the 3D transform is done as 1D transforms in three passes over the grid, so that
+ *   each pass works on blocks (planes or bundles of pencils) that stay in cache:
+ *     1. per z-plane: copy x into the padded rows, r2c along x, FFT along y
+ *     2. per y-index: FFT along z, scale with T/ngp, inverse FFT along z
+ *        (the nxh z-pencils of one y-index are nz*nxh complex numbers)
+ *     3. per z-plane: inverse FFT along y, c2r along x, y = V*x + T*x
+ *   which replaces the separate copy, 3D r2c, scaling, 3D c2r, and final sweeps;
+ *   the 1D plans are single-threaded and executed on different blocks by the OpenMP threads
+ *
+ * the r2c buffer is in place and padded: row (j,k) holds nx doubles in 2*nxh, nxh = nx/2+1,
+ * the half spectrum is along x: phi_xk[i + nxh*(j + ny*k)], matching igp = i + nx*(j + ny*k)
+ *
+ * dst = 1 (DVRType 4): real-to-real DST-I (RODFT00) in all three directions,
+ * which applies the kinetic energy matrix of the sine DVR exactly,
+ * ekin are then the 1D particle-in-a-box energies (Tsine);
+ * same three passes, but all real, and y itself is the work array (no buffer at all)
  */
 
-VectorFFT::VectorFFT(int *ndim)
+VectorFFT::VectorFFT(int *ndim, int sine) : phi_xk(0), dst(sine)
 {
-  int nthreads = omp_get_max_threads();
-  fftw_init_threads();
-  fftw_plan_with_nthreads(nthreads);
-
   n_1dbas[0]=ndim[0];
   n_1dbas[1]=ndim[1];
   n_1dbas[2]=ndim[2];
-  int ng2=n_1dbas[0]*n_1dbas[1];
-  int ng_h =n_1dbas[2]/2+1;
-
- std:: cout<<"ng2 and ng_h ="<<ng2<<" "<<ng_h<<"\n";
-//  int n_1dbas[3]={ng,ng,ng};
-  ngp=static_cast<size_t>(n_1dbas[0])*static_cast<size_t>(n_1dbas[1])*static_cast<size_t>(n_1dbas[2]);
-  ngp2=static_cast<size_t>(n_1dbas[0])*static_cast<size_t>(n_1dbas[1])*static_cast<size_t>(n_1dbas[2]/2+1);
-
-//std::cout << "ngp and ngp2 " << ngp<<" "<<ngp2 << "\n";
-// unsigned long long int un_ngp=ngp;
-// unsigned long long int un_ngp2=ngp2;
-  //int nrofpts = n_1dbas[0]*n_1dbas[1]*n_1dbas[2];
-  phi_xk    = new Complex[ngp2];
-//  phi_xk    = new Complex[ngp];
-  phi_x    = new double[ngp]; // new
-
-//  plan_forward   = fftw_plan_dft(3, n_1dbas,(fftw_complex*)phi_xk,(fftw_complex*)phi_xk, FFTW_FORWARD, FFTW_MEASURE); 
-//  plan_backward  = fftw_plan_dft(3, n_1dbas,(fftw_complex*)phi_xk,(fftw_complex*)phi_xk, FFTW_BACKWARD, FFTW_MEASURE);
-
-  plan_forward   = fftw_plan_dft_r2c(3, n_1dbas,(double*)phi_x,(fftw_complex*)phi_xk, FFTW_FORWARD); 
-  plan_backward  = fftw_plan_dft_c2r(3, n_1dbas,(fftw_complex*)phi_xk,(double*)phi_x, FFTW_BACKWARD);
+  const int nx = n_1dbas[0], ny = n_1dbas[1], nz = n_1dbas[2];
+  const int nxh = nx/2+1;
+
+  ngp=static_cast<size_t>(nx)*static_cast<size_t>(ny)*static_cast<size_t>(nz);
+  ngp2=static_cast<size_t>(nxh)*static_cast<size_t>(ny)*static_cast<size_t>(nz);
+
+  // the threads are ours, every 1D plan runs on one thread;
+  // the planner setting is global, so it is set back to all threads below
+  fftw_init_threads();
+  fftw_plan_with_nthreads(1);
+
+  if (dst) {
+    // planned on a scratch array, executed on y; rows of y are not aligned in general
+    double *w = fftw_alloc_real(ngp);
+    const fftw_r2r_kind kind = FFTW_RODFT00;
+    const unsigned flags = FFTW_ESTIMATE | FFTW_UNALIGNED;
+    plan_xf = fftw_plan_many_r2r(1, &nx, ny, w, 0, 1, nx, w, 0, 1, nx, &kind, flags);
+    plan_yf = fftw_plan_many_r2r(1, &ny, nx, w, 0, nx, 1, w, 0, nx, 1, &kind, flags);
+    plan_zf = fftw_plan_many_r2r(1, &nz, nx, w, 0, nx*ny, 1, w, 0, nx*ny, 1, &kind, flags);
+    // DST-I is its own inverse up to 2(n+1) per dimension
+    plan_xb = plan_xf;
+    plan_yb = plan_yf;
+    plan_zb = plan_zf;
+    fftw_free(w);
+    fftw_plan_with_nthreads(omp_get_max_threads());
+    return;
+  }
+
+  phi_xk = reinterpret_cast<Complex*>(fftw_alloc_complex(ngp2));
+  double *r = reinterpret_cast<double*>(phi_xk);
+  fftw_complex *c = reinterpret_cast<fftw_complex*>(phi_xk);
+  const int plane = nxh*ny;
+  // the planes (pass 1) and the z-lines (pass 2) start at arbitrary offsets into phi_xk
+  const unsigned flags = FFTW_ESTIMATE | FFTW_UNALIGNED;
+
+  plan_xf = fftw_plan_many_dft_r2c(1, &nx, ny, r, 0, 1, 2*nxh, c, 0, 1, nxh, flags);
+  plan_xb = fftw_plan_many_dft_c2r(1, &nx, ny, c, 0, 1, nxh, r, 0, 1, 2*nxh, flags);
+  plan_yf = fftw_plan_many_dft(1, &ny, nxh, c, 0, nxh, 1, c, 0, nxh, 1, FFTW_FORWARD, flags);
+  plan_yb = fftw_plan_many_dft(1, &ny, nxh, c, 0, nxh, 1, c, 0, nxh, 1, FFTW_BACKWARD, flags);
+  plan_zf = fftw_plan_many_dft(1, &nz, nxh, c, 0, plane, 1, c, 0, plane, 1, FFTW_FORWARD, flags);
+  plan_zb = fftw_plan_many_dft(1, &nz, nxh, c, 0, plane, 1, c, 0, plane, 1, FFTW_BACKWARD, flags);
+  fftw_plan_with_nthreads(omp_get_max_threads());
 }
 
 
 VectorFFT::~VectorFFT()
 {
   //cleanup
-  fftw_destroy_plan(plan_backward);
-  fftw_destroy_plan(plan_forward);
-  delete [] phi_xk;
-  delete [] phi_x;
+  fftw_destroy_plan(plan_xf);
+  fftw_destroy_plan(plan_yf);
+  fftw_destroy_plan(plan_zf);
+  if (!dst) {
+    fftw_destroy_plan(plan_xb);
+    fftw_destroy_plan(plan_yb);
+    fftw_destroy_plan(plan_zb);
+  }
+  fftw_free(phi_xk);
 }
 
-void VectorFFT::apply(const double *x, double *y, const double *v_diag, const double *KE_diag) 
+void VectorFFT::apply(const double *x, double *y, const double *v_diag, const double * const *ekin)
 {
  int verbose=0;
- int ng=n_1dbas[0];
- int ng2=n_1dbas[0]*n_1dbas[1];
- int ng_h =n_1dbas[2]/2+1;
-
-//   printf("start apply ~~~~%d   %d  \n",ng2, ng_h );
-
-
  progress_timer t("VectorFFT", verbose);
-#pragma omp parallel for simd
-  for (size_t igr = 0; igr < ngp; igr++)
-  {
-//    phi_xk[igr] =  x[igr];
-    phi_x[igr] =  x[igr]; //new
-//    printf("phi_x [%d]= %f %lf \n",igr, phi_x[igr], x[igr]);
-  }
+ if (dst) {
+   applySine(x, y, v_diag, ekin);
+   return;
+ }
+
+ const int nx = n_1dbas[0], ny = n_1dbas[1], nz = n_1dbas[2];
+ const int nxh = nx/2+1;
+ const size_t plane = static_cast<size_t>(nxh)*ny;
+ const double *ex = ekin[0], *ey = ekin[1], *ez = ekin[2];
+ const double norm=1.0/double(ngp);
+ double *r = reinterpret_cast<double*>(phi_xk);
+ fftw_complex *c = reinterpret_cast<fftw_complex*>(phi_xk);
+
+ // r2c and c2r transforms (2.5 N log2 N each), the KE scaling, and y = V*x + T*x
+ Profiler::Count("Gflop", 1e-9*(5.0*ngp*log2(double(ngp)) + 4.0*ngp2 + 3.0*ngp));
+
+#pragma omp parallel
+ {
+   // pass 1: x -> padded rows, forward along x and y
+#pragma omp for schedule(static)
+   for (int k = 0; k < nz; k++) {
+     for (int j = 0; j < ny; j++) {
+       const double *xr = x + static_cast<size_t>(nx)*(j + static_cast<size_t>(ny)*k);
+       double *row = r + 2*(static_cast<size_t>(nxh)*(j + static_cast<size_t>(ny)*k));
+#pragma omp simd
+       for (int i = 0; i < nx; i++)
+         row[i] = xr[i];
+     }
+     fftw_execute_dft_r2c(plan_xf, r + 2*plane*k, c + plane*k);
+     fftw_execute_dft(plan_yf, c + plane*k, c + plane*k);
+   }
 
-  fftw_execute(plan_forward);
-
-//  printf(" ng2 and ng_h : %d %d\n",ng2, ng_h);
-#pragma omp parallel for simd 
-   for(size_t i=0; i < ng2; i++) {
-     for(size_t j=0; j < ng_h; j++) {
-    //  printf("i j : %d %d\n",i,j);
-     // printf("phi_xk [%d]= %f \n",ng_h*i+j,phi_xk[ng_h*i+j].real());
-      phi_xk[ng_h*i+j] *= KE_diag[ng*i+j];
-     //   printf("KE_diag [ %d ] =  %f\n",ng*i+j,KE_diag[ng*i+j] );
-      //  printf("phi_xk [ %d : %d]\n",ng_h*i+j, ng*i+j );
+   // pass 2: forward along z, T/ngp, backward along z
+#pragma omp for schedule(static)
+   for (int j = 0; j < ny; j++) {
+     Complex *p = phi_xk + static_cast<size_t>(nxh)*j;
+     fftw_execute_dft(plan_zf, reinterpret_cast<fftw_complex*>(p), reinterpret_cast<fftw_complex*>(p));
+     for (int k = 0; k < nz; k++) {
+       const double eyz = ey[j] + ez[k];
+       Complex *q = p + plane*k;
+#pragma omp simd
+       for (int i = 0; i < nxh; i++)
+         q[i] *= norm*(eyz + ex[i]);
      }
+     fftw_execute_dft(plan_zb, reinterpret_cast<fftw_complex*>(p), reinterpret_cast<fftw_complex*>(p));
    }
-/*
-#pragma omp parallel for simd 
-  for(size_t igr = 0; igr < ngp; igr++){
-    //KE_phi_xk[igr] = KE_diag[igr] * phi_xk[igr]; 
 
-    printf("phi_xk [%d]= %lf %lf\n",igr,phi_xk[igr].real(), KE_diag[igr] );
-    phi_xk[igr] *= KE_diag[igr];
-  }
-    printf("============================== \n");
-*/
+   // pass 3: backward along y and x, y = V*x + T*x
+#pragma omp for schedule(static)
+   for (int k = 0; k < nz; k++) {
+     fftw_execute_dft(plan_yb, c + plane*k, c + plane*k);
+     fftw_execute_dft_c2r(plan_xb, c + plane*k, r + 2*plane*k);
+     for (int j = 0; j < ny; j++) {
+       const size_t igr = static_cast<size_t>(nx)*(j + static_cast<size_t>(ny)*k);
+       const double *row = r + 2*(static_cast<size_t>(nxh)*(j + static_cast<size_t>(ny)*k));
+#pragma omp simd
+       for (int i = 0; i < nx; i++)
+         y[igr+i] = v_diag[igr+i] * x[igr+i] + row[i];
+     }
+   }
+ }
+}
+
 
-  fftw_execute(plan_backward);
+//
+//  y = V*x + T*x with the DST-I; everything stays real and in y
+//
+void VectorFFT::applySine(const double *x, double *y, const double *v_diag, const double * const *ekin)
+{
+  const int nx = n_1dbas[0], ny = n_1dbas[1], nz = n_1dbas[2];
+  const size_t plane = static_cast<size_t>(nx)*ny;
+  const double *ex = ekin[0], *ey = ekin[1], *ez = ekin[2];
+  const double norm = 1.0 / (8.0*(nx+1.0)*(ny+1.0)*(nz+1.0));
 
-  const double norm=1.0/double(ngp);
-//  const double* restrict ke_phi_real=reinterpret_cast<double*>(phi_xk);
-  //Normalize the fourier transformation. 
-#pragma omp parallel for simd  
-  for(size_t igr = 0; igr < ngp; igr++ ) 
+  // six sets of 1D r2r transforms (about 2.5 N log2 N in total for each direction), the KE scaling, and y = V*x + T*x
+  Profiler::Count("Gflop", 1e-9*(5.0*ngp*log2(double(ngp)) + 5.0*ngp));
+
+#pragma omp parallel
   {
-    //y[igr]+=norm*ke_phi_real[igr<<1];
-    //y[igr] = v_diag[igr] * x[igr]+norm*ke_phi_real[igr<<1];
-   // y[igr] = v_diag[igr] * x[igr]+norm*ke_phi_real[2*igr];
-    y[igr] = v_diag[igr] * x[igr]+norm*phi_x[igr];
+#pragma omp for schedule(static)
+    for (int k = 0; k < nz; k++) {
+      double *w = y + plane*k;
+      const double *xp = x + plane*k;
+#pragma omp simd
+      for (size_t igr = 0; igr < plane; igr++)
+        w[igr] = xp[igr];
+      fftw_execute_r2r(plan_xf, w, w);
+      fftw_execute_r2r(plan_yf, w, w);
+    }
+
+#pragma omp for schedule(static)
+    for (int j = 0; j < ny; j++) {
+      double *p = y + static_cast<size_t>(nx)*j;
+      fftw_execute_r2r(plan_zf, p, p);
+      for (int k = 0; k < nz; k++) {
+        const double eyz = ey[j] + ez[k];
+        double *q = p + plane*k;
+#pragma omp simd
+        for (int i = 0; i < nx; i++)
+          q[i] *= norm*(eyz + ex[i]);
+      }
+      fftw_execute_r2r(plan_zb, p, p);
+    }
+
+#pragma omp for schedule(static)
+    for (int k = 0; k < nz; k++) {
+      double *w = y + plane*k;
+      const double *xp = x + plane*k;
+      const double *vp = v_diag + plane*k;
+      fftw_execute_r2r(plan_yb, w, w);
+      fftw_execute_r2r(plan_xb, w, w);
+#pragma omp simd
+      for (size_t igr = 0; igr < plane; igr++)
+        w[igr] += vp[igr] * xp[igr];
+    }
   }
 }
-
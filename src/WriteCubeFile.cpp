@@ -6,6 +6,7 @@
 
 
 #include "constants.h"
+#include "CubeWriter.h"
 
 using namespace std;
 
@@ -56,22 +57,10 @@ void WriteCubeFile(const char *fname, int nAtoms, const int *Z, const double *po
   }
 
 
-  // here comes the cube
-  int icube = 0;
-  for (int ix = 0; ix < nx; ++ix) {
-    for (int iy = 0; iy < ny; ++iy) {
-      int iPerLine = 1;
-      for (int iz = 0; iz < nz; ++iz) {
-	fprintf(cubefile, "%13.6e ", cube[icube]);
-	icube ++;
-	if (iPerLine % ValuesPerLine == 0)
-	  fprintf(cubefile, "\n");
-	iPerLine++;
-      }
-      if (nz % ValuesPerLine != 0)
-	fprintf(cubefile, "\n");
-    }
-  }
+  // here comes the cube (z runs fastest in cube)
+  int n[3] = {nx, ny, nz};
+  long stride[3] = {(long)ny*nz, nz, 1};
+  WriteCubeValues(cubefile, n, stride, cube, 1.0, ValuesPerLine, 1);
 
   fclose(cubefile);
 
@@ -0,0 +1,261 @@
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+#include <string>
+
+#include <mpi.h>
+#include "Communicator.h"
+
+#include "timer.hpp"
+#include "constants.h"
+#include "vecdefs.h"
+#include "Parameters.h"
+#include "tsin.h"
+#include "GetInput.h"
+
+// DPP incudes
+#include "GTO.h"
+#include "MO.h"
+#include "AtomCenter.h"
+#include "Water.h"
+#include "DPP.h"
+#include "Molecule.h"
+
+// excess electron includes
+#include "Potential.h"
+#include "DVR.h"
+#include "ClusterAnion.h"
+
+#include "batch.h"
+
+using namespace std;
+
+// a record: frame, Etotal, Eneutral, EBE, <x>, <y>, <z>, sqrt(<r^2>), time
+enum {NREC = 9, RECORDTAG = 4};
+
+//
+//  one line of BatchOutput; rec[0] is the frame, the record is also kept in all (if not empty)
+//
+static void WriteBatchRecord(FILE *out, const double *rec, dVec &all)
+{
+  int f = (int)rec[0];
+  fprintf(out, "%7i  %12.4f  %12.4f  %10.4f  %10.5f %10.5f %10.5f  %10.5f  %10.3f\n", f,
+	  rec[1], rec[2], rec[3], rec[4], rec[5], rec[6], rec[7], rec[8]);
+  fflush(out);
+  if (all.size() > 0)
+    std::copy(rec, rec + NREC, &all[NREC*(long)f]);
+}
+
+
+///////////////////////////////////////////////////////////////////////
+//
+//  runtype 4: single points for all frames of a trajectory
+//
+//  the trajectory is a multi-frame xyz file (Angstrom, waters as O H H)
+//  the grid, the FFT plans, and all allocations are set up once, and the
+//  wavefunction of the previous frame is the start vector of the next one,
+//  so consecutive MD snapshots converge in a few Davidson iterations
+//
+//  the ranks are split into groups of RanksPerFrame (0: all ranks form one group);
+//  each group is one ClusterAnion (PiscesComm is the group) and works on one frame 
+//  at a time; the frames are handed out dynamically: the next frame is a counter
+//  on rank 0 that the group leaders increment with MPI_Fetch_and_op
+//  (passive-target RMA, served whenever rank 0 is in MPI)
+//
+//  rank 0 reads all frames and writes one line to BatchOutput as soon as a frame is 
+//  done (flushed, so a stopped run keeps the finished frames); with several groups the 
+//  file is sorted into trajectory order at the end; the leaders of the other groups 
+//  write their output to batchNNN.log
+//
+void BatchSinglePoints(const Parameters& InP)
+{
+  int wrank, wsize;
+  MPI_Comm_rank( MPI_COMM_WORLD, &wrank );
+  MPI_Comm_size( MPI_COMM_WORLD, &wsize );
+
+  Parameters P = InP;
+  int rpf = (P.BatchRanksPerFrame > 0) ? P.BatchRanksPerFrame : wsize;
+  if (wsize % rpf != 0)
+    {if(wrank==0)cout << "BatchSinglePoints: " << wsize << " ranks cannot be split into groups of " << rpf << "\n"; exit(1);}
+  int ngroups = wsize / rpf;
+  int igroup = wrank / rpf;
+
+  // all frames are read by rank 0 and broadcast
+  FILE *out = 0;
+  int natoms = 0, nframes = 0;
+  dVec frames;
+  if (wrank == 0) {
+    FILE *traj = fopen(P.Trajectory, "r");
+    if (traj == 0)
+      cout << "BatchSinglePoints: cannot open the trajectory " << P.Trajectory << "\n";
+    else if (fscanf(traj, "%d", &natoms) != 1 || natoms % 3 != 0 || natoms <= 0) {
+      cout << "BatchSinglePoints: " << P.Trajectory << " does not start with the no of atoms of a water cluster\n";
+      natoms = 0;
+    }
+    else if (P.nWater > 0 && natoms != 3*P.nWater) {
+      cout << "BatchSinglePoints: " << natoms << " atoms in " << P.Trajectory << ", but " << P.nWater << " waters in the input\n";
+      natoms = 0;
+    }
+    if (natoms > 0) {
+      rewind(traj);
+      dVec pos(3*natoms);
+      double comments[4];
+      while (GetStructure(traj, natoms, 0, &pos[0], comments) == 0) {
+	frames.insert(frames.end(), pos.begin(), pos.end());
+	nframes ++;
+      }
+      out = fopen(P.BatchOutput, "w");
+      if (out == 0) {
+	cout << "BatchSinglePoints: cannot open " << P.BatchOutput << "\n";
+	natoms = 0;
+      }
+    }
+    if (traj)
+      fclose(traj);
+  }
+  MPI_Bcast(&natoms, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  if (natoms == 0)
+    exit(1);
+  MPI_Bcast(&nframes, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  frames.resize(3*natoms*(long)nframes);
+  if (nframes > 0)
+    MPI_Bcast(&frames[0], 3*natoms*nframes, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+  P.nWater = natoms / 3;
+
+  if (wrank == 0)
+    cout << "\nBatch of single points for the " << nframes << " frames in " << P.Trajectory 
+	 << " (" << ngroups << " group(s) of " << rpf << " rank(s))\n";
+
+  MPI_Comm_split(MPI_COMM_WORLD, igroup, wrank, &PiscesComm);
+  int grank;
+  MPI_Comm_rank( PiscesComm, &grank );
+  if (grank == 0 && wrank != 0) {
+    char fname[32];
+    sprintf(fname, "batch%03d.log", igroup);
+    if (freopen(fname, "w", stdout) == 0)
+      {cerr << "BatchSinglePoints: cannot open " << fname << "\n"; exit(1);}
+  }
+
+  // the frame counter
+  int *next = 0;
+  MPI_Win win;
+  MPI_Aint winsize = (wrank == 0) ? sizeof(int) : 0;
+  MPI_Alloc_mem(winsize, MPI_INFO_NULL, &next);
+  if (wrank == 0)
+    *next = 0;
+  MPI_Win_create(next, winsize, sizeof(int), MPI_INFO_NULL, MPI_COMM_WORLD, &win);
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  // the group leaders send it to rank 0 as soon as the frame is done, and rank 0 
+  // writes and flushes its line, so a run that is stopped keeps all finished frames
+  dVec all;
+  int nwritten = 0;
+  if (wrank == 0) {
+    all.assign(NREC*(long)nframes, 0.0);
+    fprintf(out, "# frame   Etotal[meV]   Eneutral[meV]  EBE[meV]      <x>[A]     <y>[A]     <z>[A]  sqrt(<r^2>)[A]  time[s]\n");
+    fflush(out);
+  }
+  ClusterAnion Wn;
+  Wn.SetQuiet(1);
+  dVec WaterPos(3*natoms);
+  int setup = 0, ndone = 0;
+  timer total;
+  for (;;) {
+    // rank 0 writes the frames the other groups have finished meanwhile
+    if (wrank == 0) {
+      int flag = 1;
+      while (flag) {
+	MPI_Iprobe(MPI_ANY_SOURCE, RECORDTAG, MPI_COMM_WORLD, &flag, MPI_STATUS_IGNORE);
+	if (flag) {
+	  double rec[NREC];
+	  MPI_Recv(rec, NREC, MPI_DOUBLE, MPI_ANY_SOURCE, RECORDTAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+	  WriteBatchRecord(out, rec, all);
+	  nwritten ++;
+	}
+      }
+    }
+
+    int iframe = 0;
+    if (grank == 0) {
+      const int one = 1;
+      MPI_Win_lock(MPI_LOCK_SHARED, 0, 0, win);
+      MPI_Fetch_and_op(&one, &iframe, MPI_INT, 0, 0, MPI_SUM, win);
+      MPI_Win_unlock(0, win);
+    }
+    MPI_Bcast(&iframe, 1, MPI_INT, 0, PiscesComm);
+    if (iframe >= nframes)
+      break;
+    std::copy(&frames[3*natoms*(long)iframe], &frames[3*natoms*(long)(iframe+1)], WaterPos.begin());
+
+    timer t;
+    if (!setup) {
+      Wn.SetUpClusterAnion(WaterPos, P);
+      setup = 1;
+    }
+    double Etotal = Wn.NextGeometry(WaterPos);
+    double EBE = Wn.BindingEnergy();
+    dVec m;
+    int ns = Wn.StateMoments(m);
+
+    if (grank == 0) {
+      // ground state: m[0 + ns*k], k = 1-3 <x>, <y>, <z>, k = 4 <r^2>
+      double rec[NREC];
+      rec[0] = iframe;
+      rec[1] = Etotal*AU2MEV;
+      rec[2] = (Etotal-EBE)*AU2MEV;
+      rec[3] = EBE*AU2MEV;
+      rec[4] = Bohr2Angs*m[ns];
+      rec[5] = Bohr2Angs*m[2*ns];
+      rec[6] = Bohr2Angs*m[3*ns];
+      rec[7] = Bohr2Angs*sqrt(m[4*ns]);
+      rec[8] = t.elapsed();
+      if (wrank == 0) {
+	WriteBatchRecord(out, rec, all);
+	nwritten ++;
+      }
+      else
+	MPI_Send(rec, NREC, MPI_DOUBLE, 0, RECORDTAG, MPI_COMM_WORLD);
+      cout << "Batch: frame " << iframe << " EBE = " << rec[3] << " meV (" << rec[8] << " s)\n";
+      cout.flush();
+    }
+    ndone ++;
+  }
+
+  // the frames still in flight
+  if (wrank == 0)
+    for (; nwritten < nframes; nwritten ++) {
+      double rec[NREC];
+      MPI_Recv(rec, NREC, MPI_DOUBLE, MPI_ANY_SOURCE, RECORDTAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+      WriteBatchRecord(out, rec, all);
+    }
+  MPI_Win_free(&win);
+  MPI_Free_mem(next);
+
+  if (wrank == 0) {
+    fclose(out);
+    // with several groups the lines are in the order the frames finished: 
+    // write them sorted to a new file, which then replaces BatchOutput
+    if (ngroups > 1 && nframes > 0) {
+      std::string sorted = std::string(P.BatchOutput) + ".sorted";
+      FILE *fs = fopen(sorted.c_str(), "w");
+      if (fs == 0)
+	cout << "BatchSinglePoints: cannot open " << sorted << ", " << P.BatchOutput << " stays unsorted\n";
+      else {
+	fprintf(fs, "# frame   Etotal[meV]   Eneutral[meV]  EBE[meV]      <x>[A]     <y>[A]     <z>[A]  sqrt(<r^2>)[A]  time[s]\n");
+	dVec none;
+	for (int f = 0; f < nframes; ++f)
+	  WriteBatchRecord(fs, &all[NREC*(long)f], none);
+	fclose(fs);
+	if (rename(sorted.c_str(), P.BatchOutput) != 0)
+	  cout << "BatchSinglePoints: cannot rename " << sorted << ", " << P.BatchOutput << " stays unsorted\n";
+      }
+    }
+    cout << "\nBatch: " << nframes << " frames in " << total.elapsed() << " s (" << ndone
+	 << " on the first group), results are in " << P.BatchOutput << "\n";
+  }
+
+  MPI_Comm_free(&PiscesComm);
+  PiscesComm = MPI_COMM_WORLD;
+}
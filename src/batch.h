@@ -0,0 +1 @@
+void BatchSinglePoints(const Parameters& InP);
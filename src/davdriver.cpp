@@ -18,6 +18,7 @@
 #include "Potential.h"
 #include "DVR.h"
 #include "VectorFFT.hpp"
+#include "Profiler.h"
 
 
 
@@ -30,10 +31,11 @@ int DVR::davdriver(int ng, int nstates, int maxsub, int maxiter, int ptol, int c
 
   if (verbose > 0)
     cout << "Diagonalizing using the reverse-interface Davidson\n";
+  profile_region prof("Davidson");
 
-  static dVec B; B.resize(ng * (maxsub)); // basis for the subspace plus the residual vector (next correction vector)
-  static dVec Z; Z.resize(ng * maxsub); // Hamilton matrix times basis vectors
-  static dVec diag; diag.resize(ng);    // diagonal of H
+  static gVec B; GridResize(B, ng * (maxsub)); // basis for the subspace plus the residual vector (next correction vector)
+  static gVec Z; GridResize(Z, ng * maxsub); // Hamilton matrix times basis vectors
+  static gVec diag; GridResize(diag, ng);    // diagonal of H
   static dVec davwork;
   int workmem = DavidsonWorkSize(ng, maxsub, nstates, corrflag);
   davwork.resize(workmem);
@@ -45,7 +47,8 @@ int DVR::davdriver(int ng, int nstates, int maxsub, int maxiter, int ptol, int c
   ComputeDiagonal(&diag[0]);
 
   cout<<"define fft_engine"<<endl;
-  class VectorFFT fft_engine(&n_1dbas[0]);
+  class VectorFFT fft_engine(&n_1dbas[0], dvrtype == 4);
+  const double *ekin[3] = {KineticSpectrum(0), KineticSpectrum(1), KineticSpectrum(2)};
 
 
   //
@@ -69,13 +72,14 @@ int DVR::davdriver(int ng, int nstates, int maxsub, int maxiter, int ptol, int c
 	  int iZ = inout[1]+ivec;
 	  
           //TV: Calling the FFT
-            if(dvrtype == 3)
+            if(dvrtype == 3 || dvrtype == 4)
               //  VectorFFT(&B[iB*ng], &Z[iZ*ng]);
-               fft_engine.apply(&B[iB*ng], &Z[iZ*ng], &v_diag[0], &KE_diag[0]);
+               fft_engine.apply(&B[iB*ng], &Z[iZ*ng], &v_diag[0], ekin);
 	    else
                 MatrixTimesVector(&B[iB*ng], &Z[iZ*ng]);
 	  n_mtx ++;
 	}
+	Profiler::Count("matvecs per iteration", inout[2]);
 	break;
       case 0:
 	break;
@@ -86,6 +90,7 @@ int DVR::davdriver(int ng, int nstates, int maxsub, int maxiter, int ptol, int c
   }
 
   std::copy(&B[0], &B[nstates*ng], wavefn.begin());
+  nMatVecs = n_mtx;
 
   if (verbose > 0) {
     printf("-----------------------------------------------\n");
@@ -8,8 +8,14 @@
  *
  *   It compiles with g++ and icpp, but should really compile with any C++ compiler
  *
- *   It is called from the command prompt: edna  input.cube 
- *   where input.cube is a Gaussian-cube file 
+ *   It is called from the command prompt: edna  input.cube
+ *   where input.cube is a Gaussian-cube file
+ *
+ *   or for many files:  edna [-o bins.dat] a.cube b.cube ...
+ *   (with more than one file the bins go to a.cube.bins.dat, b.cube.bins.dat, ...)
+ *
+ *   the cube is streamed: blocks of values are parsed, binned, and discarded by
+ *   all OpenMP threads, each with its own histograms and sums
  *
  */
 
@@ -20,54 +26,161 @@
 #include <ctype.h>
 #include <unistd.h>
 #include <iostream>
-#include <fstream>
+#include <vector>
+
+#include "ReadCubeFile.h"
 
 using namespace std;
 
-const int LineLength = 1024;
 const double Bohr2Angs = 0.52917720859;
 
-double r_nearest(double &x, double &y, double &z, int &nnuc, double *xnuc, double *ynuc, double *znuc);
 
+//
+//  nearest nucleus through a uniform cell list
+//
+class NucleusIndex
+{
+public:
+  NucleusIndex(int nnuc, const double *xnuc, const double *ynuc, const double *znuc, double h);
+  double r_nearest(double x, double y, double z) const;
+private:
+  int nnuc;
+  double h, lo[3];
+  int nc[3];
+  vector<int> first;     // nuclei of cell c are list[first[c]] ... list[first[c+1]-1]
+  vector<double> list;   // x, y, z of the nuclei sorted by cell
+};
 
-int main (int argc, char *argv[])
+NucleusIndex::NucleusIndex(int n, const double *xnuc, const double *ynuc, const double *znuc, double cell)
+  : nnuc(n), h(cell)
 {
+  if (nnuc == 0)
+    return;
+  const double *r[3] = {xnuc, ynuc, znuc};
+  for (int k = 0; k < 3; ++k) {
+    double hi = r[k][0];
+    lo[k] = r[k][0];
+    for (int i = 1; i < nnuc; ++i) {
+      if (r[k][i] < lo[k]) lo[k] = r[k][i];
+      if (r[k][i] > hi) hi = r[k][i];
+    }
+    nc[k] = int((hi - lo[k]) / h) + 1;
+  }
+  vector<int> cell_of(nnuc);
+  first.assign(nc[0]*nc[1]*nc[2] + 1, 0);
+  for (int i = 0; i < nnuc; ++i) {
+    int c[3];
+    for (int k = 0; k < 3; ++k)
+      c[k] = min(int((r[k][i] - lo[k]) / h), nc[k]-1);
+    cell_of[i] = c[0] + nc[0]*(c[1] + nc[1]*c[2]);
+    first[cell_of[i]+1] ++;
+  }
+  for (size_t c = 1; c < first.size(); ++c)
+    first[c] += first[c-1];
+  list.resize(3*nnuc);
+  vector<int> fill(first.begin(), first.end()-1);
+  for (int i = 0; i < nnuc; ++i) {
+    int pos = fill[cell_of[i]]++;
+    list[3*pos+0] = xnuc[i];
+    list[3*pos+1] = ynuc[i];
+    list[3*pos+2] = znuc[i];
+  }
+}
 
-  int i;
-  int verbose = 1;
+//
+//  search shells of cells around the cell of (x,y,z); a cell in shell s is
+//  at least (s-1)*h away, so the search stops once the best distance is below s*h
+//
+double NucleusIndex::r_nearest(double x, double y, double z) const
+{
+  if (nnuc == 0)
+    return 0.0;
+  double p[3] = {x, y, z};
+  int c[3];
+  for (int k = 0; k < 3; ++k)
+    c[k] = max(0, min(int(floor((p[k] - lo[k]) / h)), nc[k]-1));
+  double dsqmin = 1e300;
+  int smax = max(nc[0], max(nc[1], nc[2]));
+  for (int s = 0; s <= smax; ++s) {
+    for (int kz = c[2]-s; kz <= c[2]+s; ++kz) {
+      if (kz < 0 || kz >= nc[2]) continue;
+      for (int ky = c[1]-s; ky <= c[1]+s; ++ky) {
+	if (ky < 0 || ky >= nc[1]) continue;
+	int onface = (abs(kz-c[2]) == s || abs(ky-c[1]) == s);
+	int step = (onface || s == 0) ? 1 : 2*s;   // inside the shell only the two x-faces
+	for (int kx = c[0]-s; kx <= c[0]+s; kx += step) {
+	  if (kx < 0 || kx >= nc[0]) continue;
+	  int cell = kx + nc[0]*(ky + nc[1]*kz);
+	  for (int j = first[cell]; j < first[cell+1]; ++j) {
+	    double dx = x - list[3*j], dy = y - list[3*j+1], dz = z - list[3*j+2];
+	    double dsq = dx*dx + dy*dy + dz*dz;
+	    if (dsq < dsqmin)
+	      dsqmin = dsq;
+	  }
+	}
+      }
+    }
+    if (dsqmin < double(s)*h*double(s)*h)
+      break;
+  }
+  return sqrt(dsqmin);
+}
+
+
+int Integrate(const char *fname, const char *binname, int verbose);
 
+
+int main (int argc, char *argv[])
+{
   printf("\nCube integrator for EDNA\n");
-  if (argc < 2 || argc > 3) {
+  if (argc < 2) {
     printf("call: edna cube-file [for_binning.dat]\n");
+    printf("      edna [-o for_binning.dat] cube-file [cube-file ...]\n");
     exit(0);
   }
 
-  FILE *output = 0;
-  if (argc == 3)
-    output = fopen(argv[2], "w+");
-  else
-    output = fopen("edna_bins.dat", "w+");
-  fprintf(output,"# r, rho, rho_nearest,  rho, roh_nearest\n# cols 2,3 for plotting, cols 4,5 sum to 1\n");
-  
-  ifstream input;
-  input.open(argv[1]);
-  // skip two comment lines
-  char buffer[LineLength+1];
-  input.getline(buffer, LineLength);
-  input.getline(buffer, LineLength);
-
-  // read number of atoms and grid parameters
-  int nnuc;
-  int nx, ny, nz;
-  double xmin, ymin, zmin, xx, yy, zz, dx, dy, dz;
-  input >> nnuc >> xmin >> ymin >> zmin;
-  input >> nx >> dx >> yy >> zz;
-  if (yy != 0 || zz != 0) {cout << "Only cartesian grids please.\n"; exit(1);}
-  input >> ny >> xx >> dy >> zz;
-  if (xx != 0 || zz != 0) {cout << "Only cartesian grids please.\n"; exit(1);}
-  input >> nz >> xx >> yy >> dz;
-  if (xx != 0 || yy != 0) {cout << "Only cartesian grids please.\n"; exit(1);}
-  long npts = nx * ny * nz;
+  // the old form: edna cube-file for_binning.dat
+  const char *binname = "edna_bins.dat";
+  vector<const char*> cubes;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-o") == 0 && i+1 < argc)
+      binname = argv[++i];
+    else
+      cubes.push_back(argv[i]);
+  }
+  if (cubes.size() == 2 && strstr(cubes[1], ".dat") != 0) {
+    binname = cubes[1];
+    cubes.pop_back();
+  }
+
+  int nfailed = 0;
+  for (size_t ic = 0; ic < cubes.size(); ++ic) {
+    if (cubes.size() == 1)
+      nfailed += Integrate(cubes[ic], binname, 1);
+    else {
+      vector<char> name(strlen(cubes[ic]) + 16);
+      sprintf(&name[0], "%s.bins.dat", cubes[ic]);
+      printf("\n=== %s\n", cubes[ic]);
+      nfailed += Integrate(cubes[ic], &name[0], 1);
+    }
+  }
+
+  exit(nfailed > 0);
+}
+
+
+int Integrate(const char *fname, const char *binname, int verbose)
+{
+  CubeFile cube;
+  if (cube.Open(fname) != 0)
+    return 1;
+
+  // number of atoms and grid parameters
+  int nnuc = cube.nAtoms;
+  int nx = cube.n[0], ny = cube.n[1], nz = cube.n[2];
+  double xmin = cube.x0[0], ymin = cube.x0[1], zmin = cube.x0[2];
+  double dx = cube.dx[0], dy = cube.dx[1], dz = cube.dx[2];
+  long npts = (long)nx * ny * nz;
   double vol = dx * dy * dz;
   if (verbose > 0) {
     cout << "\nGrid parameters:\n";
@@ -77,71 +190,71 @@ int main (int argc, char *argv[])
   }
 
   // try to guess reasonable values for the width and number of bins
-  double xmax = fabs(xmin + (nx-1)*dx);
-  double ymax = fabs(ymin + (ny-1)*dx);
-  double zmax = fabs(zmin + (nz-1)*dx);
-  if (fabs(xmin) > xmax) xmax = fabs(xmin);
-  if (fabs(ymin) > ymax) xmax = fabs(ymin);
-  if (fabs(zmin) > zmax) xmax = fabs(zmin);
+  double xmax = max(fabs(xmin), fabs(xmin + (nx-1)*dx));
+  double ymax = max(fabs(ymin), fabs(ymin + (ny-1)*dy));
+  double zmax = max(fabs(zmin), fabs(zmin + (nz-1)*dz));
   double rmax = sqrt(xmax*xmax + ymax*ymax + zmax*zmax);
   double bin_width = sqrt(dx*dx+dy*dy+dz*dz);
-  int nbins = int(rmax/bin_width); 
-  double *rbins = new double[nbins+1];
-  double *rnbins = new double[nbins+1];
-
-  // read the nuclear coordinates
-  double *rnuc = new double[nnuc];
-  double *xnuc = new double[nnuc];
-  double *ynuc = new double[nnuc];
-  double *znuc = new double[nnuc];
-  int charge;
+  int nbins = int(rmax/bin_width);
+
+  // the nuclear coordinates
+  vector<double> xnuc(nnuc+1), ynuc(nnuc+1), znuc(nnuc+1);
   if (verbose > 0)
     cout << "\nNuclei\n";
-  for (i = 0; i < nnuc; ++i) {
-    input >> charge >> rnuc[i] >> xnuc[i] >> ynuc[i] >> znuc[i];
+  for (int i = 0; i < nnuc; ++i) {
+    xnuc[i] = cube.Atoms[4*i+1];
+    ynuc[i] = cube.Atoms[4*i+2];
+    znuc[i] = cube.Atoms[4*i+3];
     if (verbose > 0)
-      printf("%3i  %2i  %11.5f     %11.5f %11.5f %11.5f\n", i+1, charge, rnuc[i], xnuc[i], ynuc[i], znuc[i]); 
+      printf("%3i  %2i  %11.5f     %11.5f %11.5f %11.5f\n", i+1, cube.Z[i], cube.Atoms[4*i], xnuc[i], ynuc[i], znuc[i]);
   }
+  NucleusIndex nuclei(nnuc, &xnuc[0], &ynuc[0], &znuc[0], 2.0*bin_width);
 
 
-  // 
-  //  read the grid data and do your sums  
-  //  sum either density enclosed in contours (JobFlag > 0)
-  //  or density enclosed in spheres with different radii (JobFlag < 0)
   //
-
-  double x, y, z, orbital, density; 
-      
-  double total_sum = 0;       // sum over the grid 
+  //  stream the grid data and do your sums
+  //
+  double total_sum = 0;       // sum over the grid
   double rsqexp = 0;          // sum for <r^2>
   double rabsexp = 0;         // sum for <|r|>
   double x_exp = 0, y_exp = 0, z_exp = 0; // for <r_vec>
   double rnexp = 0;           // sum for <r_nearest>
   double maximum = -1e10;     // maximum density
   double minimum = 1e10;      // minimum density
+  vector<double> rbins(nbins+1, 0.0);
+  vector<double> rnbins(nbins+1, 0.0);
+
+#pragma omp parallel
+  {
+    vector<double> l_rbins(nbins+1, 0.0);
+    vector<double> l_rnbins(nbins+1, 0.0);
+    vector<double> block;
+    double l_max = -1e10, l_min = 1e10;
 
-  long nvaluesread = 0;  
-  for (int ix = 0; ix < nx; ++ix) {
-    x = xmin + double(ix)*dx;
-    for (int iy = 0; iy < ny; ++iy) {
-      y = ymin + double(iy)*dy;
-      for (int iz = 0; iz < nz; ++iz) {
-	z = zmin + double(iz)*dz;
-	// get next density
-	input >> orbital;
-	density = orbital*orbital;
-	nvaluesread++;
-	//  find maximal and minimal density and maximal edge value
-	if (density > maximum)
-	  maximum = density;
-	if (density < minimum)
-	  minimum = density;
-	// integrate the density 
+#pragma omp for schedule(dynamic) reduction(+:total_sum,rsqexp,rabsexp,x_exp,y_exp,z_exp,rnexp)
+    for (int ib = 0; ib < cube.nBlocks(); ++ib) {
+      long nb = cube.BlockSize(ib);
+      long i0 = cube.BlockFirst(ib);
+      block.resize(nb);
+      cube.ParseBlock(ib, &block[0]);
+      for (long k = 0; k < nb; ++k) {
+	int ix, iy, iz;
+	cube.Point(i0 + k, &ix, &iy, &iz);
+	double x = xmin + double(ix)*dx;
+	double y = ymin + double(iy)*dy;
+	double z = zmin + double(iz)*dz;
+	double density = block[k]*block[k];
+	//  find maximal and minimal density
+	if (density > l_max)
+	  l_max = density;
+	if (density < l_min)
+	  l_min = density;
+	// integrate the density
 	total_sum += density;
 	// <r^2> and <|r|>, and <r_nearest> integrals
 	double rsq = x*x + y*y + z*z;
 	double rpt = sqrt(rsq);
-	double rnr = r_nearest(x, y, z, nnuc, xnuc, ynuc, znuc);
+	double rnr = nuclei.r_nearest(x, y, z);
 	rsqexp  += density * rsq;
 	rabsexp += density * rpt;
 	rnexp   += density * rnr;
@@ -153,19 +266,23 @@ int main (int argc, char *argv[])
 	int i_rnbin = int(rnr / bin_width);
 	if (i_rbin > nbins) i_rbin = nbins;
 	if (i_rnbin > nbins) i_rnbin = nbins;
-	rbins[i_rbin] += density;
-	rnbins[i_rnbin] += density;
-	// done; next grid point
+	l_rbins[i_rbin] += density;
+	l_rnbins[i_rnbin] += density;
       }
     }
-  }
 
-  // done with reading cube data
-  input.close();
+#pragma omp critical (edna_reduce)
+    {
+      for (int i = 0; i <= nbins; ++i) {
+	rbins[i] += l_rbins[i];
+	rnbins[i] += l_rnbins[i];
+      }
+      if (l_max > maximum) maximum = l_max;
+      if (l_min < minimum) minimum = l_min;
+    }
+  }
 
-  printf("Last value read is %e (no %li)\n", orbital, nvaluesread);
-  if (nvaluesread != npts)
-    cout << "But there should be " << npts << endl;
+  printf("%li values read\n", npts);
 
   // accounting
   rsqexp *= vol;
@@ -173,14 +290,13 @@ int main (int argc, char *argv[])
   rnexp *= vol;
   total_sum *= vol;
   x_exp *= vol;
-  y_exp *= vol;  
+  y_exp *= vol;
   z_exp *= vol;
-  
+
   double r_vec_ex_sq = x_exp * x_exp + y_exp * y_exp + z_exp * z_exp;
   double r_gy  = sqrt(rsqexp - r_vec_ex_sq);
-  double r_gy2 = sqrt(rsqexp - rabsexp*rabsexp);
 
-  //  print summary  
+  //  print summary
   printf("Maximum density = %e\n", maximum);
   printf("Minimum density = %e\n", minimum);
   printf("\nIntegrals:\n");
@@ -193,34 +309,21 @@ int main (int argc, char *argv[])
   printf("  r_gyration    = %f Bohr = %f Angs\n", r_gy, r_gy * Bohr2Angs);
   printf("  <r_nearest>   = %f Bohr = %f Angs\n", rnexp , rnexp  * Bohr2Angs);
 
-  printf("\nSummary for grep:\n  %f  %f  %f  %f\n", 
+  printf("\nSummary for grep:\n  %f  %f  %f  %f\n",
 	 total_sum, sqrt(rsqexp), rabsexp, rnexp);
 
   // write bins file
+  FILE *output = fopen(binname, "w+");
+  if (output == 0) {
+    printf("cannot open %s\n", binname);
+    return 1;
+  }
+  fprintf(output,"# r, rho, rho_nearest,  rho, roh_nearest\n# cols 2,3 for plotting, cols 4,5 sum to 1\n");
   for (int i = 0; i <= nbins; ++i)
-    fprintf(output,"%12.5e  %12.5e  %12.5e  %12.5e  %12.5e\n", i*bin_width, 
+    fprintf(output,"%12.5e  %12.5e  %12.5e  %12.5e  %12.5e\n", i*bin_width,
 	    rbins[i]*vol/bin_width, rnbins[i]*vol/bin_width,
 	    rbins[i]*vol, rnbins[i]*vol);
   fclose(output);
 
-
-  exit(0);
-}
-
-
-
-double r_nearest(double &x, double &y, double &z, int &nnuc, double *xnuc, double *ynuc, double *znuc)
-{
-  // finds the distance to the nucleus nearest to (x, y, z) 
-  double dsqmin = (x-xnuc[0])*(x-xnuc[0]) + (y-ynuc[0])*(y-ynuc[0]) + (z-znuc[0])*(z-znuc[0]);
-
-  for (int i = 1; i < nnuc; ++i){
-    double dsq = (x-xnuc[i])*(x-xnuc[i]) + (y-ynuc[i])*(y-ynuc[i]) + (z-znuc[i])*(z-znuc[i]);
-    if (dsq < dsqmin)
-      dsqmin = dsq;
-  }
-
-  return sqrt(dsqmin);
+  return 0;
 }
-
-
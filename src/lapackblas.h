@@ -46,6 +46,21 @@ SUB( dgemm, dgemm, DGEMM,   // C := alpha * A*B + beta * C
      (const int&) // ldc
      );
 
+SUB( dsymm, dsymm, DSYMM,   // C := alpha * A*B + beta * C  with A symmetric
+     (const char*) // side  L or R
+     (const char*) // uplo  U or L
+     (const int&)  // M: rows of C
+     (const int&)  // N: columns of C
+     (const double&) // alpha
+     (const double *) // A
+     (const int&) // lda
+     (const double*) // B
+     (const int&) // ldb
+     (const double&) // beta
+     (double*) // C
+     (const int&) // ldc
+     );
+
 
 SUB( dsytrf, dsytrf, DSYTRF,
      (const char*) // uplo, 
@@ -12,6 +12,7 @@
 #include <iostream>
 
 #include <mpi.h>
+#include "Communicator.h"
 
 #include "constants.h"
 #include "Potential.h"
@@ -31,7 +32,7 @@
 int DVR::larnoldi(int ng, int nev, int maxsub, int maxiter, int ptol, double *ev)
 {
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 
   if(rank==0)std::cout << "Error in DVR::larnoldi(): the ARPACK library is not available.\n"
        << "If you need this method, install it, and recompile pisces.\n"; 
@@ -89,7 +90,7 @@ int DVR::larnoldi(int ng, int nev, int maxsub, int maxiter, int ptol, double *ev
 {
 
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 
   int ncv = maxsub; 
   int info = 1; // start vector is in wavefn
@@ -103,7 +104,7 @@ int DVR::larnoldi(int ng, int nev, int maxsub, int maxiter, int ptol, double *ev
   char bmat[] = "I";
   char all[] = "A";
   
- if(rank==0) progress_timer t("larnoldi", verbose);
+ progress_timer t("larnoldi", (rank==0) ? verbose : -1);
 
   DiagCount++;
 
@@ -150,13 +151,13 @@ int DVR::larnoldi(int ng, int nev, int maxsub, int maxiter, int ptol, double *ev
   // arrays for the ARPACK
   int lworkl = ncv * (ncv + 8);
   static iVec select; select.resize(ncv);       // the bloody, allegedly not referenced array
-  static dVec workd; workd.resize(3*un_ng*2);        // Lanczos vectors
+  static gVec workd; GridResize(workd, 3*un_ng*2);        // Lanczos vectors
 //  std::cout << "workd.max_size: " << workd.max_size() << "\n";
 //  std::cout << "workd.size: " << workd.size() << "\n";
   static dVec workl; workl.resize(lworkl*2);   // work space
 //  std::cout << "workl.max_size: " << workl.max_size() << "\n";
 //  std::cout << "workl.size: " << workl.size() << "\n";
-  static dVec resid; resid.resize(un_ng*2);       // residual vector
+  static gVec resid; GridResize(resid, un_ng*2);       // residual vector
 //  std::cout << "resid.max_size: " << resid.max_size() << "\n";
 //  std::cout << "resid.size: " << resid.size() << "\n";
 //  std::cout << "ncv= " << ncv <<" ng= "<<ng<< "\n";
@@ -164,7 +165,7 @@ int DVR::larnoldi(int ng, int nev, int maxsub, int maxiter, int ptol, double *ev
 //  std::cout << "2 un_ng= " << un_ng << "\n";
 //  std::cout << "2 un_ncv= " << un_ncv << "\n";
 //  std::cout << "2 bigsize= " << bigsize << "\n";
-  static dVec v; v.resize(bigsize);              // Lanczos basis
+  static gVec v; GridResize(v, bigsize);              // Lanczos basis
 //  double *v;
 //  v =(double *)malloc(ncv*ng*2*sizeof(double));
 //  std::cout << "v.max_size: " << v.max_size() << "\n";
@@ -182,7 +183,8 @@ int DVR::larnoldi(int ng, int nev, int maxsub, int maxiter, int ptol, double *ev
   int ido = 0;          // for the reverse communication interface
 
   std::cout<<"define fft_engine"<<std::endl;
-  class VectorFFT fft_engine(&n_1dbas[0]);
+  class VectorFFT fft_engine(&n_1dbas[0], dvrtype == 4);
+  const double *ekin[3] = {KineticSpectrum(0), KineticSpectrum(1), KineticSpectrum(2)};
 //  cout<<"end define fft_engine"<<endl;
 
 
@@ -272,9 +274,9 @@ else {
 	  {
           case 1:
             //TV: Calling the FFT
-            if(dvrtype == 3) {
+            if(dvrtype == 3 || dvrtype == 4) {
               // VectorFFT(&workd[ipntr[0]-1], &workd[ipntr[1]-1]);
-               fft_engine.apply(&workd[ipntr[0]-1], &workd[ipntr[1]-1], &v_diag[0], &KE_diag[0]);
+               fft_engine.apply(&workd[ipntr[0]-1], &workd[ipntr[1]-1], &v_diag[0], ekin);
             }
 	    else
                MatrixTimesVector(&workd[ipntr[0]-1], &workd[ipntr[1]-1]); 
@@ -318,6 +320,8 @@ if (DiagCount == 1 && icount%ncv ==2 ) {
   
 
   nconv = iparam[4];
+  if (iparam[2] > 0)
+    Profiler::Count("matvecs per iteration", double(n_mtx) / iparam[2]);
 //  nconv= 0;
 //  if(rank==0)cout<<" info= "<<info<<endl;
 
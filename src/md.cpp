@@ -0,0 +1,416 @@
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include <deque>
+
+#include <mpi.h>
+#include "Communicator.h"
+
+#include "timer.hpp"
+#include "constants.h"
+#include "vecdefs.h"
+#include "Parameters.h"
+#include "tsin.h"
+#include "GetInput.h"
+#include "optimize.h"
+
+// DPP incudes
+#include "GTO.h"
+#include "MO.h"
+#include "AtomCenter.h"
+#include "Water.h"
+#include "DPP.h"
+#include "Molecule.h"
+
+// excess electron includes
+#include "Potential.h"
+#include "DVR.h"
+#include "ClusterAnion.h"
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////
+//
+//  runtype 3: Born-Oppenheimer MD of the water-cluster anion
+//
+//  the waters are rigid bodies: the CoM moves with velocity Verlet, the orientation
+//  with the symplectic splitting of Dullweber, Leimkuhler, and McLachlan
+//  (free rotation as a sequence of rotations about the principal axes)
+//  forces and torques come from the site gradient of ClusterAnion::GetAnalGrad
+//
+//  the start vector of each Davidson is extrapolated from the converged
+//  wavefunctions of the last ASPCOrder+2 steps (Kolafa's always-stable
+//  predictor-corrector coefficients; the corrector is the Davidson itself),
+//  so a step takes a few matrix-times-vector operations instead of a cold start
+//  ptol starts two orders tighter than for a single point (the forces are first
+//  order in the wavefunction error) and adapts to the drift of the conserved energy
+//
+//  everything is in atomic units; timestep is in ps
+//
+namespace {
+
+  const double AMU2AU = 1822.888486;
+  const double PS2AU = 1.0 / 2.418884326505e-5;
+  const double MassO = 15.9994;
+  const double MassH = 1.00794;
+  const int MaxPtol = 12;
+
+  struct RigidWater {
+    double M;        // mass
+    double I[3];     // principal moments of inertia
+    double b[9];     // O, H, H in the body frame
+    double R[3];     // CoM
+    double P[3];     // momentum
+    double A[9];     // body -> space (row-major), the columns are the principal axes
+    double L[3];     // angular momentum in the body frame
+  };
+
+  void Normalize(double *v)
+  {
+    double n = sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+    v[0] /= n; v[1] /= n; v[2] /= n;
+  }
+
+  // x: O, H, H of one rigid water (Bohr); C2v makes bisector, HH, and normal the principal axes
+  void SetupRigidWater(const double *x, RigidWater &w)
+  {
+    const double m[3] = {MassO*AMU2AU, MassH*AMU2AU, MassH*AMU2AU};
+    w.M = m[0] + m[1] + m[2];
+    for (int k = 0; k < 3; ++k) {
+      w.R[k] = (m[0]*x[k] + m[1]*x[3+k] + m[2]*x[6+k]) / w.M;
+      w.P[k] = 0;
+      w.L[k] = 0;
+    }
+    double e[3][3];
+    for (int k = 0; k < 3; ++k) {
+      e[0][k] = 0.5*(x[3+k] + x[6+k]) - x[k];
+      e[1][k] = x[3+k] - x[6+k];
+    }
+    Normalize(e[0]);
+    double d = e[0][0]*e[1][0] + e[0][1]*e[1][1] + e[0][2]*e[1][2];
+    for (int k = 0; k < 3; ++k)
+      e[1][k] -= d * e[0][k];
+    Normalize(e[1]);
+    e[2][0] = e[0][1]*e[1][2] - e[0][2]*e[1][1];
+    e[2][1] = e[0][2]*e[1][0] - e[0][0]*e[1][2];
+    e[2][2] = e[0][0]*e[1][1] - e[0][1]*e[1][0];
+    for (int r = 0; r < 3; ++r)
+      for (int c = 0; c < 3; ++c)
+	w.A[3*r+c] = e[c][r];
+    for (int a = 0; a < 3; ++a)
+      for (int c = 0; c < 3; ++c)
+	w.b[3*a+c] = e[c][0]*(x[3*a]-w.R[0]) + e[c][1]*(x[3*a+1]-w.R[1]) + e[c][2]*(x[3*a+2]-w.R[2]);
+    for (int k = 0; k < 3; ++k) {
+      w.I[k] = 0;
+      for (int a = 0; a < 3; ++a)
+	w.I[k] += m[a] * (w.b[3*a+(k+1)%3]*w.b[3*a+(k+1)%3] + w.b[3*a+(k+2)%3]*w.b[3*a+(k+2)%3]);
+    }
+  }
+
+  void Positions(const RigidWater &w, double *x)
+  {
+    for (int a = 0; a < 3; ++a)
+      for (int r = 0; r < 3; ++r)
+	x[3*a+r] = w.R[r] + w.A[3*r]*w.b[3*a] + w.A[3*r+1]*w.b[3*a+1] + w.A[3*r+2]*w.b[3*a+2];
+  }
+
+  // free rotation about the body axis k by the angle phi: A <- A R_k(phi), L <- R_k(phi)^T L
+  void Rotate(RigidWater &w, int k, double phi)
+  {
+    int i = (k+1) % 3, j = (k+2) % 3;
+    double c = cos(phi), s = sin(phi);
+    for (int r = 0; r < 3; ++r) {
+      double ai = w.A[3*r+i], aj = w.A[3*r+j];
+      w.A[3*r+i] = c*ai + s*aj;
+      w.A[3*r+j] = -s*ai + c*aj;
+    }
+    double li = w.L[i], lj = w.L[j];
+    w.L[i] = c*li + s*lj;
+    w.L[j] = -s*li + c*lj;
+  }
+
+  void FreeRotation(RigidWater &w, double dt)
+  {
+    Rotate(w, 0, 0.5*dt*w.L[0]/w.I[0]);
+    Rotate(w, 1, 0.5*dt*w.L[1]/w.I[1]);
+    Rotate(w, 2, dt*w.L[2]/w.I[2]);
+    Rotate(w, 1, 0.5*dt*w.L[1]/w.I[1]);
+    Rotate(w, 0, 0.5*dt*w.L[0]/w.I[0]);
+  }
+
+  // half kick with the force F and the space-frame torque T
+  void Kick(RigidWater &w, const double *F, const double *T, double h)
+  {
+    for (int k = 0; k < 3; ++k) {
+      w.P[k] += h * F[k];
+      w.L[k] += h * (w.A[k]*T[0] + w.A[3+k]*T[1] + w.A[6+k]*T[2]);
+    }
+  }
+
+  double KineticEnergy(const vector<RigidWater> &ws)
+  {
+    double ekin = 0;
+    for (size_t i = 0; i < ws.size(); ++i)
+      for (int k = 0; k < 3; ++k)
+	ekin += 0.5*ws[i].P[k]*ws[i].P[k]/ws[i].M + 0.5*ws[i].L[k]*ws[i].L[k]/ws[i].I[k];
+    return ekin;
+  }
+
+  double Binomial(int n, int k)
+  {
+    if (k < 0 || k > n)
+      return 0;
+    double b = 1;
+    for (int i = 1; i <= k; ++i)
+      b = b * (n - k + i) / i;
+    return b;
+  }
+
+  // ASPC predictor of order k: psi(n+1) = sum_j B[j] psi(n-j), j = 0..k+1 (sum of B[j] = 1)
+  void ASPCCoefficients(int k, double *B)
+  {
+    double catalan = Binomial(2*k+2, k+1) / (k+2);
+    for (int j = 0; j <= k+1; ++j)
+      B[j] = ((j % 2 == 0) ? 1 : -1) * (Binomial(2*k+2, k+1-j) - Binomial(2*k+2, k-1-j)) / catalan;
+  }
+
+  // energy (Hartree) of the current positions, and forces and torques on all waters (rank 0's are used)
+  double EnergyAndForces(ClusterAnion &Wn, WaterCluster &W, const Parameters &P, const vector<RigidWater> &ws,
+			 dVec &F, dVec &T)
+  {
+    int nW = ws.size();
+    dVec x(9*nW), pos(9*nW);
+    for (int i = 0; i < nW; ++i)
+      Positions(ws[i], &x[9*i]);
+    for (int i = 0; i < 9*nW; ++i)
+      pos[i] = x[i] * Bohr2Angs;
+
+    double E = Wn.NextGeometry(pos);
+
+    W.SetStructure(nW, &pos[0], 1, P.CenterFlag, P.KTFlag, 0);
+    dVec conf(6*nW), grad(6*nW);
+    W.GetConfiguration(nW, &conf[0], 1.0, 0);
+    int nSites = 0, nCharges = 0, nDipoles = 0;
+    W.ReportNoOfSites(nSites, nCharges, nDipoles);
+    dVec SiteGrad(3*nSites), Sites(3*nSites);
+    Wn.GetAnalGrad(&conf[0], &grad[0], &SiteGrad[0], &Sites[0]);
+
+    // sites are ordered by water
+    int nper = nSites / nW;
+    for (int i = 0; i < nW; ++i) {
+      const double *R = ws[i].R;
+      for (int k = 0; k < 3; ++k)
+	F[3*i+k] = T[3*i+k] = 0;
+      for (int s = nper*i; s < nper*(i+1); ++s) {
+	const double *g = &SiteGrad[3*s];
+	double r[3] = {Sites[3*s]-R[0], Sites[3*s+1]-R[1], Sites[3*s+2]-R[2]};
+	F[3*i+0] -= g[0];
+	F[3*i+1] -= g[1];
+	F[3*i+2] -= g[2];
+	T[3*i+0] -= r[1]*g[2] - r[2]*g[1];
+	T[3*i+1] -= r[2]*g[0] - r[0]*g[2];
+	T[3*i+2] -= r[0]*g[1] - r[1]*g[0];
+      }
+    }
+    MPI_Bcast(&E, 1, MPI_DOUBLE, 0, PiscesComm);
+    MPI_Bcast(&F[0], 3*nW, MPI_DOUBLE, 0, PiscesComm);
+    MPI_Bcast(&T[0], 3*nW, MPI_DOUBLE, 0, PiscesComm);
+    return E;
+  }
+
+  // Gaussian random numbers (Box-Muller) with a fixed seed
+  double Gauss()
+  {
+    double u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    double u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    return sqrt(-2.0*log(u1)) * cos(2*PI*u2);
+  }
+
+  void InitialVelocities(vector<RigidWater> &ws, double T)
+  {
+    int nW = ws.size();
+    if (T <= 0 || nW < 1)
+      return;
+    srand(4711);
+    double ptot[3] = {0, 0, 0}, mtot = 0;
+    for (int i = 0; i < nW; ++i) {
+      for (int k = 0; k < 3; ++k) {
+	ws[i].P[k] = sqrt(ws[i].M * k_in_AU * T) * Gauss();
+	ws[i].L[k] = sqrt(ws[i].I[k] * k_in_AU * T) * Gauss();
+	ptot[k] += ws[i].P[k];
+      }
+      mtot += ws[i].M;
+    }
+    for (int i = 0; i < nW; ++i)
+      for (int k = 0; k < 3; ++k)
+	ws[i].P[k] -= ptot[k] * ws[i].M / mtot;
+    int ndof = 6*nW - 3;
+    double scale = sqrt(0.5 * ndof * k_in_AU * T / KineticEnergy(ws));
+    for (int i = 0; i < nW; ++i)
+      for (int k = 0; k < 3; ++k) {
+	ws[i].P[k] *= scale;
+	ws[i].L[k] *= scale;
+      }
+  }
+
+}
+
+
+void MolecularDynamics(dVec WaterPos, const Parameters InP)
+{
+  int rank;
+  MPI_Comm_rank( PiscesComm, &rank );
+
+  Parameters P = InP;
+  if (P.nStates != 1)
+    {if(rank==0)cout << "MolecularDynamics: only for the lowest state, nStates = " << P.nStates << "\n"; exit(1);}
+  if (P.PotFlag[3] != 3)
+    {if(rank==0)cout << "MolecularDynamics: only Polarization=3 gradients are implemented.\n"; exit(1);}
+  if (P.RigidBody != 1)
+    {if(rank==0)cout << "MolecularDynamics: only rigid waters (RigidBody = 1) are implemented.\n"; exit(1);}
+
+  int nW = P.nWater;
+  double dt = P.timestep * PS2AU;
+
+  //
+  //  rigid bodies from the projected (model) geometry
+  //
+  WaterCluster W;
+  W.SetStructure(nW, &WaterPos[0], 1, P.CenterFlag, P.KTFlag, 0);
+  dVec x(9*nW);
+  W.GetStructure(nW, &x[0], 1.0, 0);
+  vector<RigidWater> ws(nW);
+  for (int i = 0; i < nW; ++i)
+    SetupRigidWater(&x[9*i], ws[i]);
+  InitialVelocities(ws, P.Temperature);
+  for (int i = 0; i < nW; ++i) {
+    MPI_Bcast(ws[i].P, 3, MPI_DOUBLE, 0, PiscesComm);
+    MPI_Bcast(ws[i].L, 3, MPI_DOUBLE, 0, PiscesComm);
+  }
+
+  // from here on the positions are propagated as they are (the site positions must match R)
+  P.CenterFlag = 0;
+  for (int i = 0; i < 9*nW; ++i)
+    WaterPos[i] = x[i] * Bohr2Angs;
+
+  ClusterAnion Wn;
+  Wn.SetQuiet(1);  // one line per step goes to md.dat
+  Wn.SetUpClusterAnion(WaterPos, P);
+  DVR &Hel = Wn.Hamiltonian();
+  int ptol = std::min(P.ptol + 2, MaxPtol);
+  Wn.SetTolerance(ptol);
+
+  FILE *fdat = 0, *fxyz = 0;
+  if (rank == 0) {
+    fdat = fopen("md.dat", "w");
+    fxyz = fopen("md.xyz", "w");
+    if (fdat == 0 || fxyz == 0)
+      {cout << "MolecularDynamics: cannot open md.dat or md.xyz\n"; exit(1);}
+    fprintf(fdat, "#  step   time[fs]    Epot[meV]     Ekin[meV]     Econs[meV]    T[K]     EBE[meV]  ptol  matvecs  time[s]\n");
+  }
+
+  //
+  //  the history of converged wavefunctions, newest first
+  //
+  int ng = Hel.nGridPoints();
+  int nhist = (P.ASPCOrder >= 0) ? P.ASPCOrder + 2 : 1;
+  deque<dVec> history;
+  dVec guess(ng), B(nhist);
+
+  dVec F(3*nW), T(3*nW);
+  double Epot = 0, Econs0 = 0, EconsLast = 0;
+  int ndof = 6*nW - 3;
+  char tag[] = "MD";
+
+  for (int step = 0; step <= P.nsteps; ++step) {
+    timer tstep;
+
+    if (step > 0) {
+      for (int i = 0; i < nW; ++i) {
+	Kick(ws[i], &F[3*i], &T[3*i], 0.5*dt);
+	for (int k = 0; k < 3; ++k)
+	  ws[i].R[k] += dt * ws[i].P[k] / ws[i].M;
+	FreeRotation(ws[i], dt);
+      }
+    }
+
+    // predicted start vector
+    if (!history.empty()) {
+      int h = history.size();
+      int k = std::min(P.ASPCOrder, h - 2);
+      if (k < 0)
+	guess = history[0];
+      else {
+	ASPCCoefficients(k, &B[0]);
+	std::fill(guess.begin(), guess.end(), 0.0);
+	for (int j = 0; j <= k+1; ++j)
+	  for (int igp = 0; igp < ng; ++igp)
+	    guess[igp] += B[j] * history[j][igp];
+      }
+      double norm = 0;
+      for (int igp = 0; igp < ng; ++igp)
+	norm += guess[igp] * guess[igp];
+      norm = 1.0 / sqrt(norm);
+      for (int igp = 0; igp < ng; ++igp)
+	guess[igp] *= norm;
+      Hel.SetStartVector(&guess[0]);
+    }
+
+    Epot = EnergyAndForces(Wn, W, P, ws, F, T);
+    if (step > 0)
+      for (int i = 0; i < nW; ++i)
+	Kick(ws[i], &F[3*i], &T[3*i], 0.5*dt);
+
+    // store the new wavefunction with the phase of the last one
+    {
+      dVec psi(Hel.WaveFunction(), Hel.WaveFunction() + ng);
+      if (!history.empty()) {
+	double s = 0;
+	for (int igp = 0; igp < ng; ++igp)
+	  s += psi[igp] * history[0][igp];
+	if (s < 0)
+	  for (int igp = 0; igp < ng; ++igp)
+	    psi[igp] = -psi[igp];
+      }
+      history.push_front(psi);
+      if ((int)history.size() > nhist)
+	history.pop_back();
+    }
+
+    double Ekin = KineticEnergy(ws);
+    double Econs = Epot + Ekin;
+    if (step == 0)
+      Econs0 = EconsLast = Econs;
+
+    if (rank == 0) {
+      double EBE = Wn.BindingEnergy();
+      fprintf(fdat, "%7i  %9.3f  %12.4f  %12.4f  %12.4f  %8.2f  %10.4f  %3i  %6i  %8.2f\n", step, step*P.timestep*1000,
+	      Epot*AU2MEV, Ekin*AU2MEV, Econs*AU2MEV, 2*Ekin/(ndof*k_in_AU), EBE*AU2MEV, ptol, Hel.MatVecs(), tstep.elapsed());
+      fflush(fdat);
+      dVec xyz(9*nW);
+      for (int i = 0; i < nW; ++i)
+	Positions(ws[i], &xyz[9*i]);
+      for (int i = 0; i < 9*nW; ++i)
+	xyz[i] *= Bohr2Angs;
+      double comments[2] = {Econs*AU2MEV, EBE*AU2MEV};
+      PutStructure(fxyz, 3*nW, &xyz[0], step, tag, 2, comments);
+    }
+
+    // a large step-to-step change of the conserved energy asks for tighter convergence
+    double drift = fabs(Econs - EconsLast);
+    EconsLast = Econs;
+    if (drift > P.DriftTol && ptol < MaxPtol)
+      Wn.SetTolerance(++ptol);
+    else if (drift < 0.1*P.DriftTol && ptol > P.ptol)
+      Wn.SetTolerance(--ptol);
+  }
+
+  if (rank == 0) {
+    cout << "\nMD: " << P.nsteps << " steps, drift of the conserved energy "
+	 << (EconsLast - Econs0)*AU2MEV << " meV; md.dat and md.xyz are written\n";
+    fclose(fdat);
+    fclose(fxyz);
+  }
+}
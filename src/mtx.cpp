@@ -19,6 +19,16 @@ inline int sub2ind( int i, int j, int k, const int n[] )
 }
 
 
+void DVR::HamiltonianTimesVector(const double *x, double *y)
+{
+  counter kc;
+  counter *saved = m_pkc;
+  m_pkc = &kc;
+  MatrixTimesVector(x, y);
+  m_pkc = saved;
+}
+
+
 void DVR::MatrixTimesVector(const double *x, double *y)
 {
 
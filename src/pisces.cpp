@@ -21,6 +21,7 @@
 #include <fftw3-mpi.h>
 
 #include "timer.hpp"
+#include "Profiler.h"
 #include "tsin.h"
 #include "constants.h"
 #include "vecdefs.h"
@@ -40,8 +41,8 @@
 #include "Potential.h"
 #include "DVR.h"
 #include "ClusterAnion.h"
-// Optimization
-//#include "optimize.h"
+// Optimization and MD
+#include "optimize.h"
 
 //plotting
 #include "polplot.h"
@@ -54,6 +55,12 @@
 // potfit includes
 #include "potfit.h"
 
+// batch of single points
+#include "batch.h"
+
+// parallel tempering
+#include "ptmc.h"
+
 using namespace std;
 
 ///////////////////////////////////////////////////////////////////////
@@ -99,6 +106,8 @@ int main(int argc, char* argv[])
   // Parse all input groups, and put parameters into InP
   Parameters InP;
   GetInputParameters(InP, Input);
+  if (InP.Profile > 0)
+    Profiler::Enable("profile.json");
   
 
 
@@ -125,6 +134,15 @@ int main(int argc, char* argv[])
     case 2:
      Optimizer(WaterCoor, InP);
       break;
+    case 3:
+      MolecularDynamics(WaterCoor, InP);
+      break;
+    case 4:
+      BatchSinglePoints(InP);
+      break;
+    case 5:
+      ParallelTempering(WaterCoor, InP);
+      break;
     case 42:
       potfit(WaterCoor, InP);
       break;
@@ -147,6 +165,8 @@ int main(int argc, char* argv[])
        error << "unknown runtype: " << InP.runtype;
        throw std::invalid_argument( error.str() );
     }
+
+  Profiler::Report();
   
   return EXIT_SUCCESS;
 }
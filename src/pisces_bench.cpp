@@ -0,0 +1,584 @@
+///////////////////////////////////////////////////////////////////////
+//
+//  pisces_bench: timings of the hot paths on synthetic, reproducible systems
+//
+//  usage: pisces_bench [options]
+//     -k list   kernels: potential,grid,hamiltonian,davidson,gradient (default: all)
+//     -w list   water clusters (H2O)n, n waters on a cubic lattice (default: 6,24)
+//     -x n      NaCl crystal with n^3 ions (default: 4)
+//     -g list   grid points per direction (default: 32,48)
+//     -L len    grid length in Bohr (default: 36)
+//     -t list   thread counts (default: 1,2,4,... up to OMP_NUM_THREADS)
+//     -s sec    minimal time per measurement (default: 0.5)
+//     -v        keep the output of PISCES itself (otherwise it is discarded)
+//
+//  the waters are randomly oriented with a fixed seed, the C60 is an ideal truncated
+//  icosahedron, so every run sees the same systems
+//
+//  the output is one line per measurement:
+//     kernel  system  variant  size  threads  calls  s/call  rate  unit  speedup
+//  speedup is relative to the first thread count
+//
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <mpi.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "timer.hpp"
+#include "tsin.h"
+#include "constants.h"
+#include "vecdefs.h"
+#include "Parameters.h"
+#include "GetInput.h"
+
+#include "GTO.h"
+#include "MO.h"
+#include "AtomCenter.h"
+#include "Water.h"
+#include "DPP.h"
+#include "Molecule.h"
+
+#include "Potential.h"
+#include "DVR.h"
+#include "ClusterAnion.h"
+#include "VectorFFT.hpp"
+
+using namespace std;
+
+namespace {
+
+  ////////////////////////////////////////////////////////////////
+  //
+  //  output: the results go to the original stdout,
+  //  everything PISCES prints while a kernel runs goes to /dev/null (unless -v)
+  //
+  FILE *report = stdout;
+  int savedfd = -1;
+  int quiet = 1;
+
+  void Silence()
+  {
+    if (!quiet) return;
+    cout.flush(); fflush(stdout);
+    int devnull = open("/dev/null", O_WRONLY);
+    dup2(devnull, 1);
+    close(devnull);
+  }
+
+  void Speak()
+  {
+    if (!quiet) return;
+    cout.flush(); fflush(stdout);
+    dup2(savedfd, 1);
+  }
+
+  // linear congruential generator, the same numbers on every machine
+  struct Random {
+    unsigned long long s;
+    explicit Random(unsigned long long seed) : s(seed) {}
+    double Next() { s = s * 6364136223846793005ULL + 1442695040888963407ULL; return double(s >> 11) / 9007199254740992.0; }
+  };
+
+  iVec ParseList(const char *arg)
+  {
+    iVec l;
+    const char *p = arg;
+    while (*p) {
+      l.push_back(atoi(p));
+      while (*p && *p != ',') ++p;
+      if (*p == ',') ++p;
+    }
+    return l;
+  }
+
+  int SetThreads(int n)
+  {
+#ifdef _OPENMP
+    omp_set_num_threads(n);
+    return n;
+#else
+    return 1;
+#endif
+  }
+
+  ////////////////////////////////////////////////////////////////
+  //
+  //  measurement: Run() is called until the minimal time has passed
+  //
+  struct Kernel {
+    virtual ~Kernel() {}
+    virtual void Run() = 0;
+  };
+
+  double MinTime = 0.5;
+
+  double TimePerCall(Kernel &k, int *ncalls)
+  {
+    Silence();
+    k.Run();  // warm-up (plans, workspaces, first touch)
+    timer t;
+    int n = 0;
+    do {
+      k.Run();
+      n ++;
+    } while (t.elapsed() < MinTime);
+    double tcall = t.elapsed() / n;
+    Speak();
+    *ncalls = n;
+    return tcall;
+  }
+
+  void Line(const char *kernel, const char *system, const char *variant, const char *size,
+	    int threads, int calls, double tcall, double rate, const char *unit, double t1)
+  {
+    fprintf(report, "%-12s %-10s %-16s %-10s %4d %7d %12.4e %12.4e %-10s %6.2f\n",
+	    kernel, system, variant, size, threads, calls, tcall, rate, unit, t1 / tcall);
+    fflush(report);
+  }
+
+  ////////////////////////////////////////////////////////////////
+  //
+  //  synthetic systems
+  //
+
+  // n waters on a cubic lattice (2.9 Angs), random orientations; Angs, O H H
+  dVec WaterCluster_n(int n)
+  {
+    const double roh = 0.9572, theta = 104.52 / 180.0 * PI;
+    const double spacing = 2.9;
+    int m = 1;
+    while (m*m*m < n) ++m;
+    Random rnd(12345);
+    dVec pos(9*n);
+    for (int iw = 0; iw < n; ++iw) {
+      double c[3] = {spacing * (iw % m - 0.5*(m-1)), spacing * ((iw / m) % m - 0.5*(m-1)), spacing * (iw / (m*m) - 0.5*(m-1))};
+      // monomer in its own frame
+      double h[2][3] = {{roh * sin(0.5*theta), 0, roh * cos(0.5*theta)}, {-roh * sin(0.5*theta), 0, roh * cos(0.5*theta)}};
+      // random rotation from a random unit quaternion
+      double u1 = rnd.Next(), u2 = 2*PI*rnd.Next(), u3 = 2*PI*rnd.Next();
+      double q0 = sqrt(1-u1)*sin(u2), q1 = sqrt(1-u1)*cos(u2), q2 = sqrt(u1)*sin(u3), q3 = sqrt(u1)*cos(u3);
+      double R[3][3] = {{1-2*(q2*q2+q3*q3), 2*(q1*q2-q0*q3), 2*(q1*q3+q0*q2)},
+			{2*(q1*q2+q0*q3), 1-2*(q1*q1+q3*q3), 2*(q2*q3-q0*q1)},
+			{2*(q1*q3-q0*q2), 2*(q2*q3+q0*q1), 1-2*(q1*q1+q2*q2)}};
+      for (int k = 0; k < 3; ++k)
+	pos[9*iw+k] = c[k];
+      for (int a = 0; a < 2; ++a)
+	for (int k = 0; k < 3; ++k)
+	  pos[9*iw+3+3*a+k] = c[k] + R[k][0]*h[a][0] + R[k][1]*h[a][1] + R[k][2]*h[a][2];
+    }
+    return pos;
+  }
+
+  // the input file of a water-cluster single point; all other parameters are the defaults
+  void WaterInput(const char *fname, const dVec &pos, int potflag, int poltype, const int *ngrid, double length, int sampling)
+  {
+    FILE *f = fopen(fname, "w");
+    int n = pos.size() / 9;
+    fprintf(f, "BeginJob\n  runtype = 1,\n  nElectron = 1,\nEndJob\n");
+    fprintf(f, "BeginWaterModel\n  NoOfWaters = %d,\n  Verbose = 0,\nEndWaterModel\n", n);
+    fprintf(f, "BeginElectronPotential\n  Potential = %d,\n  Polarization = %d,\nEndElectronPotential\n", potflag, poltype);
+    fprintf(f, "BeginGridDef\n  NoOfGridPoints = %d, %d, %d,\n  Length = %f, %f, %f,\n  Sampling = %d,\nEndGridDef\n",
+	    ngrid[0], ngrid[1], ngrid[2], length, length, length, sampling);
+    fprintf(f, "BeginDiag\n  Method = 2,\n  nStates = 1,\n  pTol = 5,\n  Verbose = 0,\nEndDiag\n");
+    fprintf(f, "BeginWaters\n");
+    for (int i = 0; i < n; ++i)
+      for (int a = 0; a < 3; ++a)
+	fprintf(f, "  %c %12.6f %12.6f %12.6f\n", (a == 0) ? 'O' : 'H', pos[9*i+3*a], pos[9*i+3*a+1], pos[9*i+3*a+2]);
+    fprintf(f, "EndWaters\n");
+    fclose(f);
+  }
+
+  Parameters WaterParameters(const dVec &pos, int potflag, int poltype, const int *ngrid, double length, int sampling)
+  {
+    const char *fname = "pisces_bench.inp";
+    WaterInput(fname, pos, potflag, poltype, ngrid, length, sampling);
+    TSIN Input;
+    Input.ReadFromFile(fname, 0);
+    Parameters P;
+    GetInputParameters(P, Input);
+    unlink(fname);
+    return P;
+  }
+
+  // the electron-water potential as set up in ClusterAnion::EnergyFromConfiguration
+  void SetupWaterPotential(const dVec &pos, const Parameters &P, WaterCluster &WaterN, Potential &V)
+  {
+    int nW = pos.size() / 9;
+    WaterN.SetStructure(nW, &pos[0], 1, P.CenterFlag, P.KTFlag, 0);
+    WaterN.CalcEnergy(0);
+    V.VpolWaterWater = WaterN.ReportPolarization();
+    int nSites = 0, nCharges = 0, nDipoles = 0;
+    WaterN.ReportNoOfSites(nSites, nCharges, nDipoles);
+    int nPntPol = WaterN.ReportNoOfPolSites();
+    dVec Sites(3*nSites), Charges(nCharges), Dipoles(3*nDipoles), DmuByDR(3*nSites*3*nDipoles);
+    iVec iqs(nCharges), ids(nDipoles), ips(nPntPol);
+    dVec Alphas(nPntPol), Epc(3*nPntPol);
+    WaterN.GetLists(nSites, &Sites[0], nCharges, &Charges[0], &iqs[0], nDipoles, &Dipoles[0], &ids[0], &DmuByDR[0], 0);
+    nDipoles *= 3;
+    Dipoles.resize(3*nDipoles);
+    ids.resize(nDipoles);
+    WaterN.ReportInducedDipoles(nDipoles, &Dipoles[0], &ids[0], 0);
+    WaterN.ReportPolSitesAndField(nPntPol, &Alphas[0], &ips[0], &Epc[0], 1);
+    V.Setup(P.PotFlag, nSites, &Sites[0], nCharges, &Charges[0], &iqs[0], nDipoles, &Dipoles[0], &ids[0],
+	    nPntPol, &Alphas[0], &ips[0], &Epc[0], &DmuByDR[0], P.PotPara);
+  }
+
+  // rock salt, m^3 ions, 2.82 Angs apart (Bohr)
+  void SetupNaClPotential(int m, Potential &V)
+  {
+    int n = m*m*m;
+    dVec pos(3*n), q(n);
+    iVec iq(n);
+    for (int i = 0; i < n; ++i) {
+      int ix = i % m, iy = (i / m) % m, iz = i / (m*m);
+      pos[3*i+0] = 2.82 * Angs2Bohr * (ix - 0.5*(m-1));
+      pos[3*i+1] = 2.82 * Angs2Bohr * (iy - 0.5*(m-1));
+      pos[3*i+2] = 2.82 * Angs2Bohr * (iz - 0.5*(m-1));
+      q[i] = ((ix + iy + iz) % 2 == 0) ? 1.0 : -1.0;
+      iq[i] = i;
+    }
+    double PotPara[100] = {2.9, 1.0};   // rNa, rCl as in NaCl_sp
+    V.SetupBloomfield(n, &pos[0], n, &q[0], &iq[0], PotPara);
+  }
+
+  // truncated icosahedron, edges 1.40 Angs (Bohr)
+  void SetupC60Potential(Potential &V)
+  {
+    const double phi = 0.5 * (1 + sqrt(5.0));
+    const double base[3][3] = {{0, 1, 3*phi}, {1, 2+phi, 2*phi}, {phi, 2, 2*phi+1}};
+    dVec pos;
+    for (int b = 0; b < 3; ++b)
+      for (int s = 0; s < 8; ++s) {
+	double v[3];
+	for (int k = 0; k < 3; ++k)
+	  v[k] = ((s >> k) & 1) ? -base[b][k] : base[b][k];
+	if (b == 0 && (s & 1)) continue;    // -0 is 0
+	for (int c = 0; c < 3; ++c)         // cyclic permutations
+	  for (int k = 0; k < 3; ++k)
+	    pos.push_back(0.70 * Angs2Bohr * v[(k + c) % 3]);
+      }
+    int n = pos.size() / 3;    // 60
+    iVec type(n, 1);           // C_atom
+    double PotPara[100] = {0};
+    PotPara[0] = 1.7724;  PotPara[1] = 13.8;  PotPara[2] = 1.62;  PotPara[3] = 1.77;  // C60_sp defaults
+    PotPara[4] = 1;  PotPara[5] = 1;  PotPara[8] = 1;  PotPara[10] = 10.0;  PotPara[11] = 1;  PotPara[12] = 4;
+    int nAtoms[1] = {n};
+    double dipole[1] = {0}, center[3] = {0, 0, 0};
+    V.SetupFullerElec(n, &pos[0], PotPara, nAtoms, dipole, center, &type[0]);
+  }
+
+  ////////////////////////////////////////////////////////////////
+  //
+  //  kernels
+  //
+
+  // V at npts random points in a cube, all threads share V
+  struct EvaluateKernel : public Kernel {
+    Potential &V;
+    dVec pts;
+    dVec v;
+    EvaluateKernel(Potential &pot, double box, int npts) : V(pot), pts(3*npts), v(npts) {
+      Random rnd(271828);
+      for (int i = 0; i < 3*npts; ++i)
+	pts[i] = box * (rnd.Next() - 0.5);
+    }
+    void Run() {
+      int npts = v.size();
+      V.PrepareWorkspaces();
+#pragma omp parallel for schedule(dynamic, 16)
+      for (int i = 0; i < npts; ++i)
+	v[i] = V.Evaluate(&pts[3*i]);
+    }
+  };
+
+  struct GridKernel : public Kernel {
+    DVR &H;
+    Potential &V;
+    GridKernel(DVR &h, Potential &pot) : H(h), V(pot) {}
+    void Run() { H.ComputePotential(V); }
+  };
+
+  struct MtxKernel : public Kernel {
+    DVR &H;
+    dVec x, y;
+    explicit MtxKernel(DVR &h) : H(h), x(h.nGridPoints()), y(h.nGridPoints()) {
+      Random rnd(31415);
+      for (size_t i = 0; i < x.size(); ++i) x[i] = rnd.Next() - 0.5;
+    }
+    void Run() { H.HamiltonianTimesVector(&x[0], &y[0]); }
+  };
+
+  struct FFTKernel : public Kernel {
+    DVR &H;
+    VectorFFT fft;
+    dVec x, y;
+    FFTKernel(DVR &h, int dst) : H(h), fft(const_cast<int*>(h.GridPoints()), dst), x(h.nGridPoints()), y(h.nGridPoints()) {
+      Random rnd(31415);
+      for (size_t i = 0; i < x.size(); ++i) x[i] = rnd.Next() - 0.5;
+    }
+    void Run() {
+      const double *ekin[3] = {H.KineticSpectrum(0), H.KineticSpectrum(1), H.KineticSpectrum(2)};
+      fft.apply(&x[0], &y[0], H.PotentialDiagonal(), ekin);
+    }
+  };
+
+  struct DavidsonKernel : public Kernel {
+    DVR &H;
+    double ev[1];
+    explicit DavidsonKernel(DVR &h) : H(h) {}
+    void Run() { H.Diagonalize(1, ev); }   // particle-in-a-box start vector every time
+  };
+
+  struct GradientKernel : public Kernel {
+    ClusterAnion &A;
+    dVec conf, grad;
+    GradientKernel(ClusterAnion &a, const dVec &c) : A(a), conf(c), grad(c.size()) {}
+    void Run() { A.GetAnalGrad(&conf[0], &grad[0]); }
+  };
+
+  int Wanted(const string &kernels, const char *k)
+  {
+    return kernels == "all" || kernels.find(k) != string::npos;
+  }
+
+  // one kernel for all thread counts
+  void Scan(Kernel &k, const iVec &threads, const char *kernel, const char *system, const char *variant,
+	    const char *size, double work, const char *unit)
+  {
+    double t1 = 0;
+    for (size_t it = 0; it < threads.size(); ++it) {
+      int nt = SetThreads(threads[it]);
+      int calls;
+      double tcall = TimePerCall(k, &calls);
+      if (it == 0) t1 = tcall;
+      Line(kernel, system, variant, size, nt, calls, tcall, work / tcall, unit, t1);
+    }
+  }
+
+}
+
+
+int main(int argc, char* argv[])
+{
+  int provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+  int rank;
+  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+
+  string kernels = "all";
+  iVec waters(2); waters[0] = 6; waters[1] = 24;
+  iVec grids(2); grids[0] = 32; grids[1] = 48;
+  iVec threads;
+  int nacl = 4;
+  double length = 36.0;
+  for (int i = 1; i < argc; ++i) {
+    string a = argv[i];
+    if (a == "-v") { quiet = 0; continue; }
+    if (i + 1 >= argc) { cout << "pisces_bench: " << a << " needs an argument\n"; return EXIT_FAILURE; }
+    if      (a == "-k") kernels = argv[++i];
+    else if (a == "-w") waters = ParseList(argv[++i]);
+    else if (a == "-x") nacl = atoi(argv[++i]);
+    else if (a == "-g") grids = ParseList(argv[++i]);
+    else if (a == "-L") length = atof(argv[++i]);
+    else if (a == "-t") threads = ParseList(argv[++i]);
+    else if (a == "-s") MinTime = atof(argv[++i]);
+    else { cout << "pisces_bench: unknown option " << a << "\n"; return EXIT_FAILURE; }
+  }
+  if (rank != 0)
+    quiet = 1;
+  if (threads.empty()) {
+#ifdef _OPENMP
+    int maxt = omp_get_max_threads();
+#else
+    int maxt = 1;
+#endif
+    for (int t = 1; t < maxt; t *= 2)
+      threads.push_back(t);
+    threads.push_back(maxt);
+  }
+
+  if (quiet) {
+    cout.flush(); fflush(stdout);
+    savedfd = dup(1);
+    report = fdopen(savedfd, "w");
+    if (rank != 0)
+      report = fopen("/dev/null", "w");
+  }
+  fprintf(report, "%-12s %-10s %-16s %-10s %4s %7s %12s %12s %-10s %6s\n",
+	  "kernel", "system", "variant", "size", "thr", "calls", "s/call", "rate", "unit", "speedup");
+
+  const int npts = 4096;
+  char system[32], variant[32], size[32];
+
+  //
+  //  Potential::Evaluate for the water potentials (PotFlag / PolType), NaCl, and C60
+  //
+  if (Wanted(kernels, "potential")) {
+    const int flags[][2] = {{1, 3}, {2, 3}, {3, 3}, {3, 0}, {3, 1}, {3, 2}, {3, 4}};
+    int ng[3] = {8, 8, 8};
+    for (size_t iw = 0; iw < waters.size(); ++iw) {
+      dVec pos = WaterCluster_n(waters[iw]);
+      for (int f = 0; f < 7; ++f) {
+	Silence();
+	Parameters P = WaterParameters(pos, flags[f][0], flags[f][1], ng, length, 1);
+	WaterCluster WaterN;
+	Potential V;
+	SetupWaterPotential(pos, P, WaterN, V);
+	Speak();
+	EvaluateKernel k(V, length, npts);
+	sprintf(system, "(H2O)%d", waters[iw]);
+	sprintf(variant, "PotFlag%d/Pol%d", flags[f][0], flags[f][1]);
+	sprintf(size, "%d", npts);
+	Scan(k, threads, "Evaluate", system, variant, size, npts, "points/s");
+      }
+    }
+    {
+      Silence();
+      Potential V;
+      SetupNaClPotential(nacl, V);
+      Speak();
+      EvaluateKernel k(V, length, npts);
+      sprintf(system, "NaCl%d", nacl*nacl*nacl);
+      sprintf(size, "%d", npts);
+      Scan(k, threads, "Evaluate", system, "Bloomfield", size, npts, "points/s");
+    }
+    {
+      Silence();
+      Potential V;
+      SetupC60Potential(V);
+      Speak();
+      EvaluateKernel k(V, length, npts);
+      sprintf(size, "%d", npts);
+      Scan(k, threads, "Evaluate", "C60", "PolFlag1", size, npts, "points/s");
+    }
+  }
+
+  //
+  //  DVR::ComputePotential for the sampling modes (first water cluster)
+  //
+  if (Wanted(kernels, "grid") && !waters.empty()) {
+    dVec pos = WaterCluster_n(waters[0]);
+    sprintf(system, "(H2O)%d", waters[0]);
+    for (size_t ig = 0; ig < grids.size(); ++ig) {
+      int ng[3] = {grids[ig], grids[ig], grids[ig]};
+      for (int sampling = 1; sampling <= 3; ++sampling) {
+	Silence();
+	Parameters P = WaterParameters(pos, 3, 3, ng, length, sampling);
+	WaterCluster WaterN;
+	Potential V;
+	SetupWaterPotential(pos, P, WaterN, V);
+	DVR H;
+	H.SetupDVR(ng, 0, sampling, P.gpara, 0);
+	Speak();
+	GridKernel k(H, V);
+	sprintf(variant, "sampling%d", sampling);
+	sprintf(size, "%d^3", grids[ig]);
+	Scan(k, threads, "ComputePot", system, variant, size, double(H.nGridPoints()), "points/s");
+      }
+    }
+  }
+
+  //
+  //  H*x: kinetic energy matrices (MatrixTimesVector), FFT and sine transform (VectorFFT::apply)
+  //
+  if (Wanted(kernels, "hamiltonian")) {
+    for (size_t ig = 0; ig < grids.size(); ++ig) {
+      int ng[3] = {grids[ig], grids[ig], grids[ig]};
+      double gpara[3] = {length, length, length};
+      long n = long(ng[0]) * ng[1] * ng[2];
+      sprintf(size, "%d^3", grids[ig]);
+      {
+	Silence();
+	DVR H;
+	H.SetupDVR(ng, 0, 1, gpara, 0);
+	Speak();
+	MtxKernel k(H);
+	// three dspmv sweeps: 2 n_i flops per point and direction
+	double gflop = 2e-9 * n * (ng[0] + ng[1] + ng[2]);
+	Scan(k, threads, "H*x", "grid", "MatrixTimesVector", size, gflop, "GFLOP/s");
+      }
+      // DVRType 3: periodic r2c/c2r,  DVRType 4: sine DVR with DST-I
+      for (int type = 3; type <= 4; ++type) {
+	Silence();
+	DVR H;
+	H.SetupDVR(ng, type, 1, gpara, 0);
+	Speak();
+	// the plans use all threads of the construction
+	double t1 = 0;
+	for (size_t it = 0; it < threads.size(); ++it) {
+	  int nt = SetThreads(threads[it]);
+	  Silence();
+	  FFTKernel k(H, type == 4);
+	  Speak();
+	  int calls;
+	  double tcall = TimePerCall(k, &calls);
+	  if (it == 0) t1 = tcall;
+	  double gflop = 1e-9 * (5.0 * n * log2(double(n)) + 5.0 * n);
+	  Line("H*x", "grid", (type == 3) ? "VectorFFT::apply" : "VectorFFT::apply (DST-I)", size, nt, calls, tcall, gflop / tcall, "GFLOP/s", t1);
+	}
+      }
+    }
+  }
+
+  //
+  //  Davidson to convergence (first water cluster, PiaB start vector)
+  //
+  if (Wanted(kernels, "davidson") && !waters.empty()) {
+    dVec pos = WaterCluster_n(waters[0]);
+    sprintf(system, "(H2O)%d", waters[0]);
+    for (size_t ig = 0; ig < grids.size(); ++ig) {
+      int ng[3] = {grids[ig], grids[ig], grids[ig]};
+      Silence();
+      Parameters P = WaterParameters(pos, 3, 3, ng, length, 1);
+      WaterCluster WaterN;
+      Potential V;
+      SetupWaterPotential(pos, P, WaterN, V);
+      DVR H;
+      H.SetupDVR(ng, 0, 1, P.gpara, 0);
+      H.ComputePotential(V);
+      H.SetVerbose(0);
+      H.DiagonalizeSetup(1, 2, P.maxSub, P.maxIter, P.ptol);
+      Speak();
+      DavidsonKernel k(H);
+      sprintf(size, "%d^3", grids[ig]);
+      Scan(k, threads, "Davidson", system, "converged", size, 1.0, "solves/s");
+    }
+  }
+
+  //
+  //  analytical gradient of the cluster anion (after a single point)
+  //
+  if (Wanted(kernels, "gradient")) {
+    int ng[3] = {grids[0], grids[0], grids[0]};
+    sprintf(size, "%d^3", grids[0]);
+    for (size_t iw = 0; iw < waters.size(); ++iw) {
+      dVec pos = WaterCluster_n(waters[iw]);
+      Silence();
+      Parameters P = WaterParameters(pos, 3, 3, ng, length, 1);
+      ClusterAnion A;
+      A.SetUpClusterAnion(pos, P);
+      A.SinglePoint(pos);
+      WaterCluster WaterN;
+      WaterN.SetStructure(P.nWater, &pos[0], 1, P.CenterFlag, P.KTFlag, 0);
+      dVec conf(6*P.nWater);
+      WaterN.GetConfiguration(P.nWater, &conf[0], 1.0, 0);
+      Speak();
+      GradientKernel k(A, conf);
+      sprintf(system, "(H2O)%d", waters[iw]);
+      Scan(k, threads, "GetAnalGrad", system, "PotFlag3/Pol3", size, 1.0, "grads/s");
+    }
+  }
+
+  MPI_Finalize();
+  return EXIT_SUCCESS;
+}
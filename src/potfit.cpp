@@ -64,6 +64,7 @@ namespace{
   int nParaOpt = 0;
   int *mapping = 0;
   double *ParaOpt = 0;
+  int UpdateTerms = 0;   // recombine the stored term grids instead of a new Setup
   
   int ChiOutput = 1;
 }
@@ -143,11 +144,11 @@ void potfit(const dVec& WaterCoor0, const Parameters& InP)
   //  then the number of points should increase quadratically 
   //  (so inverse square weights will weigh all distances equally) 
   //
-  cout << "\nReading the reference wave function from the cube file StartVector.cub\n";
+  cout << "\nReading the reference wave function from the cube file " << InP.RefCube << "\n";
   int ncube[3] = {0,0,0};
   double x0cube[3] = {0,0,0};
   double dxcube[3] = {0,0,0};
-  ReadCubeFile(ncube, x0cube, dxcube, &eomcube);
+  ReadCubeFile(InP.RefCube, ncube, x0cube, dxcube, &eomcube);
   nCubePts = ncube[0] * ncube[1] * ncube[2];
   dvrcube = new double[nCubePts];
   weights = new double[nCubePts];
@@ -200,11 +201,24 @@ void potfit(const dVec& WaterCoor0, const Parameters& InP)
     cout << " no. " << mapping[ip] << " = " << ParaOpt[ip] << "\n";
   }
 
+  // the term grids follow the damping lengths, the Vrep scaling factors, and alpha;
+  // alpha of interacting sites (InvA), EpsDrude (PotPara[6]), and Rtol (PotPara[10])
+  // need a new Setup
+  UpdateTerms = (PotFlag[0] == 1 || PotFlag[0] == 2);
+  for (int ip = 0; ip < nParaOpt; ++ip)
+    if (mapping[ip] == 6 || mapping[ip] == 10 || (mapping[ip] == 0 && Velfit.getPolType() >= 2))
+      UpdateTerms = 0;
+  if (!UpdateTerms)
+    cout << "The potential is set up from scratch for every parameter set\n";
+
 
 
   // compute the potential on the grid
   cout << "\nEvaluate Vel on grid\n"; cout.flush();
-  Helfit.ComputePotential(Velfit);
+  if (UpdateTerms)
+    Helfit.ComputePotentialTerms(Velfit);
+  else
+    Helfit.ComputePotential(Velfit);
   cout << "\nEvaluate Vel on grid\n"; cout.flush();
 
   // compute the DVR wavefunction
@@ -394,14 +408,24 @@ double chisquared(double *fitpara)
   }
 
   // compute wavefunction of the electron with fitpara setup potential
-  if (ChiOutput >= 3) cout << "Call Vel.Setup\n";
-  Velfit.Setup(PotFlag, nSites, &Sites[0], 
-	       nCharges, &Charges[0], &iqs[0], 
-	       nDipoles, &Dipoles[0], &ids[0], 
-	       nPntPols, &Alphas[0], &ips[0], &Epc[0],	       
-	       &DmuByDR[0], PotPara);
-  if (ChiOutput >= 3) cout << "Call Hel.ComputePotential\n";
-  Helfit.ComputePotential(Velfit);
+  // for DPP6SP and DPP12SP only the parameters change, and the potential is recombined 
+  // from the stored term grids; otherwise (see UpdateTerms) it is set up and computed from scratch
+  if (UpdateTerms) {
+    if (ChiOutput >= 3) cout << "Call Vel.UpdateParameters\n";
+    Velfit.UpdateParameters(PotPara);
+    if (ChiOutput >= 3) cout << "Call Hel.UpdatePotential\n";
+    Helfit.UpdatePotential(Velfit);
+  }
+  else {
+    if (ChiOutput >= 3) cout << "Call Vel.Setup\n";
+    Velfit.Setup(PotFlag, nSites, &Sites[0], 
+		 nCharges, &Charges[0], &iqs[0], 
+		 nDipoles, &Dipoles[0], &ids[0], 
+		 nPntPols, &Alphas[0], &ips[0], &Epc[0],	       
+		 &DmuByDR[0], PotPara);
+    if (ChiOutput >= 3) cout << "Call Hel.ComputePotential\n";
+    Helfit.ComputePotential(Velfit);
+  }
   if (ChiOutput >= 3) cout << "Call Hel.Diagonalize\n";
   Helfit.Diagonalize(2, &energies[0]);
   if (ChiOutput >= 3) cout << "Call Hel.GetWaveFnCube\n";
@@ -0,0 +1,261 @@
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+#include <mpi.h>
+#include "Communicator.h"
+
+#include "timer.hpp"
+#include "constants.h"
+#include "vecdefs.h"
+#include "Parameters.h"
+#include "tsin.h"
+#include "GetInput.h"
+
+// DPP incudes
+#include "GTO.h"
+#include "MO.h"
+#include "AtomCenter.h"
+#include "Water.h"
+#include "DPP.h"
+#include "Molecule.h"
+
+// excess electron includes
+#include "Potential.h"
+#include "DVR.h"
+#include "ClusterAnion.h"
+
+#include "ptmc.h"
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////
+//
+//  runtype 5: parallel tempering (replica-exchange) Monte Carlo of a water-cluster anion
+//
+//  the ranks are split into groups of RanksPerReplica; each group is one replica with
+//  its own ClusterAnion (PiscesComm is the group), so its DVR and its last wavefunction
+//  stay warm for the whole run
+//
+//  a move displaces or rotates one water in the configuration (CoM + Euler angles)
+//  and is accepted in two stages (delayed acceptance):
+//    1. with the neutral cluster only (WaterCluster::CalcEnergy), which is cheap
+//    2. with the electron binding energy, only for the moves that passed 1.
+//  together this samples exp(-E_total/kT) exactly
+//
+//  exchanges swap temperatures, not configurations, so that the wavefunctions
+//  stay with their clusters; the decision needs one MPI_Allgather of (E, T index)
+//  and is made by all ranks with the same random numbers
+//
+//  output: pt.dat (energy at each temperature after each exchange),
+//  pt_minima.xyz (lowest structure of each replica), replicaNNN.log (output of the replicas)
+//
+namespace {
+
+  double Random(unsigned short *state) { return erand48(state); }
+
+  void Seed(unsigned short *state, int seed)
+  {
+    state[0] = 0x330e;
+    state[1] = (unsigned short)(seed & 0xffff);
+    state[2] = (unsigned short)((seed >> 16) & 0xffff);
+  }
+
+}
+
+
+void ParallelTempering(const dVec& WaterCoor, const Parameters& InP)
+{
+  int wrank, wsize;
+  MPI_Comm_rank( MPI_COMM_WORLD, &wrank );
+  MPI_Comm_size( MPI_COMM_WORLD, &wsize );
+
+  Parameters P = InP;
+  int rpr = P.ptRanksPerReplica;
+  if (rpr < 1 || wsize % rpr != 0)
+    {if(wrank==0)cout << "ParallelTempering: " << wsize << " ranks cannot be split into groups of " << rpr << "\n"; exit(1);}
+  int nrep = wsize / rpr;
+  int irep = wrank / rpr;
+  int nW = P.nWater;
+
+  MPI_Comm_split(MPI_COMM_WORLD, irep, wrank, &PiscesComm);
+  int grank;
+  MPI_Comm_rank( PiscesComm, &grank );
+  if (grank == 0 && wrank != 0) {
+    char fname[32];
+    sprintf(fname, "replica%03d.log", irep);
+    if (freopen(fname, "w", stdout) == 0)
+      {cerr << "ParallelTempering: cannot open " << fname << "\n"; exit(1);}
+  }
+
+  dVec temps(nrep);
+  for (int k = 0; k < nrep; ++k)
+    temps[k] = (nrep > 1) ? P.ptTmin * pow(P.ptTmax / P.ptTmin, double(k) / (nrep - 1)) : P.ptTmin;
+  int itemp = irep;
+
+  unsigned short mcstate[3], exstate[3];
+  Seed(mcstate, 1009 + 7919*irep);   // the same on all ranks of a replica
+  Seed(exstate, 4711);               // the same on all ranks
+
+  double rotstep = P.ptStepRot / 180.0 * PI;
+  long attempted = 0, prescreened = 0, accepted = 0;
+  iVec exAttempted(nrep, 0), exAccepted(nrep, 0);
+  double Ebest;
+  dVec best(6*nW);
+
+  FILE *fdat = 0;
+  if (wrank == 0) {
+    fdat = fopen("pt.dat", "w");
+    fprintf(fdat, "#  step   Etotal[meV] at T =");
+    for (int k = 0; k < nrep; ++k)
+      fprintf(fdat, " %8.2f", temps[k]);
+    fprintf(fdat, " K\n");
+  }
+
+  {
+    ClusterAnion Wn;
+    Wn.SetUpClusterAnion(WaterCoor, P);
+    if (nrep > 1) {
+      // every replica keeps its own restart file
+      char chkname[64];
+      sprintf(chkname, "Checkpoint.r%02d.chk", irep);
+      Wn.Hamiltonian().SetCheckpointFile(chkname);
+    }
+    WaterCluster W;
+    W.SetStructure(nW, &WaterCoor[0], 1, P.CenterFlag, P.KTFlag, 0);
+    dVec conf(6*nW), trial(6*nW);
+    W.GetConfiguration(nW, &conf[0], 1.0, 0);
+
+    double E = Wn.EnergyFromConfiguration(&conf[0]);
+    MPI_Bcast(&E, 1, MPI_DOUBLE, 0, PiscesComm);
+    W.SetConfiguration(nW, &conf[0], 1, 0);
+    double E0 = W.CalcEnergy(0);
+    double EBE = E - E0;
+    Ebest = E;
+    best = conf;
+
+    timer t;
+    for (int step = 1; step <= P.ptSteps; ++step) {
+      double beta = 1.0 / (k_in_AU * temps[itemp]);
+
+      // move one water
+      trial = conf;
+      int iw = std::min(int(nW * Random(mcstate)), nW - 1);
+      if (Random(mcstate) < 0.5)
+	for (int k = 0; k < 3; ++k)
+	  trial[6*iw+k] += P.ptStepTrans * (2*Random(mcstate) - 1);
+      else
+	for (int k = 3; k < 6; ++k)
+	  trial[6*iw+k] += rotstep * (2*Random(mcstate) - 1);
+      attempted ++;
+
+      // stage 1: neutral cluster; sin(theta) is the Jacobian of the Euler angles
+      W.SetConfiguration(nW, &trial[0], 1, 0);
+      double E0t = W.CalcEnergy(0);
+      double jac = fabs(sin(trial[6*iw+4])) / std::max(fabs(sin(conf[6*iw+4])), 1e-12);
+      if (Random(mcstate) < jac * exp(-beta * (E0t - E0))) {
+	// stage 2: the excess electron
+	double Et = Wn.EnergyFromConfiguration(&trial[0]);
+	MPI_Bcast(&Et, 1, MPI_DOUBLE, 0, PiscesComm);
+	double EBEt = Et - E0t;
+	if (Random(mcstate) < exp(-beta * (EBEt - EBE))) {
+	  conf = trial;
+	  E0 = E0t;
+	  EBE = EBEt;
+	  E = Et;
+	  accepted ++;
+	  if (E < Ebest) {
+	    Ebest = E;
+	    best = conf;
+	  }
+	}
+      }
+      else
+	prescreened ++;
+
+      //
+      //  exchange between neighboring temperatures, even and odd pairs alternating
+      //
+      if (nrep > 1 && step % P.ptExchange == 0) {
+	double mine[2] = {E, double(itemp)};
+	dVec all(2*wsize);
+	MPI_Allgather(mine, 2, MPI_DOUBLE, &all[0], 2, MPI_DOUBLE, MPI_COMM_WORLD);
+	iVec repAt(nrep);
+	dVec Erep(nrep);
+	for (int r = 0; r < nrep; ++r) {
+	  Erep[r] = all[2*r*rpr];
+	  repAt[int(all[2*r*rpr+1])] = r;
+	}
+	for (int k = (step / P.ptExchange) % 2; k + 1 < nrep; k += 2) {
+	  int a = repAt[k], b = repAt[k+1];
+	  double db = 1.0 / (k_in_AU * temps[k]) - 1.0 / (k_in_AU * temps[k+1]);
+	  exAttempted[k] ++;
+	  if (Random(exstate) < exp(db * (Erep[a] - Erep[b]))) {
+	    exAccepted[k] ++;
+	    repAt[k] = b;
+	    repAt[k+1] = a;
+	  }
+	}
+	for (int k = 0; k < nrep; ++k)
+	  if (repAt[k] == irep)
+	    itemp = k;
+	if (wrank == 0) {
+	  fprintf(fdat, "%7i", step);
+	  for (int k = 0; k < nrep; ++k)
+	    fprintf(fdat, " %12.4f", Erep[repAt[k]] * AU2MEV);
+	  fprintf(fdat, "\n");
+	  fflush(fdat);
+	}
+      }
+    }
+    if (grank == 0)
+      cout << "\nReplica " << irep << ": " << attempted << " moves, " << prescreened << " rejected by the neutral cluster, "
+	   << accepted << " accepted, " << t.elapsed() << " s\n";
+  }
+
+  //
+  //  statistics and the lowest structure of every replica on rank 0
+  //
+  long mine[3] = {attempted, prescreened, accepted};
+  vector<long> counts(3*wsize);
+  MPI_Gather(mine, 3, MPI_LONG, &counts[0], 3, MPI_LONG, 0, MPI_COMM_WORLD);
+  dVec bests(wsize), confs(6*nW*wsize);
+  MPI_Gather(&Ebest, 1, MPI_DOUBLE, &bests[0], 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+  MPI_Gather(&best[0], 6*nW, MPI_DOUBLE, &confs[0], 6*nW, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+  if (wrank == 0) {
+    cout << "\nParallel tempering: " << nrep << " replicas\n";
+    cout << "replica   moves   prescreened   accepted   lowest Etotal [meV]\n";
+    for (int r = 0; r < nrep; ++r) {
+      const long *c = &counts[3*r*rpr];
+      printf(" %4i  %8li  %10li  %10li  %14.4f\n", r, c[0], c[1], c[2], bests[r*rpr]*AU2MEV);
+    }
+    if (nrep > 1) {
+      cout << "exchange acceptance between neighboring temperatures:\n";
+      for (int k = 0; k + 1 < nrep; ++k)
+	printf("  %8.2f K <-> %8.2f K  %6.3f\n", temps[k], temps[k+1],
+	       (exAttempted[k] > 0) ? double(exAccepted[k]) / exAttempted[k] : 0.0);
+    }
+    fclose(fdat);
+
+    FILE *fxyz = fopen("pt_minima.xyz", "w");
+    WaterCluster W;
+    W.SetStructure(nW, &WaterCoor[0], 1, P.CenterFlag, P.KTFlag, 0);
+    dVec xyz(9*nW);
+    char tag[] = "PTMin";
+    for (int r = 0; r < nrep; ++r) {
+      W.SetConfiguration(nW, &confs[6*nW*r*rpr], 1, 0);
+      W.GetStructure(nW, &xyz[0], Bohr2Angs, 0);
+      double comment = bests[r*rpr] * AU2MEV;
+      PutStructure(fxyz, 3*nW, &xyz[0], r, tag, 1, &comment);
+    }
+    fclose(fxyz);
+    cout << "The lowest structures of all replicas are in pt_minima.xyz\n";
+  }
+
+  MPI_Comm_free(&PiscesComm);
+  PiscesComm = MPI_COMM_WORLD;
+}
@@ -0,0 +1 @@
+void ParallelTempering(const dVec& WaterCoor, const Parameters& InP);
@@ -4,6 +4,8 @@
 #include <string>
 #include <iostream>
 
+#include "Profiler.h"
+
 #ifdef _OPENMP
 #include <omp.h>
 #else
@@ -42,15 +44,17 @@ class timer
 
 
 /// Writes to std::cout the total time of scoping block
+/// (the block is also a Profiler region; with the Profiler enabled the time is not printed)
 class progress_timer
 {
 public:
   progress_timer(const std::string& name="_", int verbose = 2)
       : m_name (name) 
       , m_verb (verbose)
+      , m_region (name.c_str())
       {m_name.resize(20,' ');}
    ~progress_timer() {
-      if ( m_verb >= 0 )
+      if ( m_verb >= 0 && !Profiler::Enabled() )
          std::cout << "  time: " << m_name << ": " << m_t.elapsed()  << std::endl;
    }
 
@@ -58,6 +62,7 @@ private:
    timer m_t;
    std::string m_name;
   int m_verb;
+  profile_region m_region;
 };
 
 #endif  // BOOST_TIMER_HPP
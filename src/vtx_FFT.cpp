@@ -9,6 +9,7 @@
 
 #include <iostream> 
 #include <mpi.h> 
+#include "Communicator.h"
 
 #include "DVR.h"
 
@@ -18,7 +19,7 @@
 void DVR::VectorFFT_old(const double *x, double *y)
 {
   int rank;
-  MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+  MPI_Comm_rank( PiscesComm, &rank );
 //  fftw_mpi_init();
 
    m_pkc->c++;
@@ -70,7 +71,8 @@ void DVR::VectorFFT_old(const double *x, double *y)
   {
      #pragma omp for   
      for(int igr = 0; igr < ngp; igr++){
-           KE_phi_k[igr] = KE_diag[igr] * phi_k[igr]; 
+           KE_phi_k[igr] = (ke_spec[0][igr % n_1dbas[0]] + ke_spec[1][(igr / n_1dbas[0]) % n_1dbas[1]]
+                            + ke_spec[2][igr / (n_1dbas[0]*n_1dbas[1])]) * phi_k[igr]; 
         //  if(rank==0)cout<<"phi_k["<<igr<<"]= "<<phi_k[igr]<<endl;
           //if(rank==0)cout<<"KE_diag["<<igr<<"]= "<<KE_diag[igr]<<endl;
         //  if(rank==0)cout<<"KE_phi_k["<<igr<<"]= "<<KE_phi_k[igr]<<endl;